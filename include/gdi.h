@@ -600,7 +600,7 @@ typedef struct _BLOCKHEAP
      */
     size_t          heap_size;
     /**
-     * The first free element in the heap.
+     * The index of the first block in the free list; -1 if the list is empty.
      */
     int             free;
     /**
@@ -648,6 +648,7 @@ MG_EXPORT extern void InitBlockDataHeap (PBLOCKHEAP heap,
  *
  * This function allocates a data block from an initialized
  * block data heap. The allocated block will have the size of \a heap->bd_size.
+ * The free blocks are kept in a list, so the allocation takes a constant time.
  * If there is no free block in the heap, this function will try to allocate
  * the block from the system heap by using \a malloc(3) function.
  *
@@ -684,6 +685,47 @@ MG_EXPORT extern void BlockDataFree (PBLOCKHEAP heap, void* data);
  */
 MG_EXPORT extern void DestroyBlockDataHeap (PBLOCKHEAP heap);
 
+/**
+ * The struct type defines the statistics of a private block data heap.
+ *
+ * \sa GetBlockDataHeapStats
+ *
+ * Since 5.0.0
+ */
+typedef struct _BLOCKHEAPSTATS {
+    /** The size of the pre-allocated heap in blocks. */
+    size_t heap_size;
+    /** The number of the blocks in use. */
+    size_t nr_used;
+    /** The high-water mark of the blocks in use. */
+    size_t nr_peak;
+    /** The number of the allocations served by the pre-allocated heap. */
+    Uint64 nr_hits;
+    /** The number of the allocations served by the system heap. */
+    Uint64 nr_overflows;
+} BLOCKHEAPSTATS;
+
+/**
+ * \fn BOOL GetBlockDataHeapStats (PBLOCKHEAP heap, BLOCKHEAPSTATS* stats)
+ * \brief Gets the statistics of a private block data heap.
+ *
+ * This function gets the usage counters of the block data heap \a heap.
+ * You can use the high-water mark and the number of overflow allocations
+ * to tune the size of the heap.
+ *
+ * \param heap The pointer to the initialized heap.
+ * \param stats The pointer to a BLOCKHEAPSTATS structure to hold
+ *      the statistics.
+ *
+ * \return TRUE on success, FALSE on invalid arguments.
+ *
+ * \sa InitBlockDataHeap, BLOCKHEAPSTATS
+ *
+ * Since 5.0.0
+ */
+MG_EXPORT extern BOOL GetBlockDataHeapStats (PBLOCKHEAP heap,
+                BLOCKHEAPSTATS* stats);
+
     /** @} end of block_heap_fns */
 
     /** @} end of global_fns */
@@ -1631,6 +1673,7 @@ MG_EXPORT BOOL GUIAPI RestoreDC (HDC hdc, int saved_dc);
 #define MEMDC_FLAG_SRCALPHA         0x00010000  /* Blit uses source alpha blending*/
 #define MEMDC_FLAG_SRCPIXELALPHA    0x00020000  /* Blit uses source per-pixel alpha blending*/
 #define MEMDC_FLAG_RLEACCEL         0x00004000  /* Surface is RLE encoded */
+#define MEMDC_FLAG_PREMULALPHA      0x00040000  /* Pixels are premultiplied by alpha */
 
 /**
  * \fn HDC GUIAPI CreateCompatibleDCEx (HDC hdc, int width, int height)
@@ -1738,6 +1781,19 @@ MG_EXPORT BOOL GUIAPI IsWindowDC (HDC hdc);
  *     other DC.
  *   - MEMDC_FLAG_RLEACCEL\n
  *     The memory DC will be RLE encoded.
+ *   - MEMDC_FLAG_PREMULALPHA\n
+ *     The color components of the pixels in the memory DC are premultiplied
+ *     by the alpha component (since 5.0.0). Only the 32-bit pixel formats
+ *     with an 8-bit alpha channel support this flag; it is ignored for
+ *     other pixel formats. The per-pixel alpha blending from a premultiplied
+ *     memory DC saves a multiplication per component.
+ *     The colors are premultiplied by RGBA2Pixel, RGBA2Pixels and
+ *     DWORD2Pixel, by CompileRGBABitmap(Ex), and by the per-pixel alpha
+ *     blits into the DC; Pixel2RGBA and Pixel2RGBAs return the colors
+ *     divided by alpha again. The other primitives write the pixel values
+ *     they are given, so use these functions to get the pixel values of
+ *     the colors. A pixel whose color components are larger than its
+ *     alpha component is clamped when blended, not wrapped.
  *
  * \param Rmask The bit-masks of the red components in a pixel value.
  * \param Gmask The bit-masks of the green components in a pixel value.
@@ -1783,6 +1839,19 @@ MG_EXPORT HDC GUIAPI CreateMemDCEx (int width, int height, int depth, DWORD flag
  *     other DC.
  *   - MEMDC_FLAG_RLEACCEL\n
  *     The memory DC will be RLE encoded.
+ *   - MEMDC_FLAG_PREMULALPHA\n
+ *     The color components of the pixels in the memory DC are premultiplied
+ *     by the alpha component (since 5.0.0). Only the 32-bit pixel formats
+ *     with an 8-bit alpha channel support this flag; it is ignored for
+ *     other pixel formats. The per-pixel alpha blending from a premultiplied
+ *     memory DC saves a multiplication per component.
+ *     The colors are premultiplied by RGBA2Pixel, RGBA2Pixels and
+ *     DWORD2Pixel, by CompileRGBABitmap(Ex), and by the per-pixel alpha
+ *     blits into the DC; Pixel2RGBA and Pixel2RGBAs return the colors
+ *     divided by alpha again. The other primitives write the pixel values
+ *     they are given, so use these functions to get the pixel values of
+ *     the colors. A pixel whose color components are larger than its
+ *     alpha component is clamped when blended, not wrapped.
  *
  * \param Rmask The bit-masks of the red components in a pixel value.
  * \param Gmask The bit-masks of the green components in a pixel value.
@@ -3715,6 +3784,8 @@ MG_EXPORT BOOL GUIAPI FloodFillGenerator (void* context,
 #define BITMAP_SCALER_DDA       0
 /* Bilinear interpolation algorithm */
 #define BITMAP_SCALER_BILINEAR  1
+/* Box (area-average) filter, since 5.0.0 */
+#define BITMAP_SCALER_AREA      2
 
 /**
  * \fn int GUIAPI SetBitmapScalerType (HDC hdc, int scaler_type);
@@ -3722,10 +3793,16 @@ MG_EXPORT BOOL GUIAPI FloodFillGenerator (void* context,
  *
  * This function sets the bitmap scaler with DDA or bilinear interpolation
  * algorithm. MiniGUI implements StretchBlt functions by using this scaler.
+ * ScaleBitmapEx also uses the scaler of the reference DC.
+ *
+ * The bilinear and the box (area-average) scalers filter the pixels of
+ * 16-bit, 24-bit, and 32-bit bitmaps; the box filter gives better result
+ * when shrinking a bitmap. The bitmaps with a color key or an alpha mask
+ * are not filtered.
  *
  * \param hdc The device context.
- * \param scaler_type The type of scaler algorithm, use BITMAP_SCALER_DDA
- *        or BITMAP_SCALER_BILINEAR.
+ * \param scaler_type The type of scaler algorithm, use BITMAP_SCALER_DDA,
+ *        BITMAP_SCALER_BILINEAR, or BITMAP_SCALER_AREA (since 5.0.0).
  *
  * \sa BitmapDDAScaler, BitmapBinearScaler
  */
@@ -10887,6 +10964,45 @@ MG_EXPORT int GUIAPI DrawTextEx2 (HDC hdc, const char* pText, int nCount,
  */
 #define DrawTextEx(hdc, text, n, rc, indent, format)    \
                 DrawTextEx2 (hdc, text, n, rc, indent, format, NULL)
+
+/**
+ * The struct type defines the statistics of the layout cache of
+ * \a DrawTextEx2. The cache keeps the line breaks and the glyphs of
+ * the texts drawn recently by every thread, so drawing a text again
+ * with the same logical font, format, and width of the rectangle only
+ * draws the glyphs. The layouts of a logical font are dropped when the
+ * font is destroyed.
+ *
+ * \sa GetDrawTextCacheStats
+ *
+ * Since 5.0.0
+ */
+typedef struct _DRAWTEXTCACHESTATS {
+    /** The number of the layouts in the caches of all threads. */
+    size_t nr_layouts;
+    /** The number of the texts drawn with a cached layout. */
+    Uint64 nr_hits;
+    /** The number of the texts laid out. */
+    Uint64 nr_misses;
+    /** The number of the layouts evicted to cache new ones. */
+    Uint64 nr_evictions;
+} DRAWTEXTCACHESTATS;
+
+/**
+ * \fn BOOL GetDrawTextCacheStats (DRAWTEXTCACHESTATS* stats)
+ * \brief Gets the statistics of the layout cache of DrawTextEx2.
+ *
+ * \param stats The pointer to a DRAWTEXTCACHESTATS structure to hold
+ *      the statistics.
+ *
+ * \return TRUE on success, FALSE if the cache is not enabled
+ *      (see `--enable-drawtextcache`).
+ *
+ * \sa DrawTextEx2
+ *
+ * Since 5.0.0
+ */
+MG_EXPORT BOOL GUIAPI GetDrawTextCacheStats (DRAWTEXTCACHESTATS* stats);
     /** @} end of text_output_fns */
 
     /**
@@ -12928,6 +13044,51 @@ typedef struct _GLYPHINFO {
 MG_EXPORT int GUIAPI GetGlyphInfo (LOGFONT* logfont, Glyph32 glyph_value,
         GLYPHINFO* glyph_info);
 
+#ifdef _MGFONT_GLYPH_CACHE
+
+/**
+ * The struct type defines the statistics of the glyph cache, which keeps
+ * the glyph bitmaps expanded for the bold, italic, scale and flip styles,
+ * so that a glyph drawn again with the same logical font is not expanded
+ * again.
+ *
+ * \sa GetGlyphCacheStats
+ *
+ * Since 5.0.0
+ */
+typedef struct _GlyphCacheStats {
+    /** The number of the glyphs in the cache. */
+    unsigned long nr_glyphs;
+    /** The number of the bytes used by the glyphs in the cache. */
+    size_t mem_used;
+    /** The number of the lookups which found the glyph in the cache. */
+    unsigned long nr_hits;
+    /** The number of the lookups which did not find the glyph. */
+    unsigned long nr_misses;
+    /** The number of the glyphs evicted to keep the memory budget. */
+    unsigned long nr_evictions;
+} GlyphCacheStats;
+
+/**
+ * \fn BOOL GUIAPI GetGlyphCacheStats (GlyphCacheStats* stats)
+ * \brief Get the statistics of the glyph cache.
+ *
+ * This function gets the statistics of the glyph cache of the current
+ * process. The counters are accumulated since MiniGUI was initialized.
+ *
+ * \param stats The pointer to a GlyphCacheStats structure to hold
+ *      the statistics.
+ *
+ * \return TRUE on success, FALSE if \a stats is NULL.
+ *
+ * \sa GlyphCacheStats
+ *
+ * Since 5.0.0
+ */
+MG_EXPORT BOOL GUIAPI GetGlyphCacheStats (GlyphCacheStats* stats);
+
+#endif /* _MGFONT_GLYPH_CACHE */
+
 #ifdef _MGCHARSET_UNICODE
 
     /**
@@ -13744,6 +13905,48 @@ MG_EXPORT BOOL GUIAPI SetBackgroundColorInTextRuns(TEXTRUNS* truns,
 MG_EXPORT RGBCOLOR GUIAPI GetBackgroundColorInTextRuns(
         const TEXTRUNS* truns, int index);
 
+/**
+ * \fn BOOL GUIAPI UpdateTextRuns(TEXTRUNS* truns,
+ *      const Uchar32* ucs, int nr_ucs,
+ *      int start_index, int old_length, int new_length,
+ *      BreakOppo* break_oppos)
+ * \brief Update a TEXTRUNS object after the text of the paragraph changed.
+ *
+ * This function updates the TEXTRUNS object \a truns after \a old_length
+ * characters starting at \a start_index of the paragraph were replaced
+ * by \a new_length characters, for example, when the user edited the text.
+ * The font names and the colors set for the text not changed are kept;
+ * the characters inserted use the font name and the colors of the
+ * character before them.
+ *
+ * After this function, call \a UpdateLayout to update the layouts of
+ * the TEXTRUNS object; they will reuse the lines not affected by
+ * the change.
+ *
+ * \param truns The TEXTRUNS object.
+ * \param ucs The Uchar32 string of the paragraph changed; it can be
+ *      another buffer than the one used before.
+ * \param nr_ucs The length of the Uchar32 string changed.
+ * \param start_index The start index of the text changed.
+ * \param old_length The length of the text replaced.
+ * \param new_length The length of the new text.
+ * \param break_oppos If not NULL, the break opportunities of the changed
+ *      paragraph which will be tailored as \a CreateTextRuns does.
+ *
+ * \return TRUE for success, otherwise FALSE. The TEXTRUNS object keeps
+ *      unchanged on failure.
+ *
+ * \note Only available when support for UNICODE is enabled.
+ *
+ * \sa CreateTextRuns, UpdateLayout
+ *
+ * Since 5.0.0
+ */
+MG_EXPORT BOOL GUIAPI UpdateTextRuns(TEXTRUNS* truns,
+        const Uchar32* ucs, int nr_ucs,
+        int start_index, int old_length, int new_length,
+        BreakOppo* break_oppos);
+
 /**
  * \fn BOOL GUIAPI DestroyTextRuns(TEXTRUNS* truns)
  *
@@ -14015,6 +14218,48 @@ MG_EXPORT LAYOUTLINE* GUIAPI LayoutNextLine(LAYOUT* layout,
         LAYOUTLINE* prev_line, int max_extent, BOOL last_line,
         CB_GLYPH_LAID_OUT cb_laid_out, GHANDLE ctxt);
 
+/**
+ * \fn BOOL GUIAPI UpdateLayout(LAYOUT* layout,
+ *      const BreakOppo* break_oppos, int* first_line, int* nr_lines)
+ * \brief Update a layout after the text of the paragraph changed.
+ *
+ * This function updates the layout \a layout after the text of
+ * its TEXTRUNS object changed by calling \a UpdateTextRuns.
+ *
+ * If the lines of the layout are persisted, the function lays out again
+ * only the lines affected by the change: it starts from the line before
+ * the one containing the change, and stops when a new line ends where
+ * an old line after the change starts. The old line and the lines after
+ * it are reused. The lines before the first one laid out again are kept
+ * as well, while the other old lines are released. Iterate the lines
+ * by calling \a LayoutNextLine from NULL again after this function.
+ *
+ * If the lines are not persisted, or the layout missed some changes of
+ * the TEXTRUNS object, the function only resets the layout, and you
+ * need to lay out all lines again.
+ *
+ * \param layout The LAYOUT object.
+ * \param break_oppos NULL or the new break opportunities of the changed
+ *      paragraph, if they are not stored in the buffer passed to
+ *      \a CreateLayout any more.
+ * \param first_line NULL or the buffer to return the index of the first
+ *      line laid out again.
+ * \param nr_lines NULL or the buffer to return the number of the lines
+ *      laid out again.
+ *
+ * \return TRUE for success, otherwise FALSE.
+ *
+ * \note When the line extent is variable, the lines laid out again use
+ *      the extents of the old lines at the same indexes, and the old lines
+ *      are only reused when their indexes do not change.
+ *
+ * \sa UpdateTextRuns, CreateLayout, LayoutNextLine
+ *
+ * Since 5.0.0
+ */
+MG_EXPORT BOOL GUIAPI UpdateLayout(LAYOUT* layout,
+        const BreakOppo* break_oppos, int* first_line, int* nr_lines);
+
 /**
  * \fn BOOL GUIAPI GetLayoutLineSize(const LAYOUTLINE* line,
  *      SIZE* line_size)
@@ -14311,6 +14556,45 @@ MG_EXPORT int GUIAPI SetUserCompositionOps (HDC hdc,
  */
 MG_EXPORT GHANDLE GetVideoHandle (HDC hdc);
 
+/**
+ * The struct type defines the statistics of the damage filter of a video.
+ * The damage filter keeps a checksum of every tile of the screen as it was
+ * presented last time, and drops the update rectangles of the tiles whose
+ * contents did not change before refreshing the screen.
+ *
+ * The filter is disabled by default; it is enabled by the key
+ * `damage_tile_size` in the section of the NEWGAL engine, or by the
+ * environment variable `MG_GAL_DAMAGE_TILE_SIZE`.
+ *
+ * \sa GetDamageFilterStats
+ *
+ * Since 5.0.0
+ */
+typedef struct _DamageFilterStats {
+    /** The size of the tiles in pixels. */
+    int tile_size;
+    /** The number of the tiles dropped since their contents did not change. */
+    Uint64 nr_hits;
+    /** The number of the tiles passed to the engine. */
+    Uint64 nr_misses;
+} DamageFilterStats;
+
+/**
+ * This function gets the statistics of the damage filter of a video.
+ *
+ * \param video The video handle returned by \a GetVideoHandle.
+ * \param stats The pointer to a DamageFilterStats structure to hold
+ *      the statistics.
+ *
+ * \return TRUE on success, FALSE if the damage filter is not enabled
+ *      for the video.
+ *
+ * \sa GetVideoHandle
+ *
+ * Since 5.0.0
+ */
+MG_EXPORT BOOL GetDamageFilterStats (GHANDLE video, DamageFilterStats* stats);
+
 #ifdef _MGGAL_DRM
 
 /**
@@ -14467,6 +14751,54 @@ static inline HDC drmCreateDCFromHandle (GHANDLE video,
 
 #endif /* _MGGAL_DRM */
 
+#ifdef _MGGAL_SHADOW
+
+/**
+  * \defgroup gdi_shadow_fns Functions for the Shadow NEWGAL engine
+  *
+  * The Shadow engine copies the dirty areas of the shadow frame buffer
+  * to the real engine in a refresh thread. The thread sleeps until
+  * there is an update, and coalesces the updates in one frame interval
+  * (the key `refresh_fps` in the section `shadow`) into one refresh.
+  *
+  * \note Only available when support for the Shadow NEWGAL engine
+  * (`_MGGAL_SHADOW`) is enabled.
+  *
+  * Since 5.0.0
+  *
+  * @{
+  */
+
+/**
+ * The struct type defines the statistics of the refresh thread of
+ * the Shadow engine.
+ */
+typedef struct _ShadowRefreshStats {
+    /** The number of refreshes in the last second. */
+    unsigned int refreshes_per_second;
+    /** The total number of refreshes. */
+    unsigned int nr_refreshes;
+    /** The total number of pixels copied to the real engine. */
+    Uint64 nr_pixels;
+    /** The average latency from an update to the refresh, in microseconds. */
+    unsigned int avg_latency_us;
+} ShadowRefreshStats;
+
+/**
+ * This function gets the statistics of the refresh thread of the Shadow
+ * engine.
+ *
+ * \param stats The pointer to a ShadowRefreshStats structure to hold
+ *      the statistics.
+ *
+ * \return TRUE on success, FALSE if the Shadow engine is not in use.
+ */
+MG_EXPORT BOOL shadowGetRefreshStats (ShadowRefreshStats* stats);
+
+/** @} end of gdi_shadow_fns */
+
+#endif /* _MGGAL_SHADOW */
+
     /** @} end of gdi_fns */
 
 #ifdef _MGGAL_HI3560
@@ -6885,7 +6885,8 @@ static inline BOOL MainWindowThreadCleanup (HWND hMainWnd)
 #define ST_PIXEL_ARGB1555       0x0002
 #define ST_PIXEL_ARGB8888       0x0003
 
-/* other flags for future use */
+/* other flags */
+#define ST_PREMULALPHA          0x0100  /* Pixels are premultiplied by alpha */
 
 /* for default surface flags */
 #define ST_DEFAULT              (ST_PIXEL_DEFAULT)
@@ -6929,6 +6930,11 @@ static inline BOOL MainWindowThreadCleanup (HWND hMainWnd)
  *          - ST_PIXEL_ARGB8888\n
  *            Creating a surface for this main window with
  *            the pixel format ARGB8888.
+ *      For ST_PIXEL_ARGB8888, you can OR the value with ST_PREMULALPHA
+ *      to create a surface whose color components are premultiplied by
+ *      the alpha component (since 5.0.0). The compositor blends such a
+ *      surface with the cheaper premultiplied alpha equation when the
+ *      compositing type is CT_ALPHAPIXEL.
  * \param bkgnd_color The background color of the main window if you specify
  *  the main window's surface type other than the default. In this case,
  *  you must use this argument to specify the background color of the main
@@ -78,6 +78,52 @@ extern "C" {
      * @{
      */
 
+/** The magic number of the ring of dirty rectangles; since 5.0.0. */
+#define XVFB_DIRTY_RING_MAGIC       0x58444952
+
+/** The version of the ring of dirty rectangles; since 5.0.0. */
+#define XVFB_DIRTY_RING_VERSION     1
+
+/** The number of the slots in the ring of dirty rectangles; since 5.0.0. */
+#define XVFB_NR_DIRTY_RECTS         32
+
+/** A dirty rectangle in the ring; since 5.0.0. */
+typedef struct _XVFBDirtyRect {
+    /** the left of the rectangle */
+    int l;
+    /** the top of the rectangle */
+    int t;
+    /** the right of the rectangle */
+    int r;
+    /** the bottom of the rectangle */
+    int b;
+} XVFBDirtyRect;
+
+/**
+ * The ring of dirty rectangles; since 5.0.0.
+ *
+ * MiniGUI writes a dirty rectangle to the slot `seq % XVFB_NR_DIRTY_RECTS`
+ * and then increases `seq`, besides growing the bounding rectangle
+ * of the header. A viewer keeps the sequence number it has consumed,
+ * and repaints the rectangles between it and `seq` without locking
+ * the header. If the difference is larger than XVFB_NR_DIRTY_RECTS
+ * before or after copying the rectangles, the viewer has been lapped, and
+ * it should repaint the bounding rectangle instead.
+ *
+ * The ring is valid only if `magic` is XVFB_DIRTY_RING_MAGIC; the old
+ * viewers simply ignore it and use the bounding rectangle.
+ */
+typedef struct _XVFBDirtyRing {
+    /** the magic number: XVFB_DIRTY_RING_MAGIC */
+    int magic;
+    /** the version of the ring: XVFB_DIRTY_RING_VERSION */
+    int version;
+    /** the number of the rectangles written to the ring so far */
+    volatile unsigned int seq;
+    /** the slots of the rectangles */
+    XVFBDirtyRect rcs [XVFB_NR_DIRTY_RECTS];
+} XVFBDirtyRing;
+
 /** infomation header of xvfb frame buffer. */
 typedef struct _XVFBHeader {
 
@@ -140,6 +186,9 @@ typedef struct _XVFBHeader {
 
     /** the offset off framebuffer based on address of XVFBHeader. */
     int fb_offset;
+
+    /** the ring of dirty rectangles; since 5.0.0. */
+    XVFBDirtyRing dirty_ring;
 } XVFBHeader;
 
 
@@ -117,6 +117,11 @@ static Achar32 utf8_get_char_value (const unsigned char* pre_mchar, int pre_len,
 
 #include "unicode-tables.h"
 #include "unicode-break-tables.h"
+#include "unicode-width-table.inc"
+
+/* The values of UCHAR_GET_WIDTH; see utils/gen-props-tab.c */
+#define UCHAR_WIDTH_WIDE        1
+#define UCHAR_WIDTH_AMBIGUOUS   2
 
 #define ATTR_TABLE(Page) (((Page) <= UCHAR_LAST_PAGE_PART1) \
                           ? attr_table_part1[Page] \
@@ -1242,66 +1247,14 @@ BOOL GUIAPI IsUCharZeroWidth(Uchar32 uc)
     return FALSE;
 }
 
-static inline BOOL g_unichar_iswide_bsearch (Uchar32 ch)
-{
-    unsigned int lower = 0;
-    unsigned int upper = TABLESIZE (unicode_width_table_wide) - 1;
-    int mid = TABLESIZE (unicode_width_table_wide) / 2;
-
-    do {
-        if (ch < unicode_width_table_wide[mid].start)
-            upper = mid - 1;
-        else if (ch > unicode_width_table_wide[mid].end)
-            lower = mid + 1;
-        else
-            return TRUE;
-
-        mid = (lower + upper) / 2;
-    }
-    while (lower <= upper);
-
-    return FALSE;
-}
-
 BOOL GUIAPI IsUCharWide(Uchar32 uc)
 {
-    if (uc < unicode_width_table_wide[0].start)
-        return FALSE;
-    else
-        return g_unichar_iswide_bsearch (uc);
-}
-
-static int interval_compare (const void *key, const void *elt)
-{
-    Uchar32 uc = (Uchar32)((intptr_t)key);
-    struct Interval *interval = (struct Interval *)elt;
-
-    if (uc < interval->start)
-        return -1;
-    if (uc > interval->end)
-        return +1;
-
-    return 0;
+    return UCHAR_GET_WIDTH(uc) == UCHAR_WIDTH_WIDE;
 }
 
 BOOL GUIAPI IsUCharWideCJK (Uchar32 uc)
 {
-    if (IsUCharWide(uc))
-        return TRUE;
-
-    /* bsearch() is declared attribute(nonnull(1)) so we can't validly search
-     * for a NULL key */
-    if (uc == 0)
-        return FALSE;
-
-    if (bsearch((void*)((intptr_t)uc),
-                unicode_width_table_ambiguous,
-                TABLESIZE (unicode_width_table_ambiguous),
-                sizeof unicode_width_table_ambiguous[0],
-                interval_compare))
-        return TRUE;
-
-    return FALSE;
+    return UCHAR_GET_WIDTH(uc) != 0;
 }
 
 /**
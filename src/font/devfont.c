@@ -939,6 +939,8 @@ static void del_devfont_from_list(const char* font_name, BOOL is_mbc_list)
 
     while (cur) {
         if (strcmp (cur->name, font_name) == 0) {
+            __mg_glyph_cache_purge (cur);
+
             /*unload cur->data*/
             if (!cur->relationship && cur->need_unload)
                 cur->font_ops->unload_font_data (cur, cur->data);
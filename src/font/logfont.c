@@ -248,6 +248,7 @@ static PLOGFONT gdiCreateLogFont (const char* type, const char* family,
             newlf->type, newlf->family, newlf->style,
             newlf->size, newlf->charset);
 
+    __mg_advance_cache_new (newlf);
     return newlf;
 
 error:
@@ -310,6 +311,7 @@ PLOGFONT GUIAPI CreateLogFontIndirect (LOGFONT *reflf)
 
     adjust_newlf_info(newlf);
 
+    __mg_advance_cache_new (newlf);
     return newlf;
 
 error:
@@ -382,6 +384,7 @@ PLOGFONT GUIAPI CreateLogFontIndirectEx (LOGFONT *reflf, int rotation)
     }
 
     adjust_newlf_info(newlf);
+    __mg_advance_cache_new (newlf);
     return newlf;
 
 error:
@@ -518,10 +521,15 @@ void GUIAPI DestroyLogFont (PLOGFONT logfont)
     if (!logfont)
         return;
 
+    __mg_drawtext_cache_purge (logfont);
+    __mg_advance_cache_free (logfont);
+
     for (i = 0; i < MAXNR_DEVFONTS; i++) {
         DEVFONT* df = logfont->devfonts[i];
-        if (df && df->font_ops->delete_instance)
+        if (df && df->font_ops->delete_instance) {
+            __mg_glyph_cache_purge (df);
             df->font_ops->delete_instance(df);
+        }
     }
 
     free(logfont->type);
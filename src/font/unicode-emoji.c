@@ -65,43 +65,32 @@
 #ifdef _MGCHARSET_UNICODE
 
 #include "unicode-ops.h"
-#include "unicode-emoji-tables.h"
+#include "unicode-emoji-props-table.inc"
 
-static int interval_compare(const void *key, const void *elt)
-{
-    Uchar32 c = (Uchar32)(intptr_t)key;
-    struct Interval *interval = (struct Interval *)elt;
-
-    if (c < interval->start)
-        return -1;
-    if (c > interval->end)
-        return +1;
-
-    return 0;
-}
+/* The bits of UCHAR_GET_EMOJI_PROPS; see utils/gen-props-tab.c */
+#define EMOJI_PROP_EMOJI                    0x01
+#define EMOJI_PROP_EMOJI_PRESENTATION       0x02
+#define EMOJI_PROP_EMOJI_MODIFIER           0x04
+#define EMOJI_PROP_EMOJI_MODIFIER_BASE      0x08
+#define EMOJI_PROP_EXTENDED_PICTOGRAPHIC    0x10
 
-#define DEFINE_unicode_is_(name) \
+#define DEFINE_unicode_is_(name, prop) \
     BOOL _unicode_is_##name (Uchar32 ch) \
 { \
-    if (bsearch ((void*)((intptr_t)ch), \
-                _unicode_##name##_table, \
-                TABLESIZE (_unicode_##name##_table), \
-                sizeof _unicode_##name##_table[0], \
-                interval_compare)) \
-        return TRUE; \
-    \
-    return FALSE; \
+    return (UCHAR_GET_EMOJI_PROPS(ch) & prop) ? TRUE : FALSE; \
 }
 
-DEFINE_unicode_is_(emoji)
-DEFINE_unicode_is_(emoji_presentation)
-DEFINE_unicode_is_(emoji_modifier)
-DEFINE_unicode_is_(emoji_modifier_base)
-DEFINE_unicode_is_(extended_pictographic)
+DEFINE_unicode_is_(emoji, EMOJI_PROP_EMOJI)
+DEFINE_unicode_is_(emoji_presentation, EMOJI_PROP_EMOJI_PRESENTATION)
+DEFINE_unicode_is_(emoji_modifier, EMOJI_PROP_EMOJI_MODIFIER)
+DEFINE_unicode_is_(emoji_modifier_base, EMOJI_PROP_EMOJI_MODIFIER_BASE)
+DEFINE_unicode_is_(extended_pictographic, EMOJI_PROP_EXTENDED_PICTOGRAPHIC)
 
 BOOL _unicode_is_emoji_text_default(Uchar32 ch)
 {
-    return _unicode_is_emoji(ch) && !_unicode_is_emoji_presentation(ch);
+    return (UCHAR_GET_EMOJI_PROPS(ch) &
+            (EMOJI_PROP_EMOJI | EMOJI_PROP_EMOJI_PRESENTATION))
+        == EMOJI_PROP_EMOJI;
 }
 
 BOOL _unicode_is_emoji_emoji_default(Uchar32 ch)
@@ -55,38 +55,11 @@
 
 #ifdef _MGCHARSET_UNICODE
 
-#include "unicode-script-table.h"
-
-#define SCRIPT_TABLE_MIDPOINT (TABLESIZE (unicode_script_table) / 2)
-
-static inline int unichar_get_script_bsearch (Uchar32 ch)
-{
-    int lower = 0;
-    int upper = (int)TABLESIZE (unicode_script_table) - 1;
-    static int saved_mid = SCRIPT_TABLE_MIDPOINT;
-    int mid = saved_mid;
-
-    do {
-        if (ch < unicode_script_table[mid].start)
-            upper = mid - 1;
-        else if (ch >= unicode_script_table[mid].start + unicode_script_table[mid].chars)
-            lower = mid + 1;
-        else
-            return unicode_script_table[saved_mid = mid].script;
-
-        mid = (lower + upper) / 2;
-
-    } while (lower <= upper);
-
-    return SCRIPT_UNKNOWN;
-}
+#include "unicode-script-type-table.inc"
 
 ScriptType GUIAPI UCharGetScriptType (Uchar32 ch)
 {
-    if (ch < EASY_SCRIPTS_RANGE)
-        return (ScriptType)unicode_script_easy_table[ch];
-    else
-        return (ScriptType)unichar_get_script_bsearch(ch);
+    return (ScriptType)UCHAR_GET_SCRIPT(ch);
 }
 
 /* http://unicode.org/iso15924/ */
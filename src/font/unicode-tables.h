@@ -23696,6 +23696,9 @@ static const struct {
 };
 
 
+/* The sources of unicode-width-table.inc; see gen-props-tab.c */
+#ifdef _MGUNICODE_WIDTH_INTERVALS
+
 struct Interval
 {
   Uchar32 start, end;
@@ -24000,4 +24003,6 @@ static const struct Interval unicode_width_table_ambiguous[] = {
 {0x100000, 0x10FFFD},
 };
 
+#endif /* _MGUNICODE_WIDTH_INTERVALS */
+
 #endif /* _MGFONT_UNICODE_TABLES_H */
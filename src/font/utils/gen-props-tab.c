@@ -0,0 +1,349 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+//                          IMPORTANT NOTICE
+//
+// The following open source license statement does not apply to any
+// entity in the Exception List published by FMSoft.
+//
+// For more information, please visit:
+//
+// https://www.fmsoft.cn/exception-list
+//
+//////////////////////////////////////////////////////////////////////////////
+/*
+ *   This file is part of MiniGUI, a mature cross-platform windowing
+ *   and Graphics User Interface (GUI) support system for embedded systems
+ *   and smart IoT devices.
+ *
+ *   Copyright (C) 2002~2020, Beijing FMSoft Technologies Co., Ltd.
+ *   Copyright (C) 1998~2002, WEI Yongming
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *   Or,
+ *
+ *   As this program is a library, any link to this program must follow
+ *   GNU General Public License version 3 (GPLv3). If you cannot accept
+ *   GPLv3, you need to be licensed from FMSoft.
+ *
+ *   If you have got a commercial license of this program, please use it
+ *   under the terms and conditions of the commercial license.
+ *
+ *   For more information about the commercial license, please refer to
+ *   <http://www.minigui.com/blog/minigui-licensing-policy/>.
+ */
+/*
+ * gen-props-tab.c - generate the two-stage tables of the Unicode
+ * properties which are kept as interval tables in the sources:
+ *
+ *  - unicode-width-table.inc from unicode-tables.h
+ *    (the east asian wide and ambiguous characters);
+ *  - unicode-emoji-props-table.inc from unicode-emoji-tables.h
+ *    (the emoji properties);
+ *  - unicode-script-type-table.inc from unicode-script-table.h
+ *    (the script types).
+ *
+ * Usage:
+ *
+ *   gen-props-tab max-depth width|emoji|script /path/to/header
+ *
+ * The interval tables are still the sources of the properties; they are
+ * generated from the UCD by gen-unicode-tables.pl, gen-emoji-table.py and
+ * gen-scripts-table.py.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+#include "packtab.h"
+
+#define UNICODE_CHARS   0x110000
+
+#define appname "gen-props-tab"
+
+static void
+die (const char *msg)
+{
+    fprintf (stderr, appname ": %s\n", msg);
+    exit (1);
+}
+
+static void
+die2 (const char *fmt, const char *p)
+{
+    fprintf (stderr, appname ": ");
+    fprintf (stderr, fmt, p);
+    fprintf (stderr, "\n");
+    exit (1);
+}
+
+static void
+die3 (const char *fmt, unsigned long l, const char *p)
+{
+    fprintf (stderr, appname ": ");
+    fprintf (stderr, fmt, l, p);
+    fprintf (stderr, "\n");
+    exit (1);
+}
+
+/* the values of the width table */
+#define WIDTH_NARROW        0
+#define WIDTH_WIDE          1
+#define WIDTH_AMBIGUOUS     2
+
+/* the bits of the emoji properties table */
+#define EMOJI_EMOJI                 0x01
+#define EMOJI_PRESENTATION          0x02
+#define EMOJI_MODIFIER              0x04
+#define EMOJI_MODIFIER_BASE         0x08
+#define EMOJI_EXTENDED_PICTOGRAPHIC 0x10
+
+static signed int table[UNICODE_CHARS];
+static char buf[4000];
+
+#define MAX_NAMES   256
+static const char *names[MAX_NAMES];
+static int nr_names;
+
+static int
+get_name_key (const char *name)
+{
+    int i;
+
+    for (i = 0; i < nr_names; i++)
+        if (!strcmp (name, names[i]))
+            return i;
+
+    if (nr_names == MAX_NAMES)
+        die ("too many different values");
+
+    if (!(names[nr_names] = strdup (name)))
+        die ("error: insufficient memory");
+
+    return nr_names++;
+}
+
+/* Seek to the first line after the declaration of the table. */
+static unsigned long
+seek_table (FILE *f, const char *table_name)
+{
+    unsigned long l = 0;
+    size_t len = strlen (table_name);
+    const char *s;
+
+    rewind (f);
+    while (fgets (buf, sizeof buf, f)) {
+        l++;
+        s = strstr (buf, table_name);
+        if (s && (s[len] == '[' || s[len] == ' ') && strchr (s, '=')) {
+            return l;
+        }
+    }
+
+    die2 ("error: table `%s' not found", table_name);
+    return 0;
+}
+
+/* Sets the bits of the characters in a table of Interval. */
+static void
+read_intervals (FILE *f, const char *table_name, int bits, int overwrite)
+{
+    unsigned long c, c2, l;
+
+    l = seek_table (f, table_name);
+    while (fgets (buf, sizeof buf, f)) {
+        const char *s = buf;
+
+        l++;
+        while (isspace (*s))
+            s++;
+
+        if (s[0] == '{' && (s[1] == '\0' || isspace (s[1])))
+            continue;
+        if (s[0] == '}')
+            return;
+
+        if (sscanf (s, "{ %lx , %lx }", &c, &c2) != 2 ||
+                c > c2 || c2 >= UNICODE_CHARS)
+            die3 ("invalid input at line %ld: %s", l, s);
+
+        for (; c <= c2; c++) {
+            if (overwrite || table[c] == 0)
+                table[c] |= bits;
+        }
+    }
+
+    die2 ("error: unterminated table `%s'", table_name);
+}
+
+static void
+read_width (FILE *f)
+{
+    memset (table, 0, sizeof (table));
+    read_intervals (f, "unicode_width_table_wide", WIDTH_WIDE, 1);
+    /* the wide characters take precedence over the ambiguous ones */
+    read_intervals (f, "unicode_width_table_ambiguous", WIDTH_AMBIGUOUS, 0);
+}
+
+static void
+read_emoji (FILE *f)
+{
+    memset (table, 0, sizeof (table));
+    read_intervals (f, "_unicode_emoji_table", EMOJI_EMOJI, 1);
+    read_intervals (f, "_unicode_emoji_presentation_table",
+            EMOJI_PRESENTATION, 1);
+    read_intervals (f, "_unicode_emoji_modifier_table",
+            EMOJI_MODIFIER, 1);
+    read_intervals (f, "_unicode_emoji_modifier_base_table",
+            EMOJI_MODIFIER_BASE, 1);
+    read_intervals (f, "_unicode_extended_pictographic_table",
+            EMOJI_EXTENDED_PICTOGRAPHIC, 1);
+}
+
+static void
+read_script (FILE *f)
+{
+    unsigned long c, n, l;
+    int unknown = get_name_key ("SCRIPT_UNKNOWN");
+    char tp[sizeof (buf)];
+
+    for (c = 0; c < UNICODE_CHARS; c++)
+        table[c] = unknown;
+
+    /* the easy table: one script per character from U+0000 */
+    l = seek_table (f, "unicode_script_easy_table");
+    c = 0;
+    while (fgets (buf, sizeof buf, f)) {
+        char *s = buf, *e;
+
+        l++;
+        while (isspace (*s))
+            s++;
+        if (s[0] == '}')
+            break;
+
+        while ((e = strchr (s, ',')) != NULL) {
+            *e = '\0';
+            if (sscanf (s, " %[A-Z_]", tp) != 1 || c >= UNICODE_CHARS)
+                die3 ("invalid input at line %ld: %s", l, s);
+            table[c++] = get_name_key (tp);
+            s = e + 1;
+        }
+    }
+
+    /* the ranges from the end of the easy table */
+    l = seek_table (f, "unicode_script_table");
+    while (fgets (buf, sizeof buf, f)) {
+        const char *s = buf;
+
+        l++;
+        while (isspace (*s))
+            s++;
+        if (s[0] == '}')
+            return;
+
+        if (sscanf (s, "{ %lx , %lu , %[A-Z_] }", &c, &n, tp) != 3 ||
+                c + n > UNICODE_CHARS)
+            die3 ("invalid input at line %ld: %s", l, s);
+
+        for (; n > 0; c++, n--)
+            table[c] = get_name_key (tp);
+    }
+
+    die ("error: unterminated table `unicode_script_table'");
+}
+
+static void
+gen_props_tab (int max_depth, const char *prop, const char *data_file_name)
+{
+    const char *output_name, *table_name, *macro_name, *key_type_name;
+    int default_key = 0, key_size = 1, tab_width = 2;
+    const char* const *key_names = NULL;
+    const char *base_name;
+    FILE *f;
+
+    if (!(f = fopen (data_file_name, "rt")))
+        die2 ("error: cannot open `%s' for reading", data_file_name);
+
+    if (!strcmp (prop, "width")) {
+        read_width (f);
+        output_name = "unicode-width-table.inc";
+        table_name = "Wid";
+        macro_name = "UCHAR_GET_WIDTH";
+    }
+    else if (!strcmp (prop, "emoji")) {
+        read_emoji (f);
+        output_name = "unicode-emoji-props-table.inc";
+        table_name = "Emo";
+        macro_name = "UCHAR_GET_EMOJI_PROPS";
+    }
+    else if (!strcmp (prop, "script")) {
+        read_script (f);
+        output_name = "unicode-script-type-table.inc";
+        table_name = "Scr";
+        macro_name = "UCHAR_GET_SCRIPT";
+        default_key = get_name_key ("SCRIPT_UNKNOWN");
+        key_names = names;
+        tab_width = 16;
+    }
+    else {
+        die2 ("error: unknown property %s", prop);
+        return;
+    }
+
+    fclose (f);
+
+    if ((base_name = strrchr (data_file_name, '/')))
+        base_name++;
+    else
+        base_name = data_file_name;
+
+    key_type_name = "Uint8";
+    printf ("/* %s\n * generated by " appname "\n"
+            " * from the file %s. */\n\n", output_name, base_name);
+
+    printf ("#define PACKTAB_UINT8 Uint8\n"
+            "#define PACKTAB_UINT16 Uint16\n"
+            "#define PACKTAB_UINT32 Uint32\n\n");
+
+    if (!pack_table (table, UNICODE_CHARS, key_size, default_key, max_depth,
+                tab_width, key_names, key_type_name, table_name, macro_name,
+                stdout))
+        die ("error: insufficient memory, decrease max_depth");
+
+    printf ("#undef PACKTAB_UINT8\n");
+    printf ("#undef PACKTAB_UINT16\n");
+    printf ("#undef PACKTAB_UINT32\n\n");
+
+    printf ("/* End of generated %s */\n", output_name);
+}
+
+int
+main (int argc, const char **argv)
+{
+    int max_depth;
+
+    if (argc < 4)
+        die ("usage:\n  " appname
+                " max-depth width|emoji|script /path/to/header");
+
+    max_depth = atoi (argv[1]);
+    if (max_depth < 2)
+        die ("invalid depth");
+
+    gen_props_tab (max_depth, argv[2], argv[3]);
+    return 0;
+}
@@ -1444,6 +1444,9 @@ sub output_width_tables
 
     print $out <<EOT;
 
+/* The sources of unicode-width-table.inc; see gen-props-tab.c */
+#ifdef _MGUNICODE_WIDTH_INTERVALS
+
 struct Interval
 {
   Uchar32 start, end;
@@ -1453,6 +1456,8 @@ EOT
 
     &output_one_width_table ($out,"wide", "[FW]");
     &output_one_width_table ($out, "ambiguous", "[A]");
+
+    print $out "#endif /* _MGUNICODE_WIDTH_INTERVALS */\n\n";
 }
 
 sub print_scripts
@@ -82,7 +82,7 @@ most_binary (
       return packtab_pow[i];
     }
 
-  return max & (packtab_pow[i] - 1);
+  return max & ~(packtab_pow[i] - 1);
 }
 
 static void
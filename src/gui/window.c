@@ -4379,9 +4379,19 @@ HWND GUIAPI CreateMainWindowEx2 (PMAINWINCREATE pCreateInfo, LINT id,
     pWin->surf = GAL_CreateSurfaceForZNode (surf_flag, pWin->right - pWin->left,
                 pWin->bottom - pWin->top);
     if ((surf_flag & ST_PIXEL_MASK) != ST_PIXEL_DEFAULT) {
-        pWin->iBkColor = GAL_MapRGBA (pWin->surf->format,
+        Uint8 a = GetAValue (bkgnd_color);
+
+        if (pWin->surf->flags & GAL_PREMULALPHA) {
+            pWin->iBkColor = GAL_MapRGBA (pWin->surf->format,
+                GAL_PremulComponent (GetRValue (bkgnd_color), a),
+                GAL_PremulComponent (GetGValue (bkgnd_color), a),
+                GAL_PremulComponent (GetBValue (bkgnd_color), a), a);
+        }
+        else {
+            pWin->iBkColor = GAL_MapRGBA (pWin->surf->format,
                 GetRValue (bkgnd_color), GetGValue (bkgnd_color),
-                GetBValue (bkgnd_color), GetAValue (bkgnd_color));
+                GetBValue (bkgnd_color), a);
+        }
     }
 #else
     pWin->pGCRInfo = &pWin->GCRInfo;
@@ -76,6 +76,7 @@ extern int __mg_usvfb_fd; // defined in USVFB NEWGAL engine.
 #define FT_PONG         12
 #define FT_EVENT        13
 #define FT_DIRTYPIXELS  14
+#define FT_DIRTYRECTS   15
 
 struct _frame_header {
     int type;
@@ -69,6 +69,14 @@ typedef struct tagBLOCKHEAP {
 } BLOCKHEAP;
 typedef BLOCKHEAP* PBLOCKHEAP;
 
+typedef struct tagBLOCKHEAPSTATS {
+    size_t          heap_size;
+    size_t          nr_used;
+    size_t          nr_peak;
+    Uint64          nr_hits;
+    Uint64          nr_overflows;
+} BLOCKHEAPSTATS;
+
 #ifdef __cplusplus
 extern "C" {
 #endif  /* __cplusplus */
@@ -79,6 +87,7 @@ void InitBlockDataHeap (PBLOCKHEAP heap, size_t bd_size, size_t heap_size);
 void* BlockDataAlloc (PBLOCKHEAP heap);
 void BlockDataFree (PBLOCKHEAP heap, void* data);
 void DestroyBlockDataHeap (PBLOCKHEAP heap);
+BOOL GetBlockDataHeapStats (PBLOCKHEAP heap, BLOCKHEAPSTATS* stats);
 
 #ifdef __cplusplus
 }
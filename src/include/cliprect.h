@@ -90,6 +90,9 @@ extern "C" {
 void dbg_dumpRegion (CLIPRGN* region);
 #endif
 
+/* Frees the band indexes built for PtInRegion and RectInRegion. */
+void __mg_free_region_indexes (void);
+
 #ifdef __cplusplus
 }
 #endif  /* __cplusplus */
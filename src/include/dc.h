@@ -231,6 +231,8 @@ struct tagDC
     /* used by the text rendering for low-pass filtering. */
     gal_pixel filter_pixels [17];
     GAL_PixelFormat* alpha_pixel_format;
+    /* the glyph run being composited, see _gdi_begin_glyph_run. */
+    struct _GLYPH_RUN* glyph_run;
 
     /* pixel and line operation */
     CB_COMP_SETPIXEL draw_pixel;
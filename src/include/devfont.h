@@ -156,6 +156,30 @@ unsigned short font_GetBestScaleFactor (int height, int expect);
 void font_DelSBDevFont (DEVFONT* dev_font);
 void font_DelMBDevFont (DEVFONT* dev_font);
 
+#if defined(_MGFONT_GLYPH_CACHE) && !defined(_MG_MINIMALGDI)
+/* Drops the cached glyph bitmaps of a devfont which is going away. */
+void __mg_glyph_cache_purge (const DEVFONT* devfont);
+#else
+#   define __mg_glyph_cache_purge(devfont)
+#endif
+
+#if defined(_MGFONT_DRAWTEXT_CACHE) && !defined(_MG_MINIMALGDI)
+/* Drops the cached text layouts of a logfont which is going away. */
+void __mg_drawtext_cache_purge (const LOGFONT* logfont);
+#else
+#   define __mg_drawtext_cache_purge(logfont)
+#endif
+
+#if defined(_MGFONT_ADVANCE_CACHE) && !defined(_MG_MINIMALGDI)
+/* Registers a logfont created by MiniGUI for the tables of glyph advances. */
+void __mg_advance_cache_new (const LOGFONT* logfont);
+/* Frees the tables of glyph advances of a logfont. */
+void __mg_advance_cache_free (const LOGFONT* logfont);
+#else
+#   define __mg_advance_cache_new(logfont)
+#   define __mg_advance_cache_free(logfont)
+#endif
+
 #ifdef _DEBUG_DEVFONT
 void dbg_dumpDevFonts (void);
 #endif
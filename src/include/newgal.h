@@ -235,6 +235,19 @@ typedef struct GAL_Surface {
 #define GAL_SRCALPHA         MEMDC_FLAG_SRCALPHA        /* Blit uses source alpha blending */
 #define GAL_SRCPIXELALPHA    MEMDC_FLAG_SRCPIXELALPHA   /* Blit uses source per-pixel alpha blending */
 #define GAL_PREALLOC         0x01000000                 /* Surface uses preallocated memory */
+#define GAL_PREMULALPHA      MEMDC_FLAG_PREMULALPHA     /* Pixels are premultiplied by alpha */
+
+/* Only the 32-bit pixel formats with an 8-bit alpha channel can be premultiplied */
+#define GAL_CanPremulAlpha(format)  \
+    ((format)->BytesPerPixel == 4 && (format)->Amask && (format)->Aloss == 0)
+
+/* Multiply a color component by alpha (c * a / 255, rounded) */
+#define GAL_PremulComponent(c, a)   \
+    ((((c) * (a) + 128) + (((c) * (a) + 128) >> 8)) >> 8)
+
+/* The inverse of GAL_PremulComponent; the result is clamped to 255 */
+#define GAL_UnpremulComponent(c, a) \
+    ((a) ? MIN (255, ((c) * 255 + ((a) >> 1)) / (a)) : 0)
 
 /* Evaluates to true if the surface needs to be locked before access */
 #define GAL_MUSTLOCK(surface)   \
@@ -600,6 +613,7 @@ GAL_Surface *GAL_CreateSharedRGBSurface (GAL_VideoDevice* video,
 #define ST_PIXEL_ARGB4444       0x0001
 #define ST_PIXEL_ARGB1555       0x0002
 #define ST_PIXEL_ARGB8888       0x0003
+#define ST_PREMULALPHA          0x0100
 #endif /* not define ST_PIXEL_MASK */
 
 /* Allocate a shared RGB surface from the current video device. */
@@ -684,6 +698,16 @@ int GAL_SetColorKey (GAL_Surface *surface, Uint32 flag, Uint32 key);
  */
 int GAL_SetAlpha (GAL_Surface *surface, Uint32 flag, Uint8 alpha);
 
+/*
+ * Convert the pixels of a surface between straight and premultiplied
+ * alpha in place, and set or clear GAL_PREMULALPHA for the surface.
+ * The per-pixel alpha blits from a surface with GAL_PREMULALPHA use the
+ * premultiplied blend equation (d = s + d * (1 - sA)).
+ * This function returns 0, or -1 if the pixel format of the surface
+ * can not be premultiplied.
+ */
+int GAL_SetPremulAlpha (GAL_Surface *surface, BOOL premul);
+
 /*
  * A function to calculate the intersection of two rectangles:
  * return true if the rectangles intersect, false otherwise
@@ -855,6 +879,21 @@ int GAL_UpperBlit (GAL_Surface *src, GAL_Rect *srcrect,
 int GAL_LowerBlit (GAL_Surface *src, GAL_Rect *srcrect,
                          GAL_Surface *dst, GAL_Rect *dstrect);
 
+/*
+ * This function blits the source rectangle (or the entire source surface
+ * if 'srcrect' is NULL) to the point (dx, dy) of the destination surface,
+ * clipped by every rectangle of the region 'rgn' and by 'bound' (if not
+ * NULL), instead of the clip rectangle of the destination surface.
+ * The blit setup (mapping validation and the choice of the blitter) is
+ * done once for the whole region. If the source and the destination are
+ * the same surface, the rectangles are blitted in an order which is safe
+ * for overlapped areas. If 'rgn' is NULL, only 'bound' is used.
+ * This function returns 0 on success, or -1 on error.
+ */
+int GAL_RegionBlit (GAL_Surface *src, const GAL_Rect *srcrect,
+                         GAL_Surface *dst, int dx, int dy,
+                         const CLIPRGN *rgn, const RECT *bound);
+
 /*
  * This function performs a fast fill of the given rectangle with 'color'
  * The given rectangle is clipped to the destination surface clip area
@@ -867,6 +906,14 @@ int GAL_LowerBlit (GAL_Surface *src, GAL_Rect *srcrect,
 int GAL_FillRect
                 (GAL_Surface *dst, const GAL_Rect *dstrect, Uint32 color);
 
+/*
+ * This function fills the rectangle like GAL_FillRect, but clips it by
+ * every rectangle of the region 'rgn' (and by 'bound' if it is not NULL)
+ * instead of the clip rectangle of the surface.
+ */
+int GAL_FillRectRgn (GAL_Surface *dst, const GAL_Rect *dstrect, Uint32 color,
+        const CLIPRGN *rgn, const RECT *bound);
+
 /*
  * This function returns the size of pad-aligned box bitmap.
  */
@@ -892,6 +939,24 @@ int GAL_GetBox (GAL_Surface *src, const GAL_Rect* srcrect, BITMAP* box);
  */
 int GAL_PutBox (GAL_Surface *dst, const GAL_Rect* dstrect, BITMAP* box);
 
+/*
+ * This function puts a box like GAL_PutBox, but clips it by every
+ * rectangle of the region 'rgn' (and by 'bound' if it is not NULL)
+ * instead of the clip rectangle of the surface.
+ */
+int GAL_PutBoxRgn (GAL_Surface *dst, const GAL_Rect* dstrect, BITMAP* box,
+        const CLIPRGN* rgn, const RECT* bound);
+
+/*
+ * This function puts a box like GAL_PutBoxRgn, but clips it by the
+ * rectangles of a region from 'first' on. Since the rectangles of
+ * a region are sorted by bands, it stops at the first band below 'bound';
+ * so passing the current band and the bound of a scan line only walks
+ * that band.
+ */
+int GAL_PutBoxRects (GAL_Surface *dst, const GAL_Rect* dstrect, BITMAP* box,
+        const CLIPRECT* first, const RECT* bound);
+
 /*
  * This function takes a surface and copies it to a new surface of the
  * pixel format and colors of the video framebuffer, suitable for fast
@@ -922,6 +987,48 @@ GAL_Surface * GAL_DisplayFormatAlpha (GAL_Surface *surface);
 int GAL_SoftStretch (GAL_Surface *src, GAL_Rect *srcrect,
                                     GAL_Surface *dst, GAL_Rect *dstrect);
 
+/* The filters of the stretch blit */
+#define GAL_STRETCH_NEAREST     0
+#define GAL_STRETCH_BILINEAR    1
+#define GAL_STRETCH_AREA        2
+
+/*
+ * The callbacks of GAL_StretchFiltered: the first one returns the buffer
+ * of the destination row 'y' (or NULL to skip it), the second one (if
+ * not NULL) is called after the row is filled.
+ */
+typedef Uint8* (*GAL_GetStretchRow) (void* context, int y);
+typedef void (*GAL_PutStretchRow) (void* context, Uint8* row, int y);
+
+/*
+ * Returns whether the pixels in the format can be filtered by
+ * GAL_StretchFiltered.
+ */
+BOOL GAL_CanStretchFiltered (const GAL_PixelFormat *format);
+
+/*
+ * This function scales the source pixels (src_w x src_h, in 'format') to
+ * dst_w x dst_h with the filter, and writes the rows to the buffers
+ * returned by 'get_row' from top to bottom. It returns 0 on success.
+ */
+int GAL_StretchFiltered (const Uint8 *src_pixels, int src_pitch,
+                int src_w, int src_h, const GAL_PixelFormat *format,
+                int dst_w, int dst_h, int filter, void *context,
+                GAL_GetStretchRow get_row, GAL_PutStretchRow put_row);
+
+/*
+ * The SIMD features of the current CPU, used to select the vectorized
+ * software blitters at runtime. The value is always zero if MiniGUI
+ * was configured without SIMD blitters (_MGGAL_SIMD_BLIT).
+ */
+#define GAL_CPU_MMX         0x00000001
+#define GAL_CPU_SSE2        0x00000002
+#define GAL_CPU_SSSE3       0x00000004
+#define GAL_CPU_AVX2        0x00000008
+#define GAL_CPU_NEON        0x00000010
+
+Uint32 GAL_GetCPUFeatures (void);
+
 #ifdef _MGSCHEMA_COMPOSITING
 extern GAL_Surface* __gal_screen;
 extern GAL_Surface* __gal_fake_screen;
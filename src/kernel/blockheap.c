@@ -61,20 +61,50 @@
 #include "gdi.h"
 #include "blockheap.h"
 
+/*
+ * The pre-allocated heap starts with the private state of the heap, and
+ * the blocks follow it; so BLOCKHEAP keeps its layout.
+ *
+ * The first DWORD of a block holds its state. A free block in the heap
+ * holds the index of the next free block right after the state, so
+ * allocating and freeing are both O(1). The blocks beyond info->top have
+ * never been used and are not linked into the free list.
+ */
+typedef struct _BLOCKHEAPINFO {
+    /* the number of the blocks which have been carved from the heap */
+    int             top;
+    /* the number of the blocks in use, including the overflow blocks */
+    size_t          nr_used;
+    size_t          nr_peak;
+    /* the allocations served by the heap and by the system heap */
+    Uint64          nr_hits;
+    Uint64          nr_overflows;
+} BLOCKHEAPINFO;
+
+#define HEAP_INFO(heap)         ((BLOCKHEAPINFO*)(heap)->heap)
+#define HEAP_BLOCKS(heap)       ((char*)(heap)->heap + sizeof (BLOCKHEAPINFO))
+#define BLOCK_AT(heap, i)       (HEAP_BLOCKS (heap) + (heap)->bd_size * (i))
+#define NEXT_FREE(block)        (*(int*)((char*)(block) + sizeof (DWORD)))
+
 void InitBlockDataHeap (PBLOCKHEAP heap, size_t bd_size, size_t heap_size)
 {
 #ifdef _MGRM_THREADS
     pthread_mutex_init (&heap->lock, NULL);
 #endif
 
+    /* room for the link of the free list */
+    if (bd_size < sizeof (int))
+        bd_size = sizeof (int);
+
     heap->heap = NULL;
     heap->bd_size = bd_size + sizeof (DWORD);
     heap->heap_size = heap_size;
+    heap->free = -1;
 }
 
 void* BlockDataAlloc (PBLOCKHEAP heap)
 {
-    int i;
+    BLOCKHEAPINFO* info;
     char* block_data = NULL;
 
 #ifdef _MGRM_THREADS
@@ -82,39 +112,41 @@ void* BlockDataAlloc (PBLOCKHEAP heap)
 #endif
 
     if (heap->heap == NULL) {
-        if (!(heap->heap = calloc (heap->heap_size, heap->bd_size)))
+        if (!(heap->heap = calloc (1, sizeof (BLOCKHEAPINFO) +
+                        heap->heap_size * heap->bd_size)))
             goto ret;
-        heap->free = 0;
+        heap->free = -1;
     }
 
-    block_data = (char*) heap->heap + heap->bd_size*heap->free;
-    for (i = heap->free; i < heap->heap_size; i++) {
-
-        if (*((DWORD*)block_data) == BDS_FREE) {
-
-            heap->free = i + 1;
-            *((DWORD*)block_data) = BDS_USED;
-
-#if 0
-            fprintf (stderr, "heap: %p, Allocated: %d, free: %d.\n", heap, i, heap->free);
-            fprintf (stderr, "Heap: (bd_size: %d, heap_size: %d, heap: %p).\n",
-                    heap->bd_size, heap->heap_size, heap->heap);
-#endif
-            goto ret;
-        }
-
-        block_data += heap->bd_size;
+    info = HEAP_INFO (heap);
+    if (heap->free >= 0) {
+        block_data = BLOCK_AT (heap, heap->free);
+        heap->free = NEXT_FREE (block_data);
+    }
+    else if (info->top < (int)heap->heap_size) {
+        block_data = BLOCK_AT (heap, info->top);
+        info->top++;
     }
 
+    if (block_data) {
+        *((DWORD*)block_data) = BDS_USED;
+        info->nr_hits++;
+    }
+    else {
 #if 0
-    if (!(block_data = calloc (1, heap->bd_size)))
-        goto ret;
+        if (!(block_data = calloc (1, heap->bd_size)))
+            goto ret;
 #else
-    if (!(block_data = mg_slice_alloc0 (heap->bd_size)))
-        goto ret;
+        if (!(block_data = mg_slice_alloc0 (heap->bd_size)))
+            goto ret;
 #endif
+        *((DWORD*)block_data) = BDS_SPECIAL;
+        info->nr_overflows++;
+    }
 
-    *((DWORD*)block_data) = BDS_SPECIAL;
+    info->nr_used++;
+    if (info->nr_used > info->nr_peak)
+        info->nr_peak = info->nr_used;
 
 ret:
 
@@ -129,7 +161,6 @@ ret:
 
 void BlockDataFree (PBLOCKHEAP heap, void* data)
 {
-    int i;
     char* block_data;
 
 #ifdef _MGRM_THREADS
@@ -143,32 +174,59 @@ void BlockDataFree (PBLOCKHEAP heap, void* data)
 #else
         mg_slice_free (heap->bd_size, block_data);
 #endif
+        HEAP_INFO (heap)->nr_used--;
     }
     else if (*((DWORD*)block_data) == BDS_USED) {
         *((DWORD*)block_data) = BDS_FREE;
 
-        i = (block_data - (char*)heap->heap)/heap->bd_size;
-        if (heap->free > i)
-            heap->free = i;
+        NEXT_FREE (block_data) = heap->free;
+        heap->free = (block_data - HEAP_BLOCKS (heap))/heap->bd_size;
+        HEAP_INFO (heap)->nr_used--;
+    }
 
-#if 0
-        fprintf (stderr, "Heap: %p: Freed: %d, free: %d.\n", heap, i, heap->free);
-        fprintf (stderr, "Heap: (bd_size: %d, heap_size: %d, heap: %p).\n",
-                    heap->bd_size, heap->heap_size, heap->heap);
+#ifdef _MGRM_THREADS
+    pthread_mutex_unlock (&heap->lock);
 #endif
+}
+
+BOOL GetBlockDataHeapStats (PBLOCKHEAP heap, BLOCKHEAPSTATS* stats)
+{
+    if (heap == NULL || stats == NULL)
+        return FALSE;
+
+    memset (stats, 0, sizeof (BLOCKHEAPSTATS));
+
+#ifdef _MGRM_THREADS
+    pthread_mutex_lock (&heap->lock);
+#endif
+
+    stats->heap_size = heap->heap_size;
+    if (heap->heap) {
+        BLOCKHEAPINFO* info = HEAP_INFO (heap);
+
+        stats->nr_used = info->nr_used;
+        stats->nr_peak = info->nr_peak;
+        stats->nr_hits = info->nr_hits;
+        stats->nr_overflows = info->nr_overflows;
     }
 
 #ifdef _MGRM_THREADS
     pthread_mutex_unlock (&heap->lock);
 #endif
+
+    return TRUE;
 }
 
 void DestroyBlockDataHeap (PBLOCKHEAP heap)
 {
-#if 0
-    fprintf (stderr, "Heap: (bd_size: %d, heap_size: %d, heap: %p).\n",
-                    heap->bd_size, heap->heap_size, heap->heap);
-#endif
+    if (heap->heap) {
+        _DBG_PRINTF ("Heap %p: bd_size: %d, heap_size: %d, peak: %d, "
+                "hits: %llu, overflows: %llu\n", heap,
+                (int)heap->bd_size, (int)heap->heap_size,
+                (int)HEAP_INFO (heap)->nr_peak,
+                (unsigned long long)HEAP_INFO (heap)->nr_hits,
+                (unsigned long long)HEAP_INFO (heap)->nr_overflows);
+    }
 #ifdef _MGRM_THREADS
     pthread_mutex_destroy (&heap->lock);
 #endif
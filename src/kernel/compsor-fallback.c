@@ -261,59 +261,43 @@ static inline void tile_dirty_region_for_wallpaper (CompositorCtxt* ctxt)
     }
 }
 
-static void composite_wallpaper_rect (CompositorCtxt* ctxt,
-            const RECT* dirty_rc)
+static inline void composite_wallpaper (CompositorCtxt* ctxt)
 {
-    int wp_w = GetGDCapability (HDC_SCREEN, GDCAP_HPIXEL);
-    int wp_h = GetGDCapability (HDC_SCREEN, GDCAP_VPIXEL);
+    int wp_w, wp_h;
+    const RECT* rc_bound;
 
-    if (wp_w > 0 && wp_h > 0) {
+    if (IsEmptyClipRgn (&ctxt->dirty_rgn))
+        return;
 
-        // tile the wallpaper pattern
-        int y = 0;
-        int left_h = RECTH (ctxt->rc_screen);
-        while (left_h > 0) {
+    wp_w = GetGDCapability (HDC_SCREEN, GDCAP_HPIXEL);
+    wp_h = GetGDCapability (HDC_SCREEN, GDCAP_VPIXEL);
 
-            int x = 0;
-            int left_w = RECTW (ctxt->rc_screen);
-            while (left_w > 0) {
-                RECT rc = { x, y, x + wp_w, y + wp_h };
-                RECT eff_rc;
-                if (IntersectRect (&eff_rc, dirty_rc, &rc)) {
-                    SelectClipRect (HDC_SCREEN_SYS, &eff_rc);
-                    SetMemDCColorKey (HDC_SCREEN, 0, 0);
-                    SetMemDCAlpha (HDC_SCREEN, 0, 0);
-                    BitBlt (HDC_SCREEN, 0, 0, RECTW (rc), RECTH (rc),
-                            HDC_SCREEN_SYS, rc.left, rc.top, 0);
-                }
+    // BitBlt and FillBox walk the rectangles of the dirty region
+    SelectClipRegion (HDC_SCREEN_SYS, &ctxt->dirty_rgn);
+    rc_bound = &ctxt->dirty_rgn.rcBound;
 
-                x += wp_w;
-                left_w -= wp_w;
-            }
+    if (wp_w > 0 && wp_h > 0) {
 
-            left_h -= wp_h;
-            y += wp_h;
+        // tile the wallpaper pattern over the bound of the dirty region
+        int x, y;
+
+        SetMemDCColorKey (HDC_SCREEN, 0, 0);
+        SetMemDCAlpha (HDC_SCREEN, 0, 0);
+        for (y = rc_bound->top / wp_h * wp_h; y < rc_bound->bottom;
+                y += wp_h) {
+            for (x = rc_bound->left / wp_w * wp_w; x < rc_bound->right;
+                    x += wp_w) {
+                BitBlt (HDC_SCREEN, 0, 0, wp_w, wp_h,
+                        HDC_SCREEN_SYS, x, y, 0);
+            }
         }
     }
     else {
         SetBrushColor (HDC_SCREEN_SYS,
             GetWindowElementPixelEx (HWND_DESKTOP, HDC_SCREEN_SYS,
                 WE_BGC_DESKTOP));
-        SelectClipRect (HDC_SCREEN_SYS, &ctxt->rc_screen);
-        FillBox (HDC_SCREEN_SYS, dirty_rc->left, dirty_rc->top,
-                RECTWP(dirty_rc), RECTHP(dirty_rc));
-    }
-}
-
-static inline void composite_wallpaper (CompositorCtxt* ctxt)
-{
-    if (!IsEmptyClipRgn (&ctxt->dirty_rgn)) {
-
-        CLIPRECT* crc = ctxt->dirty_rgn.head;
-        while (crc) {
-            composite_wallpaper_rect (ctxt, &crc->rc);
-            crc = crc->next;
-        }
+        FillBox (HDC_SCREEN_SYS, rc_bound->left, rc_bound->top,
+                RECTWP(rc_bound), RECTHP(rc_bound));
     }
 }
 
@@ -425,6 +409,8 @@ static void composite_all_lucent_win_znodes_above (CompositorCtxt* ctxt,
                 break;
 
             case CT_ALPHAPIXEL:
+                /* A surface created with ST_PREMULALPHA keeps the flag
+                   GAL_PREMULALPHA, so the premultiplied blitter is used. */
                 SetMemDCColorKey (znode_hdr->mem_dc, 0, 0);
                 SetMemDCAlpha (znode_hdr->mem_dc,
                         MEMDC_FLAG_SRCPIXELALPHA, 0);
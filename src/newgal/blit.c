@@ -54,8 +54,29 @@
 #include "blit.h"
 #include "RLEaccel_c.h"
 #include "pixels_c.h"
+#include "parallel_c.h"
 #include "memops.h"
 
+typedef struct _SOFT_BLIT_CONTEXT {
+    GAL_BlitInfo *info;
+    GAL_loblit RunBlit;
+    int s_pitch;
+    int d_pitch;
+} SOFT_BLIT_CONTEXT;
+
+/* Run the blit on the rows [y, y + h) of the blit rectangle */
+static void GAL_SoftBlitBand(void *context, int y, int h)
+{
+    SOFT_BLIT_CONTEXT *ctxt = (SOFT_BLIT_CONTEXT *)context;
+    GAL_BlitInfo band = *ctxt->info;
+
+    band.s_pixels += y*ctxt->s_pitch;
+    band.d_pixels += y*ctxt->d_pitch;
+    band.s_height = h;
+    band.d_height = h;
+    ctxt->RunBlit(&band);
+}
+
 /* The general purpose software blit routine */
 static int GAL_SoftBlit(GAL_Surface *src, GAL_Rect *srcrect,
             GAL_Surface *dst, GAL_Rect *dstrect)
@@ -95,8 +116,19 @@ static int GAL_SoftBlit(GAL_Surface *src, GAL_Rect *srcrect,
         info.dst = dst->format;
         RunBlit = src->map->sw_data->blit;
 
-        /* Run the actual software blit */
-        RunBlit(&info);
+        /* Run the actual software blit, in bands if it is large enough */
+        if (src != dst) {
+            SOFT_BLIT_CONTEXT ctxt;
+
+            ctxt.info = &info;
+            ctxt.RunBlit = RunBlit;
+            ctxt.s_pitch = src->pitch;
+            ctxt.d_pitch = dst->pitch;
+            GAL_RunBands(GAL_SoftBlitBand, &ctxt, info.d_width, info.d_height);
+        }
+        else {
+            RunBlit(&info);
+        }
     }
 
     /* Re-encode the destination if it's RLE encoded */
@@ -294,7 +326,10 @@ int GAL_CalculateBlit(GAL_Surface *surface)
                || (blit_index == 3 && !surface->format->Amask))) {
                 if ( GAL_RLESurface(surface) == 0 )
                     surface->map->sw_blit = GAL_RLEBlit;
-        } else if(blit_index == 2 && surface->format->Amask) {
+        } else if(blit_index == 2 && surface->format->Amask
+                  /* the RLE alpha blitters only know straight alpha */
+                  && !(surface->flags & GAL_PREMULALPHA)
+                  && !(surface->map->dst->flags & GAL_PREMULALPHA)) {
                 if ( GAL_RLESurface(surface) == 0 )
                     surface->map->sw_blit = GAL_RLEAlphaBlit;
         }
@@ -432,6 +432,41 @@ do {                                                            \
     dB = (((sB-dB)*(A))>>8)+dB;                                 \
 } while(0)
 
+/*
+ * Blend a premultiplied source color: d = s + d * (1 - A). The drawing
+ * primitives store the pixel values they are given, so a component may be
+ * larger than the alpha; the sums are clamped to 255.
+ */
+#define ALPHA_BLEND_PREMUL(sR, sG, sB, A, dR, dG, dB)           \
+do {                                                            \
+    dR = MIN (255, sR + ((dR*(256-(A)))>>8));                   \
+    dG = MIN (255, sG + ((dG*(256-(A)))>>8));                   \
+    dB = MIN (255, sB + ((dB*(256-(A)))>>8));                   \
+} while(0)
+
+/*
+ * Blend a premultiplied ARGB8888 pixel with a 32-bit pixel which has the
+ * same layout; the alpha channel is blended like the color components.
+ * The components are processed two at a time in 16-bit lanes, so the
+ * other two can be multiplied by the same 32-bit multiplication. A sum
+ * larger than 255 sets bit 8 of its lane, which turns the lane into 255
+ * instead of carrying into the next component.
+ */
+static inline Uint32 blend_premul_argb8888 (Uint32 s, Uint32 d)
+{
+    Uint32 ia = 256 - (s >> 24);
+    Uint32 rb, ag;
+
+    rb = (s & 0xff00ff) + (((d & 0xff00ff) * ia >> 8) & 0xff00ff);
+    ag = ((s >> 8) & 0xff00ff) + ((((d >> 8) & 0xff00ff) * ia >> 8) & 0xff00ff);
+
+    rb |= 0x1000100 - ((rb >> 8) & 0x10001);
+    ag |= 0x1000100 - ((ag >> 8) & 0x10001);
+    return (rb & 0xff00ff) | ((ag & 0xff00ff) << 8);
+}
+
+#define BLEND_PREMUL_ARGB8888(s, d) blend_premul_argb8888 (s, d)
+
 /* This is a very useful loop for optimizing blitters */
 #define USE_DUFFS_LOOP
 #ifdef USE_DUFFS_LOOP
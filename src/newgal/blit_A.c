@@ -49,6 +49,7 @@
 #include "common.h"
 #include "newgal.h"
 #include "blit.h"
+#include "blit_simd.h"
 
 /* Functions to perform alpha blended blitting */
 
@@ -591,6 +592,31 @@ static void BlitARGBto555PixelAlpha(GAL_BlitInfo *info)
         }
 }
 
+/* fast premultiplied ARGB888->(A)RGB888 blending with pixel alpha */
+static void BlitRGBtoRGBPremulPixelAlpha(GAL_BlitInfo *info)
+{
+        int width = info->d_width;
+        int height = info->d_height;
+        Uint32 *srcp = (Uint32 *)info->s_pixels;
+        int srcskip = info->s_skip >> 2;
+        Uint32 *dstp = (Uint32 *)info->d_pixels;
+        int dstskip = info->d_skip >> 2;
+
+        while(height--) {
+            DUFFS_LOOP4({
+                Uint32 s = *srcp;
+                Uint32 d = *dstp;
+                /* no special case for the opaque alpha: 256 - 255 = 1,
+                   and d * 1 >> 8 is zero for every component */
+                *dstp = BLEND_PREMUL_ARGB8888(s, d);
+                ++srcp;
+                ++dstp;
+            }, width);
+            srcp += srcskip;
+            dstp += dstskip;
+        }
+}
+
 /* General (slow) N->N blending with per-surface alpha */
 static void BlitNtoNSurfaceAlpha(GAL_BlitInfo *info)
 {
@@ -750,6 +776,151 @@ static void BlitNtoNPixelAlpha(GAL_BlitInfo *info)
         }
 }
 
+/* N->1 blending with premultiplied pixel alpha */
+static void BlitNto1PremulPixelAlpha(GAL_BlitInfo *info)
+{
+        int width = info->d_width;
+        int height = info->d_height;
+        Uint8 *src = info->s_pixels;
+        int srcskip = info->s_skip;
+        Uint8 *dst = info->d_pixels;
+        int dstskip = info->d_skip;
+        Uint8 *palmap = info->table;
+        GAL_PixelFormat *srcfmt = info->src;
+        GAL_PixelFormat *dstfmt = info->dst;
+        int srcbpp = srcfmt->BytesPerPixel;
+
+        while ( height-- ) {
+            DUFFS_LOOP4(
+            {
+                Uint32 pixel;
+                unsigned sR;
+                unsigned sG;
+                unsigned sB;
+                unsigned sA;
+                unsigned dR;
+                unsigned dG;
+                unsigned dB;
+                DISEMBLE_RGBA(src,srcbpp,srcfmt,pixel,sR,sG,sB,sA);
+                dR = dstfmt->palette->colors[*dst].r;
+                dG = dstfmt->palette->colors[*dst].g;
+                dB = dstfmt->palette->colors[*dst].b;
+                ALPHA_BLEND_PREMUL(sR, sG, sB, sA, dR, dG, dB);
+                dR &= 0xff;
+                dG &= 0xff;
+                dB &= 0xff;
+                /* Pack RGB into 8bit pixel */
+                if ( palmap == NULL ) {
+                    *dst =((dR>>5)<<(3+2))|
+                          ((dG>>5)<<(2))|
+                          ((dB>>6)<<(0));
+                } else {
+                    *dst = palmap[((dR>>5)<<(3+2))|
+                                  ((dG>>5)<<(2))  |
+                                  ((dB>>6)<<(0))  ];
+                }
+                dst++;
+                src += srcbpp;
+            },
+            width);
+            src += srcskip;
+            dst += dstskip;
+        }
+}
+
+/*
+ * General (slow) N->N blending with premultiplied pixel alpha.
+ * The destination alpha is composed as dA = sA + dA * (1 - sA), so the
+ * result is still a premultiplied pixel if the destination is.
+ */
+static void BlitNtoNPremulPixelAlpha(GAL_BlitInfo *info)
+{
+        int width = info->d_width;
+        int height = info->d_height;
+        Uint8 *src = info->s_pixels;
+        int srcskip = info->s_skip;
+        Uint8 *dst = info->d_pixels;
+        int dstskip = info->d_skip;
+        GAL_PixelFormat *srcfmt = info->src;
+        GAL_PixelFormat *dstfmt = info->dst;
+        int srcbpp = srcfmt->BytesPerPixel;
+        int dstbpp = dstfmt->BytesPerPixel;
+
+        while ( height-- ) {
+                DUFFS_LOOP4(
+                {
+                Uint32 pixel;
+                unsigned sR;
+                unsigned sG;
+                unsigned sB;
+                unsigned dR;
+                unsigned dG;
+                unsigned dB;
+                unsigned sA;
+                unsigned dA;
+                DISEMBLE_RGBA(src, srcbpp, srcfmt, pixel, sR, sG, sB, sA);
+                DISEMBLE_RGBA(dst, dstbpp, dstfmt, pixel, dR, dG, dB, dA);
+                ALPHA_BLEND_PREMUL(sR, sG, sB, sA, dR, dG, dB);
+                if(dstfmt->Amask)
+                        dA = sA + ((dA * (256 - sA)) >> 8);
+                ASSEMBLE_RGBA(dst, dstbpp, dstfmt, dR, dG, dB, dA);
+                src += srcbpp;
+                dst += dstbpp;
+                },
+                width);
+                src += srcskip;
+                dst += dstskip;
+        }
+}
+
+
+/*
+ * General (slow) N->N blending with straight pixel alpha into a
+ * premultiplied destination: the source colors are premultiplied
+ * first, so the blended pixel is still a premultiplied one.
+ */
+static void BlitNtoPremulPixelAlpha(GAL_BlitInfo *info)
+{
+        int width = info->d_width;
+        int height = info->d_height;
+        Uint8 *src = info->s_pixels;
+        int srcskip = info->s_skip;
+        Uint8 *dst = info->d_pixels;
+        int dstskip = info->d_skip;
+        GAL_PixelFormat *srcfmt = info->src;
+        GAL_PixelFormat *dstfmt = info->dst;
+        int srcbpp = srcfmt->BytesPerPixel;
+        int dstbpp = dstfmt->BytesPerPixel;
+
+        while ( height-- ) {
+                DUFFS_LOOP4(
+                {
+                Uint32 pixel;
+                unsigned sR;
+                unsigned sG;
+                unsigned sB;
+                unsigned dR;
+                unsigned dG;
+                unsigned dB;
+                unsigned sA;
+                unsigned dA;
+                DISEMBLE_RGBA(src, srcbpp, srcfmt, pixel, sR, sG, sB, sA);
+                DISEMBLE_RGBA(dst, dstbpp, dstfmt, pixel, dR, dG, dB, dA);
+                sR = GAL_PremulComponent(sR, sA);
+                sG = GAL_PremulComponent(sG, sA);
+                sB = GAL_PremulComponent(sB, sA);
+                ALPHA_BLEND_PREMUL(sR, sG, sB, sA, dR, dG, dB);
+                dA = sA + ((dA * (256 - sA)) >> 8);
+                ASSEMBLE_RGBA(dst, dstbpp, dstfmt, dR, dG, dB, dA);
+                src += srcbpp;
+                dst += dstbpp;
+                },
+                width);
+                src += srcskip;
+                dst += dstskip;
+        }
+}
+
 
 GAL_loblit GAL_CalculateAlphaBlit(GAL_Surface *surface, int blit_index)
 {
@@ -808,6 +979,29 @@ GAL_loblit GAL_CalculateAlphaBlit(GAL_Surface *surface, int blit_index)
                 return BlitNtoNSurfaceAlpha;
         }
 
+        /* Per-pixel alpha blits from a premultiplied surface */
+        if (surface->flags & GAL_PREMULALPHA) {
+            switch(df->BytesPerPixel) {
+            case 1:
+                return BlitNto1PremulPixelAlpha;
+
+            case 4:
+                if(sf->Amask == 0xff000000
+                   && sf->Rmask == df->Rmask
+                   && sf->Gmask == df->Gmask
+                   && sf->Bmask == df->Bmask)
+                    return CHOOSE_SIMD_BLIT(BlitRGBtoRGBPremulPixelAlpha);
+                return BlitNtoNPremulPixelAlpha;
+
+            default:
+                return BlitNtoNPremulPixelAlpha;
+            }
+        }
+
+        /* Per-pixel alpha blits into a premultiplied surface */
+        if (surface->map->dst->flags & GAL_PREMULALPHA)
+            return BlitNtoPremulPixelAlpha;
+
         /* Per-pixel alpha blits */
         switch(df->BytesPerPixel) {
         case 1:
@@ -819,9 +1013,9 @@ GAL_loblit GAL_CalculateAlphaBlit(GAL_Surface *surface, int blit_index)
                && ((sf->Rmask == 0xff && df->Rmask == 0x1f)
                    || (sf->Bmask == 0xff && df->Bmask == 0x1f))) {
                 if(df->Gmask == 0x7e0)
-                    return BlitARGBto565PixelAlpha;
+                    return CHOOSE_SIMD_BLIT(BlitARGBto565PixelAlpha);
                 else if(df->Gmask == 0x3e0 && df->Amask != 0x8000)
-                    return BlitARGBto555PixelAlpha;
+                    return CHOOSE_SIMD_BLIT(BlitARGBto555PixelAlpha);
             }
             return BlitNtoNPixelAlpha;
 
@@ -831,7 +1025,7 @@ GAL_loblit GAL_CalculateAlphaBlit(GAL_Surface *surface, int blit_index)
                && sf->Gmask == df->Gmask
                && sf->Bmask == df->Bmask
                && sf->BytesPerPixel == 4)
-                return BlitRGBtoRGBPixelAlpha;
+                return CHOOSE_SIMD_BLIT(BlitRGBtoRGBPixelAlpha);
             return BlitNtoNPixelAlpha;
 
         case 3:
@@ -0,0 +1,464 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+//                          IMPORTANT NOTICE
+//
+// The following open source license statement does not apply to any
+// entity in the Exception List published by FMSoft.
+//
+// For more information, please visit:
+//
+// https://www.fmsoft.cn/exception-list
+//
+//////////////////////////////////////////////////////////////////////////////
+/*
+ *   This file is part of MiniGUI, a mature cross-platform windowing
+ *   and Graphics User Interface (GUI) support system for embedded systems
+ *   and smart IoT devices.
+ *
+ *   Copyright (C) 2002~2020, Beijing FMSoft Technologies Co., Ltd.
+ *   Copyright (C) 1998~2002, WEI Yongming
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *   Or,
+ *
+ *   As this program is a library, any link to this program must follow
+ *   GNU General Public License version 3 (GPLv3). If you cannot accept
+ *   GPLv3, you need to be licensed from FMSoft.
+ *
+ *   If you have got a commercial license of this program, please use it
+ *   under the terms and conditions of the commercial license.
+ *
+ *   For more information about the commercial license, please refer to
+ *   <http://www.minigui.com/blog/minigui-licensing-policy/>.
+ */
+
+/*
+** blit_A_simd.c: the SSE2 and AVX2 versions of the per-pixel
+**  alpha blending blitters for 32-bit and 16-bit destinations, and the
+**  ones for the premultiplied ARGB8888 sources.
+**
+** The routines here blend 4 to 16 pixels per iteration, and skip the
+**  runs of fully transparent source pixels or copy the runs of fully
+**  opaque ones. They emulate the 32-bit integer arithmetic of the scalar
+**  blitters in blit_A.c exactly, so the result does not depend on the CPU.
+*/
+
+#include <stdio.h>
+
+#include "common.h"
+#include "newgal.h"
+#include "blit_simd.h"
+
+#ifdef GAL_HAVE_SIMD_BLIT
+
+#ifdef GAL_SIMD_X86
+#include <immintrin.h>
+#endif
+
+/* The scalar versions, same as BlitRGBtoRGBPixelAlpha and friends */
+static inline Uint32 blend_rgb_pixel_alpha (Uint32 s, Uint32 d)
+{
+    Uint32 alpha = s >> 24;
+    Uint32 s1, d1;
+
+    if (alpha == GAL_ALPHA_OPAQUE)
+        return s;
+
+    s1 = s & 0xff00ff;
+    d1 = d & 0xff00ff;
+    d1 = (d1 + (((s1 - d1) * alpha) >> 8)) & 0xff00ff;
+    s1 = s & 0xff00;
+    s = d & 0xff00;
+    s = (s + (((s1 - s) * alpha) >> 8)) & 0xff00;
+    return d1 | s | (d & 0xff000000);
+}
+
+/*
+ * The components of a 16-bit pixel are spread as G0RAB65565 (or
+ * G0RAB55555) in a 32-bit word, so they can be blended at the same time.
+ */
+#define DEFINE_BLEND_ARGB_16(name, g_sh, r_sh, spread_mask,            \
+        r_mask, g_mask, r_sh2, g_sh2)                                   \
+static inline Uint16 name (Uint32 s, Uint32 d)                          \
+{                                                                       \
+    unsigned alpha = s >> 27;                                           \
+                                                                        \
+    if (alpha == (GAL_ALPHA_OPAQUE >> 3))                               \
+        return (s >> r_sh2 & r_mask) + (s >> g_sh2 & g_mask)            \
+             + (s >> 3 & 0x1f);                                         \
+                                                                        \
+    s = ((s & (g_mask << g_sh2)) << g_sh) + (s >> r_sh & r_mask)        \
+      + (s >> 3 & 0x1f);                                                \
+    d = (d | d << 16) & spread_mask;                                    \
+    d += (s - d) * alpha >> 5;                                          \
+    d &= spread_mask;                                                   \
+    return d | d >> 16;                                                 \
+}
+
+DEFINE_BLEND_ARGB_16(blend_argb_565, 11, 8, 0x07e0f81f, 0xf800, 0x7e0, 8, 5)
+DEFINE_BLEND_ARGB_16(blend_argb_555, 10, 9, 0x03e07c1f, 0x7c00, 0x3e0, 9, 6)
+
+#ifdef GAL_SIMD_X86
+
+/*
+ * SSE2 has no 32-bit multiplication; but the multiplier (alpha) fits in
+ * 16 bits, so the low 32 bits of the product can be assembled from the
+ * 16-bit multiplications. a16 holds the multiplier in both 16-bit halves.
+ */
+static inline GAL_TARGET_SSE2 __m128i mul32_sse2 (__m128i x, __m128i a16)
+{
+    return _mm_add_epi32 (_mm_mullo_epi16 (x, a16),
+            _mm_slli_epi32 (_mm_mulhi_epu16 (x, a16), 16));
+}
+
+static inline GAL_TARGET_SSE2 __m128i
+blend_rgb_pixel_alpha_sse2 (__m128i s, __m128i d, __m128i a)
+{
+    const __m128i m_ff00ff = _mm_set1_epi32 (0x00ff00ff);
+    const __m128i m_ff00 = _mm_set1_epi32 (0x0000ff00);
+    const __m128i m_alpha = _mm_set1_epi32 (0xff000000);
+    __m128i a16 = _mm_or_si128 (a, _mm_slli_epi32 (a, 16));
+    __m128i opaque = _mm_cmpeq_epi32 (a, _mm_set1_epi32 (GAL_ALPHA_OPAQUE));
+    __m128i s1, d1, t;
+
+    s1 = _mm_and_si128 (s, m_ff00ff);
+    d1 = _mm_and_si128 (d, m_ff00ff);
+    t = mul32_sse2 (_mm_sub_epi32 (s1, d1), a16);
+    d1 = _mm_and_si128 (_mm_add_epi32 (d1, _mm_srli_epi32 (t, 8)), m_ff00ff);
+
+    s1 = _mm_and_si128 (s, m_ff00);
+    t = _mm_and_si128 (d, m_ff00);
+    t = _mm_add_epi32 (t, _mm_srli_epi32 (
+                mul32_sse2 (_mm_sub_epi32 (s1, t), a16), 8));
+    d1 = _mm_or_si128 (d1, _mm_and_si128 (t, m_ff00));
+    d1 = _mm_or_si128 (d1, _mm_and_si128 (d, m_alpha));
+
+    return _mm_or_si128 (_mm_and_si128 (opaque, s),
+            _mm_andnot_si128 (opaque, d1));
+}
+
+DEFINE_SIMD_BLIT(BlitRGBtoRGBPixelAlpha_SSE2, GAL_TARGET_SSE2, Uint32, Uint32, 4,
+    const __m128i zero = _mm_setzero_si128 ();
+    const __m128i opaque = _mm_set1_epi32 (GAL_ALPHA_OPAQUE);,
+    {
+        __m128i s = _mm_loadu_si128 ((const __m128i *)src);
+        __m128i a = _mm_srli_epi32 (s, 24);
+
+        if (_mm_movemask_epi8 (_mm_cmpeq_epi32 (a, zero)) == 0xFFFF) {
+            /* fully transparent: nothing to do */
+        }
+        else if (_mm_movemask_epi8 (_mm_cmpeq_epi32 (a, opaque)) == 0xFFFF) {
+            _mm_storeu_si128 ((__m128i *)dst, s);
+        }
+        else {
+            __m128i d = _mm_loadu_si128 ((const __m128i *)dst);
+            _mm_storeu_si128 ((__m128i *)dst,
+                    blend_rgb_pixel_alpha_sse2 (s, d, a));
+        }
+    },
+    *dst = blend_rgb_pixel_alpha (*src, *dst);)
+
+/*
+ * The premultiplied blend: every component of a pixel is multiplied by
+ * (256 - alpha) in a 16-bit lane, which can not overflow. The source is
+ * added with saturation, like BLEND_PREMUL_ARGB8888.
+ */
+static inline GAL_TARGET_SSE2 __m128i
+blend_premul_sse2 (__m128i s, __m128i d)
+{
+    const __m128i zero = _mm_setzero_si128 ();
+    __m128i ia = _mm_sub_epi32 (_mm_set1_epi32 (256), _mm_srli_epi32 (s, 24));
+    __m128i lo, hi;
+
+    ia = _mm_or_si128 (ia, _mm_slli_epi32 (ia, 16));
+    lo = _mm_mullo_epi16 (_mm_unpacklo_epi8 (d, zero),
+            _mm_unpacklo_epi32 (ia, ia));
+    hi = _mm_mullo_epi16 (_mm_unpackhi_epi8 (d, zero),
+            _mm_unpackhi_epi32 (ia, ia));
+    d = _mm_packus_epi16 (_mm_srli_epi16 (lo, 8), _mm_srli_epi16 (hi, 8));
+    return _mm_adds_epu8 (s, d);
+}
+
+DEFINE_SIMD_BLIT(BlitRGBtoRGBPremulPixelAlpha_SSE2, GAL_TARGET_SSE2,
+        Uint32, Uint32, 4,
+    const __m128i zero = _mm_setzero_si128 ();
+    const __m128i opaque = _mm_set1_epi32 (GAL_ALPHA_OPAQUE);,
+    {
+        __m128i s = _mm_loadu_si128 ((const __m128i *)src);
+
+        if (_mm_movemask_epi8 (_mm_cmpeq_epi32 (s, zero)) == 0xFFFF) {
+            /* fully transparent: nothing to do */
+        }
+        else if (_mm_movemask_epi8 (_mm_cmpeq_epi32 (
+                        _mm_srli_epi32 (s, 24), opaque)) == 0xFFFF) {
+            _mm_storeu_si128 ((__m128i *)dst, s);
+        }
+        else {
+            __m128i d = _mm_loadu_si128 ((const __m128i *)dst);
+            _mm_storeu_si128 ((__m128i *)dst, blend_premul_sse2 (s, d));
+        }
+    },
+    *dst = BLEND_PREMUL_ARGB8888 (*src, *dst);)
+
+/*
+ * Blend four ARGB8888 pixels with four 16-bit pixels zero-extended in the
+ * 32-bit lanes; see DEFINE_BLEND_ARGB_16 for the meaning of the arguments.
+ */
+#define DEFINE_BLEND_ARGB_16_SSE2(name, g_sh, r_sh, spread_mask,       \
+        r_mask, g_mask, r_sh2, g_sh2)                                   \
+static inline GAL_TARGET_SSE2 __m128i name (__m128i s, __m128i d)       \
+{                                                                       \
+    const __m128i m_spread = _mm_set1_epi32 (spread_mask);              \
+    const __m128i m_r = _mm_set1_epi32 (r_mask);                        \
+    const __m128i m_g = _mm_set1_epi32 (g_mask);                        \
+    const __m128i m_b = _mm_set1_epi32 (0x1f);                          \
+    __m128i a = _mm_srli_epi32 (s, 27);                                 \
+    __m128i a16 = _mm_or_si128 (a, _mm_slli_epi32 (a, 16));             \
+    __m128i opaque = _mm_cmpeq_epi32 (a,                                \
+            _mm_set1_epi32 (GAL_ALPHA_OPAQUE >> 3));                    \
+    __m128i b = _mm_and_si128 (_mm_srli_epi32 (s, 3), m_b);             \
+    __m128i o, sc;                                                      \
+                                                                        \
+    o = _mm_add_epi32 (_mm_add_epi32 (                                  \
+            _mm_and_si128 (_mm_srli_epi32 (s, r_sh2), m_r),             \
+            _mm_and_si128 (_mm_srli_epi32 (s, g_sh2), m_g)), b);        \
+                                                                        \
+    sc = _mm_add_epi32 (_mm_add_epi32 (_mm_slli_epi32 (_mm_and_si128 (  \
+            s, _mm_set1_epi32 (g_mask << g_sh2)), g_sh),                \
+            _mm_and_si128 (_mm_srli_epi32 (s, r_sh), m_r)), b);         \
+    d = _mm_and_si128 (_mm_or_si128 (d, _mm_slli_epi32 (d, 16)),        \
+            m_spread);                                                  \
+    d = _mm_add_epi32 (d, _mm_srli_epi32 (                              \
+            mul32_sse2 (_mm_sub_epi32 (sc, d), a16), 5));               \
+    d = _mm_and_si128 (d, m_spread);                                    \
+    d = _mm_or_si128 (d, _mm_srli_epi32 (d, 16));                       \
+                                                                        \
+    return _mm_or_si128 (_mm_and_si128 (opaque, o),                     \
+            _mm_andnot_si128 (opaque, d));                              \
+}
+
+DEFINE_BLEND_ARGB_16_SSE2(blend_argb_565_sse2, 11, 8, 0x07e0f81f,
+        0xf800, 0x7e0, 8, 5)
+DEFINE_BLEND_ARGB_16_SSE2(blend_argb_555_sse2, 10, 9, 0x03e07c1f,
+        0x7c00, 0x3e0, 9, 6)
+
+/* _mm_packs_epi32 saturates, so sign-extend the 16-bit values first */
+#define SSE2_PACK_16(lo, hi)                                            \
+    _mm_packs_epi32 (_mm_srai_epi32 (_mm_slli_epi32 (lo, 16), 16),      \
+                     _mm_srai_epi32 (_mm_slli_epi32 (hi, 16), 16))
+
+/*
+ * A transparent run can be skipped for RGB565 only: the scalar blitter
+ * clears the unused bit 15 of RGB555 pixels even if alpha is zero.
+ */
+#define ARGB_16_SSE2_BODY(blend, can_skip)                              \
+    {                                                                   \
+        __m128i s0 = _mm_loadu_si128 ((const __m128i *)src);            \
+        __m128i s1 = _mm_loadu_si128 ((const __m128i *)(src + 4));      \
+        __m128i a = _mm_or_si128 (_mm_srli_epi32 (s0, 27),              \
+                _mm_slli_epi32 (_mm_srli_epi32 (s1, 27), 16));          \
+                                                                        \
+        if (!(can_skip) ||                                              \
+                _mm_movemask_epi8 (_mm_cmpeq_epi16 (a, zero)) != 0xFFFF) { \
+            __m128i d = _mm_loadu_si128 ((const __m128i *)dst);         \
+            __m128i d0 = _mm_unpacklo_epi16 (d, zero);                  \
+            __m128i d1 = _mm_unpackhi_epi16 (d, zero);                  \
+            d0 = blend (s0, d0);                                        \
+            d1 = blend (s1, d1);                                        \
+            _mm_storeu_si128 ((__m128i *)dst, SSE2_PACK_16 (d0, d1));   \
+        }                                                               \
+    }
+
+DEFINE_SIMD_BLIT(BlitARGBto565PixelAlpha_SSE2, GAL_TARGET_SSE2, Uint32, Uint16, 8,
+    const __m128i zero = _mm_setzero_si128 ();,
+    ARGB_16_SSE2_BODY(blend_argb_565_sse2, TRUE),
+    *dst = blend_argb_565 (*src, *dst);)
+
+DEFINE_SIMD_BLIT(BlitARGBto555PixelAlpha_SSE2, GAL_TARGET_SSE2, Uint32, Uint16, 8,
+    const __m128i zero = _mm_setzero_si128 ();,
+    ARGB_16_SSE2_BODY(blend_argb_555_sse2, FALSE),
+    *dst = blend_argb_555 (*src, *dst);)
+
+/* AVX2 versions; the same algorithms as the SSE2 ones on 256-bit vectors */
+static inline GAL_TARGET_AVX2 __m256i mul32_avx2 (__m256i x, __m256i a)
+{
+    return _mm256_mullo_epi32 (x, a);
+}
+
+static inline GAL_TARGET_AVX2 __m256i
+blend_rgb_pixel_alpha_avx2 (__m256i s, __m256i d, __m256i a)
+{
+    const __m256i m_ff00ff = _mm256_set1_epi32 (0x00ff00ff);
+    const __m256i m_ff00 = _mm256_set1_epi32 (0x0000ff00);
+    const __m256i m_alpha = _mm256_set1_epi32 (0xff000000);
+    __m256i opaque = _mm256_cmpeq_epi32 (a,
+            _mm256_set1_epi32 (GAL_ALPHA_OPAQUE));
+    __m256i s1, d1, t;
+
+    s1 = _mm256_and_si256 (s, m_ff00ff);
+    d1 = _mm256_and_si256 (d, m_ff00ff);
+    t = mul32_avx2 (_mm256_sub_epi32 (s1, d1), a);
+    d1 = _mm256_and_si256 (_mm256_add_epi32 (d1, _mm256_srli_epi32 (t, 8)),
+            m_ff00ff);
+
+    s1 = _mm256_and_si256 (s, m_ff00);
+    t = _mm256_and_si256 (d, m_ff00);
+    t = _mm256_add_epi32 (t, _mm256_srli_epi32 (
+                mul32_avx2 (_mm256_sub_epi32 (s1, t), a), 8));
+    d1 = _mm256_or_si256 (d1, _mm256_and_si256 (t, m_ff00));
+    d1 = _mm256_or_si256 (d1, _mm256_and_si256 (d, m_alpha));
+
+    return _mm256_blendv_epi8 (d1, s, opaque);
+}
+
+DEFINE_SIMD_BLIT(BlitRGBtoRGBPixelAlpha_AVX2, GAL_TARGET_AVX2, Uint32, Uint32, 8,
+    const __m256i zero = _mm256_setzero_si256 ();
+    const __m256i opaque = _mm256_set1_epi32 (GAL_ALPHA_OPAQUE);,
+    {
+        __m256i s = _mm256_loadu_si256 ((const __m256i *)src);
+        __m256i a = _mm256_srli_epi32 (s, 24);
+
+        if (_mm256_movemask_epi8 (_mm256_cmpeq_epi32 (a, zero)) == -1) {
+            /* fully transparent: nothing to do */
+        }
+        else if (_mm256_movemask_epi8 (
+                    _mm256_cmpeq_epi32 (a, opaque)) == -1) {
+            _mm256_storeu_si256 ((__m256i *)dst, s);
+        }
+        else {
+            __m256i d = _mm256_loadu_si256 ((const __m256i *)dst);
+            _mm256_storeu_si256 ((__m256i *)dst,
+                    blend_rgb_pixel_alpha_avx2 (s, d, a));
+        }
+    },
+    *dst = blend_rgb_pixel_alpha (*src, *dst);)
+
+/* The unpack and pack instructions work in the same 128-bit lanes */
+static inline GAL_TARGET_AVX2 __m256i
+blend_premul_avx2 (__m256i s, __m256i d)
+{
+    const __m256i zero = _mm256_setzero_si256 ();
+    __m256i ia = _mm256_sub_epi32 (_mm256_set1_epi32 (256),
+            _mm256_srli_epi32 (s, 24));
+    __m256i lo, hi;
+
+    ia = _mm256_or_si256 (ia, _mm256_slli_epi32 (ia, 16));
+    lo = _mm256_mullo_epi16 (_mm256_unpacklo_epi8 (d, zero),
+            _mm256_unpacklo_epi32 (ia, ia));
+    hi = _mm256_mullo_epi16 (_mm256_unpackhi_epi8 (d, zero),
+            _mm256_unpackhi_epi32 (ia, ia));
+    d = _mm256_packus_epi16 (_mm256_srli_epi16 (lo, 8),
+            _mm256_srli_epi16 (hi, 8));
+    return _mm256_adds_epu8 (s, d);
+}
+
+DEFINE_SIMD_BLIT(BlitRGBtoRGBPremulPixelAlpha_AVX2, GAL_TARGET_AVX2,
+        Uint32, Uint32, 8,
+    const __m256i opaque = _mm256_set1_epi32 (GAL_ALPHA_OPAQUE);,
+    {
+        __m256i s = _mm256_loadu_si256 ((const __m256i *)src);
+
+        if (_mm256_testz_si256 (s, s)) {
+            /* fully transparent: nothing to do */
+        }
+        else if (_mm256_movemask_epi8 (_mm256_cmpeq_epi32 (
+                        _mm256_srli_epi32 (s, 24), opaque)) == -1) {
+            _mm256_storeu_si256 ((__m256i *)dst, s);
+        }
+        else {
+            __m256i d = _mm256_loadu_si256 ((const __m256i *)dst);
+            _mm256_storeu_si256 ((__m256i *)dst, blend_premul_avx2 (s, d));
+        }
+    },
+    *dst = BLEND_PREMUL_ARGB8888 (*src, *dst);)
+
+#define DEFINE_BLEND_ARGB_16_AVX2(name, g_sh, r_sh, spread_mask,       \
+        r_mask, g_mask, r_sh2, g_sh2)                                   \
+static inline GAL_TARGET_AVX2 __m256i name (__m256i s, __m256i d)       \
+{                                                                       \
+    const __m256i m_spread = _mm256_set1_epi32 (spread_mask);           \
+    const __m256i m_r = _mm256_set1_epi32 (r_mask);                     \
+    const __m256i m_g = _mm256_set1_epi32 (g_mask);                     \
+    const __m256i m_b = _mm256_set1_epi32 (0x1f);                       \
+    __m256i a = _mm256_srli_epi32 (s, 27);                              \
+    __m256i opaque = _mm256_cmpeq_epi32 (a,                             \
+            _mm256_set1_epi32 (GAL_ALPHA_OPAQUE >> 3));                 \
+    __m256i b = _mm256_and_si256 (_mm256_srli_epi32 (s, 3), m_b);       \
+    __m256i o, sc;                                                      \
+                                                                        \
+    o = _mm256_add_epi32 (_mm256_add_epi32 (                            \
+            _mm256_and_si256 (_mm256_srli_epi32 (s, r_sh2), m_r),       \
+            _mm256_and_si256 (_mm256_srli_epi32 (s, g_sh2), m_g)), b);  \
+                                                                        \
+    sc = _mm256_add_epi32 (_mm256_add_epi32 (_mm256_slli_epi32 (        \
+            _mm256_and_si256 (s, _mm256_set1_epi32 (g_mask << g_sh2)),  \
+            g_sh), _mm256_and_si256 (_mm256_srli_epi32 (s, r_sh), m_r)),\
+            b);                                                         \
+    d = _mm256_and_si256 (_mm256_or_si256 (d, _mm256_slli_epi32 (d, 16)), \
+            m_spread);                                                  \
+    d = _mm256_add_epi32 (d, _mm256_srli_epi32 (                        \
+            mul32_avx2 (_mm256_sub_epi32 (sc, d), a), 5));              \
+    d = _mm256_and_si256 (d, m_spread);                                 \
+    d = _mm256_or_si256 (d, _mm256_srli_epi32 (d, 16));                 \
+                                                                        \
+    return _mm256_blendv_epi8 (d, o, opaque);                           \
+}
+
+DEFINE_BLEND_ARGB_16_AVX2(blend_argb_565_avx2, 11, 8, 0x07e0f81f,
+        0xf800, 0x7e0, 8, 5)
+DEFINE_BLEND_ARGB_16_AVX2(blend_argb_555_avx2, 10, 9, 0x03e07c1f,
+        0x7c00, 0x3e0, 9, 6)
+
+/*
+ * The pack and unpack instructions work in the 128-bit lanes; the 16-bit
+ * pixels are permuted before unpacking, and the results after packing.
+ */
+#define AVX2_PACK_16(lo, hi)                                            \
+    _mm256_permute4x64_epi64 (_mm256_packs_epi32 (                      \
+        _mm256_srai_epi32 (_mm256_slli_epi32 (lo, 16), 16),             \
+        _mm256_srai_epi32 (_mm256_slli_epi32 (hi, 16), 16)), 0xD8)
+
+#define ARGB_16_AVX2_BODY(blend, can_skip)                              \
+    {                                                                   \
+        __m256i s0 = _mm256_loadu_si256 ((const __m256i *)src);         \
+        __m256i s1 = _mm256_loadu_si256 ((const __m256i *)(src + 8));   \
+        __m256i a = _mm256_or_si256 (_mm256_srli_epi32 (s0, 27),        \
+                _mm256_srli_epi32 (s1, 27));                            \
+                                                                        \
+        if (!(can_skip) || !_mm256_testz_si256 (a, a)) {                \
+            __m256i d = _mm256_permute4x64_epi64 (                      \
+                    _mm256_loadu_si256 ((const __m256i *)dst), 0xD8);   \
+            __m256i d0 = _mm256_unpacklo_epi16 (d, zero);               \
+            __m256i d1 = _mm256_unpackhi_epi16 (d, zero);               \
+            d0 = blend (s0, d0);                                        \
+            d1 = blend (s1, d1);                                        \
+            _mm256_storeu_si256 ((__m256i *)dst, AVX2_PACK_16 (d0, d1)); \
+        }                                                               \
+    }
+
+DEFINE_SIMD_BLIT(BlitARGBto565PixelAlpha_AVX2, GAL_TARGET_AVX2, Uint32, Uint16, 16,
+    const __m256i zero = _mm256_setzero_si256 ();,
+    ARGB_16_AVX2_BODY(blend_argb_565_avx2, TRUE),
+    *dst = blend_argb_565 (*src, *dst);)
+
+DEFINE_SIMD_BLIT(BlitARGBto555PixelAlpha_AVX2, GAL_TARGET_AVX2, Uint32, Uint16, 16,
+    const __m256i zero = _mm256_setzero_si256 ();,
+    ARGB_16_AVX2_BODY(blend_argb_555_avx2, FALSE),
+    *dst = blend_argb_555 (*src, *dst);)
+
+#endif  /* GAL_SIMD_X86 */
+
+#endif  /* GAL_HAVE_SIMD_BLIT */
+
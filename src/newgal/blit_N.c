@@ -49,13 +49,14 @@
 #include "common.h"
 #include "newgal.h"
 #include "blit.h"
+#include "blit_simd.h"
 
 /* Function to check the CPU flags */
 #define MMX_CPU        0x800000
 #ifdef USE_ASMBLIT
-#define CPU_Flags()    Hermes_X86_CPU()
+#define CPU_Flags()    ((Hermes_X86_CPU() & MMX_CPU) | GAL_GetCPUFeatures())
 #else
-#define CPU_Flags()    0L
+#define CPU_Flags()    GAL_GetCPUFeatures()
 #endif
 
 /* Functions to blit from N-bit surfaces to other surfaces */
@@ -1458,6 +1459,16 @@ static const struct blit_table normal_blit_1[] = {
     { 0,0,0, 0, 0,0,0, 0, NULL, NULL },
 };
 static const struct blit_table normal_blit_2[] = {
+#ifdef GAL_SIMD_X86
+    { 0x0000F800,0x000007E0,0x0000001F, 4, 0x00FF0000,0x0000FF00,0x000000FF,
+      GAL_CPU_AVX2, NULL, Blit_RGB565_ARGB8888_AVX2, SET_ALPHA },
+    { 0x0000F800,0x000007E0,0x0000001F, 4, 0x000000FF,0x0000FF00,0x00FF0000,
+      GAL_CPU_AVX2, NULL, Blit_RGB565_ABGR8888_AVX2, SET_ALPHA },
+    { 0x0000F800,0x000007E0,0x0000001F, 4, 0x00FF0000,0x0000FF00,0x000000FF,
+      GAL_CPU_SSE2, NULL, Blit_RGB565_ARGB8888_SSE2, SET_ALPHA },
+    { 0x0000F800,0x000007E0,0x0000001F, 4, 0x000000FF,0x0000FF00,0x00FF0000,
+      GAL_CPU_SSE2, NULL, Blit_RGB565_ABGR8888_SSE2, SET_ALPHA },
+#endif
 #ifdef USE_ASMBLIT
     { 0x0000F800,0x000007E0,0x0000001F, 2, 0x0000001F,0x000007E0,0x0000F800,
       0, ConvertX86p16_16BGR565, ConvertX86, NO_ALPHA },
@@ -1483,6 +1494,20 @@ static const struct blit_table normal_blit_3[] = {
     { 0,0,0, 0, 0,0,0, 0, NULL, BlitNtoN, 0 }
 };
 static const struct blit_table normal_blit_4[] = {
+#ifdef GAL_SIMD_X86
+    { 0x00FF0000,0x0000FF00,0x000000FF, 2, 0x0000F800,0x000007E0,0x0000001F,
+      GAL_CPU_AVX2, NULL, Blit_RGB888_RGB565_AVX2, NO_ALPHA },
+    { 0x00FF0000,0x0000FF00,0x000000FF, 2, 0x00007C00,0x000003E0,0x0000001F,
+      GAL_CPU_AVX2, NULL, Blit_RGB888_RGB555_AVX2, NO_ALPHA },
+    { 0x00FF0000,0x0000FF00,0x000000FF, 4, 0x000000FF,0x0000FF00,0x00FF0000,
+      GAL_CPU_AVX2, NULL, Blit_ARGB8888_ABGR8888_AVX2, SET_ALPHA | COPY_ALPHA },
+    { 0x00FF0000,0x0000FF00,0x000000FF, 2, 0x0000F800,0x000007E0,0x0000001F,
+      GAL_CPU_SSE2, NULL, Blit_RGB888_RGB565_SSE2, NO_ALPHA },
+    { 0x00FF0000,0x0000FF00,0x000000FF, 2, 0x00007C00,0x000003E0,0x0000001F,
+      GAL_CPU_SSE2, NULL, Blit_RGB888_RGB555_SSE2, NO_ALPHA },
+    { 0x00FF0000,0x0000FF00,0x000000FF, 4, 0x000000FF,0x0000FF00,0x00FF0000,
+      GAL_CPU_SSE2, NULL, Blit_ARGB8888_ABGR8888_SSE2, SET_ALPHA | COPY_ALPHA },
+#endif
 #ifdef USE_ASMBLIT
     { 0x00FF0000,0x0000FF00,0x000000FF, 2, 0x0000F800,0x000007E0,0x0000001F,
       MMX_CPU, ConvertMMXpII32_16RGB565, ConvertMMX, NO_ALPHA },
@@ -0,0 +1,359 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+//                          IMPORTANT NOTICE
+//
+// The following open source license statement does not apply to any
+// entity in the Exception List published by FMSoft.
+//
+// For more information, please visit:
+//
+// https://www.fmsoft.cn/exception-list
+//
+//////////////////////////////////////////////////////////////////////////////
+/*
+ *   This file is part of MiniGUI, a mature cross-platform windowing
+ *   and Graphics User Interface (GUI) support system for embedded systems
+ *   and smart IoT devices.
+ *
+ *   Copyright (C) 2002~2020, Beijing FMSoft Technologies Co., Ltd.
+ *   Copyright (C) 1998~2002, WEI Yongming
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *   Or,
+ *
+ *   As this program is a library, any link to this program must follow
+ *   GNU General Public License version 3 (GPLv3). If you cannot accept
+ *   GPLv3, you need to be licensed from FMSoft.
+ *
+ *   If you have got a commercial license of this program, please use it
+ *   under the terms and conditions of the commercial license.
+ *
+ *   For more information about the commercial license, please refer to
+ *   <http://www.minigui.com/blog/minigui-licensing-policy/>.
+ */
+
+/*
+** blit_N_simd.c: the SSE2 and AVX2 versions of the most common
+**  pixel format conversions between the 16-bit and 32-bit surfaces.
+**
+** All routines here produce exactly the same pixels as the scalar ones
+**  in blit_N.c, which are still used for the remaining pixels of a row
+**  and on the CPUs without the SIMD extensions.
+*/
+
+#include <stdio.h>
+
+#include "common.h"
+#include "newgal.h"
+#include "blit_simd.h"
+
+#ifdef GAL_HAVE_SIMD_BLIT
+
+#ifdef GAL_SIMD_X86
+#include <immintrin.h>
+#endif
+
+/* The scalar conversions, same as the ones used by blit_N.c */
+static inline Uint16 rgb888_to_rgb565 (Uint32 pixel)
+{
+    return ((pixel & 0x00F80000) >> 8) |
+           ((pixel & 0x0000FC00) >> 5) |
+           ((pixel & 0x000000F8) >> 3);
+}
+
+static inline Uint16 rgb888_to_rgb555 (Uint32 pixel)
+{
+    return ((pixel & 0x00F80000) >> 9) |
+           ((pixel & 0x0000F800) >> 6) |
+           ((pixel & 0x000000F8) >> 3);
+}
+
+/* Expand the components by replicating the high bits, as the LUTs do */
+static inline Uint32 rgb565_to_argb8888 (Uint32 pixel)
+{
+    Uint32 r = ((pixel >> 8) & 0xF8) | (pixel >> 13);
+    Uint32 g = ((pixel >> 3) & 0xFC) | ((pixel >> 9) & 0x03);
+    Uint32 b = ((pixel << 3) & 0xF8) | ((pixel >> 2) & 0x07);
+
+    return 0xFF000000 | (r << 16) | (g << 8) | b;
+}
+
+static inline Uint32 rgb565_to_abgr8888 (Uint32 pixel)
+{
+    Uint32 r = ((pixel >> 8) & 0xF8) | (pixel >> 13);
+    Uint32 g = ((pixel >> 3) & 0xFC) | ((pixel >> 9) & 0x03);
+    Uint32 b = ((pixel << 3) & 0xF8) | ((pixel >> 2) & 0x07);
+
+    return 0xFF000000 | (b << 16) | (g << 8) | r;
+}
+
+/*
+ * Swapping R and B of 32-bit pixels: the alpha channel is copied if both
+ * surfaces have one, set opaque if only the destination has one, and
+ * cleared if the destination has no alpha channel, just like BlitNtoN and
+ * BlitNtoNCopyAlpha do.
+ */
+static inline void get_swap_alpha (GAL_BlitInfo *info,
+        Uint32 *keep_mask, Uint32 *set_mask)
+{
+    if (info->dst->Amask == 0) {
+        *keep_mask = 0;
+        *set_mask = 0;
+    }
+    else if (info->src->Amask) {
+        *keep_mask = 0xFF000000;
+        *set_mask = 0;
+    }
+    else {
+        *keep_mask = 0;
+        *set_mask = 0xFF000000;
+    }
+}
+
+static inline Uint32 swap_rb (Uint32 pixel, Uint32 keep_mask, Uint32 set_mask)
+{
+    return (pixel & (keep_mask | 0x0000FF00)) | set_mask |
+           ((pixel >> 16) & 0xFF) | ((pixel & 0xFF) << 16);
+}
+
+#define SWAP_RB(pixel) swap_rb (pixel, keep_mask, set_mask)
+
+#ifdef GAL_SIMD_X86
+
+/*
+ * SSE2 versions; 8 pixels per iteration.
+ *
+ * _mm_packs_epi32 saturates signed values, so the 16-bit pixels are
+ * sign-extended in the 32-bit lanes before packing.
+ */
+#define SSE2_PACK_16(lo, hi)                                    \
+    _mm_packs_epi32 (_mm_srai_epi32 (_mm_slli_epi32 (lo, 16), 16),  \
+                     _mm_srai_epi32 (_mm_slli_epi32 (hi, 16), 16))
+
+#define SSE2_RGB888_16(x, rs, rm, gs, gm, bs, bm)               \
+    _mm_or_si128 (_mm_or_si128 (                                \
+        _mm_and_si128 (_mm_srli_epi32 (x, rs), rm),             \
+        _mm_and_si128 (_mm_srli_epi32 (x, gs), gm)),            \
+        _mm_and_si128 (_mm_srli_epi32 (x, bs), bm))
+
+DEFINE_SIMD_BLIT(Blit_RGB888_RGB565_SSE2, GAL_TARGET_SSE2, Uint32, Uint16, 8,
+    const __m128i rmask = _mm_set1_epi32 (0xF800);
+    const __m128i gmask = _mm_set1_epi32 (0x07E0);
+    const __m128i bmask = _mm_set1_epi32 (0x001F);,
+    {
+        __m128i x0 = _mm_loadu_si128 ((const __m128i *)src);
+        __m128i x1 = _mm_loadu_si128 ((const __m128i *)(src + 4));
+        x0 = SSE2_RGB888_16 (x0, 8, rmask, 5, gmask, 3, bmask);
+        x1 = SSE2_RGB888_16 (x1, 8, rmask, 5, gmask, 3, bmask);
+        _mm_storeu_si128 ((__m128i *)dst, SSE2_PACK_16 (x0, x1));
+    },
+    *dst = rgb888_to_rgb565 (*src);)
+
+DEFINE_SIMD_BLIT(Blit_RGB888_RGB555_SSE2, GAL_TARGET_SSE2, Uint32, Uint16, 8,
+    const __m128i rmask = _mm_set1_epi32 (0x7C00);
+    const __m128i gmask = _mm_set1_epi32 (0x03E0);
+    const __m128i bmask = _mm_set1_epi32 (0x001F);,
+    {
+        __m128i x0 = _mm_loadu_si128 ((const __m128i *)src);
+        __m128i x1 = _mm_loadu_si128 ((const __m128i *)(src + 4));
+        x0 = SSE2_RGB888_16 (x0, 9, rmask, 6, gmask, 3, bmask);
+        x1 = SSE2_RGB888_16 (x1, 9, rmask, 6, gmask, 3, bmask);
+        _mm_storeu_si128 ((__m128i *)dst, SSE2_PACK_16 (x0, x1));
+    },
+    *dst = rgb888_to_rgb555 (*src);)
+
+/* Expand eight RGB565 pixels to the 8-bit components in 16-bit lanes */
+#define SSE2_EXPAND_565(p, r, g, b)                                     \
+    r = _mm_or_si128 (_mm_and_si128 (_mm_srli_epi16 (p, 8), m_f8),      \
+                      _mm_srli_epi16 (p, 13));                          \
+    g = _mm_or_si128 (_mm_and_si128 (_mm_srli_epi16 (p, 3), m_fc),      \
+                      _mm_and_si128 (_mm_srli_epi16 (p, 9), m_03));     \
+    b = _mm_or_si128 (_mm_and_si128 (_mm_slli_epi16 (p, 3), m_f8),      \
+                      _mm_and_si128 (_mm_srli_epi16 (p, 2), m_07));
+
+#define SSE2_EXPAND_565_PROLOGUE                                        \
+    const __m128i m_f8 = _mm_set1_epi16 (0xF8);                         \
+    const __m128i m_fc = _mm_set1_epi16 (0xFC);                         \
+    const __m128i m_03 = _mm_set1_epi16 (0x03);                         \
+    const __m128i m_07 = _mm_set1_epi16 (0x07);                         \
+    const __m128i m_ff00 = _mm_set1_epi16 ((short)0xFF00);
+
+/* lo holds the two low bytes and hi the two high bytes of the pixels */
+#define SSE2_STORE_8888(dst, lo, hi)                                    \
+    _mm_storeu_si128 ((__m128i *)dst, _mm_unpacklo_epi16 (lo, hi));     \
+    _mm_storeu_si128 ((__m128i *)(dst + 4), _mm_unpackhi_epi16 (lo, hi));
+
+DEFINE_SIMD_BLIT(Blit_RGB565_ARGB8888_SSE2, GAL_TARGET_SSE2, Uint16, Uint32, 8,
+    SSE2_EXPAND_565_PROLOGUE,
+    {
+        __m128i r; __m128i g; __m128i b; __m128i lo; __m128i hi;
+        __m128i p = _mm_loadu_si128 ((const __m128i *)src);
+        SSE2_EXPAND_565 (p, r, g, b);
+        lo = _mm_or_si128 (_mm_slli_epi16 (g, 8), b);
+        hi = _mm_or_si128 (m_ff00, r);
+        SSE2_STORE_8888 (dst, lo, hi);
+    },
+    *dst = rgb565_to_argb8888 (*src);)
+
+DEFINE_SIMD_BLIT(Blit_RGB565_ABGR8888_SSE2, GAL_TARGET_SSE2, Uint16, Uint32, 8,
+    SSE2_EXPAND_565_PROLOGUE,
+    {
+        __m128i r; __m128i g; __m128i b; __m128i lo; __m128i hi;
+        __m128i p = _mm_loadu_si128 ((const __m128i *)src);
+        SSE2_EXPAND_565 (p, r, g, b);
+        lo = _mm_or_si128 (_mm_slli_epi16 (g, 8), r);
+        hi = _mm_or_si128 (m_ff00, b);
+        SSE2_STORE_8888 (dst, lo, hi);
+    },
+    *dst = rgb565_to_abgr8888 (*src);)
+
+#define SSE2_SWAP_RB(x)                                                 \
+    _mm_or_si128 (_mm_or_si128 (_mm_and_si128 (x, keep),                \
+            _mm_and_si128 (_mm_srli_epi32 (x, 16), m_ff)),              \
+            _mm_or_si128 (_mm_slli_epi32 (_mm_and_si128 (x, m_ff), 16), \
+                set))
+
+#define SWAP_RB_PROLOGUE                                                \
+    Uint32 keep_mask, set_mask;                                         \
+    get_swap_alpha (info, &keep_mask, &set_mask);
+
+DEFINE_SIMD_BLIT(Blit_ARGB8888_ABGR8888_SSE2, GAL_TARGET_SSE2, Uint32, Uint32, 8,
+    SWAP_RB_PROLOGUE
+    const __m128i keep = _mm_set1_epi32 (keep_mask | 0x0000FF00);
+    const __m128i set = _mm_set1_epi32 (set_mask);
+    const __m128i m_ff = _mm_set1_epi32 (0xFF);,
+    {
+        __m128i x0 = _mm_loadu_si128 ((const __m128i *)src);
+        __m128i x1 = _mm_loadu_si128 ((const __m128i *)(src + 4));
+        _mm_storeu_si128 ((__m128i *)dst, SSE2_SWAP_RB (x0));
+        _mm_storeu_si128 ((__m128i *)(dst + 4), SSE2_SWAP_RB (x1));
+    },
+    *dst = SWAP_RB (*src);)
+
+/*
+ * AVX2 versions; 16 pixels per iteration.
+ *
+ * The pack and unpack instructions work in the 128-bit lanes, so the
+ * results need to be permuted across the lanes.
+ */
+#define AVX2_PACK_16(lo, hi)                                            \
+    _mm256_permute4x64_epi64 (_mm256_packs_epi32 (                      \
+        _mm256_srai_epi32 (_mm256_slli_epi32 (lo, 16), 16),             \
+        _mm256_srai_epi32 (_mm256_slli_epi32 (hi, 16), 16)), 0xD8)
+
+#define AVX2_RGB888_16(x, rs, rm, gs, gm, bs, bm)                       \
+    _mm256_or_si256 (_mm256_or_si256 (                                  \
+        _mm256_and_si256 (_mm256_srli_epi32 (x, rs), rm),               \
+        _mm256_and_si256 (_mm256_srli_epi32 (x, gs), gm)),              \
+        _mm256_and_si256 (_mm256_srli_epi32 (x, bs), bm))
+
+DEFINE_SIMD_BLIT(Blit_RGB888_RGB565_AVX2, GAL_TARGET_AVX2, Uint32, Uint16, 16,
+    const __m256i rmask = _mm256_set1_epi32 (0xF800);
+    const __m256i gmask = _mm256_set1_epi32 (0x07E0);
+    const __m256i bmask = _mm256_set1_epi32 (0x001F);,
+    {
+        __m256i x0 = _mm256_loadu_si256 ((const __m256i *)src);
+        __m256i x1 = _mm256_loadu_si256 ((const __m256i *)(src + 8));
+        x0 = AVX2_RGB888_16 (x0, 8, rmask, 5, gmask, 3, bmask);
+        x1 = AVX2_RGB888_16 (x1, 8, rmask, 5, gmask, 3, bmask);
+        _mm256_storeu_si256 ((__m256i *)dst, AVX2_PACK_16 (x0, x1));
+    },
+    *dst = rgb888_to_rgb565 (*src);)
+
+DEFINE_SIMD_BLIT(Blit_RGB888_RGB555_AVX2, GAL_TARGET_AVX2, Uint32, Uint16, 16,
+    const __m256i rmask = _mm256_set1_epi32 (0x7C00);
+    const __m256i gmask = _mm256_set1_epi32 (0x03E0);
+    const __m256i bmask = _mm256_set1_epi32 (0x001F);,
+    {
+        __m256i x0 = _mm256_loadu_si256 ((const __m256i *)src);
+        __m256i x1 = _mm256_loadu_si256 ((const __m256i *)(src + 8));
+        x0 = AVX2_RGB888_16 (x0, 9, rmask, 6, gmask, 3, bmask);
+        x1 = AVX2_RGB888_16 (x1, 9, rmask, 6, gmask, 3, bmask);
+        _mm256_storeu_si256 ((__m256i *)dst, AVX2_PACK_16 (x0, x1));
+    },
+    *dst = rgb888_to_rgb555 (*src);)
+
+#define AVX2_EXPAND_565(p, r, g, b)                                     \
+    r = _mm256_or_si256 (_mm256_and_si256 (_mm256_srli_epi16 (p, 8), m_f8), \
+                         _mm256_srli_epi16 (p, 13));                    \
+    g = _mm256_or_si256 (_mm256_and_si256 (_mm256_srli_epi16 (p, 3), m_fc), \
+                         _mm256_and_si256 (_mm256_srli_epi16 (p, 9), m_03)); \
+    b = _mm256_or_si256 (_mm256_and_si256 (_mm256_slli_epi16 (p, 3), m_f8), \
+                         _mm256_and_si256 (_mm256_srli_epi16 (p, 2), m_07));
+
+#define AVX2_EXPAND_565_PROLOGUE                                        \
+    const __m256i m_f8 = _mm256_set1_epi16 (0xF8);                      \
+    const __m256i m_fc = _mm256_set1_epi16 (0xFC);                      \
+    const __m256i m_03 = _mm256_set1_epi16 (0x03);                      \
+    const __m256i m_07 = _mm256_set1_epi16 (0x07);                      \
+    const __m256i m_ff00 = _mm256_set1_epi16 ((short)0xFF00);
+
+#define AVX2_STORE_8888(dst, lo, hi)                                    \
+{                                                                       \
+    __m256i p0 = _mm256_unpacklo_epi16 (lo, hi);                        \
+    __m256i p1 = _mm256_unpackhi_epi16 (lo, hi);                        \
+    _mm256_storeu_si256 ((__m256i *)dst,                                \
+            _mm256_permute2x128_si256 (p0, p1, 0x20));                  \
+    _mm256_storeu_si256 ((__m256i *)(dst + 8),                          \
+            _mm256_permute2x128_si256 (p0, p1, 0x31));                  \
+}
+
+DEFINE_SIMD_BLIT(Blit_RGB565_ARGB8888_AVX2, GAL_TARGET_AVX2, Uint16, Uint32, 16,
+    AVX2_EXPAND_565_PROLOGUE,
+    {
+        __m256i r; __m256i g; __m256i b; __m256i lo; __m256i hi;
+        __m256i p = _mm256_loadu_si256 ((const __m256i *)src);
+        AVX2_EXPAND_565 (p, r, g, b);
+        lo = _mm256_or_si256 (_mm256_slli_epi16 (g, 8), b);
+        hi = _mm256_or_si256 (m_ff00, r);
+        AVX2_STORE_8888 (dst, lo, hi);
+    },
+    *dst = rgb565_to_argb8888 (*src);)
+
+DEFINE_SIMD_BLIT(Blit_RGB565_ABGR8888_AVX2, GAL_TARGET_AVX2, Uint16, Uint32, 16,
+    AVX2_EXPAND_565_PROLOGUE,
+    {
+        __m256i r; __m256i g; __m256i b; __m256i lo; __m256i hi;
+        __m256i p = _mm256_loadu_si256 ((const __m256i *)src);
+        AVX2_EXPAND_565 (p, r, g, b);
+        lo = _mm256_or_si256 (_mm256_slli_epi16 (g, 8), r);
+        hi = _mm256_or_si256 (m_ff00, b);
+        AVX2_STORE_8888 (dst, lo, hi);
+    },
+    *dst = rgb565_to_abgr8888 (*src);)
+
+#define AVX2_SWAP_RB(x)                                                 \
+    _mm256_or_si256 (_mm256_or_si256 (_mm256_and_si256 (x, keep),       \
+            _mm256_and_si256 (_mm256_srli_epi32 (x, 16), m_ff)),        \
+            _mm256_or_si256 (                                           \
+                _mm256_slli_epi32 (_mm256_and_si256 (x, m_ff), 16), set))
+
+DEFINE_SIMD_BLIT(Blit_ARGB8888_ABGR8888_AVX2, GAL_TARGET_AVX2, Uint32, Uint32, 16,
+    SWAP_RB_PROLOGUE
+    const __m256i keep = _mm256_set1_epi32 (keep_mask | 0x0000FF00);
+    const __m256i set = _mm256_set1_epi32 (set_mask);
+    const __m256i m_ff = _mm256_set1_epi32 (0xFF);,
+    {
+        __m256i x0 = _mm256_loadu_si256 ((const __m256i *)src);
+        __m256i x1 = _mm256_loadu_si256 ((const __m256i *)(src + 8));
+        _mm256_storeu_si256 ((__m256i *)dst, AVX2_SWAP_RB (x0));
+        _mm256_storeu_si256 ((__m256i *)(dst + 8), AVX2_SWAP_RB (x1));
+    },
+    *dst = SWAP_RB (*src);)
+
+#endif  /* GAL_SIMD_X86 */
+
+#endif  /* GAL_HAVE_SIMD_BLIT */
+
@@ -0,0 +1,175 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+//                          IMPORTANT NOTICE
+//
+// The following open source license statement does not apply to any
+// entity in the Exception List published by FMSoft.
+//
+// For more information, please visit:
+//
+// https://www.fmsoft.cn/exception-list
+//
+//////////////////////////////////////////////////////////////////////////////
+/*
+ *   This file is part of MiniGUI, a mature cross-platform windowing
+ *   and Graphics User Interface (GUI) support system for embedded systems
+ *   and smart IoT devices.
+ *
+ *   Copyright (C) 2002~2020, Beijing FMSoft Technologies Co., Ltd.
+ *   Copyright (C) 1998~2002, WEI Yongming
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *   Or,
+ *
+ *   As this program is a library, any link to this program must follow
+ *   GNU General Public License version 3 (GPLv3). If you cannot accept
+ *   GPLv3, you need to be licensed from FMSoft.
+ *
+ *   If you have got a commercial license of this program, please use it
+ *   under the terms and conditions of the commercial license.
+ *
+ *   For more information about the commercial license, please refer to
+ *   <http://www.minigui.com/blog/minigui-licensing-policy/>.
+ */
+
+/*
+** blit_simd.h: the definitions for the vectorized software blitters.
+*/
+
+#ifndef _GAL_blit_simd_h
+#define _GAL_blit_simd_h
+
+#include "blit.h"
+
+#ifdef _MGGAL_SIMD_BLIT
+
+/*
+ * The x86 routines are compiled with the function-level target attributes,
+ * so the whole library needs not to be built with -msse2 or -mavx2; they
+ * will be used only if GAL_GetCPUFeatures() reports the instruction set.
+ */
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#   define GAL_SIMD_X86         1
+#   define GAL_TARGET_SSE2      __attribute__((target("sse2")))
+#   define GAL_TARGET_AVX2      __attribute__((target("avx2")))
+#endif
+
+#ifdef GAL_SIMD_X86
+#   define GAL_HAVE_SIMD_BLIT   1
+#endif
+
+#endif  /* _MGGAL_SIMD_BLIT */
+
+#ifdef GAL_HAVE_SIMD_BLIT
+
+/*
+ * The common framework of the SIMD blitters: every routine handles the
+ * pixels of a row in chunks of STEP pixels with VECTOR_BODY, then the
+ * remaining ones with SCALAR_BODY, which must produce the same result
+ * as the scalar blitter. Both bodies work on the pointers src and dst.
+ */
+#define DEFINE_SIMD_BLIT(name, target, src_type, dst_type, STEP,       \
+        PROLOGUE, VECTOR_BODY, SCALAR_BODY)                             \
+target void name (GAL_BlitInfo *info)                                   \
+{                                                                       \
+    int height = info->d_height;                                        \
+    const src_type *src = (const src_type *)info->s_pixels;             \
+    dst_type *dst = (dst_type *)info->d_pixels;                         \
+    int srcskip = info->s_skip / sizeof (src_type);                     \
+    int dstskip = info->d_skip / sizeof (dst_type);                     \
+    PROLOGUE                                                            \
+                                                                        \
+    while (height--) {                                                  \
+        int width = info->d_width;                                      \
+                                                                        \
+        while (width >= STEP) {                                         \
+            VECTOR_BODY                                                 \
+            src += STEP;                                                \
+            dst += STEP;                                                \
+            width -= STEP;                                              \
+        }                                                               \
+        while (width-- > 0) {                                           \
+            SCALAR_BODY                                                 \
+            src++;                                                      \
+            dst++;                                                      \
+        }                                                               \
+        src += srcskip;                                                 \
+        dst += dstskip;                                                 \
+    }                                                                   \
+}
+
+#define NOTHING
+
+/* Functions found in blit_N_simd.c */
+#ifdef GAL_SIMD_X86
+extern void Blit_RGB888_RGB565_SSE2(GAL_BlitInfo *info);
+extern void Blit_RGB888_RGB555_SSE2(GAL_BlitInfo *info);
+extern void Blit_RGB565_ARGB8888_SSE2(GAL_BlitInfo *info);
+extern void Blit_RGB565_ABGR8888_SSE2(GAL_BlitInfo *info);
+extern void Blit_ARGB8888_ABGR8888_SSE2(GAL_BlitInfo *info);
+
+extern void Blit_RGB888_RGB565_AVX2(GAL_BlitInfo *info);
+extern void Blit_RGB888_RGB555_AVX2(GAL_BlitInfo *info);
+extern void Blit_RGB565_ARGB8888_AVX2(GAL_BlitInfo *info);
+extern void Blit_RGB565_ABGR8888_AVX2(GAL_BlitInfo *info);
+extern void Blit_ARGB8888_ABGR8888_AVX2(GAL_BlitInfo *info);
+#endif
+
+/* Functions found in blit_A_simd.c */
+#ifdef GAL_SIMD_X86
+extern void BlitRGBtoRGBPixelAlpha_SSE2(GAL_BlitInfo *info);
+extern void BlitARGBto565PixelAlpha_SSE2(GAL_BlitInfo *info);
+extern void BlitARGBto555PixelAlpha_SSE2(GAL_BlitInfo *info);
+extern void BlitRGBtoRGBPremulPixelAlpha_SSE2(GAL_BlitInfo *info);
+
+extern void BlitRGBtoRGBPixelAlpha_AVX2(GAL_BlitInfo *info);
+extern void BlitARGBto565PixelAlpha_AVX2(GAL_BlitInfo *info);
+extern void BlitARGBto555PixelAlpha_AVX2(GAL_BlitInfo *info);
+extern void BlitRGBtoRGBPremulPixelAlpha_AVX2(GAL_BlitInfo *info);
+#endif
+
+/*
+ * Choose the fastest version of a blitter for the current CPU; the
+ * versions which are not compiled in are passed as NULL.
+ */
+static inline GAL_loblit GAL_ChooseSIMDBlit (GAL_loblit blit_c,
+        GAL_loblit blit_sse2, GAL_loblit blit_avx2)
+{
+    Uint32 features = GAL_GetCPUFeatures ();
+
+    if (blit_avx2 && (features & GAL_CPU_AVX2))
+        return blit_avx2;
+    if (blit_sse2 && (features & GAL_CPU_SSE2))
+        return blit_sse2;
+    return blit_c;
+}
+
+#ifdef GAL_SIMD_X86
+#   define SIMD_X86_BLITS(name)     name##_SSE2, name##_AVX2
+#else
+#   define SIMD_X86_BLITS(name)     NULL, NULL
+#endif
+
+#define CHOOSE_SIMD_BLIT(name)                                          \
+    GAL_ChooseSIMDBlit (name, SIMD_X86_BLITS(name))
+
+#else   /* GAL_HAVE_SIMD_BLIT */
+
+#define CHOOSE_SIMD_BLIT(name)      (name)
+
+#endif  /* !GAL_HAVE_SIMD_BLIT */
+
+#endif  /* _GAL_blit_simd_h */
+
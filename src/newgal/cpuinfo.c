@@ -0,0 +1,109 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+//                          IMPORTANT NOTICE
+//
+// The following open source license statement does not apply to any
+// entity in the Exception List published by FMSoft.
+//
+// For more information, please visit:
+//
+// https://www.fmsoft.cn/exception-list
+//
+//////////////////////////////////////////////////////////////////////////////
+/*
+ *   This file is part of MiniGUI, a mature cross-platform windowing
+ *   and Graphics User Interface (GUI) support system for embedded systems
+ *   and smart IoT devices.
+ *
+ *   Copyright (C) 2002~2020, Beijing FMSoft Technologies Co., Ltd.
+ *   Copyright (C) 1998~2002, WEI Yongming
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *   Or,
+ *
+ *   As this program is a library, any link to this program must follow
+ *   GNU General Public License version 3 (GPLv3). If you cannot accept
+ *   GPLv3, you need to be licensed from FMSoft.
+ *
+ *   If you have got a commercial license of this program, please use it
+ *   under the terms and conditions of the commercial license.
+ *
+ *   For more information about the commercial license, please refer to
+ *   <http://www.minigui.com/blog/minigui-licensing-policy/>.
+ */
+
+/*
+** cpuinfo.c: detect the SIMD features of the current CPU at runtime,
+**  so that the software blitters can pick the vectorized routines.
+*/
+
+#include <stdio.h>
+
+#include "common.h"
+#include "newgal.h"
+
+#ifdef _MGGAL_SIMD_BLIT
+
+static Uint32 cpu_features = 0;
+static int cpu_features_checked = 0;
+
+static Uint32 detect_cpu_features (void)
+{
+    Uint32 features = 0;
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+    __builtin_cpu_init ();
+    if (__builtin_cpu_supports ("mmx"))
+        features |= GAL_CPU_MMX;
+    if (__builtin_cpu_supports ("sse2"))
+        features |= GAL_CPU_SSE2;
+    if (__builtin_cpu_supports ("ssse3"))
+        features |= GAL_CPU_SSSE3;
+    /* libgcc checks the OS support for YMM registers (XGETBV) as well */
+    if (__builtin_cpu_supports ("avx2"))
+        features |= GAL_CPU_AVX2;
+#endif
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+    /* NEON is mandatory if the compiler was told it can emit NEON code */
+    features |= GAL_CPU_NEON;
+#endif
+
+    return features;
+}
+
+Uint32 GAL_GetCPUFeatures (void)
+{
+    /* The result is constant; a harmless race if called concurrently */
+    if (!cpu_features_checked) {
+        cpu_features = detect_cpu_features ();
+        cpu_features_checked = 1;
+
+        _DBG_PRINTF ("NEWGAL: CPU features for blitters: 0x%08x\n",
+                cpu_features);
+    }
+
+    return cpu_features;
+}
+
+#else   /* _MGGAL_SIMD_BLIT */
+
+Uint32 GAL_GetCPUFeatures (void)
+{
+    return 0;
+}
+
+#endif  /* !_MGGAL_SIMD_BLIT */
+
@@ -0,0 +1,325 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+//                          IMPORTANT NOTICE
+//
+// The following open source license statement does not apply to any
+// entity in the Exception List published by FMSoft.
+//
+// For more information, please visit:
+//
+// https://www.fmsoft.cn/exception-list
+//
+//////////////////////////////////////////////////////////////////////////////
+/*
+ *   This file is part of MiniGUI, a mature cross-platform windowing
+ *   and Graphics User Interface (GUI) support system for embedded systems
+ *   and smart IoT devices.
+ *
+ *   Copyright (C) 2002~2020, Beijing FMSoft Technologies Co., Ltd.
+ *   Copyright (C) 1998~2002, WEI Yongming
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *   Or,
+ *
+ *   As this program is a library, any link to this program must follow
+ *   GNU General Public License version 3 (GPLv3). If you cannot accept
+ *   GPLv3, you need to be licensed from FMSoft.
+ *
+ *   If you have got a commercial license of this program, please use it
+ *   under the terms and conditions of the commercial license.
+ *
+ *   For more information about the commercial license, please refer to
+ *   <http://www.minigui.com/blog/minigui-licensing-policy/>.
+ */
+
+/*
+** damage.c: the damage filter which drops the unchanged tiles of
+**  the screen before calling UpdateRects of a NEWGAL engine.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "common.h"
+#include "minigui.h"
+#include "newgal.h"
+#include "sysvideo.h"
+#include "damage_c.h"
+
+struct _GAL_DamageFilter {
+    GAL_Surface* screen;
+    GAL_TileDiff diff;
+};
+
+static int get_tile_size (GAL_VideoDevice* video)
+{
+    char* env;
+    int tile_size = 0;
+
+    if ((env = getenv ("MG_GAL_DAMAGE_TILE_SIZE")))
+        tile_size = atoi (env);
+    else if (GetMgEtcIntValue (video->name, "damage_tile_size",
+                &tile_size) < 0)
+        tile_size = 0;
+
+    if (tile_size <= 0)
+        return 0;
+
+    if (tile_size < GAL_DAMAGE_MIN_TILE || tile_size > GAL_DAMAGE_MAX_TILE ||
+            (tile_size & (tile_size - 1))) {
+        _WRN_PRINTF ("NEWGAL: bad damage tile size: %d; filter disabled\n",
+                tile_size);
+        return 0;
+    }
+
+    return tile_size;
+}
+
+int GAL_InitTileDiff (GAL_TileDiff* diff, const void* pixels,
+        int pitch, int Bpp, int w, int h, int tile_size)
+{
+    int nr_tiles;
+
+    memset (diff, 0, sizeof (GAL_TileDiff));
+    diff->pixels = pixels;
+    diff->pitch = pitch;
+    diff->Bpp = Bpp;
+    diff->w = w;
+    diff->h = h;
+    diff->tile_size = tile_size;
+    while ((1 << diff->tile_shift) < tile_size)
+        diff->tile_shift++;
+
+    diff->cols = (w + tile_size - 1) >> diff->tile_shift;
+    diff->rows = (h + tile_size - 1) >> diff->tile_shift;
+    nr_tiles = diff->cols * diff->rows;
+
+    diff->sums = calloc (nr_tiles, sizeof (Uint64));
+    diff->stamps = calloc (nr_tiles, sizeof (Uint32));
+    diff->changed = calloc (nr_tiles, sizeof (BYTE));
+    diff->rects = malloc (nr_tiles * sizeof (GAL_Rect));
+    if (diff->sums == NULL || diff->stamps == NULL ||
+            diff->changed == NULL || diff->rects == NULL) {
+        GAL_FreeTileDiff (diff);
+        return -1;
+    }
+
+    return 0;
+}
+
+void GAL_FreeTileDiff (GAL_TileDiff* diff)
+{
+    free (diff->sums);
+    free (diff->stamps);
+    free (diff->changed);
+    free (diff->rects);
+    diff->sums = NULL;
+    diff->stamps = NULL;
+    diff->changed = NULL;
+    diff->rects = NULL;
+}
+
+GAL_DamageFilter* GAL_CreateDamageFilter (GAL_VideoDevice* video,
+        GAL_Surface* screen)
+{
+    GAL_DamageFilter* filter;
+    int tile_size;
+
+    if ((tile_size = get_tile_size (video)) == 0)
+        return NULL;
+
+    filter = calloc (1, sizeof (GAL_DamageFilter));
+    if (filter == NULL)
+        goto error;
+
+    filter->screen = screen;
+    if (GAL_InitTileDiff (&filter->diff,
+                (Uint8*)screen->pixels + screen->pixels_off, screen->pitch,
+                screen->format->BytesPerPixel, screen->w, screen->h,
+                tile_size)) {
+        free (filter);
+        goto error;
+    }
+
+    _DBG_PRINTF ("NEWGAL: damage filter of %s: %dx%d tiles of %d pixels\n",
+            video->name, filter->diff.cols, filter->diff.rows, tile_size);
+    return filter;
+
+error:
+    GAL_OutOfMemory ();
+    return NULL;
+}
+
+void GAL_DeleteDamageFilter (GAL_DamageFilter* filter)
+{
+    if (filter) {
+        GAL_FreeTileDiff (&filter->diff);
+        free (filter);
+    }
+}
+
+/* FNV-1a over the 32-bit words of a tile; never returns zero */
+static Uint64 checksum_tile (GAL_TileDiff* diff, int col, int row)
+{
+    Uint64 sum = 0xCBF29CE484222325ULL;
+    const Uint8* line;
+    int x, y, w, h, bytes;
+
+    x = col << diff->tile_shift;
+    y = row << diff->tile_shift;
+    w = MIN (diff->tile_size, diff->w - x);
+    h = MIN (diff->tile_size, diff->h - y);
+
+    bytes = w * diff->Bpp;
+    line = diff->pixels + y * diff->pitch + x * diff->Bpp;
+
+    while (h--) {
+        int i;
+
+        for (i = 0; i + 4 <= bytes; i += 4) {
+            Uint32 word;
+            memcpy (&word, line + i, 4);
+            sum = (sum ^ word) * 0x100000001B3ULL;
+        }
+        for (; i < bytes; i++)
+            sum = (sum ^ line [i]) * 0x100000001B3ULL;
+
+        line += diff->pitch;
+    }
+
+    return sum ? sum : 1;
+}
+
+static void add_run (GAL_TileDiff* diff, int* nr_rects,
+        int row_start, const GAL_Rect* run)
+{
+    GAL_Rect* rects = diff->rects;
+    int i;
+
+    /* extend a rectangle of the same columns ending at this row */
+    for (i = 0; i < row_start; i++) {
+        if (rects [i].y + rects [i].h == run->y &&
+                rects [i].x == run->x && rects [i].w == run->w) {
+            rects [i].h += run->h;
+            return;
+        }
+    }
+
+    rects [(*nr_rects)++] = *run;
+}
+
+int GAL_DiffTiles (GAL_TileDiff* diff,
+        int numrects, const GAL_Rect* rects, GAL_Rect** merged)
+{
+    int i, col, row, nr_rects = 0;
+    int col_from = diff->cols, col_to = -1;
+    int row_from = diff->rows, row_to = -1;
+
+    if (++diff->pass == 0) {
+        memset (diff->stamps, 0, diff->cols * diff->rows * sizeof (Uint32));
+        diff->pass = 1;
+    }
+
+    /* checksum the tiles touched by the rectangles */
+    for (i = 0; i < numrects; i++) {
+        int x0, y0, x1, y1;
+
+        x0 = MAX (rects [i].x, 0);
+        y0 = MAX (rects [i].y, 0);
+        x1 = MIN (rects [i].x + rects [i].w, diff->w);
+        y1 = MIN (rects [i].y + rects [i].h, diff->h);
+        if (x0 >= x1 || y0 >= y1)
+            continue;
+
+        x0 >>= diff->tile_shift;
+        y0 >>= diff->tile_shift;
+        x1 = (x1 - 1) >> diff->tile_shift;
+        y1 = (y1 - 1) >> diff->tile_shift;
+
+        for (row = y0; row <= y1; row++) {
+            for (col = x0; col <= x1; col++) {
+                int idx = row * diff->cols + col;
+                Uint64 sum;
+
+                if (diff->stamps [idx] == diff->pass)
+                    continue;
+
+                diff->stamps [idx] = diff->pass;
+                sum = checksum_tile (diff, col, row);
+                if (sum == diff->sums [idx]) {
+                    diff->changed [idx] = 0;
+                    diff->nr_hits++;
+                }
+                else {
+                    diff->sums [idx] = sum;
+                    diff->changed [idx] = 1;
+                    diff->nr_misses++;
+                }
+            }
+        }
+
+        col_from = MIN (col_from, x0);
+        col_to = MAX (col_to, x1);
+        row_from = MIN (row_from, y0);
+        row_to = MAX (row_to, y1);
+    }
+
+    /* merge the changed tiles into rectangles */
+    for (row = row_from; row <= row_to; row++) {
+        int row_start = nr_rects;
+        GAL_Rect run;
+
+        run.w = 0;
+        for (col = col_from; col <= col_to + 1; col++) {
+            int idx = row * diff->cols + col;
+
+            if (col <= col_to && diff->stamps [idx] == diff->pass &&
+                    diff->changed [idx]) {
+                int x = col << diff->tile_shift;
+
+                if (run.w == 0) {
+                    run.x = x;
+                    run.y = row << diff->tile_shift;
+                    run.h = MIN (diff->tile_size, diff->h - run.y);
+                }
+                run.w = MIN (x + diff->tile_size, diff->w) - run.x;
+            }
+            else if (run.w) {
+                add_run (diff, &nr_rects, row_start, &run);
+                run.w = 0;
+            }
+        }
+    }
+
+    *merged = diff->rects;
+    return nr_rects;
+}
+
+int GAL_FilterDamage (GAL_DamageFilter* filter,
+        int numrects, const GAL_Rect* rects, GAL_Rect** filtered)
+{
+    GAL_Surface* screen = filter->screen;
+
+    filter->diff.pixels = (Uint8*)screen->pixels + screen->pixels_off;
+    return GAL_DiffTiles (&filter->diff, numrects, rects, filtered);
+}
+
+void GAL_GetDamageStats (GAL_DamageFilter* filter, DamageFilterStats* stats)
+{
+    stats->tile_size = filter->diff.tile_size;
+    stats->nr_hits = filter->diff.nr_hits;
+    stats->nr_misses = filter->diff.nr_misses;
+}
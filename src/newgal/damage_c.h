@@ -0,0 +1,128 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+//                          IMPORTANT NOTICE
+//
+// The following open source license statement does not apply to any
+// entity in the Exception List published by FMSoft.
+//
+// For more information, please visit:
+//
+// https://www.fmsoft.cn/exception-list
+//
+//////////////////////////////////////////////////////////////////////////////
+/*
+ *   This file is part of MiniGUI, a mature cross-platform windowing
+ *   and Graphics User Interface (GUI) support system for embedded systems
+ *   and smart IoT devices.
+ *
+ *   Copyright (C) 2002~2020, Beijing FMSoft Technologies Co., Ltd.
+ *   Copyright (C) 1998~2002, WEI Yongming
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *   Or,
+ *
+ *   As this program is a library, any link to this program must follow
+ *   GNU General Public License version 3 (GPLv3). If you cannot accept
+ *   GPLv3, you need to be licensed from FMSoft.
+ *
+ *   If you have got a commercial license of this program, please use it
+ *   under the terms and conditions of the commercial license.
+ *
+ *   For more information about the commercial license, please refer to
+ *   <http://www.minigui.com/blog/minigui-licensing-policy/>.
+ */
+
+/*
+** damage_c.h: the damage filter which drops the unchanged tiles of
+**  the screen before calling UpdateRects of a NEWGAL engine.
+*/
+
+#ifndef _GAL_damage_c_h
+#define _GAL_damage_c_h
+
+/*
+ * The damage filter keeps a checksum of every tile of the screen as it
+ * was presented last time. The tiles touched by the update rectangles
+ * are checksummed again, and the unchanged ones are dropped; the changed
+ * ones are merged into rectangles aligned to the tiles.
+ *
+ * The filter is enabled per engine by the key `damage_tile_size` in the
+ * section of the engine (e.g. `shadow`, `pc_xvfb`, or `commlcd`), or by
+ * the environment variable MG_GAL_DAMAGE_TILE_SIZE. The tile size should
+ * be a power of two between GAL_DAMAGE_MIN_TILE and GAL_DAMAGE_MAX_TILE;
+ * zero disables the filter.
+ */
+#define GAL_DAMAGE_MIN_TILE     8
+#define GAL_DAMAGE_MAX_TILE     256
+
+/*
+ * The tile differ behind the damage filter. It checksums the tiles of
+ * a pixel buffer touched by the rectangles, and merges the changed ones
+ * into rectangles; the engines which keep a frame buffer of their own
+ * (e.g. usvfb) use it directly. The tile size must be a power of two.
+ */
+typedef struct _GAL_TileDiff {
+    const Uint8* pixels;
+    int pitch, Bpp;
+    int w, h;
+
+    int tile_size, tile_shift;
+    int cols, rows;
+
+    /* the checksums of the tiles presented last time; zero for never */
+    Uint64* sums;
+
+    /* the tiles checked in the current pass, and whether changed */
+    Uint32* stamps;
+    BYTE* changed;
+    Uint32 pass;
+
+    /* the merged rectangles; one per tile at most */
+    GAL_Rect* rects;
+
+    Uint64 nr_hits, nr_misses;
+} GAL_TileDiff;
+
+/* Return zero on success. */
+extern int GAL_InitTileDiff (GAL_TileDiff* diff, const void* pixels,
+        int pitch, int Bpp, int w, int h, int tile_size);
+extern void GAL_FreeTileDiff (GAL_TileDiff* diff);
+
+/*
+ * Return the number of the rectangles covering the changed tiles, which
+ * are stored in an array owned by the differ and returned through 'merged'.
+ */
+extern int GAL_DiffTiles (GAL_TileDiff* diff,
+        int numrects, const GAL_Rect* rects, GAL_Rect** merged);
+
+typedef struct _GAL_DamageFilter GAL_DamageFilter;
+
+/* Return NULL if the filter is disabled for the engine or on error. */
+extern GAL_DamageFilter* GAL_CreateDamageFilter (GAL_VideoDevice* video,
+        GAL_Surface* screen);
+extern void GAL_DeleteDamageFilter (GAL_DamageFilter* filter);
+
+/*
+ * Filter the update rectangles; return the number of the rectangles
+ * left, which are stored in an array owned by the filter and returned
+ * through 'filtered'.
+ */
+extern int GAL_FilterDamage (GAL_DamageFilter* filter,
+        int numrects, const GAL_Rect* rects, GAL_Rect** filtered);
+
+extern void GAL_GetDamageStats (GAL_DamageFilter* filter,
+        DamageFilterStats* stats);
+
+#endif /* _GAL_damage_c_h */
@@ -0,0 +1,278 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+//                          IMPORTANT NOTICE
+//
+// The following open source license statement does not apply to any
+// entity in the Exception List published by FMSoft.
+//
+// For more information, please visit:
+//
+// https://www.fmsoft.cn/exception-list
+//
+//////////////////////////////////////////////////////////////////////////////
+/*
+ *   This file is part of MiniGUI, a mature cross-platform windowing
+ *   and Graphics User Interface (GUI) support system for embedded systems
+ *   and smart IoT devices.
+ *
+ *   Copyright (C) 2002~2020, Beijing FMSoft Technologies Co., Ltd.
+ *   Copyright (C) 1998~2002, WEI Yongming
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *   Or,
+ *
+ *   As this program is a library, any link to this program must follow
+ *   GNU General Public License version 3 (GPLv3). If you cannot accept
+ *   GPLv3, you need to be licensed from FMSoft.
+ *
+ *   If you have got a commercial license of this program, please use it
+ *   under the terms and conditions of the commercial license.
+ *
+ *   For more information about the commercial license, please refer to
+ *   <http://www.minigui.com/blog/minigui-licensing-policy/>.
+ */
+
+/*
+** parallel.c: a small worker pool which runs large software blits and
+**  fills in horizontal bands on several CPU cores.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "common.h"
+#include "newgal.h"
+#include "parallel_c.h"
+
+#ifdef _MGGAL_PARALLEL_BLIT
+
+#include <pthread.h>
+#include <unistd.h>
+
+#define MAX_WORKERS         7
+
+static struct {
+    /* serializes the callers of GAL_RunBands */
+    pthread_mutex_t     lock_run;
+
+    /* protects the fields below */
+    pthread_mutex_t     lock;
+    pthread_cond_t      cond_job;
+    pthread_cond_t      cond_done;
+
+    pthread_t           workers [MAX_WORKERS];
+    int                 nr_workers;
+    BOOL                quit;
+
+    /* the current job */
+    unsigned int        job_id;
+    GAL_BandFunc        func;
+    void*               context;
+    int                 height;
+    int                 nr_bands;
+    int                 next_band;
+    int                 nr_running;
+} pool;
+
+static int nr_workers_ready;
+
+/* Take the next band of the current job; called with pool.lock held */
+static BOOL take_band (int* y, int* h)
+{
+    int band;
+
+    if (pool.next_band >= pool.nr_bands)
+        return FALSE;
+
+    band = pool.next_band++;
+    *y = pool.height * band / pool.nr_bands;
+    *h = pool.height * (band + 1) / pool.nr_bands - *y;
+    return TRUE;
+}
+
+static void* worker_entry (void* arg)
+{
+    unsigned int last_job = 0;
+    int y, h;
+
+    pthread_mutex_lock (&pool.lock);
+    while (1) {
+        while (!pool.quit && pool.job_id == last_job)
+            pthread_cond_wait (&pool.cond_job, &pool.lock);
+
+        if (pool.quit)
+            break;
+
+        last_job = pool.job_id;
+        while (take_band (&y, &h)) {
+            GAL_BandFunc func = pool.func;
+            void* context = pool.context;
+
+            pool.nr_running++;
+            pthread_mutex_unlock (&pool.lock);
+
+            func (context, y, h);
+
+            pthread_mutex_lock (&pool.lock);
+            if (--pool.nr_running == 0 && pool.next_band >= pool.nr_bands)
+                pthread_cond_signal (&pool.cond_done);
+        }
+    }
+    pthread_mutex_unlock (&pool.lock);
+
+    return NULL;
+}
+
+static int get_nr_cpus (void)
+{
+#ifdef _SC_NPROCESSORS_ONLN
+    long n = sysconf (_SC_NPROCESSORS_ONLN);
+    if (n > 0)
+        return (int)n;
+#endif
+    return 1;
+}
+
+int GAL_InitParallel (void)
+{
+    int i, nr_threads;
+    char* env;
+
+    if (nr_workers_ready)
+        return 0;
+
+    /* The number of threads including the calling thread */
+    if ((env = getenv ("MG_GAL_BLIT_THREADS")))
+        nr_threads = atoi (env);
+    else
+        nr_threads = get_nr_cpus ();
+
+    if (nr_threads > MAX_WORKERS + 1)
+        nr_threads = MAX_WORKERS + 1;
+    if (nr_threads <= 1)
+        return 0;
+
+    pthread_mutex_init (&pool.lock_run, NULL);
+    pthread_mutex_init (&pool.lock, NULL);
+    pthread_cond_init (&pool.cond_job, NULL);
+    pthread_cond_init (&pool.cond_done, NULL);
+    pool.quit = FALSE;
+    pool.job_id = 0;
+
+    for (i = 0; i < nr_threads - 1; i++) {
+        if (pthread_create (pool.workers + i, NULL, worker_entry, NULL)) {
+            _WRN_PRINTF ("NEWGAL: failed to create the blit worker #%d\n", i);
+            break;
+        }
+    }
+
+    pool.nr_workers = i;
+    nr_workers_ready = 1;
+
+    _DBG_PRINTF ("NEWGAL: %d blit workers created\n", pool.nr_workers);
+    return 0;
+}
+
+void GAL_QuitParallel (void)
+{
+    int i;
+
+    if (!nr_workers_ready)
+        return;
+
+    pthread_mutex_lock (&pool.lock);
+    pool.quit = TRUE;
+    pthread_cond_broadcast (&pool.cond_job);
+    pthread_mutex_unlock (&pool.lock);
+
+    for (i = 0; i < pool.nr_workers; i++)
+        pthread_join (pool.workers [i], NULL);
+
+    pthread_cond_destroy (&pool.cond_done);
+    pthread_cond_destroy (&pool.cond_job);
+    pthread_mutex_destroy (&pool.lock);
+    pthread_mutex_destroy (&pool.lock_run);
+
+    pool.nr_workers = 0;
+    nr_workers_ready = 0;
+}
+
+void GAL_RunBands (GAL_BandFunc func, void* context, int width, int height)
+{
+    int nr_bands;
+    int y, h;
+
+    if (pool.nr_workers == 0 ||
+            (Uint32)width * (Uint32)height < GAL_PARALLEL_MIN_PIXELS ||
+            height < GAL_PARALLEL_MIN_ROWS * 2) {
+        func (context, 0, height);
+        return;
+    }
+
+    /* The pool is busy with another thread; do not wait for it */
+    if (pthread_mutex_trylock (&pool.lock_run)) {
+        func (context, 0, height);
+        return;
+    }
+
+    nr_bands = height / GAL_PARALLEL_MIN_ROWS;
+    if (nr_bands > pool.nr_workers + 1)
+        nr_bands = pool.nr_workers + 1;
+
+    pthread_mutex_lock (&pool.lock);
+    pool.func = func;
+    pool.context = context;
+    pool.height = height;
+    pool.nr_bands = nr_bands;
+    pool.next_band = 0;
+    pool.nr_running = 0;
+    pool.job_id++;
+    pthread_cond_broadcast (&pool.cond_job);
+
+    /* The calling thread works on the bands too */
+    while (take_band (&y, &h)) {
+        pool.nr_running++;
+        pthread_mutex_unlock (&pool.lock);
+
+        func (context, y, h);
+
+        pthread_mutex_lock (&pool.lock);
+        pool.nr_running--;
+    }
+
+    while (pool.nr_running > 0)
+        pthread_cond_wait (&pool.cond_done, &pool.lock);
+    pthread_mutex_unlock (&pool.lock);
+
+    pthread_mutex_unlock (&pool.lock_run);
+}
+
+#else   /* _MGGAL_PARALLEL_BLIT */
+
+int GAL_InitParallel (void)
+{
+    return 0;
+}
+
+void GAL_QuitParallel (void)
+{
+}
+
+void GAL_RunBands (GAL_BandFunc func, void* context, int width, int height)
+{
+    func (context, 0, height);
+}
+
+#endif  /* !_MGGAL_PARALLEL_BLIT */
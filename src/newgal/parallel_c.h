@@ -0,0 +1,82 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+//                          IMPORTANT NOTICE
+//
+// The following open source license statement does not apply to any
+// entity in the Exception List published by FMSoft.
+//
+// For more information, please visit:
+//
+// https://www.fmsoft.cn/exception-list
+//
+//////////////////////////////////////////////////////////////////////////////
+/*
+ *   This file is part of MiniGUI, a mature cross-platform windowing
+ *   and Graphics User Interface (GUI) support system for embedded systems
+ *   and smart IoT devices.
+ *
+ *   Copyright (C) 2002~2020, Beijing FMSoft Technologies Co., Ltd.
+ *   Copyright (C) 1998~2002, WEI Yongming
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *   Or,
+ *
+ *   As this program is a library, any link to this program must follow
+ *   GNU General Public License version 3 (GPLv3). If you cannot accept
+ *   GPLv3, you need to be licensed from FMSoft.
+ *
+ *   If you have got a commercial license of this program, please use it
+ *   under the terms and conditions of the commercial license.
+ *
+ *   For more information about the commercial license, please refer to
+ *   <http://www.minigui.com/blog/minigui-licensing-policy/>.
+ */
+
+#ifndef _GAL_parallel_c_h
+#define _GAL_parallel_c_h
+
+/*
+ * The software blits and fills smaller than GAL_PARALLEL_MIN_PIXELS pixels
+ * always run on the calling thread; every band has GAL_PARALLEL_MIN_ROWS
+ * rows at least.
+ */
+#define GAL_PARALLEL_MIN_PIXELS     (256*256)
+#define GAL_PARALLEL_MIN_ROWS       16
+
+/* The callback processing the rows [y, y + h) of an operation */
+typedef void (*GAL_BandFunc) (void* context, int y, int h);
+
+/*
+ * Create the worker threads (if MiniGUI was configured with
+ * _MGGAL_PARALLEL_BLIT). The number of threads including the calling
+ * thread is the number of online CPUs, or the value of the environment
+ * variable MG_GAL_BLIT_THREADS; a value of 1 disables the workers.
+ */
+extern int GAL_InitParallel (void);
+extern void GAL_QuitParallel (void);
+
+/*
+ * Run 'func' on horizontal bands of an operation of 'width' x 'height'
+ * pixels; the bands are processed in parallel if the operation is large
+ * enough and the workers are idle, otherwise 'func' is called once for
+ * all rows. This function returns after all bands are done.
+ *
+ * The bands must not depend on each other, so do not use this for
+ * overlapped blits on the same surface.
+ */
+extern void GAL_RunBands (GAL_BandFunc func, void* context,
+        int width, int height);
+
+#endif /* _GAL_parallel_c_h */
@@ -224,48 +224,87 @@ static void PCXVFB_DeleteDevice (GAL_VideoDevice *device)
     free (device);
 }
 
-#if 0   /* deprecated code: call common helpers for shadow screen */
-static void PCXVFB_UpdateRects (_THIS, int numrects, GAL_Rect *rects)
+/* Since 5.0.0: the viewer creates the ring of dirty rectangles only if
+   it knows the ring; make sure the palette and the frame buffer do not
+   overlap the ring before touching it. */
+static BOOL has_dirty_ring (const XVFBHeader* hdr)
 {
-    int i;
-    RECT bound;
+    int offset = hdr->fb_offset;
 
-#ifdef WIN32
-    win_PCXVFbLock ();
-#else
-    shm_lock(semid);
+    if (hdr->palette_offset > 0 && hdr->palette_offset < offset)
+        offset = hdr->palette_offset;
+
+    if (offset < (int)sizeof (XVFBHeader))
+        return FALSE;
+
+    return hdr->dirty_ring.magic == XVFB_DIRTY_RING_MAGIC &&
+        hdr->dirty_ring.version >= XVFB_DIRTY_RING_VERSION;
+}
+
+static void put_dirty_rect (XVFBDirtyRing* ring, const RECT* rc)
+{
+    XVFBDirtyRect* slot = ring->rcs + (ring->seq % XVFB_NR_DIRTY_RECTS);
+
+    slot->l = rc->left;
+    slot->t = rc->top;
+    slot->r = rc->right;
+    slot->b = rc->bottom;
+
+    /* the viewer must see the slot before the new sequence number */
+#ifdef __GNUC__
+    __sync_synchronize ();
 #endif
+    ring->seq++;
+}
 
-    bound.left   = this->hidden->hdr->dirty_rc_l;
-    bound.top    = this->hidden->hdr->dirty_rc_t;
-    bound.right  = this->hidden->hdr->dirty_rc_r;
-    bound.bottom = this->hidden->hdr->dirty_rc_b;
+static void PCXVFB_UpdateRects (_THIS, int numrects, GAL_Rect *rects)
+{
+    int i;
 
-    if (bound.right == -1) bound.right = 0;
-    if (bound.bottom == -1) bound.bottom = 0;
+    shadowScreen_UpdateRects (this, numrects, rects);
 
-    bound = this->hidden->dirty_rc;
+    /* keep the rectangles for the viewer; fall back to the bounding
+       rectangle when there are too many ones. */
+    for (i = 0; i < numrects && this->hidden->nr_dirty_rcs >= 0; i++) {
+        RECT* rc;
 
-    for (i = 0; i < numrects; i++) {
-        RECT rc;
+        if (this->hidden->nr_dirty_rcs >= XVFB_NR_DIRTY_RECTS) {
+            this->hidden->nr_dirty_rcs = -1;
+            break;
+        }
 
-        SetRect (&rc, rects[i].x, rects[i].y,
+        rc = this->hidden->dirty_rcs + this->hidden->nr_dirty_rcs;
+        SetRect (rc, rects[i].x, rects[i].y,
                 rects[i].x + rects[i].w, rects[i].y + rects[i].h);
-        if (IsRectEmpty (&bound))
-            bound = rc;
-        else
-            GetBoundRect (&bound, &bound, &rc);
+        this->hidden->nr_dirty_rcs++;
     }
+}
 
-    this->hidden->dirty_rc = bound;
+static void put_dirty_rects (_THIS)
+{
+    XVFBHeader* hdr = this->hidden->hdr;
+    RECT screen_rc, bound, rc;
+    int i;
 
-#ifdef WIN32
-    win_PCXVFbUnlock ();
-#else
-    shm_unlock(semid);
-#endif
+    SetRect (&screen_rc, 0, 0, hdr->width, hdr->height);
+
+    /* the cursor moves only grow the bounding rectangle */
+    SetRectEmpty (&bound);
+    for (i = 0; i < this->hidden->nr_dirty_rcs; i++)
+        GetBoundRect (&bound, &bound, this->hidden->dirty_rcs + i);
+
+    if (this->hidden->nr_dirty_rcs <= 0 ||
+            !EqualRect (&bound, &this->hidden->dirty_rc)) {
+        if (IntersectRect (&rc, &this->hidden->dirty_rc, &screen_rc))
+            put_dirty_rect (&hdr->dirty_ring, &rc);
+        return;
+    }
+
+    for (i = 0; i < this->hidden->nr_dirty_rcs; i++) {
+        if (IntersectRect (&rc, this->hidden->dirty_rcs + i, &screen_rc))
+            put_dirty_rect (&hdr->dirty_ring, &rc);
+    }
 }
-#endif  /* deprecated code */
 
 static BOOL PCXVFB_SyncUpdate (_THIS)
 {
@@ -280,6 +319,8 @@ static BOOL PCXVFB_SyncUpdate (_THIS)
     shm_lock(semid);
 #endif
 
+    shadowScreen_BlitToReal (this);
+
     dirty_rc.left = this->hidden->hdr->dirty_rc_l;
     dirty_rc.top = this->hidden->hdr->dirty_rc_t;
     dirty_rc.right = this->hidden->hdr->dirty_rc_r;
@@ -287,15 +328,15 @@ static BOOL PCXVFB_SyncUpdate (_THIS)
     if (dirty_rc.right == -1) dirty_rc.right = 0;
     if (dirty_rc.bottom == -1) dirty_rc.bottom = 0;
 
-    GetBoundRect (&this->hidden->dirty_rc, &dirty_rc,
-            &this->hidden->dirty_rc);
+    if (has_dirty_ring (this->hidden->hdr))
+        put_dirty_rects (this);
 
-    shadowScreen_BlitToReal (this);
+    GetBoundRect (&dirty_rc, &dirty_rc, &this->hidden->dirty_rc);
 
-    this->hidden->hdr->dirty_rc_l = this->hidden->dirty_rc.left;
-    this->hidden->hdr->dirty_rc_t = this->hidden->dirty_rc.top;
-    this->hidden->hdr->dirty_rc_r = this->hidden->dirty_rc.right;
-    this->hidden->hdr->dirty_rc_b = this->hidden->dirty_rc.bottom;
+    this->hidden->hdr->dirty_rc_l = dirty_rc.left;
+    this->hidden->hdr->dirty_rc_t = dirty_rc.top;
+    this->hidden->hdr->dirty_rc_r = dirty_rc.right;
+    this->hidden->hdr->dirty_rc_b = dirty_rc.bottom;
     this->hidden->hdr->dirty = TRUE;
 
 #ifdef WIN32
@@ -303,6 +344,10 @@ static BOOL PCXVFB_SyncUpdate (_THIS)
 #else
     shm_unlock(semid);
 #endif
+
+    /* the dirty content has been handed to the viewer */
+    SetRectEmpty (&this->hidden->dirty_rc);
+    this->hidden->nr_dirty_rcs = 0;
     return TRUE;
 }
 
@@ -337,7 +382,7 @@ static GAL_VideoDevice *PCXVFB_CreateDevice (int devindex)
     this->AllocHWSurface = PCXVFB_AllocHWSurface;
     this->FreeHWSurface = PCXVFB_FreeHWSurface;
 
-    this->UpdateRects = shadowScreen_UpdateRects;
+    this->UpdateRects = PCXVFB_UpdateRects;
     this->SyncUpdate = PCXVFB_SyncUpdate;
 
     this->CheckHWBlit = NULL;
@@ -58,6 +58,22 @@
 int __mg_pcxvfb_server_sockfd;
 int __mg_pcxvfb_client_sockfd;
 
+/* Since 5.0.0: the ring of dirty rectangles; see include/xvfb.h */
+#define XVFB_DIRTY_RING_MAGIC       0x58444952
+#define XVFB_DIRTY_RING_VERSION     1
+#define XVFB_NR_DIRTY_RECTS         32
+
+typedef struct _XVFBDirtyRect {
+    int l, t, r, b;
+} XVFBDirtyRect;
+
+typedef struct _XVFBDirtyRing {
+    int magic;
+    int version;
+    volatile unsigned int seq;
+    XVFBDirtyRect rcs [XVFB_NR_DIRTY_RECTS];
+} XVFBDirtyRing;
+
 typedef struct _XVFbHeader {
     /* Changes since 5.0.0.
      *
@@ -94,6 +110,14 @@ typedef struct _XVFbHeader {
     int Gmask;
     int Bmask;
     int Amask;
+
+    /* Since 5.0.0: the ring of dirty rectangles.
+     *
+     * It is created by the viewers which know it, and is valid only
+     * if the palette and the frame buffer are placed after it and
+     * `dirty_ring.magic` is XVFB_DIRTY_RING_MAGIC.
+     */
+    XVFBDirtyRing dirty_ring;
 } XVFBHeader;
 
 typedef struct _XVFBPalEntry {
@@ -116,6 +140,11 @@ struct GAL_PrivateVideoData {
 
     unsigned char* shmrgn;
     XVFBHeader* hdr;
+
+    /* Since 5.0.0: the dirty rectangles since the last sync;
+       -1 for too many ones, and dirty_rc should be used. */
+    int nr_dirty_rcs;
+    RECT dirty_rcs [XVFB_NR_DIRTY_RECTS];
 };
 
 #endif /* _GAL_pcxvfb_h */
@@ -108,6 +108,9 @@ XVFBHeader* xVFBAllocVirtualFrameBuffer (int width, int height, int depth,
 
     rtos_xvfb_buf->fb_offset = sizeof (XVFBHeader) + nr_entries * sizeof(XVFBPalEntry);
 
+    rtos_xvfb_buf->dirty_ring.magic = XVFB_DIRTY_RING_MAGIC;
+    rtos_xvfb_buf->dirty_ring.version = XVFB_DIRTY_RING_VERSION;
+
 #ifdef _DEBUG
     fprintf (stderr, "xVFB is allocated. width=%d, height=%d, depth=%d \n",
              rtos_xvfb_buf->width, rtos_xvfb_buf->height, rtos_xvfb_buf->depth);
@@ -138,6 +141,22 @@ static void RTOS_XVFB_DeleteDevice (GAL_VideoDevice *device)
     free (device);
 }
 
+static void put_dirty_rect (XVFBDirtyRing* ring, const RECT* rc)
+{
+    XVFBDirtyRect* slot = ring->rcs + (ring->seq % XVFB_NR_DIRTY_RECTS);
+
+    slot->l = rc->left;
+    slot->t = rc->top;
+    slot->r = rc->right;
+    slot->b = rc->bottom;
+
+    /* the viewer must see the slot before the new sequence number */
+#ifdef __GNUC__
+    __sync_synchronize ();
+#endif
+    ring->seq++;
+}
+
 static void RTOS_XVFB_UpdateRects (_THIS, int numrects, GAL_Rect *rects)
 {
     int i;
@@ -160,6 +179,10 @@ static void RTOS_XVFB_UpdateRects (_THIS, int numrects, GAL_Rect *rects)
             bound = rc;
         else
             GetBoundRect (&bound, &bound, &rc);
+
+        /* Since 5.0.0: tell the viewer the exact rectangles */
+        if (IntersectRect (&rc, &buf_rc, &rc))
+            put_dirty_rect (&hdr->dirty_ring, &rc);
     }
 
 
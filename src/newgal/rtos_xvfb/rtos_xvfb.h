@@ -57,6 +57,22 @@
 /* Hidden "this" pointer for the video functions */
 #define _THIS    GAL_VideoDevice *this
 
+/* Since 5.0.0: the ring of dirty rectangles; see include/xvfb.h */
+#define XVFB_DIRTY_RING_MAGIC       0x58444952
+#define XVFB_DIRTY_RING_VERSION     1
+#define XVFB_NR_DIRTY_RECTS         32
+
+typedef struct _XVFBDirtyRect {
+    int l, t, r, b;
+} XVFBDirtyRect;
+
+typedef struct _XVFBDirtyRing {
+    int magic;
+    int version;
+    volatile unsigned int seq;
+    XVFBDirtyRect rcs [XVFB_NR_DIRTY_RECTS];
+} XVFBDirtyRing;
+
 typedef struct _XVFBHeader {
     unsigned int info_size;
     int width;
@@ -78,6 +94,9 @@ typedef struct _XVFBHeader {
     int palette_changed;
     int palette_offset;
     int fb_offset;
+
+    /* Since 5.0.0 */
+    XVFBDirtyRing dirty_ring;
 } XVFBHeader;
 
 typedef struct _XVFBPalEntry {
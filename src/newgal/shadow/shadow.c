@@ -53,6 +53,8 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <limits.h>
+#include <time.h>
 #include "common.h"
 
 #ifdef _MGGAL_SHADOW
@@ -106,6 +108,9 @@ union semun {
 #define LEN_MODE 20
 #define PALETTE_SIZE 1024
 
+/* The default value of the key refresh_fps in the section shadow */
+#define SHADOW_DEFAULT_FPS 60
+
 extern void _get_dst_rect_cw (RECT* dst_rect, const RECT* src_rect, RealFBInfo *realfb_info);
 extern void _get_dst_rect_hflip (RECT* src_rect, RealFBInfo *realfb_info);
 extern void _get_dst_rect_vflip (RECT* src_rect, RealFBInfo *realfb_info);
@@ -177,6 +182,53 @@ again:
 
 static ShadowFBHeader* _shadowfbheader;
 
+static Uint64 get_time_us (void)
+{
+#ifdef CLOCK_MONOTONIC
+    struct timespec ts;
+
+    clock_gettime (CLOCK_MONOTONIC, &ts);
+    return (Uint64)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+#else
+    return (Uint64)GetTickCount () * 10000;
+#endif
+}
+
+static void sleep_us (int us)
+{
+#ifdef WIN32
+    win_sleep ((us + 999) / 1000);
+#else
+    usleep (us);
+#endif
+}
+
+/*
+ * Called with the header locked when the screen is changed; records the
+ * time of the first change after the last refresh for the latency
+ * statistics, and tells whether the updater should be woken up.
+ */
+static BOOL mark_dirty (void)
+{
+    if (_shadowfbheader->dirty || _shadowfbheader->palette_changed)
+        return FALSE;
+
+    _shadowfbheader->dirty_time = get_time_us ();
+    return TRUE;
+}
+
+/* Wake up the updater; called with the header unlocked. */
+static void wake_updater (_THIS)
+{
+#ifdef _MGRM_PROCESSES
+    _sysvipc_sem_op (this->hidden->semid, 1, 1);
+#else
+    pthread_mutex_lock (&this->hidden->update_lock);
+    pthread_cond_signal (&this->hidden->update_cond);
+    pthread_mutex_unlock (&this->hidden->update_lock);
+#endif
+}
+
 DWORD __mg_shadow_rotate_flags;
 extern void (*__mg_ial_change_mouse_xy_hook)(int* x, int* y);
 extern GAL_Surface* __gal_screen;
@@ -194,10 +246,67 @@ static void SHADOW_DeleteDevice(GAL_VideoDevice *device)
     refresh_destroy();
 }
 
+#define RECT_AREA(rc)   (RECTWP(rc) * RECTHP(rc))
+
+/*
+ * Add a rectangle to the dirty rectangles of the header.
+ *
+ * A rectangle is merged with an existing one if their bound is not
+ * larger than the sum of them; when the list is full, the new rectangle
+ * is merged with the one whose bound wastes the least area. So two small
+ * rectangles in the opposite corners of the screen will not be refreshed
+ * as a whole screen.
+ */
+static void add_dirty_rect (ShadowFBHeader* header, const RECT* rc)
+{
+    RECT cur = *rc;
+    RECT bound;
+    int i, best, cost, best_cost;
+
+again:
+    for (i = 0; i < header->nr_dirty_rects; i++) {
+        RECT* dirty = header->dirty_rects + i;
+
+        GetBoundRect (&bound, dirty, &cur);
+        if (RECT_AREA (&bound) <= RECT_AREA (dirty) + RECT_AREA (&cur)) {
+            header->nr_dirty_rects--;
+            *dirty = header->dirty_rects[header->nr_dirty_rects];
+            cur = bound;
+            goto again;
+        }
+    }
+
+    if (header->nr_dirty_rects < NR_SHADOW_DIRTY_RECTS) {
+        header->dirty_rects[header->nr_dirty_rects] = cur;
+        header->nr_dirty_rects++;
+        return;
+    }
+
+    best = 0;
+    best_cost = INT_MAX;
+    for (i = 0; i < header->nr_dirty_rects; i++) {
+        RECT* dirty = header->dirty_rects + i;
+
+        GetBoundRect (&bound, dirty, &cur);
+        cost = RECT_AREA (&bound) - RECT_AREA (dirty) - RECT_AREA (&cur);
+        if (cost < best_cost) {
+            best = i;
+            best_cost = cost;
+        }
+    }
+
+    GetBoundRect (&cur, header->dirty_rects + best, &cur);
+    header->nr_dirty_rects--;
+    header->dirty_rects[best] = header->dirty_rects[header->nr_dirty_rects];
+    goto again;
+}
+
 static void SHADOW_UpdateRects (_THIS, int numrects, GAL_Rect *rects)
 {
     int i;
     RECT bound;
+    RECT rcScr = GetScreenRect();
+    BOOL wake = FALSE;
 
 #ifdef _MGRM_PROCESSES
     _sysvipc_sem_op (this->hidden->semid, 0, -1);
@@ -210,6 +319,10 @@ static void SHADOW_UpdateRects (_THIS, int numrects, GAL_Rect *rects)
         RECT rc;
         SetRect (&rc, rects[i].x, rects[i].y,
                 rects[i].x + rects[i].w, rects[i].y + rects[i].h);
+        if (!IntersectRect (&rc, &rc, &rcScr))
+            continue;
+
+        add_dirty_rect (_shadowfbheader, &rc);
         if (IsRectEmpty (&bound))
             bound = rc;
         else
@@ -217,12 +330,9 @@ static void SHADOW_UpdateRects (_THIS, int numrects, GAL_Rect *rects)
     }
 
     if (!IsRectEmpty (&bound)) {
-        RECT rcScr = GetScreenRect();
-
-        if (IntersectRect (&bound, &bound, &rcScr)) {
-            _shadowfbheader->dirty_rect = bound;
-            _shadowfbheader->dirty = TRUE;
-        }
+        wake = mark_dirty ();
+        _shadowfbheader->dirty_rect = bound;
+        _shadowfbheader->dirty = TRUE;
     }
 
 #ifdef _MGRM_PROCESSES
@@ -230,6 +340,9 @@ static void SHADOW_UpdateRects (_THIS, int numrects, GAL_Rect *rects)
 #else
     pthread_mutex_unlock (&this->hidden->update_lock);
 #endif
+
+    if (wake)
+        wake_updater (this);
     return ;
 }
 
@@ -455,7 +568,7 @@ static int SHADOW_VideoInit (_THIS, GAL_PixelFormat *vformat)
         }
 
 #ifdef _MGRM_PROCESSES
-        this->hidden->semid = semget (SHADOW_SEM_KEY, 1, 0666 | IPC_CREAT | IPC_EXCL);
+        this->hidden->semid = semget (SHADOW_SEM_KEY, 2, 0666 | IPC_CREAT | IPC_EXCL);
         if (this->hidden->semid < 0) {
             perror ("NEWGAL>SHADOW: semget");
             return -1;
@@ -463,9 +576,11 @@ static int SHADOW_VideoInit (_THIS, GAL_PixelFormat *vformat)
 
         sunion.val = 1;
         semctl (this->hidden->semid, 0, SETVAL, sunion);
+        sunion.val = 0;
+        semctl (this->hidden->semid, 1, SETVAL, sunion);
     }
     else {
-        this->hidden->semid = semget (SHADOW_SEM_KEY, 1, 0);
+        this->hidden->semid = semget (SHADOW_SEM_KEY, 2, 0);
         if (this->hidden->semid < 0) {
             perror ("NEWGAL>SHADOW: semget");
             return -1;
@@ -473,18 +588,68 @@ static int SHADOW_VideoInit (_THIS, GAL_PixelFormat *vformat)
     }
 #else
     pthread_mutex_init (&this->hidden->update_lock, NULL);
+    pthread_cond_init (&this->hidden->update_cond, NULL);
 #endif
 
     /* We're done! */
     return 0;
 }
 
+/* Get the target frame interval from the key refresh_fps */
+static int get_refresh_interval (void)
+{
+    int fps;
+
+    if (GetMgEtcIntValue ("shadow", "refresh_fps", &fps) < 0)
+        fps = SHADOW_DEFAULT_FPS;
+
+    if (fps <= 0)
+        return 0;
+    return 1000000 / fps;
+}
+
+/* Block until the screen is dirty or the updater should quit */
+static void wait_for_update (_THIS)
+{
+#ifdef _MGRM_PROCESSES
+    _sysvipc_sem_op (this->hidden->semid, 1, -1);
+#else
+    pthread_mutex_lock (&this->hidden->update_lock);
+    while (run_flag == 1 && _shadowfbheader &&
+            !_shadowfbheader->dirty && !_shadowfbheader->palette_changed)
+        pthread_cond_wait (&this->hidden->update_cond,
+                &this->hidden->update_lock);
+    pthread_mutex_unlock (&this->hidden->update_lock);
+#endif
+}
+
+/* Called with the header locked after a refresh */
+static void update_stats (Uint64 now, Uint64 nr_pixels)
+{
+    ShadowFBHeader* header = _shadowfbheader;
+
+    header->nr_refreshes++;
+    header->nr_pixels += nr_pixels;
+    if (now > header->dirty_time)
+        header->total_latency += now - header->dirty_time;
+
+    header->rate_count++;
+    if (now - header->rate_start >= 1000000) {
+        header->refreshes_per_second = (unsigned int)
+            ((Uint64)header->rate_count * 1000000 / (now - header->rate_start));
+        header->rate_start = now;
+        header->rate_count = 0;
+    }
+}
+
 static void* task_do_update (void* data)
 {
     _THIS;
 
     RECT qvfb_rect;
-    GAL_Rect dirty_rect;
+    GAL_Rect dirty_rects[NR_SHADOW_DIRTY_RECTS];
+    Uint64 last_refresh, nr_pixels;
+    int i;
 
     GAL_VideoDevice *real_device;
     this = data;
@@ -500,7 +665,10 @@ static void* task_do_update (void* data)
         }
     }
 
+    last_refresh = 0;
     for (;;) {
+        wait_for_update (this);
+
         if (run_flag != 1) {
             break;
         }
@@ -509,14 +677,24 @@ static void* task_do_update (void* data)
             break;
         }
 
-        if (_shadowfbheader->dirty || _shadowfbheader->palette_changed)
-        {
+        /* Let the updates in a frame interval go in one refresh */
+        if (this->hidden->refresh_interval > 0) {
+            Uint64 now = get_time_us ();
+            Uint64 next = last_refresh + this->hidden->refresh_interval;
+
+            if (now < next)
+                sleep_us ((int)(next - now));
+        }
+
 #ifdef _MGRM_PROCESSES
-            _sysvipc_sem_op (this->hidden->semid, 0, -1);
+        _sysvipc_sem_op (this->hidden->semid, 0, -1);
 #else
-            pthread_mutex_lock (&this->hidden->update_lock);
+        pthread_mutex_lock (&this->hidden->update_lock);
 #endif
 
+        if (_shadowfbheader->dirty || _shadowfbheader->palette_changed)
+        {
+            nr_pixels = 0;
             if (real_device) {
                 if (_shadowfbheader->palette_changed) {
                     real_device->SetColors (real_device, _shadowfbheader->firstcolor,
@@ -524,51 +702,62 @@ static void* task_do_update (void* data)
                             (GAL_Color*)((char*)_shadowfbheader + _shadowfbheader->palette_offset));
                     SetRect (&_shadowfbheader->dirty_rect, 0, 0,
                             _shadowfbheader->width, _shadowfbheader->height);
+                    _shadowfbheader->dirty_rects[0] = _shadowfbheader->dirty_rect;
+                    _shadowfbheader->nr_dirty_rects = 1;
                 }
 
-                __mg_shadow_fb_ops->refresh (_shadowfbheader,
-                        this->hidden->realfb_info, &(_shadowfbheader->dirty_rect));
-
-                if (this->hidden->realfb_info->flags & _ROT_DIR_CW) {
-                    _get_dst_rect_cw (&qvfb_rect, &(_shadowfbheader->dirty_rect),
-                            this->hidden->realfb_info);
+                for (i = 0; i < _shadowfbheader->nr_dirty_rects; i++) {
+                    RECT* dirty = _shadowfbheader->dirty_rects + i;
+
+                    __mg_shadow_fb_ops->refresh (_shadowfbheader,
+                            this->hidden->realfb_info, dirty);
+                    nr_pixels += RECT_AREA (dirty);
+
+                    if (this->hidden->realfb_info->flags & _ROT_DIR_CW) {
+                        _get_dst_rect_cw (&qvfb_rect, dirty,
+                                this->hidden->realfb_info);
+                    }
+                    else if (this->hidden->realfb_info->flags & _ROT_DIR_CCW)
+                        _get_dst_rect_ccw (&qvfb_rect, dirty,
+                                this->hidden->realfb_info);
+                    else if (this->hidden->realfb_info->flags & _ROT_DIR_HFLIP)
+                    {
+                        qvfb_rect = *dirty;
+                        _get_dst_rect_hflip (&qvfb_rect, this->hidden->realfb_info);
+                    }
+                    else if (this->hidden->realfb_info->flags & _ROT_DIR_VFLIP)
+                    {
+                        qvfb_rect = *dirty;
+                        _get_dst_rect_vflip (&qvfb_rect, this->hidden->realfb_info);
+                    }else{
+                        qvfb_rect = *dirty;
+                    }
+
+                    dirty_rects[i].x = qvfb_rect.left;
+                    dirty_rects[i].y = qvfb_rect.top;
+                    dirty_rects[i].w = qvfb_rect.right - qvfb_rect.left;
+                    dirty_rects[i].h = qvfb_rect.bottom - qvfb_rect.top;
                 }
-                else if (this->hidden->realfb_info->flags & _ROT_DIR_CCW)
-                    _get_dst_rect_ccw (&qvfb_rect, &(_shadowfbheader->dirty_rect),
-                            this->hidden->realfb_info);
-                else if (this->hidden->realfb_info->flags & _ROT_DIR_HFLIP)
-                {
-                    qvfb_rect = _shadowfbheader->dirty_rect;
-                    _get_dst_rect_hflip (&qvfb_rect, this->hidden->realfb_info);
-                }
-                else if (this->hidden->realfb_info->flags & _ROT_DIR_VFLIP)
-                {
-                    qvfb_rect = _shadowfbheader->dirty_rect;
-                    _get_dst_rect_vflip (&qvfb_rect, this->hidden->realfb_info);
-                }else{
-                    qvfb_rect = _shadowfbheader->dirty_rect;
-                }
-
-                dirty_rect.x = qvfb_rect.left;
-                dirty_rect.y = qvfb_rect.top;
-                dirty_rect.w = qvfb_rect.right - qvfb_rect.left;
-                dirty_rect.h = qvfb_rect.bottom - qvfb_rect.top;
 
-                if (real_device->UpdateRects)
-                    real_device->UpdateRects(real_device, 1, &dirty_rect);
+                if (real_device->UpdateRects && _shadowfbheader->nr_dirty_rects > 0)
+                    real_device->UpdateRects(real_device,
+                            _shadowfbheader->nr_dirty_rects, dirty_rects);
             }
 
+            last_refresh = get_time_us ();
+            update_stats (last_refresh, nr_pixels);
+
             SetRect (&_shadowfbheader->dirty_rect, 0, 0, 0, 0);
+            _shadowfbheader->nr_dirty_rects = 0;
             _shadowfbheader->dirty = FALSE;
             _shadowfbheader->palette_changed = FALSE;
+        }
 
 #ifdef _MGRM_PROCESSES
-            _sysvipc_sem_op (this->hidden->semid, 0, 1);
+        _sysvipc_sem_op (this->hidden->semid, 0, 1);
 #else
-            pthread_mutex_unlock (&this->hidden->update_lock);
+        pthread_mutex_unlock (&this->hidden->update_lock);
 #endif
-        }
-        __mg_shadow_fb_ops->sleep ();
     }
 
     end_flag = 1;
@@ -685,7 +874,15 @@ static GAL_Surface *SHADOW_SetVideoMode(_THIS, GAL_Surface *current,
 
     _shadowfbheader->dirty = FALSE;
     SetRect (&(_shadowfbheader->dirty_rect), 0, 0, 0, 0);
+    _shadowfbheader->nr_dirty_rects = 0;
     _shadowfbheader->palette_changed = FALSE;
+    _shadowfbheader->dirty_time = 0;
+    _shadowfbheader->nr_pixels = 0;
+    _shadowfbheader->total_latency = 0;
+    _shadowfbheader->nr_refreshes = 0;
+    _shadowfbheader->rate_start = get_time_us ();
+    _shadowfbheader->rate_count = 0;
+    _shadowfbheader->refreshes_per_second = 0;
     _shadowfbheader->palette_offset = sizeof(ShadowFBHeader);
 
     if(shadowfbheader.depth <= 8)
@@ -719,6 +916,7 @@ static GAL_Surface *SHADOW_SetVideoMode(_THIS, GAL_Surface *current,
     {
         pthread_attr_t new_attr;
 
+        this->hidden->refresh_interval = get_refresh_interval ();
         run_flag = 1;
         end_flag = 0;
 
@@ -738,7 +936,10 @@ static GAL_Surface *SHADOW_SetVideoMode(_THIS, GAL_Surface *current,
 
 static void SHADOW_VideoQuit (_THIS)
 {
+    pthread_mutex_lock (&this->hidden->update_lock);
     run_flag = 0;
+    pthread_cond_signal (&this->hidden->update_cond);
+    pthread_mutex_unlock (&this->hidden->update_lock);
 
     /* waiting task_do_update end */
     for (;;) {
@@ -757,6 +958,7 @@ static void SHADOW_VideoQuit (_THIS)
         __mg_shadow_fb_ops->release(this->hidden->realfb_info);
         this->hidden->realfb_info = NULL;
         pthread_mutex_destroy (&this->hidden->update_lock);
+        pthread_cond_destroy (&this->hidden->update_cond);
     }
 }
 
@@ -852,7 +1054,15 @@ static GAL_Surface *SHADOW_SetVideoMode(_THIS, GAL_Surface *current,
         _shadowfbheader->info_size = size;
         _shadowfbheader->dirty = FALSE;
         SetRect (&(_shadowfbheader->dirty_rect), 0, 0, 0, 0);
+        _shadowfbheader->nr_dirty_rects = 0;
         _shadowfbheader->palette_changed = FALSE;
+        _shadowfbheader->dirty_time = 0;
+        _shadowfbheader->nr_pixels = 0;
+        _shadowfbheader->total_latency = 0;
+        _shadowfbheader->nr_refreshes = 0;
+        _shadowfbheader->rate_start = get_time_us ();
+        _shadowfbheader->rate_count = 0;
+        _shadowfbheader->refreshes_per_second = 0;
         _shadowfbheader->palette_offset = sizeof(ShadowFBHeader);
 
         if(shadowfbheader.depth <= 8)
@@ -896,6 +1106,7 @@ static GAL_Surface *SHADOW_SetVideoMode(_THIS, GAL_Surface *current,
     if (mgIsServer) {
         pthread_attr_t new_attr;
 
+        this->hidden->refresh_interval = get_refresh_interval ();
         run_flag = 1;
         end_flag = 0;
 
@@ -909,6 +1120,7 @@ static GAL_Surface *SHADOW_SetVideoMode(_THIS, GAL_Surface *current,
         pthread_attr_destroy (&new_attr);
 
         if (ret != 0) {
+            run_flag = 0;
             fprintf (stderr, "NEWGAL>SHADOW: Couldn't start updater\n");
         }
     }
@@ -931,6 +1143,14 @@ static void SHADOW_VideoQuit (_THIS)
         }
     }
     else {
+        if (run_flag) {
+            /* wake up task_do_update and wait for it to end */
+            run_flag = 0;
+            _sysvipc_sem_op (this->hidden->semid, 1, 1);
+            while (end_flag == 0)
+                sleep_us (1000);
+        }
+
         tmp = _shadowfbheader;
         _shadowfbheader = NULL;
         shmdt (tmp);
@@ -966,6 +1186,8 @@ static void SHADOW_FreeHWSurface (_THIS, GAL_Surface *surface)
 static int SHADOW_SetColors (_THIS, int firstcolor, int ncolors,
         GAL_Color *colors)
 {
+    BOOL wake = FALSE;
+
     _shadowfbheader->firstcolor = firstcolor;
     _shadowfbheader->ncolors = ncolors;
 #ifdef _MGRM_PROCESSES
@@ -975,21 +1197,53 @@ static int SHADOW_SetColors (_THIS, int firstcolor, int ncolors,
                 && (_shadowfbheader->depth <= 8)){
             __mg_shadow_fb_ops->set_palette(this->hidden->realfb_info,
                     firstcolor, ncolors, colors);
+            wake = mark_dirty ();
             _shadowfbheader->palette_changed = TRUE;
         }
+
+        if (wake)
+            wake_updater (this);
         return 0;
 #ifdef _MGRM_PROCESSES
     }else{
 #endif
         if (_shadowfbheader->depth <= 8){
             RealEngine_SetPalette(this->hidden->realfb_info, firstcolor, ncolors, colors);
+            wake = mark_dirty ();
             _shadowfbheader->palette_changed = TRUE;
         }
 #ifdef _MGRM_PROCESSES
     }
 #endif
+
+    if (wake)
+        wake_updater (this);
     return 0;
 }
 
+BOOL shadowGetRefreshStats (ShadowRefreshStats* stats)
+{
+    ShadowFBHeader* header = _shadowfbheader;
+    Uint64 now;
+
+    if (header == NULL || stats == NULL)
+        return FALSE;
+
+    stats->nr_refreshes = header->nr_refreshes;
+    stats->nr_pixels = header->nr_pixels;
+    stats->avg_latency_us = header->nr_refreshes ?
+        (unsigned int)(header->total_latency / header->nr_refreshes) : 0;
+
+    /* the rate decays if there is no refresh for a while */
+    now = get_time_us ();
+    if (now > header->rate_start + 2000000)
+        stats->refreshes_per_second = (unsigned int)
+            ((Uint64)header->rate_count * 1000000 / (now - header->rate_start));
+    else
+        stats->refreshes_per_second = header->refreshes_per_second;
+
+    return TRUE;
+}
+
 #endif /* _MGGAL_SHADOW */
 
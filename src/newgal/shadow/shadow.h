@@ -56,6 +56,9 @@ extern "C" {
 /* Hidden "this" pointer for the video functions */
 #define _THIS    GAL_VideoDevice *this
 
+/* The max number of the dirty rectangles tracked in the header */
+#define NR_SHADOW_DIRTY_RECTS   8
+
 typedef struct _ShadowFBHeader {
         unsigned int info_size;
         int width;
@@ -63,7 +66,9 @@ typedef struct _ShadowFBHeader {
         int depth;
         int pitch;
         int dirty;            /* true for dirty, and should reset to false after refreshing the dirty area */
-        RECT dirty_rect;
+        RECT dirty_rect;      /* the bound of all dirty rectangles */
+        int nr_dirty_rects;
+        RECT dirty_rects[NR_SHADOW_DIRTY_RECTS];
         int palette_changed;  /* true for changed, and should reset to false after reflecting the change */
         int palette_offset;
         int fb_offset;
@@ -73,6 +78,15 @@ typedef struct _ShadowFBHeader {
         Uint32 Amask;
         int firstcolor;
         int ncolors;
+
+        /* the statistics of the refresh thread; the times are in microseconds */
+        Uint64 dirty_time;    /* when the screen became dirty */
+        Uint64 nr_pixels;
+        Uint64 total_latency;
+        unsigned int nr_refreshes;
+        Uint64 rate_start;    /* the start of the current rate window */
+        unsigned int rate_count;
+        unsigned int refreshes_per_second;
 } ShadowFBHeader;
 
 #define FLAG_REALFB_PREALLOC  0x01
@@ -99,10 +113,14 @@ struct GAL_PrivateVideoData {
     RECT update;*/
     pthread_t update_th;
 #ifdef _MGRM_PROCESSES
+    /* semaphore 0 locks the header; semaphore 1 counts the wakeups */
     int semid;
 #else
     pthread_mutex_t update_lock;
+    pthread_cond_t update_cond;
 #endif
+    /* the target frame interval in microseconds; 0 for no pacing */
+    int refresh_interval;
 };
 
 typedef struct _ShadowFBOps {
@@ -115,6 +133,15 @@ typedef struct _ShadowFBOps {
 } ShadowFBOps;
 
 ShadowFBOps * __mg_shadow_fb_ops;
+
+/*
+ * Copy, flip, or rotate 16-bit or 32-bit pixels from the shadow frame
+ * buffer to the real one: the pixel at (r, c) of the destination is the one
+ * at src + r * row_step + c * col_step. Returns -1 if the depth or the
+ * steps are not supported, and the caller should go the generic way.
+ */
+int shadow_rotate_pixels (int depth, const BYTE* src, int row_step,
+        int col_step, BYTE* dst, int dst_pitch, int width, int height);
 #ifdef __cplusplus
 }
 #endif  /* __cplusplus */
@@ -304,6 +304,13 @@ void refresh_cw_msb_right (ShadowFBHeader *shadowfb_header, RealFBInfo *realfb_i
 
     dst_line = (gal_uint8*)realfb_info->fb + dst_update.top * realfb_info->pitch;
 
+    /* Rotate in blocks and tiles for 16-bit and 32-bit pixels */
+    if (shadow_rotate_pixels (realfb_info->depth, src_bits,
+                realfb_info->depth/8, -shadowfb_header->pitch,
+                dst_line + dst_update.left * (realfb_info->depth/8),
+                realfb_info->pitch, dst_width, dst_height) == 0)
+        return;
+
     for (x = 0; x < dst_height; x++) {
         /* Copy the bits from vertical line to horizontal line */
         const BYTE* ver_bits = src_bits;
@@ -406,6 +413,13 @@ void refresh_ccw_msb_right (ShadowFBHeader* shadowfb_header, RealFBInfo* realfb_
 
     dst_line = (gal_uint8*)realfb_info->fb + (dst_update.bottom - 1) * realfb_info->pitch;
 
+    /* Rotate in blocks and tiles for 16-bit and 32-bit pixels */
+    if (shadow_rotate_pixels (realfb_info->depth, src_bits,
+                realfb_info->depth/8, shadowfb_header->pitch,
+                dst_line + dst_update.left * (realfb_info->depth/8),
+                -realfb_info->pitch, dst_width, dst_height) == 0)
+        return;
+
     for (x = 0; x < dst_height; x++) {
         /* Copy the bits from vertical line to horizontal line */
         const BYTE* ver_bits = src_bits;
@@ -509,6 +523,14 @@ void refresh_hflip_msb_right (ShadowFBHeader* shadowfb_header, RealFBInfo* realf
 
     dst_line = (gal_uint8 *)realfb_info->fb + src_update.top * realfb_info->pitch;
 
+    /* Flip the rows directly for 16-bit and 32-bit pixels */
+    if (shadow_rotate_pixels (realfb_info->depth, src_bits,
+                shadowfb_header->pitch, -(realfb_info->depth/8),
+                dst_line + (realfb_info->width - src_update.right)
+                        * (realfb_info->depth/8),
+                realfb_info->pitch, src_width, src_height) == 0)
+        return;
+
     for (x = 0; x < src_height; x++) {
         /* Copy the bits from vertical line to horizontal line */
         const BYTE* ver_bits = src_bits;
@@ -611,6 +633,13 @@ void refresh_vflip_msb_right (ShadowFBHeader* shadowfb_header, RealFBInfo* realf
 
     dst_line = (gal_uint8*)realfb_info->fb + (realfb_info->height - src_update.bottom) * realfb_info->pitch;
 
+    /* Copy the rows directly for 16-bit and 32-bit pixels */
+    if (shadow_rotate_pixels (realfb_info->depth, src_bits,
+                -shadowfb_header->pitch, realfb_info->depth/8,
+                dst_line + src_update.left * (realfb_info->depth/8),
+                realfb_info->pitch, src_width, src_height) == 0)
+        return;
+
     for (x = 0; x < src_height; x++) {
         /* Copy the bits from vertical line to horizontal line */
         const BYTE* ver_bits = src_bits;
@@ -0,0 +1,313 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+//                          IMPORTANT NOTICE
+//
+// The following open source license statement does not apply to any
+// entity in the Exception List published by FMSoft.
+//
+// For more information, please visit:
+//
+// https://www.fmsoft.cn/exception-list
+//
+//////////////////////////////////////////////////////////////////////////////
+/*
+ *   This file is part of MiniGUI, a mature cross-platform windowing
+ *   and Graphics User Interface (GUI) support system for embedded systems
+ *   and smart IoT devices.
+ *
+ *   Copyright (C) 2002~2020, Beijing FMSoft Technologies Co., Ltd.
+ *   Copyright (C) 1998~2002, WEI Yongming
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *   Or,
+ *
+ *   As this program is a library, any link to this program must follow
+ *   GNU General Public License version 3 (GPLv3). If you cannot accept
+ *   GPLv3, you need to be licensed from FMSoft.
+ *
+ *   If you have got a commercial license of this program, please use it
+ *   under the terms and conditions of the commercial license.
+ *
+ *   For more information about the commercial license, please refer to
+ *   <http://www.minigui.com/blog/minigui-licensing-policy/>.
+ */
+
+/*
+** shadow_rotate.c: the fast paths of the shadow refreshers for 16-bit
+**  and 32-bit pixels.
+**
+** A rotation is done in blocks of 16x16 pixels, so the rows of a block
+**  both in the shadow and the real frame buffer stay in the cache; in
+**  a block, the pixels are transposed in tiles with SIMD shuffles.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "common.h"
+
+#ifdef _MGGAL_SHADOW
+
+#include "minigui.h"
+#include "newgal.h"
+#include "sysvideo.h"
+#include "blit_simd.h"
+#include "shadow.h"
+
+#ifdef GAL_HAVE_SIMD_BLIT
+#ifdef GAL_SIMD_X86
+#include <immintrin.h>
+#endif
+#endif
+
+#define ROTATE_BLOCK        16
+
+/*
+ * Transpose the pixels in the tiles of a block; rows and cols are the
+ * multiple of the tile size. The pixel (r, c) of the destination is at
+ * src + r * row_step + c * col_step, and row_step is the pixel size or
+ * the negative one.
+ */
+typedef void (*ROTATE_TILES) (const BYTE* src, int row_step, int col_step,
+        BYTE* dst, int dst_pitch, int rows, int cols);
+
+#define DEFINE_ROTATE_SCALAR(name, type)                                \
+static void name (const BYTE* src, int row_step, int col_step,          \
+        BYTE* dst, int dst_pitch, int rows, int cols)                   \
+{                                                                       \
+    int r, c;                                                           \
+                                                                        \
+    for (r = 0; r < rows; r++) {                                        \
+        const BYTE* s = src + r * row_step;                             \
+        type* d = (type*)(dst + r * dst_pitch);                         \
+                                                                        \
+        for (c = 0; c < cols; c++) {                                    \
+            d [c] = *(const type*)s;                                    \
+            s += col_step;                                              \
+        }                                                               \
+    }                                                                   \
+}
+
+DEFINE_ROTATE_SCALAR (rotate_16_c, Uint16)
+DEFINE_ROTATE_SCALAR (rotate_32_c, Uint32)
+
+/*
+ * The tile routines load every source row of a tile from the lowest
+ * address, so the loaded pixels are in the reverse order of the
+ * destination rows when row_step is negative; they are then stored
+ * from the last row of the tile upwards.
+ */
+#define DEFINE_ROTATE_TILES(name, target, TILE, vec_type, TRANSPOSE)    \
+static target void name (const BYTE* src, int row_step, int col_step,   \
+        BYTE* dst, int dst_pitch, int rows, int cols)                   \
+{                                                                       \
+    int r, c, k;                                                        \
+    int bpp = (row_step > 0) ? row_step : -row_step;                    \
+                                                                        \
+    for (r = 0; r < rows; r += TILE) {                                  \
+        const BYTE* s = src + r * row_step;                             \
+        BYTE* d = dst + r * dst_pitch;                                  \
+        int d_pitch = dst_pitch;                                        \
+                                                                        \
+        if (row_step < 0) {                                             \
+            s += (TILE - 1) * row_step;                                 \
+            d += (TILE - 1) * dst_pitch;                                \
+            d_pitch = -dst_pitch;                                       \
+        }                                                               \
+                                                                        \
+        for (c = 0; c < cols; c += TILE) {                              \
+            vec_type v [TILE];                                          \
+                                                                        \
+            for (k = 0; k < TILE; k++)                                  \
+                v [k] = LOAD (s + (c + k) * col_step);                  \
+            TRANSPOSE (v);                                              \
+            for (k = 0; k < TILE; k++)                                  \
+                STORE (d + k * d_pitch + c * bpp, v [k]);               \
+        }                                                               \
+    }                                                                   \
+}
+
+#ifdef GAL_HAVE_SIMD_BLIT
+
+#ifdef GAL_SIMD_X86
+
+#define LOAD(p)         _mm_loadu_si128 ((const __m128i*)(p))
+#define STORE(p, v)     _mm_storeu_si128 ((__m128i*)(p), v)
+
+#define TRANSPOSE_4x32_SSE2(v)                                          \
+    do {                                                                \
+        __m128i t0 = _mm_unpacklo_epi32 (v [0], v [1]);                 \
+        __m128i t1 = _mm_unpacklo_epi32 (v [2], v [3]);                 \
+        __m128i t2 = _mm_unpackhi_epi32 (v [0], v [1]);                 \
+        __m128i t3 = _mm_unpackhi_epi32 (v [2], v [3]);                 \
+        v [0] = _mm_unpacklo_epi64 (t0, t1);                            \
+        v [1] = _mm_unpackhi_epi64 (t0, t1);                            \
+        v [2] = _mm_unpacklo_epi64 (t2, t3);                            \
+        v [3] = _mm_unpackhi_epi64 (t2, t3);                            \
+    } while (0)
+
+#define TRANSPOSE_8x16_SSE2(v)                                          \
+    do {                                                                \
+        __m128i b [8], t [8];                                           \
+        int i;                                                          \
+        for (i = 0; i < 4; i++) {                                       \
+            b [i * 2] = _mm_unpacklo_epi16 (v [i * 2], v [i * 2 + 1]);  \
+            b [i * 2 + 1] = _mm_unpackhi_epi16 (v [i * 2], v [i * 2 + 1]); \
+        }                                                               \
+        for (i = 0; i < 2; i++) {                                       \
+            t [i * 4] = _mm_unpacklo_epi32 (b [i * 4], b [i * 4 + 2]);  \
+            t [i * 4 + 1] = _mm_unpackhi_epi32 (b [i * 4], b [i * 4 + 2]); \
+            t [i * 4 + 2] = _mm_unpacklo_epi32 (b [i * 4 + 1], b [i * 4 + 3]); \
+            t [i * 4 + 3] = _mm_unpackhi_epi32 (b [i * 4 + 1], b [i * 4 + 3]); \
+        }                                                               \
+        for (i = 0; i < 4; i++) {                                       \
+            v [i * 2] = _mm_unpacklo_epi64 (t [i], t [i + 4]);          \
+            v [i * 2 + 1] = _mm_unpackhi_epi64 (t [i], t [i + 4]);      \
+        }                                                               \
+    } while (0)
+
+DEFINE_ROTATE_TILES (rotate_tiles_16_sse2, GAL_TARGET_SSE2, 8, __m128i,
+        TRANSPOSE_8x16_SSE2)
+DEFINE_ROTATE_TILES (rotate_tiles_32_sse2, GAL_TARGET_SSE2, 4, __m128i,
+        TRANSPOSE_4x32_SSE2)
+
+#undef LOAD
+#undef STORE
+
+#endif /* GAL_SIMD_X86 */
+
+#endif /* GAL_HAVE_SIMD_BLIT */
+
+static ROTATE_TILES rotate_tiles_16, rotate_tiles_32;
+static int tile_16, tile_32;
+static int tiles_chosen;
+
+/* Choose the tile routines for the current CPU */
+static void choose_tiles (void)
+{
+    ROTATE_TILES tiles16 = NULL, tiles32 = NULL;
+    int t16 = 1, t32 = 1;
+#ifdef GAL_HAVE_SIMD_BLIT
+    Uint32 features = GAL_GetCPUFeatures ();
+
+#ifdef GAL_SIMD_X86
+    if (features & GAL_CPU_SSE2) {
+        tiles16 = rotate_tiles_16_sse2;
+        t16 = 8;
+        tiles32 = rotate_tiles_32_sse2;
+        t32 = 4;
+    }
+#endif
+#endif /* GAL_HAVE_SIMD_BLIT */
+
+    /* The result is constant; a harmless race if called concurrently */
+    rotate_tiles_16 = tiles16;
+    tile_16 = t16;
+    rotate_tiles_32 = tiles32;
+    tile_32 = t32;
+    tiles_chosen = 1;
+}
+
+static void rotate_blocks (int bpp, const BYTE* src, int row_step,
+        int col_step, BYTE* dst, int dst_pitch, int width, int height)
+{
+    ROTATE_TILES tiles, scalar;
+    int tile, r0, c0;
+
+    if (!tiles_chosen)
+        choose_tiles ();
+
+    if (bpp == 2) {
+        tiles = rotate_tiles_16;
+        tile = tile_16;
+        scalar = rotate_16_c;
+    }
+    else {
+        tiles = rotate_tiles_32;
+        tile = tile_32;
+        scalar = rotate_32_c;
+    }
+
+    for (r0 = 0; r0 < height; r0 += ROTATE_BLOCK) {
+        int h = MIN (ROTATE_BLOCK, height - r0);
+        int full_h = tiles ? (h - h % tile) : 0;
+
+        for (c0 = 0; c0 < width; c0 += ROTATE_BLOCK) {
+            int w = MIN (ROTATE_BLOCK, width - c0);
+            int full_w = tiles ? (w - w % tile) : 0;
+            const BYTE* s = src + r0 * row_step + c0 * col_step;
+            BYTE* d = dst + r0 * dst_pitch + c0 * bpp;
+
+            if (full_h > 0 && full_w > 0)
+                tiles (s, row_step, col_step, d, dst_pitch, full_h, full_w);
+            else
+                full_h = full_w = 0;
+
+            /* the pixels on the right and the bottom out of the tiles */
+            if (w > full_w)
+                scalar (s + full_w * col_step, row_step, col_step,
+                        d + full_w * bpp, dst_pitch, h, w - full_w);
+            if (h > full_h && full_w > 0)
+                scalar (s + full_h * row_step, row_step, col_step,
+                        d + full_h * dst_pitch, dst_pitch, h - full_h, full_w);
+        }
+    }
+}
+
+static void copy_rows (int bpp, const BYTE* src, int row_step,
+        int col_step, BYTE* dst, int dst_pitch, int width, int height)
+{
+    int r, c;
+
+    for (r = 0; r < height; r++) {
+        const BYTE* s = src + r * row_step;
+        BYTE* d = dst + r * dst_pitch;
+
+        if (col_step > 0) {
+            memcpy (d, s, width * bpp);
+        }
+        else if (bpp == 2) {
+            for (c = 0; c < width; c++)
+                ((Uint16*)d) [c] = ((const Uint16*)s) [-c];
+        }
+        else {
+            for (c = 0; c < width; c++)
+                ((Uint32*)d) [c] = ((const Uint32*)s) [-c];
+        }
+    }
+}
+
+int shadow_rotate_pixels (int depth, const BYTE* src, int row_step,
+        int col_step, BYTE* dst, int dst_pitch, int width, int height)
+{
+    int bpp;
+
+    if (depth != 16 && depth != 32)
+        return -1;
+
+    bpp = depth / 8;
+    if (col_step == bpp || col_step == -bpp)
+        copy_rows (bpp, src, row_step, col_step, dst, dst_pitch,
+                width, height);
+    else if (row_step == bpp || row_step == -bpp)
+        rotate_blocks (bpp, src, row_step, col_step, dst, dst_pitch,
+                width, height);
+    else
+        return -1;
+
+    return 0;
+}
+
+#endif /* _MGGAL_SHADOW */
@@ -45,10 +45,15 @@
  */
 
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 
 #include "common.h"
 #include "newgal.h"
 #include "blit.h"
+#include "blit_simd.h"
+#include "stretch_c.h"
+#include "parallel_c.h"
 
 /* This isn't ready for general consumption yet - it should be folded
    into the general blitting mechanism.
@@ -140,33 +145,6 @@ static int generate_rowbytes(int src_w, int dst_w, int bpp)
     return(0);
 }
 
-#else
-
-#define DEFINE_COPY_ROW(name, type)                             \
-static void name(type *src, int src_w, type *dst, int dst_w)    \
-{                                                               \
-    int i;                                                      \
-    int pos, inc;                                               \
-    type pixel = 0;                                             \
-                                                                \
-    pos = 0x10000;                                              \
-    inc = (src_w << 16) / dst_w;                                \
-    for ( i=dst_w; i>0; --i ) {                                 \
-        while ( pos >= 0x10000L ) {                             \
-            pixel = *src++;                                     \
-            pos -= 0x10000L;                                    \
-        }                                                       \
-        *dst++ = pixel;                                         \
-        pos += inc;                                             \
-    }                                                           \
-}
-
-DEFINE_COPY_ROW(copy_row1, Uint8)
-DEFINE_COPY_ROW(copy_row2, Uint16)
-DEFINE_COPY_ROW(copy_row4, Uint32)
-
-#endif /* USE_ASM_STRETCH */
-
 /* The ASM code doesn't handle 24-bpp stretch blits */
 static void copy_row3(Uint8 *src, int src_w, Uint8 *dst, int dst_w)
 {
@@ -190,83 +168,278 @@ static void copy_row3(Uint8 *src, int src_w, Uint8 *dst, int dst_w)
     }
 }
 
-/* Perform a stretch blit between two surfaces of the same format.
-   NOTE:  This function is not safe to call from multiple threads!
-*/
-int GAL_SoftStretch(GAL_Surface *src, GAL_Rect *srcrect,
-                    GAL_Surface *dst, GAL_Rect *dstrect)
+#else
+
+/* Copy the pixels of a row through the map of the columns */
+#define DEFINE_COPY_ROW(name, type)                             \
+static void name(const type *src, const int *map,               \
+                type *dst, int dst_w)                           \
+{                                                               \
+    int i;                                                      \
+                                                                \
+    for ( i=0; i<dst_w; ++i ) {                                 \
+        dst[i] = src[map[i]];                                   \
+    }                                                           \
+}
+
+DEFINE_COPY_ROW(copy_row1, Uint8)
+DEFINE_COPY_ROW(copy_row2, Uint16)
+DEFINE_COPY_ROW(copy_row4, Uint32)
+
+static void copy_row3(const Uint8 *src, const int *map,
+                Uint8 *dst, int dst_w)
 {
-    int pos, inc;
-    int dst_maxrow;
-    int src_row, dst_row;
-    Uint8 *srcp = NULL;
-    Uint8 *dstp;
-    GAL_Rect full_src;
-    GAL_Rect full_dst;
-#if defined(USE_ASM_STRETCH) && defined(__GNUC__)
-    int u1, u2;
-#endif
-    const int bpp = dst->format->BytesPerPixel;
+    int i;
 
-    if ( src->format->BitsPerPixel != dst->format->BitsPerPixel ) {
-        GAL_SetError("NEWGAL: Only works with same format surfaces.\n");
-        return(-1);
+    for ( i=0; i<dst_w; ++i ) {
+        const Uint8 *p = src + map[i] * 3;
+
+        *dst++ = p[0];
+        *dst++ = p[1];
+        *dst++ = p[2];
     }
+}
 
-    /* Verify the blit rectangles */
-    if ( srcrect ) {
-        if ( (srcrect->x < 0) || (srcrect->y < 0) ||
-             ((srcrect->x+srcrect->w) > src->w) ||
-             ((srcrect->y+srcrect->h) > src->h) ) {
-            GAL_SetError("NEWGAL: Invalid source blit rectangle.\n");
-            return(-1);
+#endif /* USE_ASM_STRETCH */
+
+/*
+ * The taps of a dimension of a stretch: every destination pixel is a
+ * weighted sum of some consecutive source pixels, and the weights of a
+ * pixel always sum to STRETCH_ONE. For the nearest-neighbour stretch
+ * there is one tap per pixel, so the taps are the map from destination
+ * to source pixels. The taps only depend on the source and destination
+ * sizes, so they are cached and shared by the stretches of the same size.
+ */
+#define STRETCH_ONE             (1 << 15)
+#define NR_CACHED_TAPS          8
+
+typedef struct _STRETCH_TAPS {
+    int src_len;
+    int dst_len;
+    int filter;
+    int refcount;
+    BOOL cached;
+    /* The max number of taps of a destination pixel */
+    int max_count;
+    /* The first source pixel, the number of taps, and the index of
+       the first weight in 'weights' of every destination pixel */
+    int *first;
+    int *count;
+    int *offset;
+    Uint16 *weights;
+} STRETCH_TAPS;
+
+static STRETCH_TAPS *cached_taps[NR_CACHED_TAPS];
+
+#ifdef _MGRM_THREADS
+static pthread_mutex_t taps_lock = PTHREAD_MUTEX_INITIALIZER;
+#define LOCK_TAPS()     pthread_mutex_lock(&taps_lock)
+#define UNLOCK_TAPS()   pthread_mutex_unlock(&taps_lock)
+#else
+#define LOCK_TAPS()
+#define UNLOCK_TAPS()
+#endif
+
+/* Make the weights of a pixel sum to STRETCH_ONE exactly */
+static void normalize_weights(Uint16 *weights, int count)
+{
+    int i, sum = 0, biggest = 0;
+
+    for ( i=0; i<count; ++i ) {
+        sum += weights[i];
+        if ( weights[i] > weights[biggest] ) {
+            biggest = i;
         }
+    }
+    weights[biggest] += STRETCH_ONE - sum;
+}
+
+static STRETCH_TAPS *create_taps(int src_len, int dst_len, int filter)
+{
+    STRETCH_TAPS *taps;
+    int nr_weights;
+    int i, k, inc;
+
+    /* An area pixel covers at most two more source pixels than its span */
+    if ( filter == GAL_STRETCH_AREA ) {
+        nr_weights = src_len + 2 * dst_len;
     } else {
-        full_src.x = 0;
-        full_src.y = 0;
-        full_src.w = src->w;
-        full_src.h = src->h;
-        srcrect = &full_src;
-    }
-    if ( dstrect ) {
-        if ( (dstrect->x < 0) || (dstrect->y < 0) ||
-             ((dstrect->x+dstrect->w) > dst->w) ||
-             ((dstrect->y+dstrect->h) > dst->h) ) {
-            GAL_SetError("NEWGAL: Invalid destination blit rectangle.\n");
-            return(-1);
+        nr_weights = 2 * dst_len;
+    }
+    inc = (src_len << 16) / dst_len;
+
+    taps = (STRETCH_TAPS *)malloc(sizeof(STRETCH_TAPS) +
+                    sizeof(int) * dst_len * 3 + sizeof(Uint16) * nr_weights);
+    if ( taps == NULL ) {
+        return(NULL);
+    }
+
+    taps->src_len = src_len;
+    taps->dst_len = dst_len;
+    taps->filter = filter;
+    taps->refcount = 0;
+    taps->cached = FALSE;
+    taps->max_count = 1;
+    taps->first = (int *)(taps + 1);
+    taps->count = taps->first + dst_len;
+    taps->offset = taps->count + dst_len;
+    taps->weights = (Uint16 *)(taps->offset + dst_len);
+
+    nr_weights = 0;
+    for ( i=0; i<dst_len; ++i ) {
+        Uint16 *weights = taps->weights + nr_weights;
+        int count;
+
+        if ( filter == GAL_STRETCH_AREA ) {
+            /* The span of the pixel in the source, in 16.16 fixed point */
+            Sint64 s0 = ((Sint64)i * src_len << 16) / dst_len;
+            Sint64 s1 = ((Sint64)(i + 1) * src_len << 16) / dst_len;
+            int first = (int)(s0 >> 16);
+
+            count = (int)((s1 - 1) >> 16) - first + 1;
+            for ( k=0; k<count; ++k ) {
+                Sint64 left = (Sint64)(first + k) << 16;
+                Sint64 right = left + 0x10000;
+
+                if ( left < s0 ) left = s0;
+                if ( right > s1 ) right = s1;
+                weights[k] = (Uint16)(((right - left) * STRETCH_ONE +
+                                    (s1 - s0) / 2) / (s1 - s0));
+            }
+            taps->first[i] = first;
+        } else if ( filter == GAL_STRETCH_NEAREST ) {
+            /* The same source pixel as the stepping of copy_row */
+            weights[0] = STRETCH_ONE;
+            count = 1;
+            taps->first[i] = (int)(((Sint64)i * inc) >> 16);
+        } else {
+            /* Sample at the top-left corner of the pixel like the old
+               bilinear scaler of GDI; clamp at the edges */
+            Sint64 pos = (Sint64)i * inc;
+            int first, frac;
+
+            first = (int)(pos >> 16);
+            frac = (int)(pos & 0xFFFF) >> 1;
+            if ( first >= src_len - 1 ) {
+                first = src_len - 1;
+                frac = 0;
+            }
+
+            weights[0] = STRETCH_ONE - frac;
+            weights[1] = frac;
+            count = frac ? 2 : 1;
+            taps->first[i] = first;
+        }
+
+        normalize_weights(weights, count);
+        taps->count[i] = count;
+        taps->offset[i] = nr_weights;
+        nr_weights += count;
+        if ( count > taps->max_count ) {
+            taps->max_count = count;
         }
-    } else {
-        full_dst.x = 0;
-        full_dst.y = 0;
-        full_dst.w = dst->w;
-        full_dst.h = dst->h;
-        dstrect = &full_dst;
     }
 
-    /* Set up the data... */
-    pos = 0x10000;
-    inc = (srcrect->h << 16) / dstrect->h;
-    src_row = srcrect->y;
-    dst_row = dstrect->y;
+    return(taps);
+}
 
-#ifdef USE_ASM_STRETCH
-    /* Write the opcodes for this stretch */
-    if ( (bpp != 3) &&
-         (generate_rowbytes(srcrect->w, dstrect->w, bpp) < 0) ) {
-        return(-1);
+/* Get the taps from the cache or create them; the most recent first */
+static STRETCH_TAPS *get_taps(int src_len, int dst_len, int filter)
+{
+    STRETCH_TAPS *taps;
+    int i;
+
+    LOCK_TAPS();
+    for ( i=0; i<NR_CACHED_TAPS; ++i ) {
+        taps = cached_taps[i];
+        if ( taps && taps->src_len == src_len &&
+                taps->dst_len == dst_len && taps->filter == filter ) {
+            memmove(cached_taps + 1, cached_taps, sizeof(taps) * i);
+            goto found;
+        }
     }
+
+    taps = create_taps(src_len, dst_len, filter);
+    if ( taps == NULL ) {
+        UNLOCK_TAPS();
+        GAL_OutOfMemory();
+        return(NULL);
+    }
+
+    /* Evict the least recently used one */
+    i = NR_CACHED_TAPS - 1;
+    if ( cached_taps[i] ) {
+        cached_taps[i]->cached = FALSE;
+        if ( cached_taps[i]->refcount == 0 ) {
+            free(cached_taps[i]);
+        }
+    }
+    memmove(cached_taps + 1, cached_taps, sizeof(taps) * i);
+    taps->cached = TRUE;
+
+found:
+    cached_taps[0] = taps;
+    taps->refcount++;
+    UNLOCK_TAPS();
+    return(taps);
+}
+
+static void release_taps(STRETCH_TAPS *taps)
+{
+    LOCK_TAPS();
+    if ( --taps->refcount == 0 && !taps->cached ) {
+        free(taps);
+    }
+    UNLOCK_TAPS();
+}
+
+typedef struct _STRETCH_CONTEXT {
+    GAL_Surface *src;
+    GAL_Rect *srcrect;
+    GAL_Surface *dst;
+    GAL_Rect *dstrect;
+    /* The maps of the rows and the columns */
+    STRETCH_TAPS *ymap;
+#ifndef USE_ASM_STRETCH
+    STRETCH_TAPS *xmap;
 #endif
+} STRETCH_CONTEXT;
+
+/* Stretch the rows [y, y + h) of the destination rectangle */
+static void stretch_band(void *context, int y, int h)
+{
+    STRETCH_CONTEXT *ctxt = (STRETCH_CONTEXT *)context;
+    GAL_Surface *src = ctxt->src;
+    GAL_Surface *dst = ctxt->dst;
+    GAL_Rect *srcrect = ctxt->srcrect;
+    GAL_Rect *dstrect = ctxt->dstrect;
+    const int *rows = ctxt->ymap->first;
+    int src_row = -1;
+    int dst_row, dst_maxrow;
+    Uint8 *srcp;
+    Uint8 *dstp;
+    Uint8 *prevp = NULL;
+#if defined(USE_ASM_STRETCH) && defined(__GNUC__)
+    int u1, u2;
+#endif
+    const int bpp = dst->format->BytesPerPixel;
 
     /* Perform the stretch blit */
-    for ( dst_maxrow = dst_row+dstrect->h; dst_row<dst_maxrow; ++dst_row ) {
-        dstp = (Uint8 *)dst->pixels + (dst_row*dst->pitch)
+    for ( dst_row=y, dst_maxrow=y+h; dst_row<dst_maxrow; ++dst_row ) {
+        dstp = (Uint8 *)dst->pixels + ((dstrect->y+dst_row)*dst->pitch)
                                     + (dstrect->x*bpp);
-        while ( pos >= 0x10000L ) {
-            srcp = (Uint8 *)src->pixels + (src_row*src->pitch)
-                                        + (srcrect->x*bpp);
-            ++src_row;
-            pos -= 0x10000L;
+
+        /* An enlarged source row repeats the last destination row */
+        if ( rows[dst_row] == src_row && src != dst ) {
+            memcpy(dstp, prevp, dstrect->w*bpp);
+            prevp = dstp;
+            continue;
         }
+
+        src_row = rows[dst_row];
+        srcp = (Uint8 *)src->pixels + ((srcrect->y+src_row)*src->pitch)
+                                    + (srcrect->x*bpp);
+        prevp = dstp;
 #ifdef USE_ASM_STRETCH
         switch (bpp) {
             case 3:
@@ -303,23 +476,497 @@ int GAL_SoftStretch(GAL_Surface *src, GAL_Rect *srcrect,
 #else
         switch (bpp) {
             case 1:
-            copy_row1(srcp, srcrect->w, dstp, dstrect->w);
+            copy_row1(srcp, ctxt->xmap->first, dstp, dstrect->w);
             break;
             case 2:
-            copy_row2((Uint16 *)srcp, srcrect->w,
+            copy_row2((Uint16 *)srcp, ctxt->xmap->first,
                       (Uint16 *)dstp, dstrect->w);
             break;
             case 3:
-            copy_row3(srcp, srcrect->w, dstp, dstrect->w);
+            copy_row3(srcp, ctxt->xmap->first, dstp, dstrect->w);
             break;
             case 4:
-            copy_row4((Uint32 *)srcp, srcrect->w,
+            copy_row4((Uint32 *)srcp, ctxt->xmap->first,
                       (Uint32 *)dstp, dstrect->w);
             break;
         }
 #endif
-        pos += inc;
     }
+}
+
+/* Verify the blit rectangles, or use the whole surfaces if they are NULL */
+static int verify_stretch_rects(GAL_Surface *src, GAL_Rect **srcrect,
+                    GAL_Rect *full_src, GAL_Surface *dst, GAL_Rect **dstrect,
+                    GAL_Rect *full_dst)
+{
+    if ( *srcrect ) {
+        if ( ((*srcrect)->x < 0) || ((*srcrect)->y < 0) ||
+             (((*srcrect)->x+(*srcrect)->w) > src->w) ||
+             (((*srcrect)->y+(*srcrect)->h) > src->h) ) {
+            GAL_SetError("NEWGAL: Invalid source blit rectangle.\n");
+            return(-1);
+        }
+    } else {
+        full_src->x = 0;
+        full_src->y = 0;
+        full_src->w = src->w;
+        full_src->h = src->h;
+        *srcrect = full_src;
+    }
+    if ( *dstrect ) {
+        if ( ((*dstrect)->x < 0) || ((*dstrect)->y < 0) ||
+             (((*dstrect)->x+(*dstrect)->w) > dst->w) ||
+             (((*dstrect)->y+(*dstrect)->h) > dst->h) ) {
+            GAL_SetError("NEWGAL: Invalid destination blit rectangle.\n");
+            return(-1);
+        }
+    } else {
+        full_dst->x = 0;
+        full_dst->y = 0;
+        full_dst->w = dst->w;
+        full_dst->h = dst->h;
+        *dstrect = full_dst;
+    }
+    return(0);
+}
+
+/* Perform a stretch blit between two surfaces of the same format.
+   NOTE:  This function is not safe to call from multiple threads!
+*/
+int GAL_SoftStretch(GAL_Surface *src, GAL_Rect *srcrect,
+                    GAL_Surface *dst, GAL_Rect *dstrect)
+{
+    GAL_Rect full_src;
+    GAL_Rect full_dst;
+    STRETCH_CONTEXT ctxt;
+#ifdef USE_ASM_STRETCH
+    const int bpp = dst->format->BytesPerPixel;
+#endif
+
+    if ( src->format->BitsPerPixel != dst->format->BitsPerPixel ) {
+        GAL_SetError("NEWGAL: Only works with same format surfaces.\n");
+        return(-1);
+    }
+
+    /* Verify the blit rectangles */
+    if ( verify_stretch_rects(src, &srcrect, &full_src,
+                dst, &dstrect, &full_dst) < 0 ) {
+        return(-1);
+    }
+
+    if ( dstrect->w <= 0 || dstrect->h <= 0 ) {
+        return(0);
+    }
+
+    /* Set up the data... */
+    ctxt.src = src;
+    ctxt.srcrect = srcrect;
+    ctxt.dst = dst;
+    ctxt.dstrect = dstrect;
+
+    /* The maps of the rows and the columns, cached for the same sizes */
+    ctxt.ymap = get_taps(srcrect->h, dstrect->h, GAL_STRETCH_NEAREST);
+    if ( ctxt.ymap == NULL ) {
+        return(-1);
+    }
+
+#ifdef USE_ASM_STRETCH
+    /* Write the opcodes for this stretch */
+    if ( (bpp != 3) &&
+         (generate_rowbytes(srcrect->w, dstrect->w, bpp) < 0) ) {
+        release_taps(ctxt.ymap);
+        return(-1);
+    }
+#else
+    ctxt.xmap = get_taps(srcrect->w, dstrect->w, GAL_STRETCH_NEAREST);
+    if ( ctxt.xmap == NULL ) {
+        release_taps(ctxt.ymap);
+        return(-1);
+    }
+#endif
+
+    /* Perform the stretch blit, in bands if it is large enough */
+    if ( src != dst ) {
+        GAL_RunBands(stretch_band, &ctxt, dstrect->w, dstrect->h);
+    } else {
+        stretch_band(&ctxt, 0, dstrect->h);
+    }
+
+#ifndef USE_ASM_STRETCH
+    release_taps(ctxt.xmap);
+#endif
+    release_taps(ctxt.ymap);
+    return(0);
+}
+
+
+/*
+ * The filtered stretch (GAL_STRETCH_BILINEAR and GAL_STRETCH_AREA).
+ *
+ * Every destination pixel is a weighted sum of some consecutive source
+ * pixels (the taps) in each direction; the weights of a pixel always sum
+ * to STRETCH_ONE. The source rows are filtered horizontally once into
+ * 16-bit rows (the channel value times 256), then the taps of these rows
+ * are summed vertically into the destination row.
+ */
+
+/* The ways to read and write the channels of the pixels */
+#define CHANNELS_BYTES          1   /* 24-bit or 32-bit, 8-bit channels */
+#define CHANNELS_PACKED16       2   /* 16-bit, unpacked to RGBA8888 */
+
+static int get_channels_mode(const GAL_PixelFormat *format)
+{
+    Uint32 masks[4];
+    int i;
+
+    if ( format->palette ) {
+        return(0);
+    }
+
+    switch (format->BytesPerPixel) {
+        case 2:
+        return(CHANNELS_PACKED16);
+
+        case 3:
+        case 4:
+        masks[0] = format->Rmask;
+        masks[1] = format->Gmask;
+        masks[2] = format->Bmask;
+        masks[3] = format->Amask;
+        for ( i=0; i<4; ++i ) {
+            if ( masks[i] != 0 && masks[i] != 0x000000FF &&
+                    masks[i] != 0x0000FF00 && masks[i] != 0x00FF0000 &&
+                    masks[i] != 0xFF000000 ) {
+                return(0);
+            }
+        }
+        return(CHANNELS_BYTES);
+    }
+
+    return(0);
+}
+
+BOOL GAL_CanStretchFiltered(const GAL_PixelFormat *format)
+{
+    return(get_channels_mode(format) != 0);
+}
+
+static inline Uint8 expand_channel(Uint32 pixel, Uint32 mask,
+                    Uint8 shift, Uint8 loss)
+{
+    Uint32 v = ((pixel & mask) >> shift) << loss;
+
+    return (Uint8)(v | (v >> (8 - loss)));
+}
+
+static void unpack_row16(Uint8 *dst, const Uint16 *src, int width,
+                    const GAL_PixelFormat *format)
+{
+    while ( width-- ) {
+        Uint32 pixel = *src++;
+
+        dst[0] = expand_channel(pixel, format->Rmask,
+                        format->Rshift, format->Rloss);
+        dst[1] = expand_channel(pixel, format->Gmask,
+                        format->Gshift, format->Gloss);
+        dst[2] = expand_channel(pixel, format->Bmask,
+                        format->Bshift, format->Bloss);
+        dst[3] = format->Amask ? expand_channel(pixel, format->Amask,
+                        format->Ashift, format->Aloss) : 0xFF;
+        dst += 4;
+    }
+}
+
+static void pack_row16(Uint16 *dst, const Uint8 *src, int width,
+                    const GAL_PixelFormat *format)
+{
+    while ( width-- ) {
+        *dst++ = (Uint16)(
+                ((src[0] >> format->Rloss) << format->Rshift) |
+                ((src[1] >> format->Gloss) << format->Gshift) |
+                ((src[2] >> format->Bloss) << format->Bshift) |
+                (((src[3] >> format->Aloss) << format->Ashift)
+                    & format->Amask));
+        src += 4;
+    }
+}
+
+/* Filter a source row horizontally */
+static void filter_row(Uint16 *hrow, const Uint8 *src, int nch,
+                    const STRETCH_TAPS *taps)
+{
+    int x, k, c;
+
+    for ( x=0; x<taps->dst_len; ++x ) {
+        const Uint8 *p = src + taps->first[x] * nch;
+        const Uint16 *w = taps->weights + taps->offset[x];
+        int count = taps->count[x];
+        Uint32 sum[4] = { 0, 0, 0, 0 };
+
+        if ( nch == 4 ) {
+            for ( k=0; k<count; ++k ) {
+                sum[0] += p[0] * w[k];
+                sum[1] += p[1] * w[k];
+                sum[2] += p[2] * w[k];
+                sum[3] += p[3] * w[k];
+                p += 4;
+            }
+        } else {
+            for ( k=0; k<count; ++k ) {
+                for ( c=0; c<nch; ++c ) {
+                    sum[c] += p[c] * w[k];
+                }
+                p += nch;
+            }
+        }
+
+        /* value * 256: the weights sum to 1 << 15 */
+        for ( c=0; c<nch; ++c ) {
+            *hrow++ = (Uint16)((sum[c] + 64) >> 7);
+        }
+    }
+}
+
+/* The scalar versions of the vertical kernels */
+static void stretch_v2_c(Uint8 *out, const Uint16 *h0, const Uint16 *h1,
+                    int w0, int w1, int n)
+{
+    while ( n-- ) {
+        *out++ = (Uint8)((*h0++ * w0 + *h1++ * w1 + (1 << 22)) >> 23);
+    }
+}
+
+static void stretch_vacc_c(Uint32 *acc, const Uint16 *h, int w, int n,
+                    int first)
+{
+    if ( first ) {
+        while ( n-- ) {
+            *acc++ = *h++ * w;
+        }
+    } else {
+        while ( n-- ) {
+            *acc++ += *h++ * w;
+        }
+    }
+}
+
+static void stretch_vpack_c(Uint8 *out, const Uint32 *acc, int n)
+{
+    while ( n-- ) {
+        *out++ = (Uint8)((*acc++ + (1 << 22)) >> 23);
+    }
+}
+
+static GAL_StretchV2 stretch_v2;
+static GAL_StretchVAcc stretch_vacc;
+static GAL_StretchVPack stretch_vpack;
+
+/* Choose the vertical kernels for the current CPU */
+static void choose_kernels(void)
+{
+    GAL_StretchV2 v2 = stretch_v2_c;
+    GAL_StretchVAcc vacc = stretch_vacc_c;
+    GAL_StretchVPack vpack = stretch_vpack_c;
+#ifdef GAL_HAVE_SIMD_BLIT
+    Uint32 features = GAL_GetCPUFeatures();
+
+#ifdef GAL_SIMD_X86
+    if ( features & GAL_CPU_AVX2 ) {
+        v2 = Stretch_V2_AVX2;
+        vacc = Stretch_VAcc_AVX2;
+        vpack = Stretch_VPack_AVX2;
+    } else if ( features & GAL_CPU_SSE2 ) {
+        v2 = Stretch_V2_SSE2;
+        vacc = Stretch_VAcc_SSE2;
+        vpack = Stretch_VPack_SSE2;
+    }
+#endif
+#endif /* GAL_HAVE_SIMD_BLIT */
+
+    /* The result is constant; a harmless race if called concurrently */
+    stretch_vacc = vacc;
+    stretch_vpack = vpack;
+    stretch_v2 = v2;
+}
+
+typedef struct _FILTERED_STRETCH {
+    const Uint8 *src_pixels;
+    int src_pitch;
+    const GAL_PixelFormat *format;
+    int mode;
+    int nch;
+    STRETCH_TAPS *xtaps;
+    STRETCH_TAPS *ytaps;
+    void *context;
+    GAL_GetStretchRow get_row;
+    GAL_PutStretchRow put_row;
+    BOOL failed;
+} FILTERED_STRETCH;
+
+/* Stretch the destination rows [y0, y0 + h) */
+static void filtered_stretch_band(void *context, int y0, int h)
+{
+    FILTERED_STRETCH *fs = (FILTERED_STRETCH *)context;
+    const STRETCH_TAPS *xtaps = fs->xtaps;
+    const STRETCH_TAPS *ytaps = fs->ytaps;
+    int n = xtaps->dst_len * fs->nch;
+    int nr_rows = ytaps->max_count;
+    Uint8 *buff, *unpacked = NULL, *packed = NULL;
+    Uint16 *hrows;
+    Uint32 *acc = NULL;
+    int *row_tags;
+    size_t size;
+    int y, k;
+
+    /* The horizontally filtered rows are kept in a ring indexed by the
+       source row modulo nr_rows; the taps of a destination row are
+       consecutive, so they never evict each other */
+    size = sizeof(Uint16) * n * nr_rows + sizeof(int) * nr_rows;
+    if ( nr_rows > 2 )
+        size += sizeof(Uint32) * n;
+    if ( fs->mode == CHANNELS_PACKED16 )
+        size += xtaps->src_len * 4 + n;
+
+    buff = (Uint8 *)malloc(size);
+    if ( buff == NULL ) {
+        fs->failed = TRUE;
+        return;
+    }
+
+    hrows = (Uint16 *)buff;
+    buff = (Uint8 *)(hrows + n * nr_rows);
+    if ( nr_rows > 2 ) {
+        acc = (Uint32 *)buff;
+        buff = (Uint8 *)(acc + n);
+    }
+    row_tags = (int *)buff;
+    buff = (Uint8 *)(row_tags + nr_rows);
+    if ( fs->mode == CHANNELS_PACKED16 ) {
+        unpacked = buff;
+        packed = unpacked + xtaps->src_len * 4;
+    }
+
+    for ( k=0; k<nr_rows; ++k ) {
+        row_tags[k] = -1;
+    }
+
+    for ( y=y0; y<y0+h; ++y ) {
+        const Uint16 *w = ytaps->weights + ytaps->offset[y];
+        int first = ytaps->first[y];
+        int count = ytaps->count[y];
+        const Uint16 *taps[2];
+        Uint8 *out, *row;
+
+        row = fs->get_row(fs->context, y);
+        if ( row == NULL ) {
+            continue;
+        }
+        out = packed ? packed : row;
+
+        for ( k=0; k<count; ++k ) {
+            int src_row = first + k;
+            int slot = src_row % nr_rows;
+            Uint16 *hrow = hrows + n * slot;
+
+            if ( row_tags[slot] != src_row ) {
+                const Uint8 *src = fs->src_pixels + src_row * fs->src_pitch;
+
+                if ( unpacked ) {
+                    unpack_row16(unpacked, (const Uint16 *)src,
+                            xtaps->src_len, fs->format);
+                    src = unpacked;
+                }
+                filter_row(hrow, src, fs->nch, xtaps);
+                row_tags[slot] = src_row;
+            }
+
+            if ( count <= 2 ) {
+                taps[k] = hrow;
+            } else {
+                stretch_vacc(acc, hrow, w[k], n, k == 0);
+            }
+        }
+
+        if ( count == 1 ) {
+            stretch_v2(out, taps[0], taps[0], w[0], 0, n);
+        } else if ( count == 2 ) {
+            stretch_v2(out, taps[0], taps[1], w[0], w[1], n);
+        } else {
+            stretch_vpack(out, acc, n);
+        }
+
+        if ( packed ) {
+            pack_row16((Uint16 *)row, packed, xtaps->dst_len, fs->format);
+        }
+        if ( fs->put_row ) {
+            fs->put_row(fs->context, row, y);
+        }
+    }
+
+    free(hrows);
+}
+
+static int setup_filtered_stretch(FILTERED_STRETCH *fs,
+                    const Uint8 *src_pixels, int src_pitch,
+                    int src_w, int src_h, const GAL_PixelFormat *format,
+                    int dst_w, int dst_h, int filter)
+{
+    fs->mode = get_channels_mode(format);
+    if ( fs->mode == 0 ) {
+        GAL_SetError("NEWGAL: Can not filter the pixels of this format.\n");
+        return(-1);
+    }
+
+    if ( stretch_v2 == NULL ) {
+        choose_kernels();
+    }
+
+    fs->src_pixels = src_pixels;
+    fs->src_pitch = src_pitch;
+    fs->format = format;
+    fs->nch = (fs->mode == CHANNELS_BYTES) ? format->BytesPerPixel : 4;
+    fs->failed = FALSE;
+
+    fs->xtaps = get_taps(src_w, dst_w, filter);
+    if ( fs->xtaps == NULL ) {
+        return(-1);
+    }
+    fs->ytaps = get_taps(src_h, dst_h, filter);
+    if ( fs->ytaps == NULL ) {
+        release_taps(fs->xtaps);
+        return(-1);
+    }
+
     return(0);
 }
 
+int GAL_StretchFiltered(const Uint8 *src_pixels, int src_pitch,
+                    int src_w, int src_h, const GAL_PixelFormat *format,
+                    int dst_w, int dst_h, int filter, void *context,
+                    GAL_GetStretchRow get_row, GAL_PutStretchRow put_row)
+{
+    FILTERED_STRETCH fs;
+
+    if ( src_w <= 0 || src_h <= 0 || dst_w <= 0 || dst_h <= 0 ) {
+        return(0);
+    }
+
+    if ( setup_filtered_stretch(&fs, src_pixels, src_pitch, src_w, src_h,
+                format, dst_w, dst_h, filter) < 0 ) {
+        return(-1);
+    }
+
+    fs.context = context;
+    fs.get_row = get_row;
+    fs.put_row = put_row;
+    filtered_stretch_band(&fs, 0, dst_h);
+
+    release_taps(fs.ytaps);
+    release_taps(fs.xtaps);
+
+    if ( fs.failed ) {
+        GAL_OutOfMemory();
+        return(-1);
+    }
+    return(0);
+}
@@ -50,3 +50,33 @@
 extern int GAL_SoftStretch(GAL_Surface *src, GAL_Rect *srcrect,
                            GAL_Surface *dst, GAL_Rect *dstrect);
 
+/*
+ * The vertical kernels of the filtered stretch. They sum the taps of
+ * 'n' channels; the horizontally filtered rows hold the channel values
+ * times 256, and the weights of a destination row sum to (1 << 15).
+ *
+ * Stretch_V2 writes (h0 * w0 + h1 * w1) to the 8-bit channels, Stretch_VAcc
+ * stores (if 'first' is not zero) or adds h * w to the accumulators, and
+ * Stretch_VPack writes the accumulators to the 8-bit channels.
+ */
+typedef void (*GAL_StretchV2)(Uint8 *out, const Uint16 *h0,
+                              const Uint16 *h1, int w0, int w1, int n);
+typedef void (*GAL_StretchVAcc)(Uint32 *acc, const Uint16 *h, int w, int n,
+                                int first);
+typedef void (*GAL_StretchVPack)(Uint8 *out, const Uint32 *acc, int n);
+
+/* Functions found in stretch_simd.c */
+#ifdef GAL_SIMD_X86
+extern void Stretch_V2_SSE2(Uint8 *out, const Uint16 *h0,
+                            const Uint16 *h1, int w0, int w1, int n);
+extern void Stretch_VAcc_SSE2(Uint32 *acc, const Uint16 *h, int w, int n,
+                              int first);
+extern void Stretch_VPack_SSE2(Uint8 *out, const Uint32 *acc, int n);
+
+extern void Stretch_V2_AVX2(Uint8 *out, const Uint16 *h0,
+                            const Uint16 *h1, int w0, int w1, int n);
+extern void Stretch_VAcc_AVX2(Uint32 *acc, const Uint16 *h, int w, int n,
+                              int first);
+extern void Stretch_VPack_AVX2(Uint8 *out, const Uint32 *acc, int n);
+#endif
+
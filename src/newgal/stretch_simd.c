@@ -0,0 +1,297 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+//                          IMPORTANT NOTICE
+//
+// The following open source license statement does not apply to any
+// entity in the Exception List published by FMSoft.
+//
+// For more information, please visit:
+//
+// https://www.fmsoft.cn/exception-list
+//
+//////////////////////////////////////////////////////////////////////////////
+/*
+ *   This file is part of MiniGUI, a mature cross-platform windowing
+ *   and Graphics User Interface (GUI) support system for embedded systems
+ *   and smart IoT devices.
+ *
+ *   Copyright (C) 2002~2020, Beijing FMSoft Technologies Co., Ltd.
+ *   Copyright (C) 1998~2002, WEI Yongming
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *   Or,
+ *
+ *   As this program is a library, any link to this program must follow
+ *   GNU General Public License version 3 (GPLv3). If you cannot accept
+ *   GPLv3, you need to be licensed from FMSoft.
+ *
+ *   If you have got a commercial license of this program, please use it
+ *   under the terms and conditions of the commercial license.
+ *
+ *   For more information about the commercial license, please refer to
+ *   <http://www.minigui.com/blog/minigui-licensing-policy/>.
+ */
+
+/*
+** stretch_simd.c: the SSE2 and AVX2 versions of the vertical
+**  kernels of the filtered stretch (see stretch.c).
+**
+** They do the same 32-bit integer arithmetic as the scalar kernels,
+**  so the result does not depend on the CPU.
+*/
+
+#include <stdio.h>
+
+#include "common.h"
+#include "newgal.h"
+#include "blit_simd.h"
+#include "stretch_c.h"
+
+#ifdef GAL_HAVE_SIMD_BLIT
+
+#ifdef GAL_SIMD_X86
+#include <immintrin.h>
+#endif
+
+#define ROUND_V     (1 << 22)
+#define SHIFT_V     23
+
+static inline void v2_scalar (Uint8 *out, const Uint16 *h0,
+        const Uint16 *h1, int w0, int w1, int n)
+{
+    while (n-- > 0) {
+        *out++ = (Uint8)((*h0++ * w0 + *h1++ * w1 + ROUND_V) >> SHIFT_V);
+    }
+}
+
+static inline void vacc_scalar (Uint32 *acc, const Uint16 *h, int w, int n,
+        int first)
+{
+    if (first) {
+        while (n-- > 0)
+            *acc++ = *h++ * w;
+    }
+    else {
+        while (n-- > 0)
+            *acc++ += *h++ * w;
+    }
+}
+
+static inline void vpack_scalar (Uint8 *out, const Uint32 *acc, int n)
+{
+    while (n-- > 0) {
+        *out++ = (Uint8)((*acc++ + ROUND_V) >> SHIFT_V);
+    }
+}
+
+#ifdef GAL_SIMD_X86
+
+/* The 32-bit products of 8 unsigned 16-bit values and a 16-bit weight */
+#define MUL_U16_SSE2(h, w, lo, hi)                                      \
+    do {                                                                \
+        __m128i _l = _mm_mullo_epi16 (h, w);                            \
+        __m128i _h = _mm_mulhi_epu16 (h, w);                            \
+        lo = _mm_unpacklo_epi16 (_l, _h);                               \
+        hi = _mm_unpackhi_epi16 (_l, _h);                               \
+    } while (0)
+
+GAL_TARGET_SSE2 void Stretch_V2_SSE2 (Uint8 *out, const Uint16 *h0,
+        const Uint16 *h1, int w0, int w1, int n)
+{
+    __m128i vw0 = _mm_set1_epi16 ((short)w0);
+    __m128i vw1 = _mm_set1_epi16 ((short)w1);
+    __m128i round = _mm_set1_epi32 (ROUND_V);
+
+    while (n >= 16) {
+        __m128i res [2];
+        int i;
+
+        for (i = 0; i < 2; i++) {
+            __m128i a = _mm_loadu_si128 ((const __m128i *)(h0 + i * 8));
+            __m128i b = _mm_loadu_si128 ((const __m128i *)(h1 + i * 8));
+            __m128i alo, ahi, blo, bhi;
+
+            MUL_U16_SSE2 (a, vw0, alo, ahi);
+            MUL_U16_SSE2 (b, vw1, blo, bhi);
+            alo = _mm_srli_epi32 (_mm_add_epi32 (_mm_add_epi32 (alo, blo),
+                        round), SHIFT_V);
+            ahi = _mm_srli_epi32 (_mm_add_epi32 (_mm_add_epi32 (ahi, bhi),
+                        round), SHIFT_V);
+            res [i] = _mm_packs_epi32 (alo, ahi);
+        }
+
+        _mm_storeu_si128 ((__m128i *)out, _mm_packus_epi16 (res [0], res [1]));
+        out += 16;
+        h0 += 16;
+        h1 += 16;
+        n -= 16;
+    }
+
+    v2_scalar (out, h0, h1, w0, w1, n);
+}
+
+GAL_TARGET_SSE2 void Stretch_VAcc_SSE2 (Uint32 *acc, const Uint16 *h,
+        int w, int n, int first)
+{
+    __m128i vw = _mm_set1_epi16 ((short)w);
+
+    while (n >= 8) {
+        __m128i v = _mm_loadu_si128 ((const __m128i *)h);
+        __m128i lo, hi;
+
+        MUL_U16_SSE2 (v, vw, lo, hi);
+        if (!first) {
+            lo = _mm_add_epi32 (lo, _mm_loadu_si128 ((const __m128i *)acc));
+            hi = _mm_add_epi32 (hi,
+                    _mm_loadu_si128 ((const __m128i *)(acc + 4)));
+        }
+        _mm_storeu_si128 ((__m128i *)acc, lo);
+        _mm_storeu_si128 ((__m128i *)(acc + 4), hi);
+        acc += 8;
+        h += 8;
+        n -= 8;
+    }
+
+    vacc_scalar (acc, h, w, n, first);
+}
+
+GAL_TARGET_SSE2 void Stretch_VPack_SSE2 (Uint8 *out, const Uint32 *acc, int n)
+{
+    __m128i round = _mm_set1_epi32 (ROUND_V);
+
+    while (n >= 16) {
+        __m128i v [4];
+        int i;
+
+        for (i = 0; i < 4; i++) {
+            v [i] = _mm_loadu_si128 ((const __m128i *)(acc + i * 4));
+            v [i] = _mm_srli_epi32 (_mm_add_epi32 (v [i], round), SHIFT_V);
+        }
+
+        _mm_storeu_si128 ((__m128i *)out, _mm_packus_epi16 (
+                    _mm_packs_epi32 (v [0], v [1]),
+                    _mm_packs_epi32 (v [2], v [3])));
+        out += 16;
+        acc += 16;
+        n -= 16;
+    }
+
+    vpack_scalar (out, acc, n);
+}
+
+/* The unpack and pack instructions work in 128-bit lanes, so the values
+   keep their order as long as both are used. */
+#define MUL_U16_AVX2(h, w, lo, hi)                                      \
+    do {                                                                \
+        __m256i _l = _mm256_mullo_epi16 (h, w);                         \
+        __m256i _h = _mm256_mulhi_epu16 (h, w);                         \
+        lo = _mm256_unpacklo_epi16 (_l, _h);                            \
+        hi = _mm256_unpackhi_epi16 (_l, _h);                            \
+    } while (0)
+
+/* Store the low 8-bit halves of 16 16-bit values packed in lanes */
+#define STORE_PACKED_AVX2(out, v16)                                     \
+    do {                                                                \
+        __m256i _b = _mm256_packus_epi16 (v16, v16);                    \
+        _b = _mm256_permute4x64_epi64 (_b, 0x08);                       \
+        _mm_storeu_si128 ((__m128i *)(out),                             \
+                _mm256_castsi256_si128 (_b));                           \
+    } while (0)
+
+GAL_TARGET_AVX2 void Stretch_V2_AVX2 (Uint8 *out, const Uint16 *h0,
+        const Uint16 *h1, int w0, int w1, int n)
+{
+    __m256i vw0 = _mm256_set1_epi16 ((short)w0);
+    __m256i vw1 = _mm256_set1_epi16 ((short)w1);
+    __m256i round = _mm256_set1_epi32 (ROUND_V);
+
+    while (n >= 16) {
+        __m256i a = _mm256_loadu_si256 ((const __m256i *)h0);
+        __m256i b = _mm256_loadu_si256 ((const __m256i *)h1);
+        __m256i alo, ahi, blo, bhi;
+
+        MUL_U16_AVX2 (a, vw0, alo, ahi);
+        MUL_U16_AVX2 (b, vw1, blo, bhi);
+        alo = _mm256_srli_epi32 (_mm256_add_epi32 (
+                    _mm256_add_epi32 (alo, blo), round), SHIFT_V);
+        ahi = _mm256_srli_epi32 (_mm256_add_epi32 (
+                    _mm256_add_epi32 (ahi, bhi), round), SHIFT_V);
+        STORE_PACKED_AVX2 (out, _mm256_packs_epi32 (alo, ahi));
+        out += 16;
+        h0 += 16;
+        h1 += 16;
+        n -= 16;
+    }
+
+    v2_scalar (out, h0, h1, w0, w1, n);
+}
+
+GAL_TARGET_AVX2 void Stretch_VAcc_AVX2 (Uint32 *acc, const Uint16 *h,
+        int w, int n, int first)
+{
+    __m256i vw = _mm256_set1_epi16 ((short)w);
+
+    while (n >= 16) {
+        __m256i v = _mm256_loadu_si256 ((const __m256i *)h);
+        __m256i lo, hi, a0, a1;
+
+        MUL_U16_AVX2 (v, vw, lo, hi);
+        /* lo holds the values 0-3 and 8-11, hi 4-7 and 12-15 */
+        a0 = _mm256_permute2x128_si256 (lo, hi, 0x20);
+        a1 = _mm256_permute2x128_si256 (lo, hi, 0x31);
+        if (!first) {
+            a0 = _mm256_add_epi32 (a0,
+                    _mm256_loadu_si256 ((const __m256i *)acc));
+            a1 = _mm256_add_epi32 (a1,
+                    _mm256_loadu_si256 ((const __m256i *)(acc + 8)));
+        }
+        _mm256_storeu_si256 ((__m256i *)acc, a0);
+        _mm256_storeu_si256 ((__m256i *)(acc + 8), a1);
+        acc += 16;
+        h += 16;
+        n -= 16;
+    }
+
+    vacc_scalar (acc, h, w, n, first);
+}
+
+GAL_TARGET_AVX2 void Stretch_VPack_AVX2 (Uint8 *out, const Uint32 *acc,
+        int n)
+{
+    __m256i round = _mm256_set1_epi32 (ROUND_V);
+
+    while (n >= 16) {
+        __m256i a0 = _mm256_loadu_si256 ((const __m256i *)acc);
+        __m256i a1 = _mm256_loadu_si256 ((const __m256i *)(acc + 8));
+        __m256i v16;
+
+        a0 = _mm256_srli_epi32 (_mm256_add_epi32 (a0, round), SHIFT_V);
+        a1 = _mm256_srli_epi32 (_mm256_add_epi32 (a1, round), SHIFT_V);
+        /* packs gives 0-3 8-11 | 4-7 12-15; restore the order */
+        v16 = _mm256_permute4x64_epi64 (_mm256_packs_epi32 (a0, a1), 0xD8);
+        _mm_storeu_si128 ((__m128i *)out, _mm_packus_epi16 (
+                    _mm256_castsi256_si128 (v16),
+                    _mm256_extracti128_si256 (v16, 1)));
+        out += 16;
+        acc += 16;
+        n -= 16;
+    }
+
+    vpack_scalar (out, acc, n);
+}
+
+#endif  /* GAL_SIMD_X86 */
+
+#endif  /* GAL_HAVE_SIMD_BLIT */
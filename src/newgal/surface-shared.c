@@ -126,6 +126,10 @@ GAL_Surface * GAL_CreateSharedRGBSurface (GAL_VideoDevice *video,
         goto error;
     }
 
+    if ((flags & GAL_PREMULALPHA) && GAL_CanPremulAlpha (surface->format)) {
+        surface->flags |= GAL_PREMULALPHA;
+    }
+
     surface->w = width;
     surface->h = height;
     surface->pitch = GAL_CalculatePitch (surface);
@@ -468,7 +472,7 @@ void GAL_DettachSharedSurfaceData (GAL_Surface *surface)
 }
 
 static inline
-GAL_Surface *create_surface_for_znode (GAL_VideoDevice* video,
+GAL_Surface *create_surface_for_znode (GAL_VideoDevice* video, Uint32 flags,
         int width, int height, int bpp,
         Uint32 Rmask, Uint32 Gmask, Uint32 Bmask, Uint32 Amask)
 {
@@ -478,8 +482,8 @@ GAL_Surface *create_surface_for_znode (GAL_VideoDevice* video,
     if (height <= 0) height = 1;
 
     if (IsServer()) {
-        surface = GAL_CreateRGBSurface (
-            GAL_HWSURFACE, width, height, bpp, Rmask, Gmask, Bmask, Amask);
+        surface = GAL_CreateRGBSurface (GAL_HWSURFACE | flags,
+            width, height, bpp, Rmask, Gmask, Bmask, Amask);
 
         if (surface) {
             surface->dirty_info = calloc (1, sizeof (GAL_DirtyInfo));
@@ -493,14 +497,15 @@ GAL_Surface *create_surface_for_znode (GAL_VideoDevice* video,
         return surface;
     }
 
-    return GAL_CreateSharedRGBSurface (video,
-        GAL_HWSURFACE, 0600, width, height, bpp, Rmask, Gmask, Bmask, Amask);
+    return GAL_CreateSharedRGBSurface (video, GAL_HWSURFACE | flags, 0600,
+        width, height, bpp, Rmask, Gmask, Bmask, Amask);
 }
 
 GAL_Surface *GAL_CreateSurfaceForZNodeAs (const GAL_Surface* ref_surf,
         int width, int height)
 {
     return create_surface_for_znode (__gal_screen->video,
+            ref_surf->flags & GAL_PREMULALPHA,
             width, height, ref_surf->format->BitsPerPixel,
             ref_surf->format->Rmask, ref_surf->format->Gmask,
             ref_surf->format->Bmask, ref_surf->format->Amask);
@@ -548,6 +553,7 @@ GAL_Surface *GAL_CreateSurfaceForZNode (unsigned surf_flag, int width, int heigh
     }
 
     return create_surface_for_znode (__gal_screen->video,
+            (surf_flag & ST_PREMULALPHA) ? GAL_PREMULALPHA : 0,
             width, height, bpp, Rmask, Gmask, Bmask, Amask);
 }
 
@@ -54,6 +54,7 @@
 #include "blit.h"
 #include "RLEaccel_c.h"
 #include "pixels_c.h"
+#include "parallel_c.h"
 #include "memops.h"
 #include "leaks.h"
 
@@ -132,6 +133,9 @@ GAL_Surface * GAL_CreateRGBSurface (Uint32 flags,
         free (surface);
         return(NULL);
     }
+    if ((flags & GAL_PREMULALPHA) && GAL_CanPremulAlpha(surface->format)) {
+        surface->flags |= GAL_PREMULALPHA;
+    }
     surface->w = width;
     surface->h = height;
     surface->pitch = GAL_CalculatePitch(surface);
@@ -333,6 +337,54 @@ int GAL_SetAlpha (GAL_Surface *surface, Uint32 flag, Uint8 value)
     return(0);
 }
 
+int GAL_SetPremulAlpha (GAL_Surface *surface, BOOL premul)
+{
+    GAL_PixelFormat *fmt = surface->format;
+    Uint8 *row = (Uint8 *)surface->pixels + surface->pixels_off;
+    int x, y;
+
+    if (!GAL_CanPremulAlpha (fmt))
+        return -1;
+
+    if (!premul == !(surface->flags & GAL_PREMULALPHA))
+        return 0;
+
+    if (surface->flags & GAL_RLEACCEL)
+        GAL_UnRLESurface (surface, 1);
+
+    for (y = 0; y < surface->h; y++) {
+        Uint32 *pixel = (Uint32 *)row;
+
+        for (x = 0; x < surface->w; x++) {
+            unsigned r, g, b, a;
+
+            RGBA_FROM_8888 (*pixel, fmt, r, g, b, a);
+            if (premul) {
+                r = GAL_PremulComponent (r, a);
+                g = GAL_PremulComponent (g, a);
+                b = GAL_PremulComponent (b, a);
+            }
+            else {
+                r = GAL_UnpremulComponent (r, a);
+                g = GAL_UnpremulComponent (g, a);
+                b = GAL_UnpremulComponent (b, a);
+            }
+            PIXEL_FROM_RGBA (*pixel, fmt, r, g, b, a);
+            pixel++;
+        }
+
+        row += surface->pitch;
+    }
+
+    if (premul)
+        surface->flags |= GAL_PREMULALPHA;
+    else
+        surface->flags &= ~GAL_PREMULALPHA;
+
+    GAL_InvalidateMap (surface->map);
+    return 0;
+}
+
 /*
  * Set the clipping rectangle for a blittable surface
  */
@@ -500,17 +552,16 @@ static int own_overlapped_bitblit(GAL_blit real_blit, struct GAL_Surface *src, G
  * you know exactly what you are doing, you can optimize your code
  * by calling the one(s) you need.
  */
-int GAL_LowerBlit (GAL_Surface *src, GAL_Rect *srcrect,
-                GAL_Surface *dst, GAL_Rect *dstrect)
+/* Validate the blit mapping and figure out which blitter to use */
+static GAL_blit choose_blit (GAL_Surface *src, GAL_Surface *dst)
 {
     GAL_blit do_blit;
-    int ret;
 
     /* Check to make sure the blit mapping is valid */
     if ((src->map->dst != dst) ||
              (src->map->dst->format_version != src->map->format_version)) {
         if (GAL_MapSurface(src, dst) < 0) {
-            return(-1);
+            return NULL;
         }
     }
 
@@ -534,11 +585,31 @@ int GAL_LowerBlit (GAL_Surface *src, GAL_Rect *srcrect,
     }
 #endif
 
+    return do_blit;
+}
+
+static inline int run_blit (GAL_blit do_blit, GAL_Surface *src,
+        GAL_Rect *srcrect, GAL_Surface *dst, GAL_Rect *dstrect)
+{
 #ifdef MG_CONFIG_USE_OWN_OVERLAPPED_BITBLIT
-    ret = own_overlapped_bitblit(do_blit, src, srcrect, dst, dstrect);
+    return own_overlapped_bitblit(do_blit, src, srcrect, dst, dstrect);
 #else
-    ret = do_blit(src, srcrect, dst, dstrect);
+    return do_blit(src, srcrect, dst, dstrect);
 #endif
+}
+
+int GAL_LowerBlit (GAL_Surface *src, GAL_Rect *srcrect,
+                GAL_Surface *dst, GAL_Rect *dstrect)
+{
+    GAL_blit do_blit;
+    int ret;
+
+    do_blit = choose_blit(src, dst);
+    if (do_blit == NULL) {
+        return(-1);
+    }
+
+    ret = run_blit(do_blit, src, srcrect, dst, dstrect);
 
 #if 0
     {
@@ -565,7 +636,6 @@ int GAL_LowerBlit (GAL_Surface *src, GAL_Rect *srcrect,
     return ret;
 }
 
-
 int GAL_UpperBlit (GAL_Surface *src, GAL_Rect *srcrect,
            GAL_Surface *dst, GAL_Rect *dstrect)
 {
@@ -654,45 +724,145 @@ int GAL_UpperBlit (GAL_Surface *src, GAL_Rect *srcrect,
 }
 
 /*
- * This function performs a fast fill of the given rectangle with 'color'
+ * Blit a source rectangle to a destination point, clipped by all the
+ * rectangles of a region. The blit mapping is validated and the blitter
+ * is chosen once for the whole region, instead of once per rectangle.
+ *
+ * When blitting to an overlapped area of the same surface, the bands of
+ * the region are walked from bottom to top if the destination is below
+ * the source, and the rectangles of a band are walked from right to left
+ * if the destination is on the right of the source; so no pixel is
+ * overwritten before it is copied.
  */
-int GAL_FillRect(GAL_Surface *dst, const GAL_Rect *dstrect, Uint32 color)
+int GAL_RegionBlit (GAL_Surface *src, const GAL_Rect *srcrect,
+                GAL_Surface *dst, int dx, int dy,
+                const CLIPRGN *rgn, const RECT *bound)
 {
-    GAL_VideoDevice *video = dst->video;
-    GAL_VideoDevice *this  = dst->video;
-    int x, y;
-    Uint8 *row;
-    GAL_Rect my_dstrect;
+    GAL_blit do_blit;
+    const CLIPRECT *crc;
+    RECT rc_dst, eff_rc;
+    GAL_Rect sr, dr;
+    int srcx, srcy, w, h;
+    BOOL bottom_up = FALSE, right_to_left = FALSE;
+    int ret = 0;
 
-    if (!video)
-    {
-        video = __mg_current_video;
-        this = __mg_current_video;
+    if (! src || ! dst) {
+        GAL_SetError("NEWGAL: GAL_RegionBlit: passed a NULL surface.\n");
+        return(-1);
     }
 
-    /* If 'dstrect' == NULL, then fill the whole surface */
-    if (dstrect) {
-        /* Perform clipping */
-        if (!GAL_IntersectRect(dstrect, &dst->clip_rect, &my_dstrect)) {
-            return(0);
-        }
+    /* clip the source rectangle to the source surface */
+    if (srcrect) {
+        srcx = srcrect->x;
+        srcy = srcrect->y;
+        w = srcrect->w;
+        h = srcrect->h;
     } else {
-        my_dstrect = dst->clip_rect;
+        srcx = srcy = 0;
+        w = src->w;
+        h = src->h;
     }
 
-    /* Check for hardware acceleration */
-    if (((dst->flags & GAL_HWSURFACE) == GAL_HWSURFACE) &&
-                    video->info.blit_fill) {
-        return(video->FillHWRect(this, dst, &my_dstrect, color));
+    if (srcx < 0) {
+        w += srcx;
+        dx -= srcx;
+        srcx = 0;
+    }
+    if (srcy < 0) {
+        h += srcy;
+        dy -= srcy;
+        srcy = 0;
+    }
+    if (w > src->w - srcx)
+        w = src->w - srcx;
+    if (h > src->h - srcy)
+        h = src->h - srcy;
+
+    /* clip the destination rectangle to the destination surface */
+    SetRect (&eff_rc, 0, 0, dst->w, dst->h);
+    SetRect (&rc_dst, dx, dy, dx + w, dy + h);
+    if (!IntersectRect (&rc_dst, &rc_dst, &eff_rc))
+        return 0;
+    if (bound && !IntersectRect (&rc_dst, &rc_dst, bound))
+        return 0;
+
+    do_blit = choose_blit (src, dst);
+    if (do_blit == NULL) {
+        return(-1);
+    }
+
+    if (rgn == NULL) {
+        sr.x = srcx + rc_dst.left - dx;
+        sr.y = srcy + rc_dst.top - dy;
+        dr.x = rc_dst.left;
+        dr.y = rc_dst.top;
+        sr.w = dr.w = RECTW (rc_dst);
+        sr.h = dr.h = RECTH (rc_dst);
+        return run_blit (do_blit, src, &sr, dst, &dr);
+    }
+
+    if (src == dst) {
+        bottom_up = (dy > srcy);
+        right_to_left = (dx > srcx);
+    }
+
+    crc = bottom_up ? rgn->tail : rgn->head;
+    while (crc) {
+        const CLIPRECT *band_first = crc, *band_last = crc, *next_band;
+        int band_top = crc->rc.top;
+
+        while (band_first->prev && band_first->prev->rc.top == band_top)
+            band_first = band_first->prev;
+        while (band_last->next && band_last->next->rc.top == band_top)
+            band_last = band_last->next;
+        next_band = bottom_up ? band_first->prev : band_last->next;
+
+        crc = right_to_left ? band_last : band_first;
+        while (crc) {
+            if (IntersectRect (&eff_rc, &rc_dst, &crc->rc)) {
+                sr.x = srcx + eff_rc.left - dx;
+                sr.y = srcy + eff_rc.top - dy;
+                dr.x = eff_rc.left;
+                dr.y = eff_rc.top;
+                sr.w = dr.w = RECTW (eff_rc);
+                sr.h = dr.h = RECTH (eff_rc);
+                ret |= run_blit (do_blit, src, &sr, dst, &dr);
+            }
+
+            if (crc == (right_to_left ? band_first : band_last))
+                break;
+            crc = right_to_left ? crc->prev : crc->next;
+        }
+
+        crc = next_band;
     }
 
-    row = (Uint8 *)dst->pixels+my_dstrect.y*dst->pitch+
-            my_dstrect.x*dst->format->BytesPerPixel;
+    return ret;
+}
+
+typedef struct _FILL_RECT_CONTEXT {
+    GAL_Surface *dst;
+    Uint8 *row;
+    int w;
+    Uint32 color;
+} FILL_RECT_CONTEXT;
+
+/* Fill the rows [y0, y0 + h) of the rectangle */
+static void fill_rect_band(void *context, int y0, int h)
+{
+    FILL_RECT_CONTEXT *ctxt = (FILL_RECT_CONTEXT *)context;
+    GAL_Surface *dst = ctxt->dst;
+    Uint32 color = ctxt->color;
+    int w = ctxt->w;
+    int x, y;
+    Uint8 *row;
+
+    row = ctxt->row + y0*dst->pitch;
     if (dst->format->palette || (color == 0)) {
-        x = my_dstrect.w*dst->format->BytesPerPixel;
+        x = w*dst->format->BytesPerPixel;
         if (!color && !((long)row&3) && !(x&3) && !(dst->pitch&3)) {
             int n = x >> 2;
-            for (y=my_dstrect.h; y; --y) {
+            for (y=h; y; --y) {
                 GAL_memset4(row, 0, n);
                 row += dst->pitch;
             }
@@ -705,14 +875,14 @@ int GAL_FillRect(GAL_Surface *dst, const GAL_Rect *dstrect, Uint32 color)
              * uncachable, so only use it on software surfaces
              */
             if((dst->flags & GAL_HWSURFACE) == GAL_HWSURFACE) {
-                if(my_dstrect.w >= 8) {
+                if(w >= 8) {
                     /*
                      * 64-bit stores are probably most
                      * efficient to uncached video memory
                      */
                     double fill;
                     memset(&fill, color, (sizeof fill));
-                    for(y = my_dstrect.h; y; y--) {
+                    for(y = h; y; y--) {
                         Uint8 *d = row;
                         unsigned n = x;
                         unsigned nn;
@@ -748,7 +918,7 @@ int GAL_FillRect(GAL_Surface *dst, const GAL_Rect *dstrect, Uint32 color)
                     }
                 } else {
                     /* narrow boxes */
-                    for(y = my_dstrect.h; y; y--) {
+                    for(y = h; y; y--) {
                         Uint8 *d = row;
                         Uint8 c = color;
                         int n = x;
@@ -762,7 +932,7 @@ int GAL_FillRect(GAL_Surface *dst, const GAL_Rect *dstrect, Uint32 color)
             } else
 #endif /* __powerpc__ */
             {
-                for(y = my_dstrect.h; y; y--) {
+                for(y = h; y; y--) {
                     memset(row, color, x);
                     row += dst->pitch;
                 }
@@ -771,11 +941,11 @@ int GAL_FillRect(GAL_Surface *dst, const GAL_Rect *dstrect, Uint32 color)
     } else {
         switch (dst->format->BytesPerPixel) {
             case 2:
-            for (y=my_dstrect.h; y; --y) {
+            for (y=h; y; --y) {
                 Uint16 *pixels = (Uint16 *)row;
                 Uint16 c = color;
                 Uint32 cc = (Uint32)c << 16 | c;
-                int n = my_dstrect.w;
+                int n = w;
                 if((unsigned long)pixels & 3) {
                     *pixels++ = c;
                     n--;
@@ -791,9 +961,9 @@ int GAL_FillRect(GAL_Surface *dst, const GAL_Rect *dstrect, Uint32 color)
             case 3:
             if(GAL_BYTEORDER == GAL_BIG_ENDIAN)
                 color <<= 8;
-            for (y=my_dstrect.h; y; --y) {
+            for (y=h; y; --y) {
                 Uint8 *pixels = row;
-                for (x=my_dstrect.w; x; --x) {
+                for (x=w; x; --x) {
                     memcpy(pixels, &color, 3);
                     pixels += 3;
                 }
@@ -802,18 +972,109 @@ int GAL_FillRect(GAL_Surface *dst, const GAL_Rect *dstrect, Uint32 color)
             break;
 
             case 4:
-            for(y = my_dstrect.h; y; --y) {
-                GAL_memset4(row, color, my_dstrect.w);
+            for(y = h; y; --y) {
+                GAL_memset4(row, color, w);
                 row += dst->pitch;
             }
             break;
         }
     }
 
-    /* We're done! */
+}
+
+/* Fill a rectangle which has been clipped already */
+static int fill_rect_clipped(GAL_VideoDevice *video, GAL_Surface *dst,
+        GAL_Rect *rect, Uint32 color)
+{
+    FILL_RECT_CONTEXT ctxt;
+
+    /* Check for hardware acceleration */
+    if (((dst->flags & GAL_HWSURFACE) == GAL_HWSURFACE) &&
+                    video->info.blit_fill) {
+        return(video->FillHWRect(video, dst, rect, color));
+    }
+
+    ctxt.dst = dst;
+    ctxt.row = (Uint8 *)dst->pixels+rect->y*dst->pitch+
+            rect->x*dst->format->BytesPerPixel;
+    ctxt.w = rect->w;
+    ctxt.color = color;
+    GAL_RunBands(fill_rect_band, &ctxt, rect->w, rect->h);
+
     return(0);
 }
 
+/*
+ * This function performs a fast fill of the given rectangle with 'color'
+ */
+int GAL_FillRect(GAL_Surface *dst, const GAL_Rect *dstrect, Uint32 color)
+{
+    GAL_VideoDevice *video = dst->video;
+    GAL_Rect my_dstrect;
+
+    if (!video)
+    {
+        video = __mg_current_video;
+    }
+
+    /* If 'dstrect' == NULL, then fill the whole surface */
+    if (dstrect) {
+        /* Perform clipping */
+        if (!GAL_IntersectRect(dstrect, &dst->clip_rect, &my_dstrect)) {
+            return(0);
+        }
+    } else {
+        my_dstrect = dst->clip_rect;
+    }
+
+    return fill_rect_clipped(video, dst, &my_dstrect, color);
+}
+
+/*
+ * Fill a rectangle clipped by all the rectangles of a region, like
+ * GAL_RegionBlit; the clip rectangle of the surface is not used.
+ */
+int GAL_FillRectRgn(GAL_Surface *dst, const GAL_Rect *dstrect, Uint32 color,
+                const CLIPRGN *rgn, const RECT *bound)
+{
+    GAL_VideoDevice *video = dst->video;
+    const CLIPRECT *crc;
+    RECT rc_fill, eff_rc;
+    GAL_Rect rect;
+    int ret = 0;
+
+    if (!video)
+    {
+        video = __mg_current_video;
+    }
+
+    SetRect(&rc_fill, 0, 0, dst->w, dst->h);
+    if (dstrect) {
+        SetRect(&eff_rc, dstrect->x, dstrect->y,
+                dstrect->x + dstrect->w, dstrect->y + dstrect->h);
+        if (!IntersectRect(&rc_fill, &rc_fill, &eff_rc))
+            return(0);
+    }
+    if (bound && !IntersectRect(&rc_fill, &rc_fill, bound))
+        return(0);
+
+    for (crc = rgn->head; crc; crc = crc->next) {
+        /* the rectangles are sorted by bands */
+        if (crc->rc.top >= rc_fill.bottom)
+            break;
+
+        if (IntersectRect(&eff_rc, &rc_fill, &crc->rc)) {
+            rect.x = eff_rc.left;
+            rect.y = eff_rc.top;
+            rect.w = RECTW(eff_rc);
+            rect.h = RECTH(eff_rc);
+            ret |= fill_rect_clipped(video, dst, &rect, color);
+        }
+    }
+
+    return(ret);
+}
+
 /*
  * Calculate the pad-aligned box sizew in a surface
  */
@@ -1062,7 +1323,23 @@ static int _PutBoxAlpha (GAL_Surface* dst, BYTE* dstrow, BYTE* srcrow, Uint32 w,
         return -1;
 
     if (!(box->bmType & BMP_TYPE_ALPHA_MASK)) {
-        if (dstfmt->Amask == 0xff000000 && dstfmt->BitsPerPixel == 32)
+        if ((dst->flags & GAL_PREMULALPHA) && dstfmt->Amask == 0xff000000)
+        {
+            /* the box was compiled for dst, so its pixels are premultiplied */
+            while(h--) {
+                Uint32 *srcp = (Uint32 *)srcrow;
+                Uint32 *dstp = (Uint32 *)dstrow;
+                DUFFS_LOOP4(
+                        {
+                        *dstp = BLEND_PREMUL_ARGB8888(*srcp, *dstp);
+                        ++srcp;
+                        ++dstp;
+                        }, w);
+                srcrow += box->bmPitch;
+                dstrow += dst->pitch;
+            }
+        }
+        else if (dstfmt->Amask == 0xff000000 && dstfmt->BitsPerPixel == 32)
         {
             while(h--) {
                 Uint32 *srcp = (Uint32 *)srcrow;
@@ -1116,9 +1393,15 @@ static int _PutBoxAlpha (GAL_Surface* dst, BYTE* dstrow, BYTE* srcrow, Uint32 w,
                         unsigned dA = 0;
                         DISEMBLE_RGBA (srcpixels, bpp, dstfmt, pixel, sR, sG, sB, sA);
                         DISEMBLE_RGBA (dstpixels, bpp, dstfmt, pixel, dR, dG, dB, dA);
-                        ALPHA_BLEND (sR, sG, sB, sA, dR, dG, dB);
-                        dA = sA + dA - ((sA * dA) >> 8);
-                        if(dA > 255) dA = 255; //alpha may be greater than 255
+                        if (dst->flags & GAL_PREMULALPHA) {
+                            ALPHA_BLEND_PREMUL (sR, sG, sB, sA, dR, dG, dB);
+                            dA = sA + ((dA * (256 - sA)) >> 8);
+                        }
+                        else {
+                            ALPHA_BLEND (sR, sG, sB, sA, dR, dG, dB);
+                            dA = sA + dA - ((sA * dA) >> 8);
+                            if(dA > 255) dA = 255; //alpha may be greater than 255
+                        }
                         ASSEMBLE_RGBA (dstpixels, bpp, dstfmt, dR, dG, dB, dA);
                         dstpixels += bpp;
                         srcpixels += bpp;
@@ -1469,71 +1752,10 @@ static int _PutBoxKeyAlphaChannel (GAL_Surface* dst, BYTE* dstrow, BYTE* srcrow,
     return 0;
 }
 
-int GAL_PutBox (GAL_Surface *dst, const GAL_Rect *dstrect, BITMAP* box)
+static int _PutBoxCopy (GAL_Surface* dst, BYTE* dstrow, BYTE* srcrow, Uint32 w, Uint32 h, BITMAP* box)
 {
-    Uint32 box_x, box_y, off_x, off_y;
-    int y, w, h;
-    Uint8 *srcrow, *dstrow;
-    Uint32 linelen;
-    GAL_Rect my_dstrect;
-
-    /* If 'dstrect' == NULL, then put to (0, 0) */
-    if (dstrect) {
-        box_x = dstrect->x;
-        box_y = dstrect->y;
-
-        /* Perform clipping */
-        if (!GAL_IntersectRect (dstrect, &dst->clip_rect, &my_dstrect)) {
-            return 0;
-        }
-    } else {
-        box_x = 0;
-        box_y = 0;
-
-        my_dstrect = dst->clip_rect;
-    }
-
-    off_x = my_dstrect.x - box_x;
-    off_y = my_dstrect.y - box_y;
-    if (off_x >= box->bmWidth || off_y >= box->bmHeight ||
-            box->bmBytesPerPixel != dst->format->BytesPerPixel) {
-        return 0;
-    }
-
-    dstrow = (Uint8 *)dst->pixels + my_dstrect.y * dst->pitch +
-            my_dstrect.x * dst->format->BytesPerPixel;
-    srcrow = (Uint8 *)box->bmBits + off_y * box->bmPitch +
-            off_x * box->bmBytesPerPixel;
-    w = MIN (my_dstrect.w, box->bmWidth);
-    h = MIN (my_dstrect.h, box->bmHeight);
-    linelen = w * box->bmBytesPerPixel;
-
-    /* TODO: Check for hardware acceleration here */
-
-    if (box->bmType & BMP_TYPE_ALPHA) {
-        if ((box->bmType & BMP_TYPE_ALPHACHANNEL) && (box->bmType & BMP_TYPE_COLORKEY)) {
-            return _PutBoxKeyAlphaChannelEx (dst, dstrow, srcrow, w, h, box);
-        }
-        if ((box->bmType & BMP_TYPE_ALPHACHANNEL)) {
-            return _PutBoxAlphaChannelEx (dst, dstrow, srcrow, w, h, box);
-        }
-        else if ((box->bmType & BMP_TYPE_ALPHA) && (box->bmType & BMP_TYPE_COLORKEY)) {
-            return _PutBoxKeyAlpha (dst, dstrow, srcrow, w, h, box);
-        }
-        else if (box->bmType & BMP_TYPE_ALPHA) {
-            return _PutBoxAlpha (dst, dstrow, srcrow, w, h, box);
-        }
-    }
-    else if ((box->bmType & BMP_TYPE_ALPHACHANNEL) && (box->bmType & BMP_TYPE_COLORKEY)) {
-        return _PutBoxKeyAlphaChannel (dst, dstrow, srcrow, w, h, box);
-    }
-    else if (box->bmType & BMP_TYPE_COLORKEY) {
-        return _PutBoxKey (dst, dstrow, srcrow, w, h, box);
-    }
-    else if (box->bmType & BMP_TYPE_ALPHACHANNEL) {
-        return _PutBoxAlphaChannel (dst, dstrow, srcrow, w, h, box);
-    }
-
+    Uint32 linelen = w * box->bmBytesPerPixel;
+    int y;
 
     switch (dst->format->BytesPerPixel) {
         case 1:
@@ -1600,6 +1822,124 @@ slow_copy:
     return 0;
 }
 
+typedef int (*PUT_BOX_FUNC) (GAL_Surface* dst, BYTE* dstrow, BYTE* srcrow,
+        Uint32 w, Uint32 h, BITMAP* box);
+
+static PUT_BOX_FUNC _ChoosePutBox (const BITMAP* box)
+{
+    /* TODO: Check for hardware acceleration here */
+
+    if (box->bmType & BMP_TYPE_ALPHA) {
+        if ((box->bmType & BMP_TYPE_ALPHACHANNEL) && (box->bmType & BMP_TYPE_COLORKEY)) {
+            return _PutBoxKeyAlphaChannelEx;
+        }
+        if ((box->bmType & BMP_TYPE_ALPHACHANNEL)) {
+            return _PutBoxAlphaChannelEx;
+        }
+        else if ((box->bmType & BMP_TYPE_ALPHA) && (box->bmType & BMP_TYPE_COLORKEY)) {
+            return _PutBoxKeyAlpha;
+        }
+        else if (box->bmType & BMP_TYPE_ALPHA) {
+            return _PutBoxAlpha;
+        }
+    }
+    else if ((box->bmType & BMP_TYPE_ALPHACHANNEL) && (box->bmType & BMP_TYPE_COLORKEY)) {
+        return _PutBoxKeyAlphaChannel;
+    }
+    else if (box->bmType & BMP_TYPE_COLORKEY) {
+        return _PutBoxKey;
+    }
+    else if (box->bmType & BMP_TYPE_ALPHACHANNEL) {
+        return _PutBoxAlphaChannel;
+    }
+
+    return _PutBoxCopy;
+}
+
+static int _PutBoxClipped (GAL_Surface *dst, const GAL_Rect *dstrect,
+        BITMAP* box, const GAL_Rect *clip, PUT_BOX_FUNC put_box)
+{
+    Uint32 box_x, box_y, off_x, off_y;
+    int w, h;
+    Uint8 *srcrow, *dstrow;
+    GAL_Rect my_dstrect;
+
+    /* If 'dstrect' == NULL, then put to (0, 0) */
+    if (dstrect) {
+        box_x = dstrect->x;
+        box_y = dstrect->y;
+
+        /* Perform clipping */
+        if (!GAL_IntersectRect (dstrect, clip, &my_dstrect)) {
+            return 0;
+        }
+    } else {
+        box_x = 0;
+        box_y = 0;
+
+        my_dstrect = *clip;
+    }
+
+    off_x = my_dstrect.x - box_x;
+    off_y = my_dstrect.y - box_y;
+    if (off_x >= box->bmWidth || off_y >= box->bmHeight ||
+            box->bmBytesPerPixel != dst->format->BytesPerPixel) {
+        return 0;
+    }
+
+    dstrow = (Uint8 *)dst->pixels + my_dstrect.y * dst->pitch +
+            my_dstrect.x * dst->format->BytesPerPixel;
+    srcrow = (Uint8 *)box->bmBits + off_y * box->bmPitch +
+            off_x * box->bmBytesPerPixel;
+    w = MIN (my_dstrect.w, box->bmWidth);
+    h = MIN (my_dstrect.h, box->bmHeight);
+
+    return put_box (dst, dstrow, srcrow, w, h, box);
+}
+
+int GAL_PutBox (GAL_Surface *dst, const GAL_Rect *dstrect, BITMAP* box)
+{
+    return _PutBoxClipped (dst, dstrect, box, &dst->clip_rect,
+            _ChoosePutBox (box));
+}
+
+int GAL_PutBoxRects (GAL_Surface *dst, const GAL_Rect* dstrect, BITMAP* box,
+        const CLIPRECT* first, const RECT* bound)
+{
+    PUT_BOX_FUNC put_box = _ChoosePutBox (box);
+    const CLIPRECT *crc;
+    RECT eff_rc;
+    GAL_Rect clip;
+    int ret = 0;
+
+    for (crc = first; crc; crc = crc->next) {
+        if (bound) {
+            /* the rectangles are sorted by bands */
+            if (crc->rc.top >= bound->bottom)
+                break;
+            if (!IntersectRect (&eff_rc, bound, &crc->rc))
+                continue;
+        }
+        else {
+            eff_rc = crc->rc;
+        }
+
+        clip.x = eff_rc.left;
+        clip.y = eff_rc.top;
+        clip.w = RECTW (eff_rc);
+        clip.h = RECTH (eff_rc);
+        ret |= _PutBoxClipped (dst, dstrect, box, &clip, put_box);
+    }
+
+    return ret;
+}
+
+int GAL_PutBoxRgn (GAL_Surface *dst, const GAL_Rect* dstrect, BITMAP* box,
+        const CLIPRGN* rgn, const RECT* bound)
+{
+    return GAL_PutBoxRects (dst, dstrect, box, rgn->head, bound);
+}
+
 /*
  * Convert a surface into the specified pixel format.
  */
@@ -1611,6 +1951,7 @@ GAL_Surface * GAL_ConvertSurface (GAL_Surface *surface,
     Uint8 alpha = 0;
     Uint32 surface_flags;
     GAL_Rect bounds;
+    BOOL premul_changed;
 
     /* Check for empty destination palette! (results in empty image) */
     if (format->palette != NULL) {
@@ -1660,6 +2001,19 @@ GAL_Surface * GAL_ConvertSurface (GAL_Surface *surface,
         GAL_SetAlpha(surface, 0, 0);
     }
 
+    /*
+     * Copy the pixels without blending if the converted surface uses
+     * the other alpha representation; the color components will be
+     * (un)premultiplied after the copy. The formats which can not be
+     * premultiplied get the colors blended over black, as usual.
+     */
+    premul_changed = ((surface->flags ^ convert->flags) & GAL_PREMULALPHA)
+            && surface->format->Amask && GAL_CanPremulAlpha(convert->format);
+    if (premul_changed && (surface_flags & GAL_SRCPIXELALPHA)) {
+        surface->flags &= ~GAL_SRCPIXELALPHA;
+        GAL_InvalidateMap(surface->map);
+    }
+
     /* Copy over the image data */
     bounds.x = 0;
     bounds.y = 0;
@@ -1667,6 +2021,23 @@ GAL_Surface * GAL_ConvertSurface (GAL_Surface *surface,
     bounds.h = surface->h;
     GAL_LowerBlit(surface, &bounds, convert, &bounds);
 
+    if (premul_changed) {
+        if (surface_flags & GAL_SRCPIXELALPHA) {
+            surface->flags |= GAL_SRCPIXELALPHA;
+            GAL_InvalidateMap(surface->map);
+        }
+
+        /* convert holds the pixels in the representation of surface now */
+        if (convert->flags & GAL_PREMULALPHA) {
+            convert->flags &= ~GAL_PREMULALPHA;
+            GAL_SetPremulAlpha(convert, TRUE);
+        }
+        else {
+            convert->flags |= GAL_PREMULALPHA;
+            GAL_SetPremulAlpha(convert, FALSE);
+        }
+    }
+
     /* Clean up the original surface, and update converted surface */
     if (convert != NULL) {
         GAL_SetClipRect(convert, &surface->clip_rect);
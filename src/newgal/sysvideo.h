@@ -260,6 +260,9 @@ struct GAL_VideoDevice {
     /* Since 4.0.0; used for VT switching */
     int (*Suspend) (_THIS);
     int (*Resume) (_THIS);
+
+    /* Since 5.0.0; the damage filter of the screen, NULL if disabled */
+    struct _GAL_DamageFilter *damage_filter;
 };
 
 #undef _THIS
@@ -0,0 +1,346 @@
+/*
+** usvfb-server.c: a stand-in Web Display Server for testing the USVFB
+** NEWGAL engine.
+**
+** It accepts one MiniGUI client, decodes the FT_DIRTYPIXELS and
+** FT_DIRTYRECTS frames into a local frame buffer, and reports the
+** number of the frames, rectangles, and bytes received. The frame
+** buffer is saved as a PPM file when the client quits.
+**
+** Usage: usvfb-server [output.ppm]
+**
+** Run a MiniGUI program in another terminal with:
+**
+**  MG_GAL_ENGINE=usvfb MG_IAL_ENGINE=usvfb MG_DEFAULTMODE=320x240-16bpp \
+**  MG_USVFB_DIRTY_FRAME=rle ./helloworld
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+/* The following definitions must be same as src/newgal/usvfb/usvfb.h */
+#define USVFB_TRUE_RGB565   3
+#define USVFB_TRUE_RGB0888  5
+
+struct _vfb_info {
+    short height;
+    short width;
+    short bpp;
+    short type;
+    short rlen;
+    void  *fb;
+
+    short async_update;
+};
+
+#define USS_PATH    "/var/tmp/web-display-server"
+
+#define FT_VFBINFO      10
+#define FT_PING         11
+#define FT_PONG         12
+#define FT_EVENT        13
+#define FT_DIRTYPIXELS  14
+#define FT_DIRTYRECTS   15
+
+#define USVFB_ENCODING_RAW      0
+#define USVFB_ENCODING_RLE      1
+
+#define USVFB_RLE_REPEAT        0x8000
+#define USVFB_RLE_MAX_COUNT     0x7FFF
+
+typedef struct _RECT {
+    int left, top, right, bottom;
+} RECT;
+
+struct _frame_header {
+    int type;
+    size_t payload_len;
+    unsigned char payload[0];
+};
+
+struct _dirty_rects_info {
+    int nr_rects;
+};
+
+struct _dirty_rect_info {
+    RECT rc;
+    int encoding;
+    int data_len;
+};
+
+static struct _vfb_info vfb_info;
+static unsigned char* frame;
+static int Bpp, pitch;
+
+static unsigned long nr_frames, nr_rects, nr_bytes, nr_pixels;
+
+static int read_all (int fd, void* buf, size_t len)
+{
+    unsigned char* p = buf;
+
+    while (len > 0) {
+        ssize_t n = read (fd, p, len);
+        if (n <= 0)
+            return -1;
+        p += n;
+        len -= n;
+    }
+
+    return 0;
+}
+
+static int check_rect (const RECT* rc)
+{
+    return rc->left >= 0 && rc->top >= 0 &&
+        rc->right <= vfb_info.width && rc->bottom <= vfb_info.height &&
+        rc->left <= rc->right && rc->top <= rc->bottom;
+}
+
+static int put_raw (const RECT* rc, const unsigned char* src, size_t len)
+{
+    int y, row_len = (rc->right - rc->left) * Bpp;
+
+    if (len != (size_t)row_len * (rc->bottom - rc->top))
+        return -1;
+
+    for (y = rc->top; y < rc->bottom; y++) {
+        memcpy (frame + pitch * y + rc->left * Bpp, src, row_len);
+        src += row_len;
+    }
+
+    return 0;
+}
+
+static int put_rle (const RECT* rc, const unsigned char* src, size_t len)
+{
+    const unsigned char* end = src + len;
+    int y, w = rc->right - rc->left;
+
+    for (y = rc->top; y < rc->bottom; y++) {
+        unsigned char* dst = frame + pitch * y + rc->left * Bpp;
+        int x = 0;
+
+        while (x < w) {
+            unsigned short ctrl;
+            int n;
+
+            if (end - src < (int)sizeof (ctrl))
+                return -1;
+            memcpy (&ctrl, src, sizeof (ctrl));
+            src += sizeof (ctrl);
+
+            n = ctrl & USVFB_RLE_MAX_COUNT;
+            if (n == 0 || x + n > w)
+                return -1;
+
+            if (ctrl & USVFB_RLE_REPEAT) {
+                int i;
+
+                if (end - src < Bpp)
+                    return -1;
+                for (i = 0; i < n; i++)
+                    memcpy (dst + (x + i) * Bpp, src, Bpp);
+                src += Bpp;
+            }
+            else {
+                if (end - src < n * Bpp)
+                    return -1;
+                memcpy (dst + x * Bpp, src, n * Bpp);
+                src += n * Bpp;
+            }
+
+            x += n;
+        }
+    }
+
+    return (src == end) ? 0 : -1;
+}
+
+static int decode_dirty_pixels (const unsigned char* payload, size_t len)
+{
+    RECT rc;
+
+    if (len < sizeof (RECT))
+        return -1;
+
+    memcpy (&rc, payload, sizeof (RECT));
+    if (!check_rect (&rc))
+        return -1;
+
+    nr_rects++;
+    nr_pixels += (rc.right - rc.left) * (rc.bottom - rc.top);
+    return put_raw (&rc, payload + sizeof (RECT), len - sizeof (RECT));
+}
+
+static int decode_dirty_rects (const unsigned char* payload, size_t len)
+{
+    const unsigned char* end = payload + len;
+    struct _dirty_rects_info info;
+    int i;
+
+    if (len < sizeof (info))
+        return -1;
+    memcpy (&info, payload, sizeof (info));
+    payload += sizeof (info);
+
+    for (i = 0; i < info.nr_rects; i++) {
+        struct _dirty_rect_info rc_info;
+        int ret;
+
+        if (end - payload < (int)sizeof (rc_info))
+            return -1;
+        memcpy (&rc_info, payload, sizeof (rc_info));
+        payload += sizeof (rc_info);
+
+        if (!check_rect (&rc_info.rc) || rc_info.data_len < 0 ||
+                end - payload < rc_info.data_len)
+            return -1;
+
+        if (rc_info.encoding == USVFB_ENCODING_RLE)
+            ret = put_rle (&rc_info.rc, payload, rc_info.data_len);
+        else if (rc_info.encoding == USVFB_ENCODING_RAW)
+            ret = put_raw (&rc_info.rc, payload, rc_info.data_len);
+        else
+            ret = -1;
+
+        if (ret)
+            return -1;
+
+        payload += rc_info.data_len;
+        nr_rects++;
+        nr_pixels += (rc_info.rc.right - rc_info.rc.left) *
+            (rc_info.rc.bottom - rc_info.rc.top);
+    }
+
+    return (payload == end) ? 0 : -1;
+}
+
+static void save_frame (const char* file)
+{
+    FILE* fp;
+    int x, y;
+
+    if ((fp = fopen (file, "wb")) == NULL) {
+        perror ("fopen");
+        return;
+    }
+
+    fprintf (fp, "P6\n%d %d\n255\n", vfb_info.width, vfb_info.height);
+    for (y = 0; y < vfb_info.height; y++) {
+        for (x = 0; x < vfb_info.width; x++) {
+            unsigned char rgb [3];
+
+            if (Bpp == 2) {
+                unsigned short p;
+                memcpy (&p, frame + pitch * y + x * 2, 2);
+                rgb [0] = (p >> 8) & 0xF8;
+                rgb [1] = (p >> 3) & 0xFC;
+                rgb [2] = (p << 3) & 0xF8;
+            }
+            else {
+                unsigned int p;
+                memcpy (&p, frame + pitch * y + x * 4, 4);
+                rgb [0] = (p >> 16) & 0xFF;
+                rgb [1] = (p >> 8) & 0xFF;
+                rgb [2] = p & 0xFF;
+            }
+            fwrite (rgb, 1, 3, fp);
+        }
+    }
+
+    fclose (fp);
+}
+
+int main (int argc, const char* argv[])
+{
+    int listen_fd, fd;
+    struct sockaddr_un addr;
+    struct _frame_header header;
+    unsigned char* payload = NULL;
+    size_t payload_size = 0;
+
+    if ((listen_fd = socket (AF_UNIX, SOCK_STREAM, 0)) < 0) {
+        perror ("socket");
+        return 1;
+    }
+
+    memset (&addr, 0, sizeof (addr));
+    addr.sun_family = AF_UNIX;
+    strcpy (addr.sun_path, USS_PATH);
+    unlink (USS_PATH);
+
+    if (bind (listen_fd, (struct sockaddr*)&addr, sizeof (addr)) < 0 ||
+            listen (listen_fd, 1) < 0) {
+        perror ("bind/listen");
+        return 1;
+    }
+
+    if ((fd = accept (listen_fd, NULL, NULL)) < 0) {
+        perror ("accept");
+        return 1;
+    }
+
+    if (read_all (fd, &header, sizeof (header)) || header.type != FT_VFBINFO
+            || header.payload_len != sizeof (vfb_info)
+            || read_all (fd, &vfb_info, sizeof (vfb_info))) {
+        fprintf (stderr, "usvfb-server: bad FT_VFBINFO frame\n");
+        return 1;
+    }
+
+    Bpp = (vfb_info.type == USVFB_TRUE_RGB565) ? 2 : 4;
+    pitch = vfb_info.width * Bpp;
+    frame = calloc (vfb_info.height, pitch);
+    printf ("usvfb-server: %dx%d-%dbpp\n",
+            vfb_info.width, vfb_info.height, vfb_info.bpp);
+
+    while (read_all (fd, &header, sizeof (header)) == 0) {
+        int ret = 0;
+
+        if (header.payload_len > payload_size) {
+            payload_size = header.payload_len;
+            payload = realloc (payload, payload_size);
+        }
+
+        if (read_all (fd, payload, header.payload_len))
+            break;
+
+        switch (header.type) {
+        case FT_DIRTYPIXELS:
+            ret = decode_dirty_pixels (payload, header.payload_len);
+            break;
+        case FT_DIRTYRECTS:
+            ret = decode_dirty_rects (payload, header.payload_len);
+            break;
+        default:
+            fprintf (stderr, "usvfb-server: unknown frame: %d\n", header.type);
+            break;
+        }
+
+        if (ret) {
+            fprintf (stderr, "usvfb-server: bad frame of type %d\n",
+                    header.type);
+            return 2;
+        }
+
+        nr_frames++;
+        nr_bytes += sizeof (header) + header.payload_len;
+    }
+
+    printf ("usvfb-server: %lu frames, %lu rects, %lu pixels, %lu bytes\n",
+            nr_frames, nr_rects, nr_pixels, nr_bytes);
+
+    if (argc > 1)
+        save_frame (argv[1]);
+
+    free (payload);
+    free (frame);
+    close (fd);
+    close (listen_fd);
+    unlink (USS_PATH);
+    return 0;
+}
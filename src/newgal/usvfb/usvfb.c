@@ -61,6 +61,10 @@
         * MG_GAL_ENGINE: should be usvfb
         * MG_DEFAULTMODE: should be a pattern like 320x240-16bpp
         * MG_IAL_ENGINE: shold be usvfb
+        * MG_USVFB_DIRTY_FRAME (optional, since 5.0.0): `rects' to send
+          the dirty pixels in FT_DIRTYRECTS frames, `rle' to send them in
+          FT_DIRTYRECTS frames with the RLE encoding. The legacy FT_DIRTYPIXELS
+          frames will be used if the variable is not defined.
 
     3. The server creates a UNIX domain socket at a well-known path (/var/tmp/mg-remote-sever)
        and wait for the connection from the MiniGUI client.
@@ -80,6 +84,10 @@
        UNIX socket, and the server then sends the information and the pixel data
        to the websocket client.
 
+       A FT_DIRTYRECTS frame carries a list of rectangles and their pixels
+       in one message. The client divides the screen into tiles, and only
+       sends the tiles changed since the last frame.
+
     8. The server gets the input events from the websocket client and sends them
        to the MiniGUI client via the UNIX socket.
 
@@ -104,6 +112,8 @@
 #include <sys/socket.h>
 #include <sys/stat.h>
 #include <sys/un.h>
+#include <sys/uio.h>
+#include <errno.h>
 
 #include <pthread.h>
 
@@ -112,6 +122,7 @@
 #include "newgal.h"
 #include "sysvideo.h"
 #include "pixels_c.h"
+#include "damage_c.h"
 
 #ifdef _MGGAL_USVFB
 
@@ -139,6 +150,14 @@ struct _frame_header {
 int __mg_usvfb_fd = -1;
 static struct _vfb_info _vfb_info;
 
+/* Since 5.0.0: the context of FT_DIRTYRECTS frames */
+static int _dirty_frame = FT_DIRTYPIXELS;
+static int _encoding = USVFB_ENCODING_RAW;
+static GAL_TileDiff _tile_diff;
+static BYTE* _payload;
+
+static int a_update_rects (const RECT* rc_dirty);
+
 static int a_init (void)
 {
     int len, retval;
@@ -188,6 +207,47 @@ error:
     return retval;
 }
 
+static void get_dirty_frame_type (void)
+{
+    const char* env_value;
+
+    if ((env_value = getenv ("MG_USVFB_DIRTY_FRAME")) == NULL)
+        return;
+
+    if (strcmp (env_value, "rects") == 0) {
+        _dirty_frame = FT_DIRTYRECTS;
+        _encoding = USVFB_ENCODING_RAW;
+    }
+    else if (strcmp (env_value, "rle") == 0) {
+        _dirty_frame = FT_DIRTYRECTS;
+        _encoding = USVFB_ENCODING_RLE;
+    }
+}
+
+static int init_dirty_rects (void)
+{
+    int Bpp = _vfb_info.bpp >> 3;
+    int nr_tiles;
+
+    if (GAL_InitTileDiff (&_tile_diff, _vfb_info.fb, _vfb_info.rlen, Bpp,
+                _vfb_info.width, _vfb_info.height, USVFB_TILE_SIZE))
+        return -1;
+    nr_tiles = _tile_diff.cols * _tile_diff.rows;
+
+    /* The tiles do not overlap, and an encoded rectangle is never
+       larger than the raw one; so the payload never exceeds the frame. */
+    _payload = malloc (sizeof (struct _dirty_rects_info) +
+            nr_tiles * sizeof (struct _dirty_rect_info) +
+            _vfb_info.width * _vfb_info.height * Bpp);
+
+    if (_payload == NULL) {
+        GAL_FreeTileDiff (&_tile_diff);
+        return -1;
+    }
+
+    return 0;
+}
+
 /* return zero for success */
 static int a_getinfo (struct _vfb_info *li, int width, int height, int bpp)
 {
@@ -201,6 +261,8 @@ static int a_getinfo (struct _vfb_info *li, int width, int height, int bpp)
         goto error;
     }
 
+    get_dirty_frame_type ();
+
     _vfb_info.width = width;
     _vfb_info.height = height;
     if (bpp == 16) {
@@ -229,6 +291,13 @@ static int a_getinfo (struct _vfb_info *li, int width, int height, int bpp)
         goto error;
     }
 
+    if (_dirty_frame == FT_DIRTYRECTS && init_dirty_rects ()) {
+        free (_vfb_info.fb);
+        _vfb_info.fb = NULL;
+        retval = 4;
+        goto error;
+    }
+
     _vfb_info.async_update = 0;
     memcpy (li, &_vfb_info, sizeof (struct _vfb_info));
     return retval;
@@ -249,6 +318,9 @@ static int a_update (const RECT* rc_dirty)
     size_t bytes;
     struct _frame_header header;
 
+    if (_dirty_frame == FT_DIRTYRECTS)
+        return a_update_rects (rc_dirty);
+
     dirty_w = RECTWP (rc_dirty);
     dirty_h = RECTHP (rc_dirty);
 
@@ -283,8 +355,201 @@ static int a_update (const RECT* rc_dirty)
     return 0;
 }
 
+/* Since 5.0.0: FT_DIRTYRECTS frames */
+static inline Uint32 get_pixel (const BYTE* src, int Bpp)
+{
+    if (Bpp == 2)
+        return *(const Uint16*)src;
+    return *(const Uint32*)src;
+}
+
+/* Return the length of the encoded pixels, or -1 if it would be
+   not shorter than max_len. */
+static int rle_encode_rect (const RECT* rc, int Bpp, BYTE* dst, int max_len)
+{
+    const BYTE* row;
+    int y, w, len = 0;
+
+    w = RECTWP (rc);
+    row = (const BYTE*)_vfb_info.fb + _vfb_info.rlen * rc->top
+        + rc->left * Bpp;
+
+    for (y = rc->top; y < rc->bottom; y++) {
+        int x = 0;
+
+        while (x < w) {
+            Uint32 pixel = get_pixel (row + x * Bpp, Bpp);
+            Uint16 ctrl;
+            int n = 1;
+
+            while (x + n < w && n < USVFB_RLE_MAX_COUNT &&
+                    get_pixel (row + (x + n) * Bpp, Bpp) == pixel)
+                n++;
+
+            if (n >= 3) {
+                if (len + (int)sizeof (Uint16) + Bpp >= max_len)
+                    return -1;
+
+                ctrl = USVFB_RLE_REPEAT | n;
+                memcpy (dst + len, &ctrl, sizeof (Uint16));
+                memcpy (dst + len + sizeof (Uint16), row + x * Bpp, Bpp);
+                len += sizeof (Uint16) + Bpp;
+            }
+            else {
+                /* stop the literals where a run of three pixels begins */
+                n = 1;
+                while (x + n < w && n < USVFB_RLE_MAX_COUNT) {
+                    if (x + n + 2 < w) {
+                        pixel = get_pixel (row + (x + n) * Bpp, Bpp);
+                        if (get_pixel (row + (x + n + 1) * Bpp, Bpp) == pixel &&
+                                get_pixel (row + (x + n + 2) * Bpp, Bpp) == pixel)
+                            break;
+                    }
+                    n++;
+                }
+
+                if (len + (int)sizeof (Uint16) + n * Bpp >= max_len)
+                    return -1;
+
+                ctrl = n;
+                memcpy (dst + len, &ctrl, sizeof (Uint16));
+                memcpy (dst + len + sizeof (Uint16), row + x * Bpp, n * Bpp);
+                len += sizeof (Uint16) + n * Bpp;
+            }
+
+            x += n;
+        }
+
+        row += _vfb_info.rlen;
+    }
+
+    return len;
+}
+
+static int copy_rect (const RECT* rc, int Bpp, BYTE* dst)
+{
+    const BYTE* row;
+    int y, row_len;
+
+    row_len = RECTWP (rc) * Bpp;
+    row = (const BYTE*)_vfb_info.fb + _vfb_info.rlen * rc->top
+        + rc->left * Bpp;
+
+    for (y = rc->top; y < rc->bottom; y++) {
+        memcpy (dst, row, row_len);
+        dst += row_len;
+        row += _vfb_info.rlen;
+    }
+
+    return row_len * RECTHP (rc);
+}
+
+static int write_frame (struct _frame_header* header, const void* payload)
+{
+    struct iovec iov [2];
+    int nr_iov = 2;
+
+    iov[0].iov_base = header;
+    iov[0].iov_len = sizeof (struct _frame_header);
+    iov[1].iov_base = (void*)payload;
+    iov[1].iov_len = header->payload_len;
+
+    while (nr_iov > 0) {
+        ssize_t n = writev (__mg_usvfb_fd, iov + 2 - nr_iov, nr_iov);
+
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            return -1;
+        }
+
+        /* the socket may take a part of a large frame */
+        while (nr_iov > 0 && (size_t)n >= iov[2 - nr_iov].iov_len) {
+            n -= iov[2 - nr_iov].iov_len;
+            nr_iov--;
+        }
+
+        if (nr_iov > 0) {
+            iov[2 - nr_iov].iov_base = (BYTE*)iov[2 - nr_iov].iov_base + n;
+            iov[2 - nr_iov].iov_len -= n;
+        }
+    }
+
+    return 0;
+}
+
+static int a_update_rects (const RECT* rc_dirty)
+{
+    int i, Bpp, nr_rcs;
+    RECT rc_screen, rc_bound;
+    GAL_Rect bound, *dirty_rcs;
+    struct _frame_header header;
+    struct _dirty_rects_info* info;
+    BYTE* dst;
+
+    SetRect (&rc_screen, 0, 0, _vfb_info.width, _vfb_info.height);
+    if (!IntersectRect (&rc_bound, rc_dirty, &rc_screen))
+        return 1;
+
+    Bpp = _vfb_info.bpp >> 3;
+
+    bound.x = rc_bound.left;
+    bound.y = rc_bound.top;
+    bound.w = RECTW (rc_bound);
+    bound.h = RECTH (rc_bound);
+    nr_rcs = GAL_DiffTiles (&_tile_diff, 1, &bound, &dirty_rcs);
+    if (nr_rcs == 0)
+        return 0;
+
+    info = (struct _dirty_rects_info*)_payload;
+    info->nr_rects = nr_rcs;
+    dst = _payload + sizeof (struct _dirty_rects_info);
+
+    for (i = 0; i < nr_rcs; i++) {
+        struct _dirty_rect_info rc_info;
+        BYTE* data;
+        int raw_len;
+
+        SetRect (&rc_info.rc, dirty_rcs[i].x, dirty_rcs[i].y,
+                dirty_rcs[i].x + dirty_rcs[i].w,
+                dirty_rcs[i].y + dirty_rcs[i].h);
+        raw_len = RECTW (rc_info.rc) * RECTH (rc_info.rc) * Bpp;
+
+        /* The payload of the previous rectangle may leave dst unaligned
+           (e.g. RLE of 16-bit pixels); so the header is copied in. */
+        data = dst + sizeof (struct _dirty_rect_info);
+
+        rc_info.data_len = -1;
+        if (_encoding == USVFB_ENCODING_RLE) {
+            rc_info.encoding = USVFB_ENCODING_RLE;
+            rc_info.data_len = rle_encode_rect (&rc_info.rc, Bpp,
+                    data, raw_len);
+        }
+
+        /* fall back to the raw pixels if RLE does not help */
+        if (rc_info.data_len < 0) {
+            rc_info.encoding = USVFB_ENCODING_RAW;
+            rc_info.data_len = copy_rect (&rc_info.rc, Bpp, data);
+        }
+
+        memcpy (dst, &rc_info, sizeof (struct _dirty_rect_info));
+        dst = data + rc_info.data_len;
+    }
+
+    header.type = FT_DIRTYRECTS;
+    header.payload_len = dst - _payload;
+    if (write_frame (&header, _payload))
+        return 2;
+
+    return 0;
+}
+
 static int a_release (void)
 {
+    GAL_FreeTileDiff (&_tile_diff);
+    free (_payload);
+    _payload = NULL;
+
     free (_vfb_info.fb);
     close (__mg_usvfb_fd);
 
@@ -99,6 +99,36 @@ struct _vfb_info {
 #define FT_PONG         12
 #define FT_EVENT        13
 #define FT_DIRTYPIXELS  14
+#define FT_DIRTYRECTS   15  /* Since 5.0.0 */
+
+/* Since 5.0.0: the encodings of the pixels of a rectangle in FT_DIRTYRECTS.
+ *
+ * USVFB_ENCODING_RLE encodes every row of the rectangle as a sequence of
+ * 16-bit control words: a word with the bit 15 set is followed by one pixel,
+ * which repeats (word & 0x7FFF) times; other words are followed by the
+ * given number of literal pixels.
+ */
+#define USVFB_ENCODING_RAW      0
+#define USVFB_ENCODING_RLE      1
+
+#define USVFB_RLE_REPEAT        0x8000
+#define USVFB_RLE_MAX_COUNT     0x7FFF
+
+/* Since 5.0.0: the payload of FT_DIRTYRECTS is a _dirty_rects_info,
+   followed by nr_rects _dirty_rect_info, each one followed by
+   data_len bytes of the encoded pixels. */
+struct _dirty_rects_info {
+    int nr_rects;
+};
+
+struct _dirty_rect_info {
+    RECT rc;
+    int encoding;
+    int data_len;
+};
+
+/* The size of the tiles to detect the unchanged pixels */
+#define USVFB_TILE_SIZE         32
 
 #ifdef __cplusplus
 }
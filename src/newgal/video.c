@@ -56,6 +56,8 @@
 #include "sysvideo.h"
 #include "blit.h"
 #include "pixels_c.h"
+#include "parallel_c.h"
+#include "damage_c.h"
 #include "license.h"
 #include "debug.h"
 
@@ -288,6 +290,7 @@ int GAL_VideoInit (const char *driver_name, Uint32 flags)
 
     video->info.vfmt = GAL_VideoSurface->format;
 
+    GAL_InitParallel();
     return(0);
 }
 
@@ -620,9 +623,34 @@ GAL_Surface * GAL_SetVideoMode (int width, int height, int bpp, Uint32 flags)
     video->info.vfmt = GAL_VideoSurface->format;
     GAL_VideoSurface->video = __mg_current_video;
 
+    /* Since 5.0.0: the damage filter works only if this process is the
+       only one which updates the screen. */
+    GAL_DeleteDamageFilter (video->damage_filter);
+    video->damage_filter = NULL;
+#if defined(_MGRM_PROCESSES) && !defined(_MGSCHEMA_COMPOSITING)
+    /* the clients draw to the shared screen directly */
+#else
+#ifdef _MGRM_PROCESSES
+    if (mgIsServer)
+#endif
+    if (video->info.mlt_surfaces == 0 && video->UpdateRects)
+        video->damage_filter = GAL_CreateDamageFilter (video, GAL_VideoSurface);
+#endif
+
     return(GAL_PublicSurface);
 }
 
+BOOL GetDamageFilterStats (GHANDLE video, DamageFilterStats* stats)
+{
+    GAL_VideoDevice *this = (GAL_VideoDevice *)video;
+
+    if (this == NULL || this->damage_filter == NULL || stats == NULL)
+        return FALSE;
+
+    GAL_GetDamageStats (this->damage_filter, stats);
+    return TRUE;
+}
+
 #ifdef _MGSCHEMA_COMPOSITING
 void GAL_SetVideoModeInfo(GAL_Surface* screen)
 {
@@ -809,6 +837,18 @@ static void mark_surface_dirty (GAL_Surface* surface,
 #include "drawsemop.h"
 #endif /* defined _MGSCHEMA_COMPOSITING */
 
+/* Call UpdateRects of the engine with the rectangles changed actually */
+static inline void update_screen_rects (GAL_VideoDevice *this,
+        GAL_Surface *surface, int numrects, GAL_Rect *rects)
+{
+    if (this->damage_filter && surface == this->screen)
+        numrects = GAL_FilterDamage (this->damage_filter,
+                numrects, rects, &rects);
+
+    if (numrects > 0)
+        this->UpdateRects (this, numrects, rects);
+}
+
 #ifdef _MGUSE_UPDATE_REGION
 
 static inline void add_rects_to_update_region (CLIPRGN* region,
@@ -921,7 +961,7 @@ BOOL GAL_SyncUpdate (GAL_Surface *surface)
 
     if (this) {
         if (this->info.mlt_surfaces == 0 && this->UpdateRects) {
-            this->UpdateRects (this, numrects, rects);
+            update_screen_rects (this, surface, numrects, rects);
         }
         else if (this->UpdateSurfaceRects) {
             this->UpdateSurfaceRects (this, surface, numrects, rects);
@@ -950,7 +990,7 @@ void GAL_UpdateRects (GAL_Surface *surface, int numrects, GAL_Rect *rects)
 
     if (this) {
         if (this->info.mlt_surfaces == 0 && this->UpdateRects) {
-            this->UpdateRects (this, numrects, rects);
+            update_screen_rects (this, surface, numrects, rects);
         }
         else if (this->UpdateSurfaceRects) {
             this->UpdateSurfaceRects (this, surface, numrects, rects);
@@ -1146,10 +1186,15 @@ void GAL_VideoQuit (void)
             video->physpal = NULL;
         }
 
+        GAL_DeleteDamageFilter (video->damage_filter);
+        video->damage_filter = NULL;
+
         /* Finish cleaning up video subsystem */
         video->free(this);
         __mg_current_video = NULL;
 
+        GAL_QuitParallel();
+
 #ifdef _MGUSE_UPDATE_REGION
         DestroyFreeClipRectList (&__mg_free_update_region_list);
 #endif
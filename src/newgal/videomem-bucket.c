@@ -56,16 +56,148 @@
 #define TEST_BIT(a, bit) ((a) & (bit))
 #define SET_BIT(a, bit) ((a) |= (bit))
 #define UNSET_BIT(a, bit) ((a) &= ~(bit))
-#define BLOCK_SIZE(block) ((block)->height * (block)->pitch)
+#define BLOCK_SIZE(block) ((block)->size)
 
+#define BLOCK_OF_LIST(entry) list_entry(entry, gal_vmblock_t, list)
+#define BLOCK_OF_FREE_LIST(entry) list_entry(entry, gal_vmblock_t, free_list)
+
+/* the index of the most significant bit; x must not be zero */
+static inline int fls_index(unsigned int x)
+{
+#ifdef __GNUC__
+    return 31 - __builtin_clz(x);
+#else
+    int i = 0;
+    while (x >>= 1)
+        i++;
+    return i;
+#endif
+}
+
+/* the index of the least significant bit; x must not be zero */
+static inline int ffs_index(unsigned int x)
+{
+#ifdef __GNUC__
+    return __builtin_ctz(x);
+#else
+    int i = 0;
+    while (!(x & 1)) {
+        x >>= 1;
+        i++;
+    }
+    return i;
+#endif
+}
+
+/* get the size class of a block */
+static void mapping_insert(int size, int *fl, int *sl)
+{
+    if (size < VMBUCKET_SL_COUNT) {
+        *fl = 0;
+        *sl = size;
+    }
+    else {
+        int msb = fls_index((unsigned int)size);
+        *fl = msb - VMBUCKET_SL_BITS + 1;
+        *sl = (size >> (msb - VMBUCKET_SL_BITS)) - VMBUCKET_SL_COUNT;
+    }
+}
+
+/*
+ * get the first size class in which every block is big enough;
+ * returns -1 if the size is too big.
+ */
+static int mapping_search(int size, int *fl, int *sl)
+{
+    unsigned int rounded = (unsigned int)size;
+
+    if (size >= VMBUCKET_SL_COUNT) {
+        rounded += (1U << (fls_index(rounded) - VMBUCKET_SL_BITS)) - 1;
+        if (rounded > 0x7FFFFFFF)
+            return -1;
+    }
+
+    mapping_insert((int)rounded, fl, sl);
+    return 0;
+}
+
+static void insert_free_block(gal_vmbucket_t *bucket, gal_vmblock_t *block)
+{
+    int fl, sl;
+
+    mapping_insert(block->size, &fl, &sl);
+    list_add(&block->free_list, &bucket->free_lists[fl][sl]);
+    bucket->fl_bitmap |= 1U << fl;
+    bucket->sl_bitmap[fl] |= 1U << sl;
+    bucket->nr_free_blocks++;
+}
+
+static void remove_free_block(gal_vmbucket_t *bucket, gal_vmblock_t *block)
+{
+    int fl, sl;
+
+    mapping_insert(block->size, &fl, &sl);
+    list_del(&block->free_list);
+    if (list_empty(&bucket->free_lists[fl][sl])) {
+        bucket->sl_bitmap[fl] &= ~(1U << sl);
+        if (bucket->sl_bitmap[fl] == 0)
+            bucket->fl_bitmap &= ~(1U << fl);
+    }
+    bucket->nr_free_blocks--;
+}
+
+/* find a free block of which the size is not less than size */
+static gal_vmblock_t *find_free_block(gal_vmbucket_t *bucket, int size)
+{
+    unsigned int sl_map, fl_map;
+    struct list_head *i;
+    int fl, sl;
+
+    if (mapping_search(size, &fl, &sl) == 0) {
+        sl_map = bucket->sl_bitmap[fl] & (~0U << sl);
+        if (sl_map == 0) {
+            fl_map = (fl + 1 < 32) ? (bucket->fl_bitmap & (~0U << (fl + 1))) : 0;
+            if (fl_map) {
+                fl = ffs_index(fl_map);
+                sl_map = bucket->sl_bitmap[fl];
+            }
+        }
+
+        if (sl_map) {
+            sl = ffs_index(sl_map);
+            return BLOCK_OF_FREE_LIST(bucket->free_lists[fl][sl].next);
+        }
+    }
+
+    /* the blocks in the class of the size may be big enough as well */
+    mapping_insert(size, &fl, &sl);
+    list_for_each(i, &bucket->free_lists[fl][sl]) {
+        gal_vmblock_t *block = BLOCK_OF_FREE_LIST(i);
+        if (block->size >= size)
+            return block;
+    }
+
+    return NULL;
+}
+
+static gal_vmblock_t *new_free_block(int offset, int size)
+{
+    gal_vmblock_t *block;
+
+    block = (gal_vmblock_t *)calloc(1, sizeof(*block));
+    if (block) {
+        block->offset = offset;
+        block->height = 1;
+        block->pitch = size;
+        block->size = size;
+    }
+    return block;
+}
 
 #ifdef GAL_VMBUCKET_DEBUG
 static void gal_vmbucket_print(const gal_vmbucket_t *bucket) {
     struct list_head *i;
-    int unused_total = 0;
-    int unused_max = 0;
-    int used_max = 0;
-    int used_total = 0;
+    gal_vmbucket_stats_t stats;
     char bit_flags[32] = "";
 
     printf( "\n---- GAL Video Memory Bucket -------\n"
@@ -73,16 +205,12 @@ static void gal_vmbucket_print(const gal_vmbucket_t *bucket) {
             "  size=%d\n",
             bucket->start, bucket->size);
     list_for_each(i, &bucket->block_head) {
-        gal_vmblock_t *block = (gal_vmblock_t *)i;
+        gal_vmblock_t *block = BLOCK_OF_LIST(i);
 
         if (TEST_BIT(block->flag, VMBLOCK_FLAG_USED)) {
-            used_total++;
-            used_max = used_max > (block->height * block->pitch) ? used_max : (block->height * block->pitch);
             sprintf(bit_flags, " ");
         }
         else {
-            unused_total++;
-            unused_max = unused_max > (block->height * block->pitch) ? unused_max : (block->height * block->pitch);
             sprintf(bit_flags, "\t\t");
         }
 
@@ -96,81 +224,101 @@ static void gal_vmbucket_print(const gal_vmbucket_t *bucket) {
                 bit_flags, block->height,
                 bit_flags, block->pitch,
                 bit_flags, block->flag,
-                bit_flags, block->height*block->pitch);
+                bit_flags, block->size);
     }
 
+    gal_vmbucket_get_stats(bucket, &stats);
     printf( "---------- Total Result -------------\n"
-            "unused: count=%d, max_block:%d\n"
-            "used  : count=%d, max_block:%d\n"
-            "total : count=%d\n"
+            "unused: count=%d, size=%d, max_block:%d\n"
+            "used  : count=%d, size=%d\n"
+            "total : count=%d, fragmentation=%d%%\n"
             "-------------------------------------\n\n",
-            unused_total, unused_max,
-            used_total, used_max,
-            unused_total+used_total);
+            stats.nr_free_blocks, stats.free_size, stats.largest_free_size,
+            stats.nr_used_blocks, stats.used_size,
+            stats.nr_free_blocks + stats.nr_used_blocks,
+            stats.fragmentation);
 }
 #else
 #   define gal_vmbucket_print(x) /* NULL */
 #endif
 
 int gal_vmbucket_init(gal_vmbucket_t *bucket, unsigned char *start, int size) {
+    gal_vmblock_t *block;
+    int fl, sl;
+
     bucket->start = start;
     bucket->size = size;
     INIT_LIST_HEAD(&bucket->block_head);
 
-    {
-        gal_vmblock_t *block;
-        block = (gal_vmblock_t *)calloc(1, sizeof(*block));
-        block->offset = 0;
-        block->height = 1;
-        block->pitch = size;
-        list_add(&block->list, &bucket->block_head);
+    bucket->fl_bitmap = 0;
+    for (fl = 0; fl < VMBUCKET_FL_COUNT; fl++) {
+        bucket->sl_bitmap[fl] = 0;
+        for (sl = 0; sl < VMBUCKET_SL_COUNT; sl++)
+            INIT_LIST_HEAD(&bucket->free_lists[fl][sl]);
     }
+    bucket->used_size = 0;
+    bucket->nr_used_blocks = 0;
+    bucket->nr_free_blocks = 0;
+
+    block = new_free_block(0, size);
+    if (block == NULL)
+        return -1;
+
+    list_add(&block->list, &bucket->block_head);
+    insert_free_block(bucket, block);
+
     gal_vmbucket_print(bucket);
     return 0;
 }
 
 void gal_vmbucket_destroy(gal_vmbucket_t *bucket) {
     while (! list_empty(&bucket->block_head)) {
-        gal_vmblock_t *block = (gal_vmblock_t *)bucket->block_head.prev;
+        gal_vmblock_t *block = BLOCK_OF_LIST(bucket->block_head.prev);
         list_del(bucket->block_head.prev);
         free(block);
     }
 }
 
 gal_vmblock_t *gal_vmbucket_alloc(gal_vmbucket_t *bucket, int pitch, int height) {
-    struct list_head *i;
+    gal_vmblock_t *block;
     int required_size = height * pitch;
 
-    list_for_each(i, &bucket->block_head) {
-        gal_vmblock_t *block;
-        block = (gal_vmblock_t *)i;
-        if (! TEST_BIT(block->flag, VMBLOCK_FLAG_USED)) {
-            int block_size = BLOCK_SIZE(block);
-            if (required_size > block_size) {
-                continue;
-            }else if (required_size < block_size) {
-                gal_vmblock_t *new_block;
-                new_block = (gal_vmblock_t *)calloc(1, sizeof(*new_block));
-                new_block->offset = block->offset + required_size;
-                new_block->pitch = block_size - required_size;
-                new_block->height = 1;
-                list_add(&new_block->list, &block->list);
-            }
-            block->height = height;
-            block->pitch = pitch;
-            SET_BIT(block->flag, VMBLOCK_FLAG_USED);
-            gal_vmbucket_print(bucket);
-            return block;
+    if (required_size <= 0)
+        return NULL;
+
+    block = find_free_block(bucket, required_size);
+    if (block == NULL) {
+        fprintf(stderr, "videomem-bucket: Failed to alloc hardware surface(request_size=%d)\n", required_size);
+        return NULL;
+    }
+
+    remove_free_block(bucket, block);
+    if (required_size < block->size) {
+        gal_vmblock_t *new_block;
+        new_block = new_free_block(block->offset + required_size,
+                block->size - required_size);
+        if (new_block == NULL) {
+            insert_free_block(bucket, block);
+            return NULL;
         }
+
+        list_add(&new_block->list, &block->list);
+        insert_free_block(bucket, new_block);
+        block->size = required_size;
     }
-    fprintf(stderr, "videomem-bucket: Failed to alloc hardware surface(request_size=%d)\n", required_size);
 
-    return NULL;
+    block->height = height;
+    block->pitch = pitch;
+    SET_BIT(block->flag, VMBLOCK_FLAG_USED);
+    bucket->used_size += block->size;
+    bucket->nr_used_blocks++;
+
+    gal_vmbucket_print(bucket);
+    return block;
 }
 
 void gal_vmbucket_free(gal_vmbucket_t *bucket, gal_vmblock_t *block)
 {
-    int size = BLOCK_SIZE(block);
     gal_vmblock_t *near_block;
 
     //assert(TEST_BIT(block->flag, VMBLOCK_FLAG_USED));
@@ -179,15 +327,16 @@ void gal_vmbucket_free(gal_vmbucket_t *bucket, gal_vmblock_t *block)
         return;
     }
     UNSET_BIT(block->flag, VMBLOCK_FLAG_USED);
+    bucket->used_size -= block->size;
+    bucket->nr_used_blocks--;
 
     /* look for prev */
     if (block->list.prev != &(bucket->block_head)) {
-        near_block = (gal_vmblock_t *)block->list.prev;
+        near_block = BLOCK_OF_LIST(block->list.prev);
         if (!TEST_BIT(near_block->flag, VMBLOCK_FLAG_USED)) {
-            size += BLOCK_SIZE(near_block);
+            remove_free_block(bucket, near_block);
             block->offset = near_block->offset;
-            block->height = 1;
-            block->pitch = size;
+            block->size += near_block->size;
             list_del(&near_block->list);
             free(near_block);
         }
@@ -195,15 +344,48 @@ void gal_vmbucket_free(gal_vmbucket_t *bucket, gal_vmblock_t *block)
 
     /* look for next */
     if (block->list.next != &(bucket->block_head)) {
-        near_block = (gal_vmblock_t *)block->list.next;
+        near_block = BLOCK_OF_LIST(block->list.next);
         if (!TEST_BIT(near_block->flag, VMBLOCK_FLAG_USED)) {
-            size += BLOCK_SIZE(near_block);
-            block->height = 1;
-            block->pitch = size;
+            remove_free_block(bucket, near_block);
+            block->size += near_block->size;
             list_del(&near_block->list);
             free(near_block);
         }
     }
 
+    block->height = 1;
+    block->pitch = block->size;
+    insert_free_block(bucket, block);
+
     gal_vmbucket_print(bucket);
 }
+
+void gal_vmbucket_get_stats(const gal_vmbucket_t *bucket,
+        gal_vmbucket_stats_t *stats)
+{
+    stats->total_size = bucket->size;
+    stats->used_size = bucket->used_size;
+    stats->free_size = bucket->size - bucket->used_size;
+    stats->nr_used_blocks = bucket->nr_used_blocks;
+    stats->nr_free_blocks = bucket->nr_free_blocks;
+    stats->largest_free_size = 0;
+
+    /* the largest free block is in the highest non-empty size class */
+    if (bucket->fl_bitmap) {
+        int fl = fls_index(bucket->fl_bitmap);
+        int sl = fls_index(bucket->sl_bitmap[fl]);
+        struct list_head *i;
+
+        list_for_each(i, &bucket->free_lists[fl][sl]) {
+            gal_vmblock_t *block = BLOCK_OF_FREE_LIST(i);
+            if (block->size > stats->largest_free_size)
+                stats->largest_free_size = block->size;
+        }
+    }
+
+    if (stats->free_size > 0)
+        stats->fragmentation = 100 - (int)((long long)stats->largest_free_size
+                * 100 / stats->free_size);
+    else
+        stats->fragmentation = 0;
+}
@@ -49,11 +49,26 @@
 
 #include "list.h"
 
+/*
+ * The video memory bucket is a segregated-fit allocator: the free blocks
+ * are kept in the lists of size classes (8 classes for each power of two),
+ * and two bitmaps tell which lists are not empty. So allocating and freeing
+ * a block only take a few bit operations, and a freed block is merged with
+ * its free neighbours at once.
+ */
+#define VMBUCKET_SL_BITS    3
+#define VMBUCKET_SL_COUNT   (1 << VMBUCKET_SL_BITS)
+#define VMBUCKET_FL_COUNT   (32 - VMBUCKET_SL_BITS)
+
 typedef struct _memblock {
+    /* all blocks in the order of their offsets */
     struct list_head list;
+    /* the list of the size class if the block is free */
+    struct list_head free_list;
     int offset;
     int height; /* XXX: There is no need to know width at all */
     int pitch;
+    int size;
 #define VMBLOCK_FLAG_USED 0x01
     int flag;
 } gal_vmblock_t;
@@ -62,11 +77,32 @@ typedef struct _membucket {
     struct list_head block_head;
     unsigned char *start;
     int size;
+
+    unsigned int fl_bitmap;
+    unsigned int sl_bitmap[VMBUCKET_FL_COUNT];
+    struct list_head free_lists[VMBUCKET_FL_COUNT][VMBUCKET_SL_COUNT];
+
+    int used_size;
+    int nr_used_blocks;
+    int nr_free_blocks;
 } gal_vmbucket_t;
 
+typedef struct _membucket_stats {
+    int total_size;
+    int used_size;
+    int free_size;
+    int largest_free_size;
+    int nr_used_blocks;
+    int nr_free_blocks;
+    /* the percentage of the free memory not in the largest free block */
+    int fragmentation;
+} gal_vmbucket_stats_t;
+
 int gal_vmbucket_init(gal_vmbucket_t *bucket, unsigned char *start, int size);
 void gal_vmbucket_destroy(gal_vmbucket_t *bucket);
 gal_vmblock_t *gal_vmbucket_alloc(gal_vmbucket_t *bucket, int pitch, int height);
 void gal_vmbucket_free(gal_vmbucket_t *bucket, gal_vmblock_t *block);
+void gal_vmbucket_get_stats(const gal_vmbucket_t *bucket,
+        gal_vmbucket_stats_t *stats);
 
 #endif
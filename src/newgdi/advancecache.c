@@ -0,0 +1,325 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+//                          IMPORTANT NOTICE
+//
+// The following open source license statement does not apply to any
+// entity in the Exception List published by FMSoft.
+//
+// For more information, please visit:
+//
+// https://www.fmsoft.cn/exception-list
+//
+//////////////////////////////////////////////////////////////////////////////
+/*
+ *   This file is part of MiniGUI, a mature cross-platform windowing
+ *   and Graphics User Interface (GUI) support system for embedded systems
+ *   and smart IoT devices.
+ *
+ *   Copyright (C) 2002~2020, Beijing FMSoft Technologies Co., Ltd.
+ *   Copyright (C) 1998~2002, WEI Yongming
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *   Or,
+ *
+ *   As this program is a library, any link to this program must follow
+ *   GNU General Public License version 3 (GPLv3). If you cannot accept
+ *   GPLv3, you need to be licensed from FMSoft.
+ *
+ *   If you have got a commercial license of this program, please use it
+ *   under the terms and conditions of the commercial license.
+ *
+ *   For more information about the commercial license, please refer to
+ *   <http://www.minigui.com/blog/minigui-licensing-policy/>.
+ */
+/*
+** advancecache.c: The tables of glyph advances of logical fonts.
+**
+** Measuring a text asks the device font for the advance of every glyph,
+** which can mean loading the glyph for a TrueType font. A logical font
+** keeps the advances in a two-level table per device font instead: 256
+** pages of 256 glyphs each, covering the first 64K glyph values, filled
+** lazily. A page is allocated when a glyph in it is measured first, so
+** an ASCII or a CJK text only costs a few pages.
+**
+** The advances depend on the logical font only: the character extra of
+** the DC and the direction are applied by the caller. Kerning is not
+** applied by any text measurement function, so no pairs are kept.
+**
+** The tables are kept aside, keyed by the address of the logical font,
+** so that the layout of LOGFONT does not change. Only the logical fonts
+** created by MiniGUI are registered, since DestroyLogFont() frees their
+** tables; a LOGFONT copied by an app is measured without the tables.
+**
+** A logical font can be shared by several threads. In MiniGUI-Threads,
+** only the writers are serialized: a table, a page or an entry is filled
+** before it is published, and is kept until the logical font is
+** destroyed, so a lookup reads them without the lock. For the same
+** reason, the node of a destroyed logical font stays in its bucket and
+** is reused by a new logical font, instead of being freed under a reader.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "common.h"
+
+#ifdef _MGFONT_ADVANCE_CACHE
+
+#include "minigui.h"
+#include "gdi.h"
+#include "devfont.h"
+#include "glyph.h"
+
+#define ADV_PAGE_SHIFT      8
+#define ADV_PAGE_SIZE       (1 << ADV_PAGE_SHIFT)
+#define ADV_NR_PAGES        256
+#define ADV_MAX_GLYPH       (ADV_PAGE_SIZE * ADV_NR_PAGES)
+
+typedef struct _ADVANCETABLE {
+    const DEVFONT* devfont;
+    int extra;          /* the width added for bold and grey/outline */
+    GLYPHADVANCE* pages[ADV_NR_PAGES];
+} ADVANCETABLE;
+
+typedef struct _ADVANCECACHE {
+    struct _ADVANCECACHE* next;
+    const LOGFONT* logfont;
+    ADVANCETABLE* tables[MAXNR_DEVFONTS];
+} ADVANCECACHE;
+
+#define ADV_NR_BUCKETS      64
+
+static ADVANCECACHE* caches[ADV_NR_BUCKETS];
+
+#ifdef _MGRM_THREADS
+static pthread_mutex_t cache_lock = PTHREAD_MUTEX_INITIALIZER;
+#   define LOCK_CACHE()     pthread_mutex_lock (&cache_lock)
+#   define UNLOCK_CACHE()   pthread_mutex_unlock (&cache_lock)
+#else
+#   define LOCK_CACHE()
+#   define UNLOCK_CACHE()
+#endif
+
+#if defined(_MGRM_THREADS) && defined(__GNUC__)
+#   define LOAD_ACQUIRE(v)          __atomic_load_n (&(v), __ATOMIC_ACQUIRE)
+#   define STORE_RELEASE(v, val)    __atomic_store_n (&(v), (val), __ATOMIC_RELEASE)
+#   define LOCK_LOOKUP()
+#   define UNLOCK_LOOKUP()
+#else
+#   define LOAD_ACQUIRE(v)          (v)
+#   define STORE_RELEASE(v, val)    ((v) = (val))
+#   define LOCK_LOOKUP()            LOCK_CACHE ()
+#   define UNLOCK_LOOKUP()          UNLOCK_CACHE ()
+#endif
+
+static inline int hash_logfont (const LOGFONT* logfont)
+{
+    return (int)(((size_t)logfont >> 4) & (ADV_NR_BUCKETS - 1));
+}
+
+/* The next link of a node never changes after the node is published. */
+static ADVANCECACHE* find_cache (const LOGFONT* logfont)
+{
+    ADVANCECACHE* cache = LOAD_ACQUIRE (caches[hash_logfont (logfont)]);
+
+    while (cache && LOAD_ACQUIRE (cache->logfont) != logfont)
+        cache = cache->next;
+
+    return cache;
+}
+
+/* Same rules as _font_get_glyph_advance. */
+static ADVANCETABLE* new_table (LOGFONT* logfont, DEVFONT* devfont)
+{
+    ADVANCETABLE* table;
+    int glyph_bmptype;
+    int bold = 0, grey = 0;
+
+    if ((table = calloc (1, sizeof (ADVANCETABLE))) == NULL)
+        return NULL;
+
+    glyph_bmptype = devfont->font_ops->get_glyph_bmptype (logfont, devfont)
+            & DEVFONTGLYPHTYPE_MASK_BMPTYPE;
+
+    if (((int)(logfont->style & FS_WEIGHT_MASK) -
+            (int)(devfont->style & FS_WEIGHT_MASK)) > FS_WEIGHT_AUTOBOLD
+            && (glyph_bmptype == DEVFONTGLYPHTYPE_MONOBMP)) {
+        bold = GET_DEVFONT_SCALE (logfont, devfont);
+    }
+
+    if (glyph_bmptype == DEVFONTGLYPHTYPE_MONOBMP) {
+        if ((logfont->style & FS_RENDER_MASK) == FS_RENDER_GREY ||
+                (logfont->style & FS_DECORATE_OUTLINE)) {
+            grey = 1;
+        }
+    }
+
+    table->devfont = devfont;
+    table->extra = bold + grey;
+    return table;
+}
+
+/* Returns the entry if it is filled already. */
+static const GLYPHADVANCE* lookup_advance (ADVANCECACHE* cache,
+        int slot, Glyph32 gv)
+{
+    ADVANCETABLE* table;
+    GLYPHADVANCE* page;
+    GLYPHADVANCE* adv;
+
+    if ((table = LOAD_ACQUIRE (cache->tables[slot])) == NULL)
+        return NULL;
+
+    if ((page = LOAD_ACQUIRE (table->pages[gv >> ADV_PAGE_SHIFT])) == NULL)
+        return NULL;
+
+    adv = page + (gv & (ADV_PAGE_SIZE - 1));
+    return LOAD_ACQUIRE (adv->valid) ? adv : NULL;
+}
+
+/* Call this with the lock held. */
+static const GLYPHADVANCE* fill_advance (ADVANCECACHE* cache,
+        LOGFONT* logfont, DEVFONT* devfont, int slot, Glyph32 gv)
+{
+    ADVANCETABLE* table;
+    GLYPHADVANCE* page;
+    GLYPHADVANCE* adv;
+    int len, x = 0, y = 0;
+
+    table = cache->tables[slot];
+    if (table == NULL) {
+        if ((table = new_table (logfont, devfont)) == NULL)
+            return NULL;
+        STORE_RELEASE (cache->tables[slot], table);
+    }
+
+    page = table->pages[gv >> ADV_PAGE_SHIFT];
+    if (page == NULL) {
+        if ((page = calloc (ADV_PAGE_SIZE, sizeof (GLYPHADVANCE))) == NULL)
+            return NULL;
+        STORE_RELEASE (table->pages[gv >> ADV_PAGE_SHIFT], page);
+    }
+
+    /* filled by another thread before we got the lock */
+    adv = page + (gv & (ADV_PAGE_SIZE - 1));
+    if (adv->valid)
+        return adv;
+
+    len = devfont->font_ops->get_glyph_advance (logfont, devfont, gv, &x, &y);
+    /* do not keep failures or values out of range */
+    if (len < 0 || table->extra > 0xFF || len > 0x7FFF - table->extra ||
+            x < -0x8000 || x > 0x7FFF || y < -0x8000 || y > 0x7FFF)
+        return NULL;
+
+    adv->advance = (Sint16)(len + table->extra);
+    adv->adv_x = (Sint16)x;
+    adv->adv_y = (Sint16)y;
+    adv->extra_x = (Uint8)table->extra;
+    STORE_RELEASE (adv->valid, 1);
+    return adv;
+}
+
+const GLYPHADVANCE* __mg_advance_cache_get (LOGFONT* logfont,
+        DEVFONT* devfont, Glyph32 gv)
+{
+    const GLYPHADVANCE* adv = NULL;
+    ADVANCECACHE* cache;
+    int slot;
+
+    if (gv >= ADV_MAX_GLYPH)
+        return NULL;
+
+    for (slot = 0; slot < MAXNR_DEVFONTS; slot++) {
+        if (logfont->devfonts[slot] == devfont)
+            break;
+    }
+
+    /* not a devfont of this logfont, e.g. a fallback of UPF or QPF */
+    if (slot == MAXNR_DEVFONTS)
+        return NULL;
+
+    LOCK_LOOKUP ();
+    if ((cache = find_cache (logfont)) &&
+            (adv = lookup_advance (cache, slot, gv)) == NULL) {
+        LOCK_CACHE ();
+        adv = fill_advance (cache, logfont, devfont, slot, gv);
+        UNLOCK_CACHE ();
+    }
+    UNLOCK_LOOKUP ();
+
+    return adv;
+}
+
+void __mg_advance_cache_new (const LOGFONT* logfont)
+{
+    ADVANCECACHE* cache;
+    int bucket = hash_logfont (logfont);
+
+    LOCK_CACHE ();
+    /* reuse the node of a destroyed logfont */
+    for (cache = caches[bucket]; cache; cache = cache->next) {
+        if (cache->logfont == NULL) {
+            STORE_RELEASE (cache->logfont, logfont);
+            goto done;
+        }
+    }
+
+    /* the logfont is measured without the tables if this fails */
+    if ((cache = calloc (1, sizeof (ADVANCECACHE))) == NULL)
+        goto done;
+
+    cache->logfont = logfont;
+    cache->next = caches[bucket];
+    STORE_RELEASE (caches[bucket], cache);
+
+done:
+    UNLOCK_CACHE ();
+}
+
+void __mg_advance_cache_free (const LOGFONT* logfont)
+{
+    ADVANCETABLE* tables[MAXNR_DEVFONTS];
+    ADVANCECACHE* cache;
+    int i, j;
+
+    LOCK_CACHE ();
+    cache = caches[hash_logfont (logfont)];
+    while (cache && cache->logfont != logfont)
+        cache = cache->next;
+    if (cache) {
+        /* the node is kept in the bucket; see the note at the top */
+        memcpy (tables, cache->tables, sizeof (tables));
+        memset (cache->tables, 0, sizeof (cache->tables));
+        STORE_RELEASE (cache->logfont, NULL);
+    }
+    UNLOCK_CACHE ();
+
+    if (cache == NULL)
+        return;
+
+    for (i = 0; i < MAXNR_DEVFONTS; i++) {
+        ADVANCETABLE* table = tables[i];
+
+        if (table == NULL)
+            continue;
+
+        for (j = 0; j < ADV_NR_PAGES; j++)
+            free (table->pages[j]);
+        free (table);
+    }
+}
+
+#endif /* _MGFONT_ADVANCE_CACHE */
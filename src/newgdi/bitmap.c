@@ -94,13 +94,8 @@ void _dc_fillbox_clip (PDC pdc, const GAL_Rect* rect)
 
     cliprect = pdc->ecrgn.head;
     if (pdc->rop == ROP_SET) {
-        while (cliprect) {
-            if (IntersectRect (&eff_rc, &pdc->rc_output, &cliprect->rc)) {
-                SET_GAL_CLIPRECT (pdc, eff_rc);
-                GAL_FillRect (pdc->surface, rect, pdc->cur_pixel);
-            }
-            cliprect = cliprect->next;
-        }
+        GAL_FillRectRgn (pdc->surface, rect, pdc->cur_pixel,
+                &pdc->ecrgn, &pdc->rc_output);
     }
     else {
         pdc->step = 1;
@@ -150,14 +145,7 @@ void _dc_fillbox_bmp_clip (PDC pdc, const GAL_Rect* rect, BITMAP* bmp)
 
     cliprect = pdc->ecrgn.head;
     if (pdc->rop == ROP_SET) {
-        while (cliprect) {
-            if (IntersectRect (&eff_rc, &pdc->rc_output, &cliprect->rc)) {
-                SET_GAL_CLIPRECT (pdc, eff_rc);
-                GAL_PutBox (pdc->surface, rect, bmp);
-            }
-
-            cliprect = cliprect->next;
-        }
+        GAL_PutBoxRgn (pdc->surface, rect, bmp, &pdc->ecrgn, &pdc->rc_output);
     }
     else {
         BYTE* row;
@@ -302,16 +290,9 @@ static void _line_scaled_fillbox (void* context, const void* line, int y)
             tmp_bmp.bmAlphaPitch = 0;
         }
 
-        cliprect = info->pdc->cur_ban;
-        top = cliprect->rc.top;
-        while (cliprect && cliprect->rc.top == top) {
-            if (IntersectRect (&eff_rc, &rc_output, &cliprect->rc)) {
-                SET_GAL_CLIPRECT (info->pdc, eff_rc);
-                GAL_PutBox (info->pdc->surface, &rect, &tmp_bmp);
-            }
-
-            cliprect = cliprect->next;
-        }
+        /* rc_output is a scan line, so only this ban is walked */
+        GAL_PutBoxRects (info->pdc->surface, &rect, &tmp_bmp,
+                info->pdc->cur_ban, &rc_output);
     }
     else {
         rc_output.left = info->dst_rc.left;
@@ -929,16 +910,9 @@ static void _line_scaled_fillboxpart (void* context, const void* line, int y)
             tmp_bmp.bmAlphaPitch = 0;
         }
 
-        cliprect = info->pdc->cur_ban;
-        top = cliprect->rc.top;
-        while (cliprect && cliprect->rc.top == top) {
-            if (IntersectRect (&eff_rc, &rc_output, &cliprect->rc)) {
-                SET_GAL_CLIPRECT (info->pdc, eff_rc);
-                GAL_PutBox (info->pdc->surface, &rect, &tmp_bmp);
-            }
-
-            cliprect = cliprect->next;
-        }
+        /* rc_output is a scan line, so only this ban is walked */
+        GAL_PutBoxRects (info->pdc->surface, &rect, &tmp_bmp,
+                info->pdc->cur_ban, &rc_output);
     }
     else {
         rc_output.left = info->dst_x;
@@ -1100,11 +1074,9 @@ BOOL GUIAPI FillBitmapPartInBox (HDC hdc, int box_x, int box_y, int box_w, int b
 void GUIAPI BitBlt (HDC hsdc, int sx, int sy, int sw, int sh,
         HDC hddc, int dx, int dy, DWORD dwRop)
 {
-    PCLIPRECT cliprect;
     PDC psdc, pddc;
     RECT srcOutput, dstOutput;
-    GAL_Rect dst, src;
-    RECT eff_rc;
+    GAL_Rect src;
 
     psdc = dc_HDC2PDC (hsdc);
     if (!(pddc = __mg_check_ecrgn (hddc)))
@@ -1150,136 +1122,12 @@ void GUIAPI BitBlt (HDC hsdc, int sx, int sy, int sw, int sh,
     }
 
     /*
-     * The CLIPRECT's RECT order is: rc1 rc2 rc3 rc4 rc5 rc6
-     *
-     * In same TOP   rc1 -> rc2 -> rc3..  -->
-     *      ( rc1.left > rc2.left > rc3.left .. rc1.top == rc2.top == rc3.top ...)
-     * In same TOP   rc4 -> rc5 -> rc6 .. -->
-     *      ( rc4.left > rc5.left ...  rc4.top==rc5.top ...  rc1.top < rc4.top < rc6.top ... )
-     * ....
-     *
-     * if surface is same, and dy > sy, should
-     *      if dx > sx, should copy every rect like order: rc6 rc5 rc4, rc3 ... rc1
-     *      else like: rc4 rc5 rc6, rc1 rc2 rc3 ...
-     *
-     * if dy <= sy, should
-     *      if dx > sx, should rc3 rc2 rc1 ..., rc6 rc5 rc4 ...
-     *      else should     rc1 rc2 rc3 ..., rc4 rc5 rc6 ...
-     *
+     * GAL_RegionBlit walks the clipping rectangles in a safe order
+     * for the overlapped blits on the same surface.
      */
-    if (pddc->surface == psdc->surface) {
-        if (dy > sy) {
-            cliprect = pddc->ecrgn.tail;
-            if (dx > sx) {
-                while (cliprect) {
-                    if (IntersectRect (&eff_rc, &pddc->rc_output, &cliprect->rc)) {
-                        SET_GAL_CLIPRECT (pddc, eff_rc);
-
-                        src.x = sx; src.y = sy; src.w = sw; src.h = sh;
-                        dst.x = dx; dst.y = dy; dst.w = sw; dst.h = sh;
-                        GAL_BlitSurface (psdc->surface, &src, pddc->surface, &dst);
-                    }
-                    cliprect = cliprect->prev;
-                }
-            }
-            else {
-                int ban_top;
-                PCLIPRECT ban_first = NULL, ban_saved;
-
-                while (cliprect) {
-                    /* to find the first clipping rect of the current ban. */
-                    ban_top = cliprect->rc.top;
-                    ban_first = cliprect;
-                    while (ban_first && ban_top == ban_first->rc.top) {
-                        ban_saved = ban_first;
-                        ban_first = ban_first->prev;
-                    }
-                    /* ban_first is the last clipping rect of the previous ban */
-                    if (ban_first) {
-                        cliprect = ban_first;
-                        ban_first = ban_first->next;
-                    }
-                    else {
-                        ban_first = ban_saved;
-                        cliprect = NULL;
-                    }
-
-                    while (ban_first && ban_top == ban_first->rc.top) {
-                        if (IntersectRect (&eff_rc, &pddc->rc_output, &ban_first->rc)) {
-                            SET_GAL_CLIPRECT (pddc, eff_rc);
-
-                            src.x = sx; src.y = sy; src.w = sw; src.h = sh;
-                            dst.x = dx; dst.y = dy; dst.w = sw; dst.h = sh;
-                            GAL_BlitSurface (psdc->surface, &src, pddc->surface, &dst);
-                        }
-                        ban_first = ban_first->next;
-                    }
-                }
-            }
-        }
-        else {
-            cliprect = pddc->ecrgn.head;
-            if (dx > sx) {
-                int ban_top;
-                PCLIPRECT ban_last = NULL, ban_saved;
-
-                while (cliprect) {
-                    /* to find the last clipping rect of the current ban. */
-                    ban_top = cliprect->rc.top;
-                    ban_last = cliprect;
-                    while (ban_last && ban_top == ban_last->rc.top) {
-                        ban_saved = ban_last;
-                        ban_last = ban_last->next;
-                    }
-                    /* ban_last is the first clipping rect of the next ban */
-                    if (ban_last) {
-                        cliprect = ban_last;
-                        ban_last = ban_last->prev;
-                    }
-                    else {
-                        ban_last = ban_saved;
-                        cliprect = NULL;
-                    }
-
-                    while (ban_last && ban_top == ban_last->rc.top) {
-                        if (IntersectRect (&eff_rc, &pddc->rc_output, &ban_last->rc)) {
-                            SET_GAL_CLIPRECT (pddc, eff_rc);
-
-                            src.x = sx; src.y = sy; src.w = sw; src.h = sh;
-                            dst.x = dx; dst.y = dy; dst.w = sw; dst.h = sh;
-                            GAL_BlitSurface (psdc->surface, &src, pddc->surface, &dst);
-                        }
-                        ban_last = ban_last->prev;
-                    }
-                }
-            }
-            else {
-                while (cliprect) {
-                    if (IntersectRect (&eff_rc, &pddc->rc_output, &cliprect->rc)) {
-                        SET_GAL_CLIPRECT (pddc, eff_rc);
-
-                        src.x = sx; src.y = sy; src.w = sw; src.h = sh;
-                        dst.x = dx; dst.y = dy; dst.w = sw; dst.h = sh;
-                        GAL_BlitSurface (psdc->surface, &src, pddc->surface, &dst);
-                    }
-                    cliprect = cliprect->next;
-                }
-            }
-        }
-    }
-    else {
-        cliprect = pddc->ecrgn.head;
-        while (cliprect) {
-            if (IntersectRect (&eff_rc, &pddc->rc_output, &cliprect->rc)) {
-                SET_GAL_CLIPRECT (pddc, eff_rc);
-
-                src.x = sx; src.y = sy; src.w = sw; src.h = sh;
-                dst.x = dx; dst.y = dy; dst.w = sw; dst.h = sh;
-                GAL_BlitSurface (psdc->surface, &src, pddc->surface, &dst);
-            }
-            cliprect = cliprect->next;
-        }
-    }
+    src.x = sx; src.y = sy; src.w = sw; src.h = sh;
+    GAL_RegionBlit (psdc->surface, &src, pddc->surface, dx, dy,
+            &pddc->ecrgn, &pddc->rc_output);
 
     if (pddc->surface != psdc->surface && IS_SCREEN_SURFACE(psdc))
         kernel_ShowCursorForGDI (TRUE, psdc);
@@ -1800,6 +1648,60 @@ static inline void get_linear_pt(BYTE *dst, int dst_off, BYTE *src, int sx, int
     return;
 }
 
+struct _FILTERED_SCALER_INFO
+{
+    void* context;
+    CB_GET_LINE_BUFF cb_line_buff;
+    CB_LINE_SCALED cb_line_scaled;
+};
+
+static Uint8* _get_row_filtered_scaler (void* context, int y)
+{
+    struct _FILTERED_SCALER_INFO* info =
+            (struct _FILTERED_SCALER_INFO*) context;
+    void* alpha_line_mask = NULL;
+
+    return info->cb_line_buff (info->context, y, &alpha_line_mask);
+}
+
+static void _put_row_filtered_scaler (void* context, Uint8* row, int y)
+{
+    struct _FILTERED_SCALER_INFO* info =
+            (struct _FILTERED_SCALER_INFO*) context;
+
+    info->cb_line_scaled (info->context, row, y);
+}
+
+/*
+ * Scale the bitmap with the filters of NEWGAL. Returns FALSE if the
+ * bitmap can not be filtered: the pixel format is not supported, or
+ * it has a color key or a separate alpha mask.
+ */
+static BOOL filtered_scaler (void* context, const BITMAP* src_bmp,
+        int dst_w, int dst_h, CB_GET_LINE_BUFF cb_line_buff,
+        CB_LINE_SCALED cb_line_scaled, GAL_PixelFormat *format, int filter)
+{
+    struct _FILTERED_SCALER_INFO info;
+
+    if (!format) {
+        PDC pdc = dc_HDC2PDC (HDC_SCREEN_SYS);
+        format = pdc->surface->format;
+    }
+
+    if ((src_bmp->bmType & (BMP_TYPE_COLORKEY | BMP_TYPE_ALPHA_MASK)) ||
+            src_bmp->bmBytesPerPixel != format->BytesPerPixel ||
+            !GAL_CanStretchFiltered (format))
+        return FALSE;
+
+    info.context = context;
+    info.cb_line_buff = cb_line_buff;
+    info.cb_line_scaled = cb_line_scaled;
+    return GAL_StretchFiltered (src_bmp->bmBits, src_bmp->bmPitch,
+            src_bmp->bmWidth, src_bmp->bmHeight, format, dst_w, dst_h,
+            filter, &info, _get_row_filtered_scaler,
+            _put_row_filtered_scaler) == 0;
+}
+
 BOOL BitmapBilinerScaler(
     void* context,
     const BITMAP* src_bmp,
@@ -1808,7 +1710,7 @@ BOOL BitmapBilinerScaler(
     CB_LINE_SCALED cb_line_scaled,
     GAL_PixelFormat *format)
 {
-    BYTE *dp1 = src_bmp->bmBits;
+    BYTE *dp1;
     BYTE *dp2;
     int xfactor;
     int yfactor;
@@ -1818,6 +1720,12 @@ BOOL BitmapBilinerScaler(
     if (dst_w <= 0 || dst_h <= 0 || src_bmp == NULL)
         return FALSE;
 
+    if (filtered_scaler (context, src_bmp, dst_w, dst_h,
+                cb_line_buff, cb_line_scaled, format, GAL_STRETCH_BILINEAR))
+        return TRUE;
+
+    dp1 = src_bmp->bmBits;
+
     xfactor = muldiv64 (src_bmp->bmWidth, 65536, dst_w);    /* scaled by 65536 */
     yfactor = muldiv64 (src_bmp->bmHeight, 65536, dst_h);   /* scaled by 65536 */
 
@@ -1840,6 +1748,26 @@ BOOL BitmapBilinerScaler(
     return TRUE;
 }
 
+/*
+ * The box (area-average) filter, which is good for shrinking; falls back
+ * to the DDA scaler if the bitmap can not be filtered.
+ */
+BOOL BitmapAreaScaler (void* context, const BITMAP* src_bmp,
+        int dst_w, int dst_h,
+        CB_GET_LINE_BUFF cb_line_buff, CB_LINE_SCALED cb_line_scaled,
+        GAL_PixelFormat *format)
+{
+    if (dst_w <= 0 || dst_h <= 0 || src_bmp == NULL)
+        return FALSE;
+
+    if (filtered_scaler (context, src_bmp, dst_w, dst_h,
+                cb_line_buff, cb_line_scaled, format, GAL_STRETCH_AREA))
+        return TRUE;
+
+    return BitmapDDAScalerEx (context, src_bmp, dst_w, dst_h,
+            cb_line_buff, cb_line_scaled, format);
+}
+
 /**
  * \fn BOOL GUIAPI BitmapDDAScalerEx (void* context, \
                 const BITMAP* src_bmp, int dst_w, int dst_h, \
@@ -2356,6 +2284,8 @@ int GUIAPI SetBitmapScalerType (HDC hdc,  int scaler_type)
     PDC pdc = dc_HDC2PDC(hdc);
     if ( scaler_type == BITMAP_SCALER_BILINEAR )
         pdc->bitmap_scaler = BitmapBilinerScaler;
+    else if ( scaler_type == BITMAP_SCALER_AREA )
+        pdc->bitmap_scaler = BitmapAreaScaler;
     else
         pdc->bitmap_scaler = BitmapDDAScalerEx;
 
@@ -2756,6 +2686,11 @@ void GUIAPI CompileRGBABitmap (HDC hdc, BYTE* bits, Uint32 pitch,
             if (flags & MYBMP_RGBSIZE_4) {
                 if (flags & MYBMP_ALPHA) {
                     rgb.a = *src;
+                    if (pdc->surface->flags & GAL_PREMULALPHA) {
+                        rgb.r = GAL_PremulComponent (rgb.r, rgb.a);
+                        rgb.g = GAL_PremulComponent (rgb.g, rgb.a);
+                        rgb.b = GAL_PremulComponent (rgb.b, rgb.a);
+                    }
                     pixel = GAL_MapRGBA (pdc->surface->format,
                                     rgb.r, rgb.g, rgb.b, rgb.a);
                 }
@@ -2833,6 +2768,11 @@ void GUIAPI CompileRGBABitmapEx (HDC hdc, BYTE* bits, Uint32 pitch,
                         pixel = GAL_MapRGB(pdc->surface->format,
                                 rgb.r, rgb.g, rgb.b);
                     } else {
+                        if (pdc->surface->flags & GAL_PREMULALPHA) {
+                            rgb.r = GAL_PremulComponent (rgb.r, rgb.a);
+                            rgb.g = GAL_PremulComponent (rgb.g, rgb.a);
+                            rgb.b = GAL_PremulComponent (rgb.b, rgb.a);
+                        }
                         pixel = GAL_MapRGBA (pdc->surface->format,
                                 rgb.r, rgb.g, rgb.b, rgb.a);
                     }
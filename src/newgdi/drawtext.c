@@ -111,14 +111,84 @@ static inline BOOL is_utf16_logfont (PDC pdc)
 
 #endif
 
+#ifdef _MGFONT_DRAWTEXT_CACHE
+static void free_layout (DRAWTEXTEX2_CTXT* ctxt)
+{
+    if (ctxt->layout) {
+        free (ctxt->layout->lines);
+        free (ctxt->layout->glyphs);
+        ctxt->layout = NULL;
+    }
+}
+
+/* Stops recording if there is no memory. */
+static void record_line (DRAWTEXTEX2_CTXT* ctxt, int index, int line_x,
+                int advance)
+{
+    DTLAYOUT* layout = ctxt->layout;
+    DTLINE* line;
+
+    if (layout == NULL)
+        return;
+
+    if (layout->nr_lines >= layout->max_lines) {
+        int max = layout->max_lines ? layout->max_lines * 2 : 8;
+
+        line = realloc (layout->lines, sizeof (DTLINE) * max);
+        if (line == NULL) {
+            free_layout (ctxt);
+            return;
+        }
+        layout->lines = line;
+        layout->max_lines = max;
+    }
+
+    line = layout->lines + layout->nr_lines++;
+    line->index = index;
+    line->line_x = line_x;
+    line->advance = advance;
+    line->first_glyph = layout->nr_glyphs;
+    line->nr_glyphs = 0;
+}
+
+static void record_glyph (DRAWTEXTEX2_CTXT* ctxt, Glyph32 glyph_value,
+                unsigned int char_type)
+{
+    DTLAYOUT* layout = ctxt->layout;
+    DTGLYPH* glyph;
+
+    if (layout->nr_glyphs >= layout->max_glyphs) {
+        int max = layout->max_glyphs ? layout->max_glyphs * 2 : 64;
+
+        glyph = realloc (layout->glyphs, sizeof (DTGLYPH) * max);
+        if (glyph == NULL) {
+            free_layout (ctxt);
+            return;
+        }
+        layout->glyphs = glyph;
+        layout->max_glyphs = max;
+    }
+
+    glyph = layout->glyphs + layout->nr_glyphs++;
+    glyph->glyph_value = glyph_value;
+    glyph->char_type = char_type;
+    layout->lines [layout->nr_lines - 1].nr_glyphs++;
+}
+#endif /* _MGFONT_DRAWTEXT_CACHE */
+
 static BOOL cb_drawtextex2 (void* context, Glyph32 glyph_value,
                 unsigned int char_type)
 {
     DRAWTEXTEX2_CTXT* ctxt = (DRAWTEXTEX2_CTXT*)context;
     int adv_x = 0, adv_y = 0;
-    BBOX bbox;
     int bkmode;
 
+#ifdef _MGFONT_DRAWTEXT_CACHE
+    /* the contexts only for the extent do not have the layout field */
+    if (!ctxt->only_extent && ctxt->layout)
+        record_glyph (ctxt, glyph_value, char_type);
+#endif
+
     switch (char_type & ACHARTYPE_BASIC_MASK) {
         case ACHAR_BASIC_ZEROWIDTH:
         case ACHAR_BASIC_CR:
@@ -160,7 +230,7 @@ static BOOL cb_drawtextex2 (void* context, Glyph32 glyph_value,
                 ctxt->advance += _gdi_get_glyph_advance (ctxt->pdc,
                     glyph_value,
                     (ctxt->pdc->ta_flags & TA_X_MASK) != TA_RIGHT,
-                    ctxt->x, ctxt->y, &adv_x, &adv_y, &bbox);
+                    ctxt->x, ctxt->y, &adv_x, &adv_y, NULL);
             }
             else {
                 ctxt->advance += _gdi_draw_one_glyph (ctxt->pdc, glyph_value,
@@ -189,6 +259,9 @@ int _gdi_get_drawtext_extent (PDC pdc, const unsigned char* text, int len,
     ctxt.only_extent = TRUE;
     ctxt.nFormat = _tmp->nFormat;
     ctxt.tab_width = _tmp->tab_width;
+#ifdef _MGFONT_DRAWTEXT_CACHE
+    ctxt.layout = NULL;
+#endif
 
     _gdi_start_new_line (pdc);
     _gdi_reorder_text (pdc, text, len,
@@ -202,6 +275,34 @@ int _gdi_get_drawtext_extent (PDC pdc, const unsigned char* text, int len,
     return ctxt.advance;
 }
 
+#ifdef _MGFONT_DRAWTEXT_CACHE
+/* Draws the glyphs of a cached layout as DrawTextEx2 does. */
+static void draw_cached_layout (DRAWTEXTEX2_CTXT* ctxt,
+                const DTLAYOUT* layout, const RECT* rcDraw)
+{
+    PDC pdc = ctxt->pdc;
+    int i, j;
+
+    for (i = 0; i < layout->nr_lines; i++) {
+        const DTLINE* line = layout->lines + i;
+        const DTGLYPH* glyph = layout->glyphs + line->first_glyph;
+
+        ctxt->x = ctxt->start_x + line->line_x;
+        ctxt->y = ctxt->start_y + line->index * ctxt->line_height;
+        ctxt->advance = 0;
+        _gdi_start_new_line (pdc);
+        _gdi_get_baseline_point (pdc, &ctxt->x, &ctxt->y);
+
+        if (ctxt->nFormat & DT_CENTER)
+            ctxt->x = rcDraw->left + ((RECTWP (rcDraw) - line->advance) >> 1)
+                    + line->line_x;
+
+        for (j = 0; j < line->nr_glyphs; j++, glyph++)
+            cb_drawtextex2 (ctxt, glyph->glyph_value, glyph->char_type);
+    }
+}
+#endif /* _MGFONT_DRAWTEXT_CACHE */
+
 int DrawTextEx2 (HDC hdc, const char* pText, int nCount,
                 RECT* pRect, int indent, UINT nFormat, DTFIRSTLINE *firstline)
 {
@@ -215,6 +316,11 @@ int DrawTextEx2 (HDC hdc, const char* pText, int nCount,
     int nr_delim_newline = 0;
     const unsigned char* pline = NULL;
     int old_ta = TA_LEFT;
+    GLYPH_RUN run;
+#ifdef _MGFONT_DRAWTEXT_CACHE
+    DTLAYOUTKEY key;
+    DTLAYOUT layout;
+#endif
 
     if (pText == NULL || nCount == 0 || pRect == NULL) return -1;
     if (RECTWP(pRect) == 0 || RECTHP(pRect) == 0) return -1;
@@ -302,6 +408,36 @@ int DrawTextEx2 (HDC hdc, const char* pText, int nCount,
     ctxt.pdc = pdc;
     ctxt.x   = x;
     ctxt.y   = y;
+#ifdef _MGFONT_DRAWTEXT_CACHE
+    ctxt.layout = NULL;
+#endif
+
+    if (!ctxt.only_extent)
+        _gdi_begin_glyph_run (pdc, &run);
+
+#ifdef _MGFONT_DRAWTEXT_CACHE
+    /* a repaint with the same layout only draws the glyphs */
+    if (!ctxt.only_extent && nCount <= DTCACHE_MAX_TEXT) {
+        const DTLAYOUT* cached;
+
+        key.logfont = pdc->pLogFont;
+        key.text = pText;
+        key.len = nCount;
+        key.format = nFormat;
+        key.width = RECTW (rcDraw);
+        key.indent = indent;
+        key.tab_width = nTabWidth;
+        key.ch_extra = pdc->cExtra;
+        if ((cached = __mg_drawtext_cache_find (&key))) {
+            draw_cached_layout (&ctxt, cached, &rcDraw);
+            nLines = cached->nr_text_lines;
+            goto down;
+        }
+
+        memset (&layout, 0, sizeof (layout));
+        ctxt.layout = &layout;
+    }
+#endif
 
     while (nCount > 0) {
         int line_x, maxwidth;
@@ -361,6 +497,9 @@ int DrawTextEx2 (HDC hdc, const char* pText, int nCount,
                         (pdc->ta_flags & TA_X_MASK) != TA_RIGHT,
                         cb_drawtextex2, &ctxt);
 
+#ifdef _MGFONT_DRAWTEXT_CACHE
+                record_line (&ctxt, nLines, line_x, ctxt.advance);
+#endif
                 /* calc text start pos under DT_CENTER.*/
                 ctxt.nCount = 0;
                 x = rcDraw.left + ((RECTW (rcDraw) - ctxt.advance) >> 1);
@@ -374,6 +513,9 @@ int DrawTextEx2 (HDC hdc, const char* pText, int nCount,
                         cb_drawtextex2, &ctxt);
             }
             else {
+#ifdef _MGFONT_DRAWTEXT_CACHE
+                record_line (&ctxt, nLines, line_x, 0);
+#endif
                 _gdi_reorder_text_break (pdc, pline, line_len,
                         (pdc->ta_flags & TA_X_MASK) != TA_RIGHT,
                         cb_drawtextex2, &ctxt);
@@ -382,8 +524,14 @@ int DrawTextEx2 (HDC hdc, const char* pText, int nCount,
                         pRect->left = pRect->right - ctxt.advance;
                 }
             }
-            if(ctxt.nCount <= 0)
+            if(ctxt.nCount <= 0) {
+                if (!ctxt.only_extent)
+                    _gdi_end_glyph_run (pdc, &run);
+#ifdef _MGFONT_DRAWTEXT_CACHE
+                free_layout (&ctxt);
+#endif
                 return 0;
+            }
             if (ctxt.max_advance < ctxt.advance) {
                 ctxt.max_advance = ctxt.advance;
             }
@@ -412,6 +560,17 @@ int DrawTextEx2 (HDC hdc, const char* pText, int nCount,
     }
 
 down:
+    if (!ctxt.only_extent)
+        _gdi_end_glyph_run (pdc, &run);
+
+#ifdef _MGFONT_DRAWTEXT_CACHE
+    if (ctxt.layout) {
+        layout.nr_text_lines = nLines;
+        __mg_drawtext_cache_add (&key, &layout);
+        free_layout (&ctxt);
+    }
+#endif
+
     if (nFormat & DT_RIGHT){
         SetTextAlign(hdc, old_ta);
     }
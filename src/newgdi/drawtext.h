@@ -85,6 +85,24 @@ static inline int _gdi_get_glyph_advance (PDC pdc, Glyph32 glyph_value,
 int _gdi_draw_one_glyph (PDC pdc, Glyph32 glyph_value, BOOL direction,
             int x, int y, int* adv_x, int* adv_y);
 
+/* The glyphs of a run are composited into one coverage mask, which is
+ * drawn at the end of the run or when a glyph can not join the run. */
+#define GLYPH_RUN_INLINE_MASK   4096
+
+typedef struct _GLYPH_RUN {
+    RECT rc_clip;       /* the output rect of the run */
+    RECT rc_mask;       /* the area covered by the mask */
+    RECT rc_dirty;      /* the area covered by the glyphs */
+    int  nr_glyphs;
+    BOOL mono;          /* 1bpp mask, otherwise a coverage level per pixel */
+    size_t mask_size;
+    BYTE* mask;
+    BYTE inline_mask [GLYPH_RUN_INLINE_MASK];
+} GLYPH_RUN;
+
+BOOL _gdi_begin_glyph_run (PDC pdc, GLYPH_RUN* run);
+void _gdi_end_glyph_run (PDC pdc, GLYPH_RUN* run);
+
 int _gdi_get_null_glyph_advance (PDC pdc, int advance, BOOL direction,
         int x, int y, int* adv_x, int* adv_y);
 
@@ -122,6 +140,53 @@ int _gdi_get_drawtext_extent (PDC pdc, const unsigned char* text, int len,
 BOOL gdi_InitTextBitmapBuffer (void);
 void TermTextBitmapBuffer (void);
 
+#ifdef _MGFONT_DRAWTEXT_CACHE
+/* The layout of a text drawn by DrawTextEx2 (drawtextcache.c). */
+typedef struct _DTLINE {
+    int index;          /* the number of the lines before this one */
+    int line_x;         /* the indent of the line */
+    int advance;        /* the advance of the line, for DT_CENTER */
+    int first_glyph;
+    int nr_glyphs;
+} DTLINE;
+
+typedef struct _DTGLYPH {
+    Glyph32 glyph_value;
+    unsigned int char_type;
+} DTGLYPH;
+
+typedef struct _DTLAYOUT {
+    int nr_text_lines;  /* the number of the lines, including empty ones */
+    int nr_lines;
+    int max_lines;
+    DTLINE* lines;
+    int nr_glyphs;
+    int max_glyphs;
+    DTGLYPH* glyphs;
+} DTLAYOUT;
+
+typedef struct _DTLAYOUTKEY {
+    const LOGFONT* logfont;
+    const char* text;
+    int len;
+    UINT format;
+    int width;
+    int indent;
+    int tab_width;
+    int ch_extra;
+    DWORD hash;
+} DTLAYOUTKEY;
+
+/* the longest text to cache the layout of */
+#define DTCACHE_MAX_TEXT        4096
+
+/* Computes the hash of the key, and returns NULL if it is not cached. */
+const DTLAYOUT* __mg_drawtext_cache_find (DTLAYOUTKEY* key);
+/* Adds a copy of the layout; the key must be the one found. */
+void __mg_drawtext_cache_add (const DTLAYOUTKEY* key, const DTLAYOUT* layout);
+void __mg_drawtext_cache_term (void);
+#endif /* _MGFONT_DRAWTEXT_CACHE */
+
 typedef struct _DRAWTEXTEX2_CTXT
 {
     PDC pdc;
@@ -137,6 +202,9 @@ typedef struct _DRAWTEXTEX2_CTXT
     int nCount;
     Uint32 max_extent;
     BOOL   only_extent;
+#ifdef _MGFONT_DRAWTEXT_CACHE
+    DTLAYOUT* layout;   /* the layout being recorded, or NULL */
+#endif
 } DRAWTEXTEX2_CTXT;
 
 #ifdef __cplusplus
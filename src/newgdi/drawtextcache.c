@@ -0,0 +1,385 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+//                          IMPORTANT NOTICE
+//
+// The following open source license statement does not apply to any
+// entity in the Exception List published by FMSoft.
+//
+// For more information, please visit:
+//
+// https://www.fmsoft.cn/exception-list
+//
+//////////////////////////////////////////////////////////////////////////////
+/*
+ *   This file is part of MiniGUI, a mature cross-platform windowing
+ *   and Graphics User Interface (GUI) support system for embedded systems
+ *   and smart IoT devices.
+ *
+ *   Copyright (C) 2002~2020, Beijing FMSoft Technologies Co., Ltd.
+ *   Copyright (C) 1998~2002, WEI Yongming
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *   Or,
+ *
+ *   As this program is a library, any link to this program must follow
+ *   GNU General Public License version 3 (GPLv3). If you cannot accept
+ *   GPLv3, you need to be licensed from FMSoft.
+ *
+ *   If you have got a commercial license of this program, please use it
+ *   under the terms and conditions of the commercial license.
+ *
+ *   For more information about the commercial license, please refer to
+ *   <http://www.minigui.com/blog/minigui-licensing-policy/>.
+ */
+/*
+** drawtextcache.c: The cache of the text layouts of DrawTextEx2.
+**
+** Laying out a text for DrawTextEx2 decodes the characters, breaks the
+** words and measures them again and again to find the line breaks. The
+** result only depends on the text, the logical font, the format, the
+** width of the rectangle and a few attributes of the DC, so this cache
+** keeps the glyphs of every line laid out, and a repaint with the same
+** arguments only draws the glyphs.
+**
+** Every thread has its own small LRU cache. The caches are purged when
+** a logical font is destroyed; a lock is needed for that in
+** MiniGUI-Threads, since it can be done by another thread.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "common.h"
+
+#ifndef _MG_MINIMALGDI
+
+#include "minigui.h"
+#include "gdi.h"
+#include "window.h"
+#include "devfont.h"
+#include "cliprect.h"
+#include "gal.h"
+#include "internals.h"
+#include "dc.h"
+#include "drawtext.h"
+
+#ifdef _MGFONT_DRAWTEXT_CACHE
+
+/* the layouts kept by a thread */
+#define NR_LAYOUTS_PER_THREAD   64
+
+typedef struct _DTNODE {
+    DTLAYOUTKEY key;        /* key.text is the copy after the node */
+    DTLAYOUT layout;        /* the arrays follow the text */
+
+    struct _DTNODE* lru_prev;
+    struct _DTNODE* lru_next;
+} DTNODE;
+
+typedef struct _DTCACHE {
+    /* lru_head is the most recently used one */
+    DTNODE* lru_head;
+    DTNODE* lru_tail;
+    int nr_nodes;
+#ifdef _MGRM_THREADS
+    struct _DTCACHE* next;
+#endif
+} DTCACHE;
+
+static DRAWTEXTCACHESTATS cache_stats;
+
+#ifdef _MGRM_THREADS
+static pthread_mutex_t cache_lock = PTHREAD_MUTEX_INITIALIZER;
+#   define LOCK_CACHE()     pthread_mutex_lock (&cache_lock)
+#   define UNLOCK_CACHE()   pthread_mutex_unlock (&cache_lock)
+
+static pthread_key_t cache_key;
+static BOOL cache_key_created;
+
+/* all caches of the threads, to purge them */
+static DTCACHE* cache_list;
+#else
+#   define LOCK_CACHE()
+#   define UNLOCK_CACHE()
+
+static DTCACHE the_cache;
+#endif
+
+/* FNV-1a */
+static DWORD hash_text (const char* text, int len)
+{
+    DWORD h = 2166136261U;
+
+    while (len-- > 0) {
+        h ^= (BYTE)*text++;
+        h *= 16777619U;
+    }
+
+    return h;
+}
+
+static inline BOOL equal_keys (const DTLAYOUTKEY* a, const DTLAYOUTKEY* b)
+{
+    return a->hash == b->hash && a->logfont == b->logfont &&
+        a->len == b->len && a->format == b->format &&
+        a->width == b->width && a->indent == b->indent &&
+        a->tab_width == b->tab_width && a->ch_extra == b->ch_extra &&
+        memcmp (a->text, b->text, a->len) == 0;
+}
+
+static void lru_unlink (DTCACHE* cache, DTNODE* node)
+{
+    if (node->lru_prev)
+        node->lru_prev->lru_next = node->lru_next;
+    else
+        cache->lru_head = node->lru_next;
+
+    if (node->lru_next)
+        node->lru_next->lru_prev = node->lru_prev;
+    else
+        cache->lru_tail = node->lru_prev;
+}
+
+static void lru_push_head (DTCACHE* cache, DTNODE* node)
+{
+    node->lru_prev = NULL;
+    node->lru_next = cache->lru_head;
+    if (cache->lru_head)
+        cache->lru_head->lru_prev = node;
+    else
+        cache->lru_tail = node;
+    cache->lru_head = node;
+}
+
+static void remove_node (DTCACHE* cache, DTNODE* node)
+{
+    lru_unlink (cache, node);
+    cache->nr_nodes--;
+    cache_stats.nr_layouts--;
+    free (node);
+}
+
+static void empty_cache (DTCACHE* cache)
+{
+    while (cache->lru_head)
+        remove_node (cache, cache->lru_head);
+}
+
+#ifdef _MGRM_THREADS
+/* called at the exit of a thread */
+static void destroy_cache (void* data)
+{
+    DTCACHE* cache = (DTCACHE*)data;
+    DTCACHE** pp;
+
+    LOCK_CACHE ();
+    for (pp = &cache_list; *pp; pp = &(*pp)->next) {
+        if (*pp == cache) {
+            *pp = cache->next;
+            break;
+        }
+    }
+
+    empty_cache (cache);
+    UNLOCK_CACHE ();
+    free (cache);
+}
+
+/* called with the lock held */
+static DTCACHE* get_cache (void)
+{
+    DTCACHE* cache;
+
+    if (!cache_key_created) {
+        if (pthread_key_create (&cache_key, destroy_cache))
+            return NULL;
+        cache_key_created = TRUE;
+    }
+
+    if ((cache = pthread_getspecific (cache_key)) == NULL) {
+        if ((cache = calloc (1, sizeof (DTCACHE))) == NULL)
+            return NULL;
+
+        if (pthread_setspecific (cache_key, cache)) {
+            free (cache);
+            return NULL;
+        }
+
+        cache->next = cache_list;
+        cache_list = cache;
+    }
+
+    return cache;
+}
+#else
+static inline DTCACHE* get_cache (void)
+{
+    return &the_cache;
+}
+#endif
+
+const DTLAYOUT* __mg_drawtext_cache_find (DTLAYOUTKEY* key)
+{
+    DTCACHE* cache;
+    DTNODE* node = NULL;
+
+    key->hash = hash_text (key->text, key->len);
+
+    LOCK_CACHE ();
+    if ((cache = get_cache ()) == NULL)
+        goto done;
+
+    for (node = cache->lru_head; node; node = node->lru_next) {
+        if (equal_keys (&node->key, key)) {
+            if (node != cache->lru_head) {
+                lru_unlink (cache, node);
+                lru_push_head (cache, node);
+            }
+            break;
+        }
+    }
+
+done:
+    if (node)
+        cache_stats.nr_hits++;
+    else
+        cache_stats.nr_misses++;
+    UNLOCK_CACHE ();
+
+    /* only this thread evicts the node, so it stays after unlocking */
+    return node ? &node->layout : NULL;
+}
+
+void __mg_drawtext_cache_add (const DTLAYOUTKEY* key, const DTLAYOUT* layout)
+{
+    DTCACHE* cache;
+    DTNODE* node;
+    size_t lines_size, glyphs_size;
+    char* p;
+
+    lines_size = sizeof (DTLINE) * layout->nr_lines;
+    glyphs_size = sizeof (DTGLYPH) * layout->nr_glyphs;
+
+    /* the arrays are aligned after the text */
+    node = malloc (sizeof (DTNODE) + ((key->len + 7) & ~7) +
+            lines_size + glyphs_size);
+    if (node == NULL)
+        return;
+
+    p = (char*)(node + 1);
+    memcpy (p, key->text, key->len);
+    node->key = *key;
+    node->key.text = p;
+    p += (key->len + 7) & ~7;
+
+    node->layout = *layout;
+    node->layout.lines = (DTLINE*)p;
+    memcpy (p, layout->lines, lines_size);
+    p += lines_size;
+    node->layout.glyphs = (DTGLYPH*)p;
+    memcpy (p, layout->glyphs, glyphs_size);
+
+    LOCK_CACHE ();
+    if ((cache = get_cache ()) == NULL) {
+        UNLOCK_CACHE ();
+        free (node);
+        return;
+    }
+
+    if (cache->nr_nodes >= NR_LAYOUTS_PER_THREAD) {
+        remove_node (cache, cache->lru_tail);
+        cache_stats.nr_evictions++;
+    }
+
+    lru_push_head (cache, node);
+    cache->nr_nodes++;
+    cache_stats.nr_layouts++;
+    UNLOCK_CACHE ();
+}
+
+static void purge_cache (DTCACHE* cache, const LOGFONT* logfont)
+{
+    DTNODE *node, *next;
+
+    for (node = cache->lru_head; node; node = next) {
+        next = node->lru_next;
+        if (node->key.logfont == logfont)
+            remove_node (cache, node);
+    }
+}
+
+void __mg_drawtext_cache_purge (const LOGFONT* logfont)
+{
+    LOCK_CACHE ();
+#ifdef _MGRM_THREADS
+    {
+        DTCACHE* cache;
+
+        for (cache = cache_list; cache; cache = cache->next)
+            purge_cache (cache, logfont);
+    }
+#else
+    purge_cache (&the_cache, logfont);
+#endif
+    UNLOCK_CACHE ();
+}
+
+void __mg_drawtext_cache_term (void)
+{
+    LOCK_CACHE ();
+#ifdef _MGRM_THREADS
+    while (cache_list) {
+        DTCACHE* cache = cache_list;
+
+        cache_list = cache->next;
+        empty_cache (cache);
+        free (cache);
+    }
+
+    if (cache_key_created) {
+        pthread_key_delete (cache_key);
+        cache_key_created = FALSE;
+    }
+#else
+    empty_cache (&the_cache);
+#endif
+
+    _DBG_PRINTF ("drawtext cache: hits: %llu, misses: %llu, evictions: %llu\n",
+            (unsigned long long)cache_stats.nr_hits,
+            (unsigned long long)cache_stats.nr_misses,
+            (unsigned long long)cache_stats.nr_evictions);
+    memset (&cache_stats, 0, sizeof (cache_stats));
+    UNLOCK_CACHE ();
+}
+
+#endif /* _MGFONT_DRAWTEXT_CACHE */
+
+BOOL GUIAPI GetDrawTextCacheStats (DRAWTEXTCACHESTATS* stats)
+{
+#ifdef _MGFONT_DRAWTEXT_CACHE
+    if (stats == NULL)
+        return FALSE;
+
+    LOCK_CACHE ();
+    *stats = cache_stats;
+    UNLOCK_CACHE ();
+    return TRUE;
+#else
+    return FALSE;
+#endif
+}
+
+#endif /* !_MG_MINIMALGDI */
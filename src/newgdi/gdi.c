@@ -316,6 +316,7 @@ void mg_TerminateScreenDC (void)
         free (__mg_screen_sys_dc.alpha_pixel_format);
 
     dc_DeinitClipRgnInfo();
+    __mg_free_region_indexes ();
 
     DESTROY_LOCK (&__mg_gdilock);
     DESTROY_LOCK (&dcslot);
@@ -2044,6 +2045,7 @@ static void dc_InitDC (PDC pdc, HWND hWnd, BOOL bIsClient)
     pdc->step_x = step_x_ops [pdc->surface->format->BytesPerPixel - 1];
 
     pdc->alpha_pixel_format = NULL;
+    pdc->glyph_run = NULL;
     SetBitmapScalerType((HDC)pdc, BITMAP_SCALER_DDA);
 }
 
@@ -2097,6 +2099,7 @@ static void dc_InitMemDCFrom (PDC pdc, const PDC pdc_ref)
     pdc->step_x = step_x_ops [pdc->surface->format->BytesPerPixel - 1];
 
     pdc->alpha_pixel_format = NULL;
+    pdc->glyph_run = NULL;
 
     /* Init bitmap scaler ALG */
     //SetBitmapScalerType((HDC)pdc, BITMAP_SCALER_DDA);
@@ -2190,6 +2193,7 @@ static void dc_InitScreenDC (PDC pdc, GAL_Surface *surface)
     memset (pdc->gray_pixels, 0, sizeof (pdc->gray_pixels));
     memset (pdc->filter_pixels, 0, sizeof (pdc->filter_pixels));
     pdc->alpha_pixel_format = NULL;
+    pdc->glyph_run = NULL;
     /* Init bitmap scaler ALG */
     SetBitmapScalerType((HDC)pdc, BITMAP_SCALER_DDA);
 }
@@ -3285,6 +3289,10 @@ HDC GUIAPI CreateMemDCEx (int width, int height, int depth, DWORD flags,
         if (Amask) {
             surface->flags |= GAL_SRCPIXELALPHA;
         }
+        if ((flags & MEMDC_FLAG_PREMULALPHA) &&
+                GAL_CanPremulAlpha (surface->format)) {
+            surface->flags |= GAL_PREMULALPHA;
+        }
     }
 
     pmem_dc->DataType = TYPE_HDC;
@@ -81,8 +81,6 @@ int ft2GetLcdFilter (DEVFONT* devfont);
 int ft2IsFreeTypeDevfont (DEVFONT* devfont);
 #endif
 
-#define FS_WEIGHT_AUTOBOLD  29
-
 Glyph32 GetGlyphValueAlt(LOGFONT* lf, Achar32 chv)
 {
     Glyph32 gv = INV_GLYPH_VALUE;
@@ -301,7 +299,15 @@ void TermTextBitmapBuffer (void)
     _line_bk_size = 0;
 
     free (_scaled_bits);
+    _scaled_bits = NULL;
     _scaled_bits_size = 0;
+
+#ifdef _MGFONT_GLYPH_CACHE
+    __mg_glyph_cache_term ();
+#endif
+#ifdef _MGFONT_DRAWTEXT_CACHE
+    __mg_drawtext_cache_term ();
+#endif
 }
 
 static BOOL _realloc_bk_buffers (size_t size)
@@ -581,6 +587,99 @@ static void _glyph_blend_pixels (PDC pdc, int x, int y, gal_pixel pixel, int w)
     }
 }
 
+static inline int _glyph_grey_level (int b, int scale)
+{
+#ifdef _MGFONT_TTF_GRAYADJUST
+    if (scale == 1 && b != 0)
+        b += _MGFONT_TTF_GRAYADJUST_VALUE;
+#endif
+    return (b >= 255) ? 16 : (b >> 4);
+}
+
+/* the longest glyph line blended with the vectorized blenders */
+#define GLYPH_BLEND_MAX_SPAN    512
+
+/*
+ * Blends a line of coverage at (x, y) with the vectorized blender,
+ * touching only the pixels in rc_output and in the clip rects of the
+ * current ban, as _glyph_draw_pixel does.
+ */
+static void _glyph_blend_span (PDC pdc, CB_GLYPH_BLEND blend,
+        const GLYPH_BLEND_INFO* info, int x, int y,
+        const BYTE* coverage, int cov_size, int w)
+{
+    int bpp = pdc->surface->format->BytesPerPixel;
+    BYTE* dst = (BYTE*)pdc->surface->pixels + pdc->surface->pitch * y;
+    RECT rc_span, eff_rc;
+    PCLIPRECT cliprect;
+    int top;
+
+    SetRect (&rc_span, x, y, x + w, y + 1);
+    if (!IntersectRect (&rc_span, &rc_span, &pdc->rc_output))
+        return;
+
+    if (_noneed_clip) {
+        blend (info, dst + rc_span.left * bpp,
+                coverage + (rc_span.left - x) * cov_size, RECTW (rc_span));
+        return;
+    }
+
+    if ((cliprect = pdc->cur_ban) == NULL)
+        return;
+
+    top = cliprect->rc.top;
+    while (cliprect && cliprect->rc.top == top) {
+        if (IntersectRect (&eff_rc, &rc_span, &cliprect->rc)) {
+            blend (info, dst + eff_rc.left * bpp,
+                    coverage + (eff_rc.left - x) * cov_size, RECTW (eff_rc));
+        }
+
+        cliprect = cliprect->next;
+    }
+}
+
+/*
+ * Blends a line of a grey glyph with the alpha pixels in gray_pixels;
+ * returns FALSE if there is no vectorized blender for the DC.
+ */
+static BOOL _glyph_blend_grey_line (PDC pdc, int x, int y,
+        SCANLINE_CTXT* ctxt)
+{
+    GAL_PixelFormat* srcfmt = pdc->alpha_pixel_format;
+    CB_GLYPH_BLEND blend;
+    GLYPH_BLEND_INFO info;
+    BYTE alphas [17];
+    BYTE line [GLYPH_BLEND_MAX_SPAN];
+    unsigned r, g, b, a;
+    int i;
+
+    if (pdc->rop != ROP_SET || ctxt->bmp_w > GLYPH_BLEND_MAX_SPAN)
+        return FALSE;
+
+    blend = __mg_get_glyph_blender (pdc->surface->format, FALSE);
+    if (blend == NULL)
+        return FALSE;
+
+    /* the pixels of level 0 are skipped by the scalar renderer */
+    alphas [0] = 0;
+    for (i = 1; i <= 16; i++) {
+        RGBA_FROM_PIXEL (pdc->gray_pixels [i], srcfmt, r, g, b, a);
+        alphas [i] = a;
+    }
+
+    for (i = 0; i < ctxt->bmp_w; i++)
+        line [i] = alphas [_glyph_grey_level (ctxt->line_bits [i], 1)];
+
+    RGBA_FROM_PIXEL (pdc->gray_pixels [16], srcfmt, r, g, b, a);
+    info.format = pdc->surface->format;
+    info.r = r;
+    info.g = g;
+    info.b = b;
+
+    _glyph_blend_span (pdc, blend, &info, x, y, line, 1, ctxt->bmp_w);
+    return TRUE;
+}
+
 static void _dc_bmpfont_scan_line (PDC pdc, int xpos, int ypos,
         SCANLINE_CTXT* ctxt)
 {
@@ -644,6 +743,11 @@ static void _dc_bookgrey_scan_line (PDC pdc, int xpos, int ypos,
                         ctxt->glyph_ascent, ctxt->glyph_line,
                         ctxt->glyph_advance);
 
+        if (pdc->alpha_pixel_format && pdc->bkmode == BM_TRANSPARENT
+                && _glyph_blend_grey_line (pdc, off_x + xpos, ypos, ctxt)) {
+            goto nodraw_ret;
+        }
+
         for (x = 0; x < ctxt->bmp_w; x++) {
             b = *(ctxt->line_bits + x);
 #ifdef _MGFONT_TTF_GRAYADJUST
@@ -1074,6 +1178,7 @@ static void _dc_ft2subpixel_scan_line(PDC pdc, int xpos, int ypos,
     RGB   rgba_cur;
     RGB   rgba_fg;
     gal_pixel pixel = 0;
+    CB_GLYPH_BLEND blend;
 
     int x = 0;
     const BYTE* bits = ctxt->line_bits;
@@ -1089,6 +1194,19 @@ static void _dc_ft2subpixel_scan_line(PDC pdc, int xpos, int ypos,
     GAL_GetRGB (pdc->textcolor, pdc->surface->format, &rgba_fg.r,
             &rgba_fg.g, &rgba_fg.b);
 
+    if (pdc->rop == ROP_SET &&
+            (blend = __mg_get_glyph_blender (pdc->surface->format, TRUE))) {
+        GLYPH_BLEND_INFO info;
+
+        info.format = pdc->surface->format;
+        info.r = rgba_fg.r;
+        info.g = rgba_fg.g;
+        info.b = rgba_fg.b;
+        _glyph_blend_span (pdc, blend, &info, xpos, ypos, bits, 3,
+                ctxt->bmp_w);
+        goto nodraw_ret;
+    }
+
     for (x = 0; x < ctxt->bmp_w; x++) {
         if (!PtInRect (&pdc->rc_output, x+xpos, ypos)) {
             bits += 3;
@@ -1918,9 +2036,38 @@ static BOOL _gdi_get_glyph_data (PDC pdc, Glyph32 glyph_value,
     BYTE* data = NULL;
     PLOGFONT logfont = pdc->pLogFont;
     DEVFONT* devfont = SELECT_DEVFONT_BY_GLYPH(pdc->pLogFont, glyph_value);
+#ifdef _MGFONT_GLYPH_CACHE
+    GLYPHCACHEKEY key;
+    const GLYPHBITS* cached;
+#endif
     glyph_value = REAL_GLYPH(glyph_value);
 
     DWORD bmptype = devfont->font_ops->get_glyph_bmptype (logfont, devfont);
+
+#ifdef _MGFONT_GLYPH_CACHE
+    key.devfont = devfont;
+    key.cb = NULL;
+    key.glyph = glyph_value;
+    key.style = logfont->style;
+    key.size = logfont->size;
+    key.rotation = logfont->rotation;
+    key.bold = bold;
+
+    /* the renderer decides how the bitmap is post-processed */
+#   define LOOKUP_GLYPH_CACHE()                                 \
+        key.cb = (const void*)ctxt->cb;                         \
+        if ((cached = __mg_glyph_cache_find (&key))) {          \
+            data = (BYTE*)cached->bits;                         \
+            pitch = cached->pitch;                              \
+            scale = cached->scale;                              \
+            bbox->cx = cached->w;                               \
+            bbox->cy = cached->h;                               \
+            break;                                              \
+        }
+#else
+#   define LOOKUP_GLYPH_CACHE()
+#endif
+
     switch (bmptype & DEVFONTGLYPHTYPE_MASK_BMPTYPE) {
     case GLYPHBMP_TYPE_MONO:
         if ((logfont->style & FS_RENDER_MASK) == FS_RENDER_GREY) {
@@ -1939,6 +2086,7 @@ static BOOL _gdi_get_glyph_data (PDC pdc, Glyph32 glyph_value,
             ctxt->cb = _dc_regular_scan_line;
         }
 
+        LOOKUP_GLYPH_CACHE ();
         data = (BYTE*)(*devfont->font_ops->get_glyph_monobitmap) (logfont,
                 devfont, glyph_value, bbox, &pitch, &scale);
         bbox->cx += bold;
@@ -1974,9 +2122,10 @@ static BOOL _gdi_get_glyph_data (PDC pdc, Glyph32 glyph_value,
     case GLYPHBMP_TYPE_GREY:
         /* get preybitmap */
         if (devfont->font_ops->get_glyph_greybitmap) {
+            ctxt->cb = _dc_bookgrey_scan_line;
+            LOOKUP_GLYPH_CACHE ();
             data = (BYTE*)(*devfont->font_ops->get_glyph_greybitmap) (logfont,
                     devfont, glyph_value, bbox, &pitch, &scale);
-            ctxt->cb = _dc_bookgrey_scan_line;
             if (data && scale > 1) {
                 bbox->cx = bbox->cx / scale;
                 bbox->cy = bbox->cy / scale;
@@ -1995,12 +2144,14 @@ static BOOL _gdi_get_glyph_data (PDC pdc, Glyph32 glyph_value,
         if (ft2IsFreeTypeDevfont (devfont) &&
                 ft2GetLcdFilter (devfont) &&
                 *devfont->font_ops->get_glyph_greybitmap) {
+            ctxt->cb = _dc_ft2subpixel_scan_line;
+            LOOKUP_GLYPH_CACHE ();
+
             /* the returned bits will be the subpixled pixmap */
             data = (BYTE*)(*devfont->font_ops->get_glyph_greybitmap) (logfont,
                     devfont, glyph_value, bbox, &pitch, &scale);
             // the width of SUBPIXEL bitmap is 3x real width of bbox
             bbox->cx /= 3;
-            ctxt->cb = _dc_ft2subpixel_scan_line;
 
             /* flip the subpixeled pixmap */
             if (logfont->style & FS_FLIP_HORZ)
@@ -2045,6 +2196,12 @@ static BOOL _gdi_get_glyph_data (PDC pdc, Glyph32 glyph_value,
     if (!data || !ctxt->cb)
         return FALSE;
 
+#ifdef _MGFONT_GLYPH_CACHE
+    /* keep the bitmap if it was expanded or flipped */
+    if (data == _scaled_bits)
+        __mg_glyph_cache_add (&key, data, pitch, bbox, scale);
+#endif
+
 #if 0
     if (ctxt->cb != _dc_bmpfont_scan_line && logfont->style & FS_FLIP_VERT) {
         data  = data + (bbox->cy-1) * pitch;
@@ -2149,6 +2306,538 @@ static inline void _gdi_direct_fillglyph (PDC pdc, Glyph32 glyph_value,
     }
 }
 
+/*
+ * Glyph runs.
+ *
+ * Drawing a glyph through the scan line renderers clips every pixel span
+ * against the effective clip region again. For a run of glyphs rendered
+ * with the regular mono or the grey renderer, the glyphs are composited
+ * into one mask instead: a 1bpp mask for the mono glyphs, and a mask of
+ * coverage levels (0-16) for the grey ones. The mask is drawn when the
+ * run is flushed, with one pass over the clip rects. A run is flushed at
+ * its end, on a new line, or before a glyph which can not join it.
+ */
+
+/* the largest mask of a run; a run is flushed before it gets larger */
+#define GLYPH_RUN_MAX_MASK      (64 * 1024)
+
+/* the bytes of a line of the mask covering rc */
+static inline int _glyph_run_pitch (const GLYPH_RUN* run, const RECT* rc)
+{
+    return run->mono ? ((RECTWP (rc) + 7) >> 3) : RECTWP (rc);
+}
+
+static inline BYTE* _glyph_run_line (GLYPH_RUN* run, int y)
+{
+    return run->mask + (y - run->rc_mask.top) *
+            _glyph_run_pitch (run, &run->rc_mask);
+}
+
+static void _glyph_run_blend_bits (PDC pdc, GLYPH_RUN* run,
+        const RECT* eff_rc, BOOL direct)
+{
+    int bpp = pdc->surface->format->BytesPerPixel;
+    Uint32 color = (Uint32)pdc->textcolor;
+    int y, i0, i1;
+
+    /* the bits of the mask in the effective rect */
+    i0 = eff_rc->left - run->rc_mask.left;
+    i1 = eff_rc->right - run->rc_mask.left;
+
+    pdc->cur_pixel = pdc->textcolor;
+    for (y = eff_rc->top; y < eff_rc->bottom; y++) {
+        const BYTE* line = _glyph_run_line (run, y);
+        BYTE* dst = (BYTE*)pdc->surface->pixels + pdc->surface->pitch * y;
+        int i, n, x;
+        unsigned int b;
+        Uint64 word;
+
+        for (i = i0; i < i1; i += n) {
+            /* most of the mask is transparent; skip 64 bits at a time */
+            if ((i & 7) == 0 && i + 64 <= i1) {
+                memcpy (&word, line + (i >> 3), sizeof (word));
+                if (word == 0) {
+                    n = 64;
+                    continue;
+                }
+            }
+
+            /* the bits left in this byte, from the highest one */
+            n = MIN (8 - (i & 7), i1 - i);
+            b = ((line [i >> 3] << (i & 7)) & 0xFF) & (0xFF00 >> n);
+            x = i + run->rc_mask.left;
+
+            if (direct && bpp == 4) {
+                Uint32* p = (Uint32*)dst + x;
+                for (; b; b = (b << 1) & 0xFF, p++) {
+                    if (b & 0x80)
+                        *p = color;
+                }
+            }
+            else if (direct) {
+                Uint16* p = (Uint16*)dst + x;
+                for (; b; b = (b << 1) & 0xFF, p++) {
+                    if (b & 0x80)
+                        *p = (Uint16)color;
+                }
+            }
+            else {
+                while (b) {
+                    int start;
+
+                    for (; !(b & 0x80); b <<= 1)
+                        x++;
+                    for (start = x; b & 0x80; b = (b << 1) & 0xFF)
+                        x++;
+
+                    pdc->move_to (pdc, start, y);
+                    pdc->draw_pixel_span (PDC_TO_COMP_CTXT(pdc), x - start);
+                }
+            }
+        }
+    }
+}
+
+static void _glyph_run_blend_levels (PDC pdc, GLYPH_RUN* run,
+        const RECT* eff_rc, BOOL direct)
+{
+    gal_pixel pixels [17];
+    int bpp = pdc->surface->format->BytesPerPixel;
+    int y;
+
+    /* the grey renderer is not used with alpha pixel format */
+    memcpy (pixels, pdc->gray_pixels, sizeof (pixels));
+    pixels [16] = pdc->textcolor;
+
+    for (y = eff_rc->top; y < eff_rc->bottom; y++) {
+        const BYTE* line = _glyph_run_line (run, y) - run->rc_mask.left;
+        BYTE* dst = (BYTE*)pdc->surface->pixels + pdc->surface->pitch * y;
+        int x = eff_rc->left;
+
+        while (x < eff_rc->right) {
+            int level, start, end;
+            Uint64 word;
+
+            /* most of the mask is transparent; skip eight at a time */
+            if (x + 8 <= eff_rc->right) {
+                memcpy (&word, line + x, sizeof (word));
+                if (word == 0) {
+                    x += 8;
+                    continue;
+                }
+                end = x + 8;
+            }
+            else
+                end = eff_rc->right;
+
+            if (direct && bpp == 4) {
+                for (; x < end; x++) {
+                    if ((level = line [x]))
+                        ((Uint32*)dst) [x] = (Uint32)pixels [level];
+                }
+            }
+            else if (direct) {
+                for (; x < end; x++) {
+                    if ((level = line [x]))
+                        ((Uint16*)dst) [x] = (Uint16)pixels [level];
+                }
+            }
+            else {
+                while (x < end && line [x] == 0)
+                    x++;
+                if (x == end)
+                    continue;
+
+                level = line [x];
+                start = x;
+                while (++x < eff_rc->right && line [x] == level);
+
+                pdc->cur_pixel = pixels [level];
+                pdc->move_to (pdc, start, y);
+                pdc->draw_pixel_span (PDC_TO_COMP_CTXT(pdc), x - start);
+            }
+        }
+    }
+}
+
+static void _glyph_run_blend (PDC pdc, GLYPH_RUN* run)
+{
+    PCLIPRECT cliprect;
+    RECT eff_rc;
+    gal_pixel old_color = pdc->cur_pixel;
+    int bpp = pdc->surface->format->BytesPerPixel;
+    BOOL direct;
+
+    /* most glyph spans are a few pixels wide; write them directly
+     * instead of calling the span operation for each of them */
+    direct = (pdc->rop == ROP_SET && (bpp == 2 || bpp == 4));
+
+    for (cliprect = pdc->ecrgn.head; cliprect; cliprect = cliprect->next) {
+        if (cliprect->rc.top >= run->rc_dirty.bottom)
+            break;
+
+        if (!IntersectRect (&eff_rc, &run->rc_dirty, &cliprect->rc))
+            continue;
+
+        if (run->mono)
+            _glyph_run_blend_bits (pdc, run, &eff_rc, direct);
+        else
+            _glyph_run_blend_levels (pdc, run, &eff_rc, direct);
+    }
+
+    pdc->cur_pixel = old_color;
+}
+
+static void _glyph_run_reset (GLYPH_RUN* run)
+{
+    int y, left, size;
+
+    left = run->rc_dirty.left - run->rc_mask.left;
+    size = RECTW (run->rc_dirty);
+    if (run->mono) {
+        size = ((left + size + 7) >> 3) - (left >> 3);
+        left >>= 3;
+    }
+
+    for (y = run->rc_dirty.top; run->nr_glyphs > 0 &&
+            y < run->rc_dirty.bottom; y++) {
+        memset (_glyph_run_line (run, y) + left, 0, size);
+    }
+    run->nr_glyphs = 0;
+}
+
+static void _glyph_run_flush (PDC pdc, GLYPH_RUN* run)
+{
+    RECT rc_tmp = pdc->rc_output;
+
+    if (!__mg_check_ecrgn ((HDC)pdc))
+        goto reset;
+
+    pdc->rc_output = run->rc_dirty;
+    if (WITHOUT_DRAWING (pdc)) goto end;
+
+    ENTER_DRAWING (pdc);
+
+    pdc->step = 1;
+    _glyph_run_blend (pdc, run);
+
+    LEAVE_DRAWING (pdc);
+end:
+    UNLOCK_GCRINFO (pdc);
+    pdc->rc_output = rc_tmp;
+reset:
+    _glyph_run_reset (run);
+}
+
+/* Makes the mask of the run cover rc, which is in the output rect of the
+ * run. Returns FALSE if the mask would be too large. */
+static BOOL _glyph_run_extend (GLYPH_RUN* run, const RECT* rc)
+{
+    RECT rc_new;
+    size_t size, capacity;
+    int w;
+
+    if (run->nr_glyphs == 0)
+        rc_new = *rc;
+    else if (IsCovered (rc, &run->rc_mask))
+        return TRUE;
+    else
+        GetBoundRect (&rc_new, &run->rc_mask, rc);
+
+    /* the lines of a 1bpp mask start at a byte */
+    if (run->mono)
+        rc_new.left &= ~7;
+
+    size = _glyph_run_pitch (run, &rc_new) * RECTH (rc_new);
+    if (size > GLYPH_RUN_MAX_MASK)
+        return FALSE;
+
+    capacity = run->mask_size;
+    if (size > capacity)
+        capacity = MIN (MAX (size, capacity * 2), GLYPH_RUN_MAX_MASK);
+
+    /* leave room for the following glyphs in the direction of the text */
+    w = capacity / RECTH (rc_new);
+    if (run->mono)
+        w = (w - 1) << 3;
+    if (run->nr_glyphs > 0 && rc->left < run->rc_mask.left) {
+        rc_new.left = MIN (rc_new.left,
+                MAX (rc_new.right - w, run->rc_clip.left));
+        if (run->mono)
+            rc_new.left &= ~7;
+    }
+    else {
+        rc_new.right = MAX (rc_new.right,
+                MIN (rc_new.left + w, run->rc_clip.right));
+    }
+
+    if (run->nr_glyphs == 0 && capacity == run->mask_size) {
+        /* the mask is clean */
+        run->rc_mask = rc_new;
+        return TRUE;
+    }
+    else {
+        BYTE* mask;
+        int y, offset, pitch = _glyph_run_pitch (run, &rc_new);
+
+        if ((mask = calloc (1, capacity)) == NULL)
+            return FALSE;
+
+        offset = run->rc_mask.left - rc_new.left;
+        if (run->mono)
+            offset >>= 3;
+
+        for (y = run->rc_mask.top; run->nr_glyphs > 0 &&
+                y < run->rc_mask.bottom; y++) {
+            memcpy (mask + (y - rc_new.top) * pitch + offset,
+                    _glyph_run_line (run, y),
+                    _glyph_run_pitch (run, &run->rc_mask));
+        }
+
+        if (run->mask != run->inline_mask)
+            free (run->mask);
+        run->mask = mask;
+        run->mask_size = capacity;
+        run->rc_mask = rc_new;
+    }
+
+    return TRUE;
+}
+
+/* Composites a line of a mono glyph bitmap at off_x into a line of
+ * the mask, touching only the pixels in [left, right). */
+static void _glyph_run_composite_bits (GLYPH_RUN* run, BYTE* dst,
+        const BYTE* bits, int w, int scale, int off_x, int left, int right)
+{
+    int x, x0, x1, i;
+
+    if (scale == 1) {
+        x0 = MAX (0, left - off_x);
+        x1 = MIN (w, right - off_x);
+        off_x -= run->rc_mask.left;
+        for (x = x0; x < x1; x++) {
+            BYTE b = bits [x >> 3];
+
+            i = off_x + x;
+            if (b == 0) {
+                x |= 7;
+            }
+            else if ((x & 7) == 0 && x + 8 <= x1) {
+                /* a whole byte of the glyph */
+                dst [i >> 3] |= b >> (i & 7);
+                if (i & 7)
+                    dst [(i >> 3) + 1] |= b << (8 - (i & 7));
+                x += 7;
+            }
+            else if (b & (0x80 >> (x & 7))) {
+                dst [i >> 3] |= 0x80 >> (i & 7);
+            }
+        }
+        return;
+    }
+
+    /* the bits having pixels in [left, right) */
+    x0 = (left > off_x) ? (left - off_x) / scale : 0;
+    x1 = MIN (w, (right - off_x + scale - 1) / scale);
+    for (x = x0; x < x1; x++) {
+        int dst_x, n;
+
+        if (!(bits [x >> 3] & (0x80 >> (x & 7))))
+            continue;
+
+        dst_x = off_x + x * scale;
+        for (n = 0; n < scale; n++, dst_x++) {
+            if (dst_x >= left && dst_x < right) {
+                i = dst_x - run->rc_mask.left;
+                dst [i >> 3] |= 0x80 >> (i & 7);
+            }
+        }
+    }
+}
+
+/* Composites a line of a grey glyph bitmap at off_x into a line of
+ * the mask, touching only the pixels in [left, right). */
+static void _glyph_run_composite_levels (GLYPH_RUN* run, BYTE* dst,
+        const BYTE* bits, int w, int scale, int off_x, int left, int right)
+{
+    int x, x0, x1;
+
+    dst -= run->rc_mask.left;
+    if (scale == 1) {
+        x0 = MAX (0, left - off_x);
+        x1 = MIN (w, right - off_x);
+        dst += off_x;
+        for (x = x0; x < x1; x++) {
+            int level = _glyph_grey_level (bits [x], 1);
+
+            if (dst [x] < level)
+                dst [x] = level;
+        }
+        return;
+    }
+
+    /* the bits having pixels in [left, right) */
+    x0 = (left > off_x) ? (left - off_x) / scale : 0;
+    x1 = MIN (w, (right - off_x + scale - 1) / scale);
+    for (x = x0; x < x1; x++) {
+        int level, dst_x, n;
+
+        if ((level = _glyph_grey_level (bits [x], scale)) == 0)
+            continue;
+
+        dst_x = off_x + x * scale;
+        for (n = 0; n < scale; n++, dst_x++) {
+            if (dst_x >= left && dst_x < right && dst [dst_x] < level)
+                dst [dst_x] = level;
+        }
+    }
+}
+
+/* Composites a glyph into the mask of the run; pdc->rc_output is the
+ * output rect of the glyph. Returns FALSE if the glyph should be drawn
+ * as usual. */
+static BOOL _gdi_run_fillglyph (PDC pdc, GLYPH_RUN* run, Glyph32 glyph_value,
+        GAL_Rect* fg_gal_rc, SIZE* bbox,
+        int glyph_ascent, int glyph_advance, int italic, int bold)
+{
+    GLYPH_CTXT ctxt = {0};
+    RECT rc_glyph;
+    int y, scale, off_first, off_last;
+
+    if (!_gdi_get_glyph_data (pdc, glyph_value, bbox, bold, &ctxt))
+        return TRUE;
+
+    /* like the scan line renderers, do not cut the pixels out of the box
+     * of the glyph, but keep them in the output rect of the run. */
+    scale = ctxt.scale;
+    off_first = get_italic_offx (pdc, italic, glyph_ascent, 0, glyph_advance);
+    off_last = get_italic_offx (pdc, italic, glyph_ascent,
+            bbox->cy * scale - 1, glyph_advance);
+    SetRect (&rc_glyph, fg_gal_rc->x + MIN (off_first, off_last),
+            fg_gal_rc->y,
+            fg_gal_rc->x + MAX (off_first, off_last) + bbox->cx * scale,
+            fg_gal_rc->y + bbox->cy * scale);
+
+    if (ctxt.cb != (run->mono ?
+                _dc_regular_scan_line : _dc_bookgrey_scan_line) ||
+            !IntersectRect (&rc_glyph, &rc_glyph, &run->rc_clip) ||
+            !IntersectRect (&rc_glyph, &rc_glyph, &pdc->ecrgn.rcBound) ||
+            !_glyph_run_extend (run, &rc_glyph)) {
+        return FALSE;
+    }
+
+    for (y = rc_glyph.top; y < rc_glyph.bottom; y++) {
+        int line = y - fg_gal_rc->y;
+        int off_x = fg_gal_rc->x + get_italic_offx (pdc, italic,
+                glyph_ascent, line, glyph_advance);
+
+        if (line < 0)
+            continue;
+        if (line >= bbox->cy * scale)
+            break;
+
+        if (run->mono)
+            _glyph_run_composite_bits (run, _glyph_run_line (run, y),
+                    ctxt.data + (line / scale) * ctxt.pitch, bbox->cx, scale,
+                    off_x, rc_glyph.left, rc_glyph.right);
+        else
+            _glyph_run_composite_levels (run, _glyph_run_line (run, y),
+                    ctxt.data + (line / scale) * ctxt.pitch, bbox->cx, scale,
+                    off_x, rc_glyph.left, rc_glyph.right);
+    }
+
+    if (run->nr_glyphs == 0)
+        run->rc_dirty = rc_glyph;
+    else
+        GetBoundRect (&run->rc_dirty, &run->rc_dirty, &rc_glyph);
+    run->nr_glyphs++;
+
+    return TRUE;
+}
+
+/* Checks whether the glyph can join the run, and flushes the run if it
+ * can not, if it starts a new line, or if the mask would be too large. */
+static BOOL _gdi_glyph_in_run (PDC pdc, GLYPH_RUN* run, DEVFONT* devfont,
+        int glyph_bmptype, const RECT* rc_clip, const RECT* rc_glyph,
+        const BBOX* bbox)
+{
+    LOGFONT* logfont = pdc->pLogFont;
+    BOOL in_run, mono = (glyph_bmptype == DEVFONTGLYPHTYPE_MONOBMP);
+    RECT rc;
+
+    if (pdc->bkmode != BM_TRANSPARENT
+            || (logfont->style & FS_DECORATE_UNDERLINE)
+            || (logfont->style & FS_DECORATE_STRUCKOUT)) {
+        in_run = FALSE;
+    }
+    else if (mono) {
+        /* only the regular scan line renderer; see _gdi_get_glyph_data */
+        in_run = !((logfont->style & FS_RENDER_MASK) == FS_RENDER_SUBPIXEL
+            || ((logfont->style & FS_RENDER_MASK) == FS_RENDER_GREY
+                && pdc->alpha_pixel_format)
+            || ((logfont->style & FS_DECORATE_OUTLINE)
+                && pdc->textcolor != pdc->bkcolor));
+    }
+    else if (glyph_bmptype == DEVFONTGLYPHTYPE_GREYBMP) {
+        in_run = devfont->font_ops->get_glyph_greybitmap != NULL
+            && pdc->alpha_pixel_format == NULL;
+    }
+    else
+        in_run = FALSE;
+
+    if (run->nr_glyphs > 0) {
+        if (!in_run || mono != run->mono
+                || !EqualRect (&run->rc_clip, rc_clip)
+                /* a new line; keep the mask small */
+                || (bbox->h > 0 && (bbox->y >= run->rc_dirty.bottom
+                        || bbox->y + bbox->h <= run->rc_dirty.top))) {
+            _glyph_run_flush (pdc, run);
+        }
+        else if (IntersectRect (&rc, rc_glyph, rc_clip)) {
+            GetBoundRect (&rc, &rc, &run->rc_mask);
+            if (RECTW (rc) * RECTH (rc) > GLYPH_RUN_MAX_MASK)
+                _glyph_run_flush (pdc, run);
+        }
+    }
+
+    if (in_run && run->nr_glyphs == 0) {
+        if (!IntersectRect (&rc, rc_glyph, rc_clip)
+                || RECTW (rc) * RECTH (rc) > GLYPH_RUN_MAX_MASK)
+            return FALSE;
+        run->rc_clip = *rc_clip;
+        run->mono = mono;
+    }
+
+    return in_run;
+}
+
+BOOL _gdi_begin_glyph_run (PDC pdc, GLYPH_RUN* run)
+{
+    /* the outer run goes on */
+    if (pdc->glyph_run)
+        return FALSE;
+
+    run->nr_glyphs = 0;
+    run->mask = run->inline_mask;
+    run->mask_size = GLYPH_RUN_INLINE_MASK;
+    memset (run->inline_mask, 0, GLYPH_RUN_INLINE_MASK);
+    pdc->glyph_run = run;
+    return TRUE;
+}
+
+void _gdi_end_glyph_run (PDC pdc, GLYPH_RUN* run)
+{
+    if (pdc->glyph_run != run)
+        return;
+
+    if (run->nr_glyphs > 0)
+        _glyph_run_flush (pdc, run);
+
+    if (run->mask != run->inline_mask)
+        free (run->mask);
+    pdc->glyph_run = NULL;
+}
+
 void _gdi_get_rotated_point(int *x, int *y, int rotation)
 {
     int advance = fixtoi(fixsqrt(fixadd(itofix(*x * *x), itofix(*y * *y))));
@@ -2265,6 +2954,15 @@ int _font_get_glyph_log_width(LOGFONT* logfont, Glyph32 gv)
         return 0;
 
     gv = REAL_GLYPH(gv);
+
+#ifdef _MGFONT_ADVANCE_CACHE
+    {
+        const GLYPHADVANCE* ga = __mg_advance_cache_get (logfont, devfont, gv);
+        if (ga)
+            return ga->advance;
+    }
+#endif
+
     width = devfont->font_ops->get_glyph_advance(logfont, devfont, gv,
             &tmp_x, &tmp_y);
 
@@ -2310,6 +3008,25 @@ int _font_get_glyph_advance (LOGFONT* logfont, DEVFONT* devfont,
         goto done;
     }
 
+#ifdef _MGFONT_ADVANCE_CACHE
+    // the bbox depends on the position, so it is not cached
+    if (bbox == NULL) {
+        const GLYPHADVANCE* ga = __mg_advance_cache_get (logfont, devfont,
+                REAL_GLYPH(glyph_value));
+        if (ga) {
+            if (direction) {
+                if (adv_x) *adv_x = ga->adv_x + ga->extra_x + ch_extra;
+                if (adv_y) *adv_y = ga->adv_y;
+            }
+            else {
+                if (adv_x) *adv_x = ga->extra_x + ch_extra - ga->adv_x;
+                if (adv_y) *adv_y = -ga->adv_y;
+            }
+            return ga->advance + ch_extra;
+        }
+    }
+#endif
+
     glyph_bmptype = devfont->font_ops->get_glyph_bmptype (logfont, devfont)
             & DEVFONTGLYPHTYPE_MASK_BMPTYPE;
 
@@ -2806,6 +3523,7 @@ int _gdi_draw_one_glyph (PDC pdc, Glyph32 glyph_value, BOOL direction,
     POINT area[4];
     int flag = 0;
     int glyph_bmptype;
+    BOOL in_run = FALSE;
 
     y += pdc->alExtra;
 
@@ -2874,6 +3592,12 @@ int _gdi_draw_one_glyph (PDC pdc, Glyph32 glyph_value, BOOL direction,
     else
         rc_output = rc_front;
 
+    /* a run flushed here is drawn in ENTER_DRAWING/LEAVE_DRAWING by
+     * _glyph_run_flush, so this is done before locking anything */
+    if (pdc->glyph_run)
+        in_run = _gdi_glyph_in_run (pdc, pdc->glyph_run, devfont,
+                glyph_bmptype, &rc_tmp, &rc_output, &bbox);
+
     if (!(pdc = __mg_check_ecrgn ((HDC)pdc))) {
         return advance;
     }
@@ -2882,8 +3606,27 @@ int _gdi_draw_one_glyph (PDC pdc, Glyph32 glyph_value, BOOL direction,
         goto end;
     }
 
+    /* bbox is the real glyph pixels on one scan-line. */
+    bbx_size.cx = bbox.w;
+    bbx_size.cy = bbox.h;
+
     if (WITHOUT_DRAWING (pdc)) goto end;
 
+    /* the glyphs composited into the run are drawn when it is flushed.
+     * Getting the glyph data uses the font engines and the glyph cache,
+     * so it is done with __mg_gdilock held, like the drawing below. */
+    if (in_run) {
+        BOOL filled;
+
+        LOCK (&__mg_gdilock);
+        filled = _gdi_run_fillglyph (pdc, pdc->glyph_run, glyph_value,
+                &fg_gal_rc, &bbx_size, y - bbox.y, advance, italic, bold);
+        UNLOCK (&__mg_gdilock);
+
+        if (filled)
+            goto end;
+    }
+
     ENTER_DRAWING (pdc);
 
     pdc->step = 1;
@@ -2895,10 +3638,6 @@ int _gdi_draw_one_glyph (PDC pdc, Glyph32 glyph_value, BOOL direction,
         draw_back_area (pdc, area, &bg_gal_rc, italic, bold, flag);
     }
 
-    /* bbox is the real glyph pixels on one scan-line. */
-    bbx_size.cx = bbox.w;
-    bbx_size.cy = bbox.h;
-
     _gdi_direct_fillglyph (pdc, glyph_value, &fg_gal_rc, &bbx_size,
             y - bbox.y, advance, italic, bold);
 
@@ -2971,7 +3710,9 @@ int GUIAPI DrawGlyphStrings(HDC hdc, Glyph32* glyphs, int nr_glyphs,
     int count = 0;
     int i;
     PDC pdc = dc_HDC2PDC(hdc);
+    GLYPH_RUN run;
 
+    _gdi_begin_glyph_run (pdc, &run);
     for (i = 0; i < nr_glyphs; i++) {
         int x, y;
         int my_adv_x, my_adv_y;
@@ -2997,6 +3738,7 @@ int GUIAPI DrawGlyphStrings(HDC hdc, Glyph32* glyphs, int nr_glyphs,
                 x, y, &my_adv_x, &my_adv_y);
     }
 
+    _gdi_end_glyph_run (pdc, &run);
     return count;
 }
 
@@ -59,6 +59,9 @@ typedef struct _BBOX {
 extern "C" {
 #endif  /* __cplusplus */
 
+/* Use auto bold when the weight of devfont is lighter by more than this. */
+#define FS_WEIGHT_AUTOBOLD  29
+
 int _font_get_glyph_log_width (LOGFONT* logfont, Glyph32 gv);
 
 int _font_get_glyph_advance (LOGFONT* logfont, DEVFONT* devfont,
@@ -68,6 +71,65 @@ int _font_get_glyph_advance (LOGFONT* logfont, DEVFONT* devfont,
 int _font_get_glyph_metrics(LOGFONT* logfont,
         Glyph32 gv, int* adv_x, int* adv_y, BBOX* bbox);
 
+#ifdef _MGFONT_GLYPH_CACHE
+/* The key of a post-processed glyph bitmap in the glyph cache. */
+typedef struct _GLYPHCACHEKEY {
+    const DEVFONT* devfont;
+    const void* cb;         /* the scan line renderer */
+    Glyph32 glyph;
+    DWORD style;
+    int size;
+    int rotation;
+    int bold;
+} GLYPHCACHEKEY;
+
+typedef struct _GLYPHBITS {
+    int w, h;
+    int pitch;
+    unsigned short scale;
+    const BYTE* bits;
+} GLYPHBITS;
+
+const GLYPHBITS* __mg_glyph_cache_find (const GLYPHCACHEKEY* key);
+const GLYPHBITS* __mg_glyph_cache_add (const GLYPHCACHEKEY* key,
+        const BYTE* bits, int pitch, const SIZE* bbox, unsigned short scale);
+void __mg_glyph_cache_term (void);
+#endif /* _MGFONT_GLYPH_CACHE */
+
+#ifdef _MGFONT_ADVANCE_CACHE
+/* The advance of a glyph kept by the logical font; the character extra
+ * of the DC is not included. */
+typedef struct _GLYPHADVANCE {
+    Sint16 advance;     /* the advance length with bold and grey widths */
+    Sint16 adv_x;       /* the advance vector of the devfont */
+    Sint16 adv_y;
+    Uint8 extra_x;      /* the width added for bold and grey */
+    Uint8 valid;
+} GLYPHADVANCE;
+
+const GLYPHADVANCE* __mg_advance_cache_get (LOGFONT* logfont,
+        DEVFONT* devfont, Glyph32 gv);
+#endif /* _MGFONT_ADVANCE_CACHE */
+
+/* The blending of the anti-aliased glyph spans (glyphblend.c). */
+typedef struct _GLYPH_BLEND_INFO {
+    const GAL_PixelFormat* format;  /* the format of the destination */
+    Uint8 r, g, b;                  /* the text color */
+} GLYPH_BLEND_INFO;
+
+/*
+ * Blends the text color into w pixels at dst by their coverage: one
+ * alpha (0-255) a pixel for a grey glyph, or three, for the red, green,
+ * and blue subpixels, for a subpixel one. The pixels not covered are
+ * not touched.
+ */
+typedef void (* CB_GLYPH_BLEND) (const GLYPH_BLEND_INFO* info,
+        void* dst, const BYTE* coverage, int w);
+
+/* Returns NULL if there is no vectorized blender for the format. */
+CB_GLYPH_BLEND __mg_get_glyph_blender (const GAL_PixelFormat* format,
+        BOOL subpixel);
+
 #ifdef __cplusplus
 }
 #endif  /* __cplusplus */
@@ -0,0 +1,426 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+//                          IMPORTANT NOTICE
+//
+// The following open source license statement does not apply to any
+// entity in the Exception List published by FMSoft.
+//
+// For more information, please visit:
+//
+// https://www.fmsoft.cn/exception-list
+//
+//////////////////////////////////////////////////////////////////////////////
+/*
+ *   This file is part of MiniGUI, a mature cross-platform windowing
+ *   and Graphics User Interface (GUI) support system for embedded systems
+ *   and smart IoT devices.
+ *
+ *   Copyright (C) 2002~2020, Beijing FMSoft Technologies Co., Ltd.
+ *   Copyright (C) 1998~2002, WEI Yongming
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *   Or,
+ *
+ *   As this program is a library, any link to this program must follow
+ *   GNU General Public License version 3 (GPLv3). If you cannot accept
+ *   GPLv3, you need to be licensed from FMSoft.
+ *
+ *   If you have got a commercial license of this program, please use it
+ *   under the terms and conditions of the commercial license.
+ *
+ *   For more information about the commercial license, please refer to
+ *   <http://www.minigui.com/blog/minigui-licensing-policy/>.
+ */
+/*
+** glyphblend.c: The SSE2 versions of the coverage blending of
+**  the anti-aliased glyph spans, for 32-bit and 16-bit destinations.
+**
+** The scan line renderers of the grey and the subpixel glyphs blend
+** the text color into the surface pixel by pixel. The routines here
+** blend 4 or 8 pixels per iteration instead, and skip the runs of the
+** pixels not covered. They use the integer arithmetic of the scalar
+** renderers in glyph.c exactly, so the result does not depend on the CPU.
+*/
+
+#include <stdio.h>
+#include <string.h>
+
+#include "common.h"
+#include "minigui.h"
+#include "gdi.h"
+#include "newgal.h"
+#include "devfont.h"
+#include "glyph.h"
+#include "../newgal/blit_simd.h"
+
+#ifdef GAL_SIMD_X86
+
+#include <immintrin.h>
+
+/* a component with the lost bits replicated, same as GAL_GetRGB */
+static inline unsigned expand_comp (unsigned v, int loss)
+{
+    return (v << loss) + (v >> (8 - loss));
+}
+
+/* d * (256 - a) + s * a <= 255 * 256, so it fits in a 16-bit lane */
+static inline unsigned blend_comp (unsigned d, unsigned s, unsigned a)
+{
+    return (d * (256 - a) + s * a) >> 8;
+}
+
+/* the renderer uses the coverage of a subpixel plus one if not zero */
+static inline unsigned subpixel_alpha (unsigned c)
+{
+    return c + (c != 0);
+}
+
+static inline Uint32 map_rgb (const GAL_PixelFormat* fmt,
+        unsigned r, unsigned g, unsigned b)
+{
+    return (r >> fmt->Rloss) << fmt->Rshift
+         | (g >> fmt->Gloss) << fmt->Gshift
+         | (b >> fmt->Bloss) << fmt->Bshift
+         | fmt->Amask;
+}
+
+/* The scalar versions, same as _glyph_blend_pixel and the subpixel
+ * renderer in glyph.c */
+static inline Uint32 blend_grey_pixel (const GLYPH_BLEND_INFO* info,
+        Uint32 d, unsigned a)
+{
+    const GAL_PixelFormat* fmt = info->format;
+    unsigned r, g, b;
+
+    RGB_FROM_PIXEL (d, fmt, r, g, b);
+    return map_rgb (fmt, blend_comp (r, info->r, a),
+            blend_comp (g, info->g, a), blend_comp (b, info->b, a));
+}
+
+static inline Uint32 blend_subpixel_pixel (const GLYPH_BLEND_INFO* info,
+        Uint32 d, const BYTE* c)
+{
+    const GAL_PixelFormat* fmt = info->format;
+    unsigned r, g, b;
+
+    r = expand_comp ((d & fmt->Rmask) >> fmt->Rshift, fmt->Rloss);
+    g = expand_comp ((d & fmt->Gmask) >> fmt->Gshift, fmt->Gloss);
+    b = expand_comp ((d & fmt->Bmask) >> fmt->Bshift, fmt->Bloss);
+    return map_rgb (fmt, blend_comp (r, info->r, subpixel_alpha (c [0])),
+            blend_comp (g, info->g, subpixel_alpha (c [1])),
+            blend_comp (b, info->b, subpixel_alpha (c [2])));
+}
+
+#define GREY_TAIL(type)                                                 \
+    for (; w > 0; w--, p++, coverage++) {                               \
+        if (*coverage)                                                  \
+            *p = (type)blend_grey_pixel (info, *p, *coverage);          \
+    }
+
+#define SUBPIXEL_TAIL(type)                                             \
+    for (; w > 0; w--, p++, coverage += 3) {                            \
+        if (coverage [0] || coverage [1] || coverage [2])               \
+            *p = (type)blend_subpixel_pixel (info, *p, coverage);       \
+    }
+
+/* the text color as a 32-bit pixel without alpha */
+static inline Uint32 source_pixel_32 (const GLYPH_BLEND_INFO* info)
+{
+    const GAL_PixelFormat* fmt = info->format;
+
+    return (Uint32)info->r << fmt->Rshift | (Uint32)info->g << fmt->Gshift
+         | (Uint32)info->b << fmt->Bshift;
+}
+
+/* the coverage of 4 pixels of a subpixel glyph laid out as the pixels */
+static inline Uint32 subpixel_coverage_32 (const GAL_PixelFormat* fmt,
+        Uint32* cov, const BYTE* c)
+{
+    int i;
+
+    for (i = 0; i < 4; i++, c += 3) {
+        cov [i] = (Uint32)c [0] << fmt->Rshift
+                | (Uint32)c [1] << fmt->Gshift
+                | (Uint32)c [2] << fmt->Bshift;
+    }
+
+    return cov [0] | cov [1] | cov [2] | cov [3];
+}
+
+/* the coverage of 8 pixels of a subpixel glyph, one plane a component */
+static inline Uint64 subpixel_coverage_16 (BYTE cov [3][8], const BYTE* c)
+{
+    Uint64 r, g, b;
+    int i;
+
+    for (i = 0; i < 8; i++, c += 3) {
+        cov [0][i] = c [0];
+        cov [1][i] = c [1];
+        cov [2][i] = c [2];
+    }
+
+    memcpy (&r, cov [0], sizeof (r));
+    memcpy (&g, cov [1], sizeof (g));
+    memcpy (&b, cov [2], sizeof (b));
+    return r | g | b;
+}
+
+static inline GAL_TARGET_SSE2 __m128i
+blend_comp_sse2 (__m128i d, __m128i s, __m128i a)
+{
+    __m128i t = _mm_mullo_epi16 (d, _mm_sub_epi16 (_mm_set1_epi16 (256), a));
+    return _mm_srli_epi16 (_mm_add_epi16 (t, _mm_mullo_epi16 (s, a)), 8);
+}
+
+static inline GAL_TARGET_SSE2 __m128i subpixel_alpha_sse2 (__m128i c)
+{
+    return _mm_add_epi16 (c, _mm_min_epi16 (c, _mm_set1_epi16 (1)));
+}
+
+/*
+ * Blends 4 32-bit pixels by the alpha of their bytes in alo and ahi,
+ * and leaves the pixels in keep untouched.
+ */
+static inline GAL_TARGET_SSE2 __m128i
+blend_32_sse2 (__m128i d, __m128i s16, __m128i alo, __m128i ahi,
+        __m128i keep, __m128i rgb, __m128i amask)
+{
+    const __m128i zero = _mm_setzero_si128 ();
+    __m128i lo, hi;
+
+    lo = blend_comp_sse2 (_mm_unpacklo_epi8 (d, zero), s16, alo);
+    hi = blend_comp_sse2 (_mm_unpackhi_epi8 (d, zero), s16, ahi);
+    lo = _mm_or_si128 (_mm_and_si128 (_mm_packus_epi16 (lo, hi), rgb), amask);
+    return _mm_or_si128 (_mm_and_si128 (keep, d), _mm_andnot_si128 (keep, lo));
+}
+
+#define SSE2_32_PROLOGUE                                                    \
+    const GAL_PixelFormat* fmt = info->format;                              \
+    const __m128i zero = _mm_setzero_si128 ();                              \
+    const __m128i rgb = _mm_set1_epi32 (fmt->Rmask|fmt->Gmask|fmt->Bmask);  \
+    const __m128i amask = _mm_set1_epi32 (fmt->Amask);                      \
+    const __m128i s16 = _mm_unpacklo_epi8 (                                 \
+            _mm_set1_epi32 (source_pixel_32 (info)), zero);                 \
+    Uint32* p = (Uint32*)dst;
+
+static GAL_TARGET_SSE2 void blend_grey_32_sse2 (const GLYPH_BLEND_INFO* info,
+        void* dst, const BYTE* coverage, int w)
+{
+    SSE2_32_PROLOGUE
+
+    for (; w >= 4; w -= 4, p += 4, coverage += 4) {
+        Uint32 a4;
+        __m128i a8, d;
+
+        memcpy (&a4, coverage, sizeof (a4));
+        if (a4 == 0)
+            continue;
+
+        /* the alpha of a pixel in all its bytes */
+        a8 = _mm_cvtsi32_si128 ((int)a4);
+        a8 = _mm_unpacklo_epi8 (a8, a8);
+        a8 = _mm_unpacklo_epi16 (a8, a8);
+
+        d = _mm_loadu_si128 ((const __m128i *)p);
+        _mm_storeu_si128 ((__m128i *)p, blend_32_sse2 (d, s16,
+                    _mm_unpacklo_epi8 (a8, zero), _mm_unpackhi_epi8 (a8, zero),
+                    _mm_cmpeq_epi32 (a8, zero), rgb, amask));
+    }
+
+    GREY_TAIL(Uint32)
+}
+
+static GAL_TARGET_SSE2 void blend_subpixel_32_sse2 (
+        const GLYPH_BLEND_INFO* info, void* dst, const BYTE* coverage, int w)
+{
+    SSE2_32_PROLOGUE
+
+    for (; w >= 4; w -= 4, p += 4, coverage += 12) {
+        Uint32 cov [4];
+        __m128i c8, d;
+
+        if (subpixel_coverage_32 (fmt, cov, coverage) == 0)
+            continue;
+
+        c8 = _mm_loadu_si128 ((const __m128i *)cov);
+        d = _mm_loadu_si128 ((const __m128i *)p);
+        _mm_storeu_si128 ((__m128i *)p, blend_32_sse2 (d, s16,
+                    subpixel_alpha_sse2 (_mm_unpacklo_epi8 (c8, zero)),
+                    subpixel_alpha_sse2 (_mm_unpackhi_epi8 (c8, zero)),
+                    _mm_cmpeq_epi32 (c8, zero), rgb, amask));
+    }
+
+    SUBPIXEL_TAIL(Uint32)
+}
+
+/* The components of 8 16-bit pixels in 16-bit lanes, and back */
+#define SSE2_GET_COMP16(d, c)                                           \
+    _mm_sll_epi16 (_mm_srl_epi16 (_mm_and_si128 (d, c##mask), c##sh), c##loss)
+
+#define SSE2_EXPAND_COMP16(d, c)                                        \
+    _mm_or_si128 (SSE2_GET_COMP16 (d, c), _mm_srl_epi16 (               \
+            _mm_srl_epi16 (_mm_and_si128 (d, c##mask), c##sh), c##rep))
+
+#define SSE2_PUT_COMP16(v, c)                                           \
+    _mm_sll_epi16 (_mm_srl_epi16 (v, c##loss), c##sh)
+
+#define SSE2_16_PROLOGUE                                                \
+    const GAL_PixelFormat* fmt = info->format;                          \
+    const __m128i zero = _mm_setzero_si128 ();                          \
+    const __m128i amask = _mm_set1_epi16 ((short)fmt->Amask);           \
+    const __m128i rmask = _mm_set1_epi16 ((short)fmt->Rmask);           \
+    const __m128i gmask = _mm_set1_epi16 ((short)fmt->Gmask);           \
+    const __m128i bmask = _mm_set1_epi16 ((short)fmt->Bmask);           \
+    const __m128i rsh = _mm_cvtsi32_si128 (fmt->Rshift);                \
+    const __m128i gsh = _mm_cvtsi32_si128 (fmt->Gshift);                \
+    const __m128i bsh = _mm_cvtsi32_si128 (fmt->Bshift);                \
+    const __m128i rloss = _mm_cvtsi32_si128 (fmt->Rloss);               \
+    const __m128i gloss = _mm_cvtsi32_si128 (fmt->Gloss);               \
+    const __m128i bloss = _mm_cvtsi32_si128 (fmt->Bloss);               \
+    const __m128i sr = _mm_set1_epi16 (info->r);                        \
+    const __m128i sg = _mm_set1_epi16 (info->g);                        \
+    const __m128i sb = _mm_set1_epi16 (info->b);                        \
+    Uint16* p = (Uint16*)dst;
+
+static inline GAL_TARGET_SSE2 __m128i
+select_16_sse2 (__m128i keep, __m128i d, __m128i v)
+{
+    return _mm_or_si128 (_mm_and_si128 (keep, d), _mm_andnot_si128 (keep, v));
+}
+
+static GAL_TARGET_SSE2 void blend_grey_16_sse2 (const GLYPH_BLEND_INFO* info,
+        void* dst, const BYTE* coverage, int w)
+{
+    SSE2_16_PROLOGUE
+
+    for (; w >= 8; w -= 8, p += 8, coverage += 8) {
+        Uint64 a8;
+        __m128i a, d, v;
+
+        memcpy (&a8, coverage, sizeof (a8));
+        if (a8 == 0)
+            continue;
+
+        a = _mm_unpacklo_epi8 (_mm_loadl_epi64 ((const __m128i *)coverage),
+                zero);
+        d = _mm_loadu_si128 ((const __m128i *)p);
+        v = _mm_or_si128 (amask,
+                SSE2_PUT_COMP16 (blend_comp_sse2 (
+                        SSE2_GET_COMP16 (d, r), sr, a), r));
+        v = _mm_or_si128 (v, SSE2_PUT_COMP16 (blend_comp_sse2 (
+                        SSE2_GET_COMP16 (d, g), sg, a), g));
+        v = _mm_or_si128 (v, SSE2_PUT_COMP16 (blend_comp_sse2 (
+                        SSE2_GET_COMP16 (d, b), sb, a), b));
+        _mm_storeu_si128 ((__m128i *)p,
+                select_16_sse2 (_mm_cmpeq_epi16 (a, zero), d, v));
+    }
+
+    GREY_TAIL(Uint16)
+}
+
+static GAL_TARGET_SSE2 void blend_subpixel_16_sse2 (
+        const GLYPH_BLEND_INFO* info, void* dst, const BYTE* coverage, int w)
+{
+    SSE2_16_PROLOGUE
+    const __m128i rrep = _mm_cvtsi32_si128 (8 - fmt->Rloss);
+    const __m128i grep = _mm_cvtsi32_si128 (8 - fmt->Gloss);
+    const __m128i brep = _mm_cvtsi32_si128 (8 - fmt->Bloss);
+
+    for (; w >= 8; w -= 8, p += 8, coverage += 24) {
+        BYTE cov [3][8];
+        __m128i cr, cg, cb, d, v;
+
+        if (subpixel_coverage_16 (cov, coverage) == 0)
+            continue;
+
+        cr = _mm_unpacklo_epi8 (_mm_loadl_epi64 ((const __m128i *)cov [0]),
+                zero);
+        cg = _mm_unpacklo_epi8 (_mm_loadl_epi64 ((const __m128i *)cov [1]),
+                zero);
+        cb = _mm_unpacklo_epi8 (_mm_loadl_epi64 ((const __m128i *)cov [2]),
+                zero);
+        d = _mm_loadu_si128 ((const __m128i *)p);
+        v = _mm_or_si128 (amask,
+                SSE2_PUT_COMP16 (blend_comp_sse2 (SSE2_EXPAND_COMP16 (d, r),
+                        sr, subpixel_alpha_sse2 (cr)), r));
+        v = _mm_or_si128 (v,
+                SSE2_PUT_COMP16 (blend_comp_sse2 (SSE2_EXPAND_COMP16 (d, g),
+                        sg, subpixel_alpha_sse2 (cg)), g));
+        v = _mm_or_si128 (v,
+                SSE2_PUT_COMP16 (blend_comp_sse2 (SSE2_EXPAND_COMP16 (d, b),
+                        sb, subpixel_alpha_sse2 (cb)), b));
+        _mm_storeu_si128 ((__m128i *)p, select_16_sse2 (_mm_cmpeq_epi16 (
+                        _mm_or_si128 (_mm_or_si128 (cr, cg), cb), zero), d, v));
+    }
+
+    SUBPIXEL_TAIL(Uint16)
+}
+
+#define IS_BYTE_COMP(mask, shift, loss)                                 \
+    ((loss) == 0 && ((shift) & 7) == 0 && (mask) == (0xFFU << (shift)))
+
+#define IS_16BIT_COMP(mask, shift, loss)                                \
+    ((loss) < 8 && (mask) == ((0xFFU >> (loss)) << (shift)))
+
+/*
+ * The blenders work on the pixels of which the RGB components are
+ * contiguous masks; and on a 32-bit pixel, every component is a byte.
+ */
+static int blender_pixel_size (const GAL_PixelFormat* format)
+{
+#if defined(_NEWGAL_SWAP16) || defined(_EM86_IAL) || defined(_EM85_IAL)
+    /* GAL_MapRGB does more than packing the components */
+    return 0;
+#endif
+
+    if (format->palette)
+        return 0;
+
+    if (format->BytesPerPixel == 4
+            && IS_BYTE_COMP (format->Rmask, format->Rshift, format->Rloss)
+            && IS_BYTE_COMP (format->Gmask, format->Gshift, format->Gloss)
+            && IS_BYTE_COMP (format->Bmask, format->Bshift, format->Bloss))
+        return 4;
+
+    if (format->BytesPerPixel == 2
+            && IS_16BIT_COMP (format->Rmask, format->Rshift, format->Rloss)
+            && IS_16BIT_COMP (format->Gmask, format->Gshift, format->Gloss)
+            && IS_16BIT_COMP (format->Bmask, format->Bshift, format->Bloss))
+        return 2;
+
+    return 0;
+}
+
+#endif  /* GAL_SIMD_X86 */
+
+CB_GLYPH_BLEND __mg_get_glyph_blender (const GAL_PixelFormat* format,
+        BOOL subpixel)
+{
+#ifdef GAL_SIMD_X86
+    Uint32 features = GAL_GetCPUFeatures ();
+    int size = blender_pixel_size (format);
+
+    if (size == 0)
+        return NULL;
+
+    if (features & GAL_CPU_SSE2) {
+        if (size == 4)
+            return subpixel ? blend_subpixel_32_sse2 : blend_grey_32_sse2;
+        return subpixel ? blend_subpixel_16_sse2 : blend_grey_16_sse2;
+    }
+#endif  /* GAL_SIMD_X86 */
+
+    return NULL;
+}
@@ -0,0 +1,288 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+//                          IMPORTANT NOTICE
+//
+// The following open source license statement does not apply to any
+// entity in the Exception List published by FMSoft.
+//
+// For more information, please visit:
+//
+// https://www.fmsoft.cn/exception-list
+//
+//////////////////////////////////////////////////////////////////////////////
+/*
+ *   This file is part of MiniGUI, a mature cross-platform windowing
+ *   and Graphics User Interface (GUI) support system for embedded systems
+ *   and smart IoT devices.
+ *
+ *   Copyright (C) 2002~2020, Beijing FMSoft Technologies Co., Ltd.
+ *   Copyright (C) 1998~2002, WEI Yongming
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *   Or,
+ *
+ *   As this program is a library, any link to this program must follow
+ *   GNU General Public License version 3 (GPLv3). If you cannot accept
+ *   GPLv3, you need to be licensed from FMSoft.
+ *
+ *   If you have got a commercial license of this program, please use it
+ *   under the terms and conditions of the commercial license.
+ *
+ *   For more information about the commercial license, please refer to
+ *   <http://www.minigui.com/blog/minigui-licensing-policy/>.
+ */
+/*
+** glyphcache.c: The cache of post-processed glyph bitmaps.
+**
+** The bitmaps returned by the device fonts are expanded for the bold
+** style and the scale factor, and flipped, before they are drawn. This
+** cache keeps the results, so a glyph drawn again with the same logical
+** font costs a lookup only. It works for all font engines, and is
+** bounded by a memory budget with LRU eviction.
+**
+** All functions are called with __mg_gdilock held, except
+** __mg_glyph_cache_purge and __mg_glyph_cache_term, so a lock of the
+** cache itself is only needed for these two in MiniGUI-Threads.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "common.h"
+
+#ifdef _MGFONT_GLYPH_CACHE
+
+#include "minigui.h"
+#include "gdi.h"
+#include "devfont.h"
+#include "glyph.h"
+
+#define NR_HASH_BUCKETS     1024
+
+typedef struct _GLYPHNODE {
+    GLYPHCACHEKEY key;
+    GLYPHBITS bits;
+    size_t mem_size;
+
+    struct _GLYPHNODE* hash_next;
+    struct _GLYPHNODE* lru_prev;
+    struct _GLYPHNODE* lru_next;
+} GLYPHNODE;
+
+static GLYPHNODE** hash_buckets;
+
+/* lru_head is the most recently used one */
+static GLYPHNODE* lru_head;
+static GLYPHNODE* lru_tail;
+static size_t mem_used;
+
+/* statistics returned by GetGlyphCacheStats */
+static struct {
+    unsigned long nr_glyphs;
+    unsigned long nr_hits;
+    unsigned long nr_misses;
+    unsigned long nr_evictions;
+} cache_stats;
+
+#ifdef _MGRM_THREADS
+static pthread_mutex_t cache_lock = PTHREAD_MUTEX_INITIALIZER;
+#   define LOCK_CACHE()     pthread_mutex_lock (&cache_lock)
+#   define UNLOCK_CACHE()   pthread_mutex_unlock (&cache_lock)
+#else
+#   define LOCK_CACHE()
+#   define UNLOCK_CACHE()
+#endif
+
+static inline unsigned int hash_key (const GLYPHCACHEKEY* key)
+{
+    unsigned int h = (unsigned int)((DWORD_PTR)key->devfont >> 4);
+
+    h = h * 31 + key->glyph;
+    h = h * 31 + key->style;
+    h = h * 31 + (key->size << 8) + key->bold;
+    h = h * 31 + key->rotation;
+    h = h * 31 + (unsigned int)((DWORD_PTR)key->cb >> 4);
+    return (h ^ (h >> 16)) & (NR_HASH_BUCKETS - 1);
+}
+
+static inline BOOL equal_keys (const GLYPHCACHEKEY* a, const GLYPHCACHEKEY* b)
+{
+    return a->devfont == b->devfont && a->glyph == b->glyph &&
+        a->style == b->style && a->size == b->size &&
+        a->rotation == b->rotation && a->bold == b->bold && a->cb == b->cb;
+}
+
+static void lru_unlink (GLYPHNODE* node)
+{
+    if (node->lru_prev)
+        node->lru_prev->lru_next = node->lru_next;
+    else
+        lru_head = node->lru_next;
+
+    if (node->lru_next)
+        node->lru_next->lru_prev = node->lru_prev;
+    else
+        lru_tail = node->lru_prev;
+}
+
+static void lru_push_head (GLYPHNODE* node)
+{
+    node->lru_prev = NULL;
+    node->lru_next = lru_head;
+    if (lru_head)
+        lru_head->lru_prev = node;
+    else
+        lru_tail = node;
+    lru_head = node;
+}
+
+static void remove_node (GLYPHNODE* node)
+{
+    GLYPHNODE** pp = hash_buckets + hash_key (&node->key);
+
+    while (*pp != node)
+        pp = &(*pp)->hash_next;
+    *pp = node->hash_next;
+
+    lru_unlink (node);
+    mem_used -= node->mem_size;
+    cache_stats.nr_glyphs--;
+    free (node);
+}
+
+const GLYPHBITS* __mg_glyph_cache_find (const GLYPHCACHEKEY* key)
+{
+    GLYPHNODE* node;
+
+    if (hash_buckets == NULL)
+        return NULL;
+
+    LOCK_CACHE ();
+    for (node = hash_buckets [hash_key (key)]; node; node = node->hash_next) {
+        if (equal_keys (&node->key, key)) {
+            if (node != lru_head) {
+                lru_unlink (node);
+                lru_push_head (node);
+            }
+            cache_stats.nr_hits++;
+            break;
+        }
+    }
+
+    if (node == NULL)
+        cache_stats.nr_misses++;
+    UNLOCK_CACHE ();
+
+    return node ? &node->bits : NULL;
+}
+
+const GLYPHBITS* __mg_glyph_cache_add (const GLYPHCACHEKEY* key,
+        const BYTE* bits, int pitch, const SIZE* bbox, unsigned short scale)
+{
+    GLYPHNODE* node;
+    size_t bits_size, mem_size;
+    unsigned int h;
+
+    bits_size = (size_t)pitch * bbox->cy;
+    mem_size = sizeof (GLYPHNODE) + bits_size;
+
+    /* do not let a huge glyph flush the cache */
+    if (pitch <= 0 || bbox->cy <= 0 ||
+            mem_size > (_MGGLYPH_CACHE_SIZE * 1024) / 8)
+        return NULL;
+
+    LOCK_CACHE ();
+
+    if (hash_buckets == NULL) {
+        hash_buckets = calloc (NR_HASH_BUCKETS, sizeof (GLYPHNODE*));
+        if (hash_buckets == NULL)
+            goto fail;
+    }
+
+    while (lru_tail && mem_used + mem_size > _MGGLYPH_CACHE_SIZE * 1024) {
+        remove_node (lru_tail);
+        cache_stats.nr_evictions++;
+    }
+
+    if ((node = malloc (mem_size)) == NULL)
+        goto fail;
+
+    node->key = *key;
+    node->bits.w = bbox->cx;
+    node->bits.h = bbox->cy;
+    node->bits.pitch = pitch;
+    node->bits.scale = scale;
+    node->bits.bits = (BYTE*)(node + 1);
+    memcpy (node + 1, bits, bits_size);
+    node->mem_size = mem_size;
+
+    h = hash_key (key);
+    node->hash_next = hash_buckets [h];
+    hash_buckets [h] = node;
+    lru_push_head (node);
+
+    mem_used += mem_size;
+    cache_stats.nr_glyphs++;
+    UNLOCK_CACHE ();
+    return &node->bits;
+
+fail:
+    UNLOCK_CACHE ();
+    return NULL;
+}
+
+void __mg_glyph_cache_purge (const DEVFONT* devfont)
+{
+    GLYPHNODE *node, *next;
+
+    LOCK_CACHE ();
+    for (node = lru_head; node; node = next) {
+        next = node->lru_next;
+        if (node->key.devfont == devfont)
+            remove_node (node);
+    }
+    UNLOCK_CACHE ();
+}
+
+void __mg_glyph_cache_term (void)
+{
+    LOCK_CACHE ();
+    while (lru_head)
+        remove_node (lru_head);
+
+    free (hash_buckets);
+    hash_buckets = NULL;
+
+    memset (&cache_stats, 0, sizeof (cache_stats));
+    UNLOCK_CACHE ();
+}
+
+BOOL GUIAPI GetGlyphCacheStats (GlyphCacheStats* stats)
+{
+    if (stats == NULL)
+        return FALSE;
+
+    LOCK_CACHE ();
+    stats->nr_glyphs = cache_stats.nr_glyphs;
+    stats->mem_used = mem_used;
+    stats->nr_hits = cache_stats.nr_hits;
+    stats->nr_misses = cache_stats.nr_misses;
+    stats->nr_evictions = cache_stats.nr_evictions;
+    UNLOCK_CACHE ();
+    return TRUE;
+}
+
+#endif /* _MGFONT_GLYPH_CACHE */
@@ -153,6 +153,7 @@ LAYOUT* GUIAPI CreateLayout(
 
     INIT_LIST_HEAD(&layout->lines);
     layout->nr_left_ucs = truns->nr_ucs;
+    layout->nr_changes = truns->nr_changes;
 
     if (render_flags & GRF_WRITING_MODE_VERTICAL_FLAG) {
         if (!check_logfont_rotatable(layout->lf_upright)) {
@@ -219,6 +220,15 @@ static void release_line(LAYOUTLINE* line)
     mg_slice_delete(LAYOUTLINE, line);
 }
 
+static void release_lines(struct list_head* lines)
+{
+    while (!list_empty(lines)) {
+        LAYOUTLINE* line = (LAYOUTLINE*)lines->prev;
+        list_del(lines->prev);
+        release_line(line);
+    }
+}
+
 BOOL GUIAPI DestroyLayout(LAYOUT* layout)
 {
     if (layout->lf_upright) {
@@ -228,11 +238,7 @@ BOOL GUIAPI DestroyLayout(LAYOUT* layout)
         }
     }
 
-    while (!list_empty(&layout->lines)) {
-        LAYOUTLINE* line = (LAYOUTLINE*)layout->lines.prev;
-        list_del(layout->lines.prev);
-        release_line(line);
-    }
+    release_lines(&layout->lines);
 
     mg_slice_delete(LAYOUT, layout);
     return TRUE;
@@ -2182,39 +2188,12 @@ static int traverse_line_glyphs(const LAYOUT* layout,
     return j;
 }
 
-LAYOUTLINE* GUIAPI LayoutNextLine(
-        LAYOUT* layout, LAYOUTLINE* prev_line,
-        int max_extent, BOOL last_line,
-        CB_GLYPH_LAID_OUT cb_laid_out, GHANDLE ctxt)
+static LAYOUTLINE* layout_next_line(LAYOUT* layout, LAYOUTLINE* prev_line,
+        int max_extent, BOOL last_line)
 {
     LAYOUTLINE* next_line = NULL;
     LayoutState state;
 
-    if (prev_line && prev_line->list.next &&
-            prev_line->list.next != &layout->lines) {
-        // must be a line persisted and not the last line.
-        next_line = (LAYOUTLINE*)prev_line->list.next;
-        goto out;
-    }
-
-    if (layout->persist && layout->nr_left_ucs == 0) {
-        // already laid out
-
-        if (list_empty(&layout->lines))
-            return NULL;
-
-        if (prev_line == NULL) {
-            next_line = (LAYOUTLINE*)layout->lines.next;
-            goto out;
-        }
-        else if (prev_line->list.next != &layout->lines) {
-            next_line = (LAYOUTLINE*)prev_line->list.next;
-            goto out;
-        }
-
-        return NULL;
-    }
-
     // init state here
 
     state.last_line = last_line ? 1 : 0;
@@ -2230,8 +2209,7 @@ LAYOUTLINE* GUIAPI LayoutNextLine(
     if (prev_line == NULL) {
         if (list_empty(&layout->truns->truns)) {
             // empty line
-            next_line = NULL;
-            goto out;
+            return NULL;
         }
 
         state.line_start_index = 0;
@@ -2251,8 +2229,7 @@ LAYOUTLINE* GUIAPI LayoutNextLine(
             state.trun);
 
         if (state.trun == NULL) {
-            next_line = NULL;
-            goto out;
+            return NULL;
         }
     }
 
@@ -2313,6 +2290,37 @@ LAYOUTLINE* GUIAPI LayoutNextLine(
             layout->nr_left_ucs -= next_line->len;
     }
 
+    return next_line;
+}
+
+LAYOUTLINE* GUIAPI LayoutNextLine(
+        LAYOUT* layout, LAYOUTLINE* prev_line,
+        int max_extent, BOOL last_line,
+        CB_GLYPH_LAID_OUT cb_laid_out, GHANDLE ctxt)
+{
+    LAYOUTLINE* next_line = NULL;
+
+    if (prev_line && prev_line->list.next &&
+            prev_line->list.next != &layout->lines) {
+        // must be a line persisted and not the last line.
+        next_line = (LAYOUTLINE*)prev_line->list.next;
+        goto out;
+    }
+
+    if (layout->persist && prev_line == NULL &&
+            !list_empty(&layout->lines)) {
+        // the lines persisted, maybe updated by UpdateLayout
+        next_line = (LAYOUTLINE*)layout->lines.next;
+        goto out;
+    }
+
+    if (layout->persist && layout->nr_left_ucs == 0) {
+        // already laid out
+        return NULL;
+    }
+
+    next_line = layout_next_line(layout, prev_line, max_extent, last_line);
+
     // Release the previous line after got the next line.
     // This will avoid releasing the LOGFONT objects earlier.
     if (layout->persist == 0 && prev_line) {
@@ -2332,6 +2340,191 @@ out:
     return next_line;
 }
 
+/* Points the runs of a line reused to the text changed. */
+static void rebase_line(const LAYOUT* layout, LAYOUTLINE* line, int delta)
+{
+    struct list_head* i;
+
+    line->si += delta;
+    list_for_each(i, &line->gruns) {
+        GlyphRun* run = (GlyphRun*)i;
+
+        run->lrun->si += delta;
+        if (!(run->lrun->flags & LAYOUTRUN_FLAG_ELLIPSIS))
+            run->lrun->ucs = layout->truns->ucs + run->lrun->si;
+    }
+}
+
+/*
+ * The lines are laid out again from the line before the one containing
+ * the change, since the first word changed may fit in it now. When a
+ * new line ends where an old line after the change starts, the old line
+ * and the lines after it are reused.
+ */
+BOOL GUIAPI UpdateLayout(LAYOUT* layout, const BreakOppo* break_oppos,
+        int* first_line, int* nr_lines)
+{
+    const TEXTRUNS* truns;
+    struct list_head old_lines;
+    struct list_head *i, *n, *kept_tail;
+    LAYOUTLINE *prev_line, *old_line, *reused_line;
+    int chg_si, chg_old_end, delta;
+    int nr_kept, nr_old_left, reused_index, nr_relaid = 0;
+    int max_extent = -1;
+
+    if (layout == NULL)
+        return FALSE;
+
+    truns = layout->truns;
+    if (break_oppos)
+        layout->bos = break_oppos;
+
+    if (layout->nr_changes == truns->nr_changes) {
+        // not changed
+        if (first_line) *first_line = layout->nr_lines;
+        if (nr_lines) *nr_lines = 0;
+        return TRUE;
+    }
+
+    if (layout->persist == 0 || layout->nr_changes + 1 != truns->nr_changes) {
+        // lay out the whole paragraph again
+        release_lines(&layout->lines);
+        layout->nr_lines = 0;
+        layout->nr_left_ucs = truns->nr_ucs;
+        layout->nr_changes = truns->nr_changes;
+        if (first_line) *first_line = 0;
+        if (nr_lines) *nr_lines = 0;
+        return TRUE;
+    }
+
+    chg_si = truns->chg_si;
+    chg_old_end = chg_si + truns->chg_old_len;
+    delta = truns->chg_new_len - truns->chg_old_len;
+    layout->nr_changes = truns->nr_changes;
+
+    // the number of the chars not laid out after the change
+    nr_old_left = layout->nr_left_ucs;
+    if (nr_old_left > 0)
+        nr_old_left += delta;
+
+    // find the line before the one containing the change
+    nr_kept = 0;
+    prev_line = NULL;
+    old_line = NULL;
+    list_for_each(i, &layout->lines) {
+        LAYOUTLINE* line = (LAYOUTLINE*)i;
+
+        if (line->si > chg_si)
+            break;
+
+        prev_line = old_line;
+        old_line = line;
+        nr_kept++;
+    }
+
+    if (old_line == NULL) {
+        // no line laid out
+        layout->nr_left_ucs = nr_old_left;
+        if (first_line) *first_line = 0;
+        if (nr_lines) *nr_lines = 0;
+        return TRUE;
+    }
+
+    if (prev_line) {
+        old_line = prev_line;
+        nr_kept--;
+    }
+    nr_kept--;
+
+    // move the lines from old_line on to old_lines
+    INIT_LIST_HEAD(&old_lines);
+    kept_tail = old_line->list.prev;
+    while (layout->lines.prev != kept_tail) {
+        struct list_head* entry = layout->lines.prev;
+        list_del(entry);
+        list_add(entry, &old_lines);
+    }
+
+    list_for_each(i, &layout->lines) {
+        rebase_line(layout, (LAYOUTLINE*)i, 0);
+    }
+
+    layout->nr_lines = nr_kept;
+    layout->nr_left_ucs = truns->nr_ucs - old_line->si;
+    prev_line = list_empty(&layout->lines) ? NULL :
+            (LAYOUTLINE*)layout->lines.prev;
+
+    // old_line is the old one at the index of the line to lay out
+    reused_line = old_line;
+    reused_index = nr_kept;
+    while (layout->nr_left_ucs > nr_old_left || nr_old_left == 0) {
+        LAYOUTLINE* line;
+        BOOL last_line = FALSE;
+        int end;
+
+        // use the extent of the old line or the last old line
+        if (old_line) {
+            max_extent = old_line->max_extent;
+            last_line = old_line->is_last_line;
+        }
+
+        line = layout_next_line(layout, prev_line, max_extent, last_line);
+        if (line == NULL)
+            break;
+        nr_relaid++;
+
+        if (old_line) {
+            old_line = (old_line->list.next == &old_lines) ? NULL :
+                    (LAYOUTLINE*)old_line->list.next;
+        }
+
+        if (layout->nr_left_ucs == 0)
+            break;
+
+        // find the old line starting at the end of the new line
+        end = line->si + line->len;
+        while (reused_line && reused_line->si + delta < end) {
+            reused_line = (reused_line->list.next == &old_lines) ? NULL :
+                    (LAYOUTLINE*)reused_line->list.next;
+            reused_index++;
+        }
+
+        if (reused_line && reused_line->si + delta == end &&
+                reused_line->si > chg_old_end &&
+                ((layout->rf & GRF_LINE_EXTENT_MASK) ==
+                    GRF_LINE_EXTENT_FIXED ||
+                 reused_index == layout->nr_lines)) {
+            // reuse the old lines from reused_line on
+            while (old_lines.next != &reused_line->list) {
+                LAYOUTLINE* old = (LAYOUTLINE*)old_lines.next;
+                list_del(&old->list);
+                release_line(old);
+            }
+
+            list_for_each_safe(i, n, &old_lines) {
+                LAYOUTLINE* old = (LAYOUTLINE*)i;
+
+                rebase_line(layout, old, delta);
+                old->is_paragraph_start = 0;
+                list_del(i);
+                list_add_tail(i, &layout->lines);
+                layout->nr_lines++;
+            }
+
+            layout->nr_left_ucs = nr_old_left;
+            break;
+        }
+
+        prev_line = line;
+    }
+
+    release_lines(&old_lines);
+
+    if (first_line) *first_line = nr_kept;
+    if (nr_lines) *nr_lines = nr_relaid;
+    return TRUE;
+}
+
 BOOL GUIAPI GetLayoutLineSize(const LAYOUTLINE* line,
         SIZE* line_size)
 {
@@ -150,6 +150,7 @@ struct _LAYOUT {
     LOGFONT*            lf_upright; // the default upright logfont
     int                 nr_left_ucs;// the number of chars not laied out
     int                 nr_lines;   // the number of lines
+    Uint32              nr_changes; // the changes of the text runs laid out
 
     Uint32              grv_base:4; // the base gravity
     Uint32              grv_plc:2;  // the gravity policy specified
@@ -242,6 +242,18 @@ void GUIAPI RGBA2Pixels (HDC hdc, const RGB* rgbs, gal_pixel* pixels, int count)
     int i;
     PDC pdc = dc_HDC2PDC (hdc);
 
+    /* the pixels of a premultiplied DC keep the premultiplied colors */
+    if (pdc->surface->flags & GAL_PREMULALPHA) {
+        for (i = 0; i < count; i++) {
+            pixels [i] = GAL_MapRGBA (pdc->surface->format,
+                        GAL_PremulComponent (rgbs[i].r, rgbs[i].a),
+                        GAL_PremulComponent (rgbs[i].g, rgbs[i].a),
+                        GAL_PremulComponent (rgbs[i].b, rgbs[i].a),
+                        rgbs[i].a);
+        }
+        return;
+    }
+
     for (i = 0; i < count; i++) {
         pixels [i] = GAL_MapRGBA (pdc->surface->format,
                         rgbs[i].r, rgbs[i].g, rgbs[i].b, rgbs[i].a);
@@ -268,5 +280,13 @@ void GUIAPI Pixel2RGBAs (HDC hdc, const gal_pixel* pixels, RGB* rgbs, int count)
         GAL_GetRGBA (pixels[i], pdc->surface->format,
                         &rgbs[i].r, &rgbs[i].g, &rgbs[i].b, &rgbs[i].a);
     }
+
+    if (pdc->surface->flags & GAL_PREMULALPHA) {
+        for (i = 0; i < count; i++) {
+            rgbs[i].r = GAL_UnpremulComponent (rgbs[i].r, rgbs[i].a);
+            rgbs[i].g = GAL_UnpremulComponent (rgbs[i].g, rgbs[i].a);
+            rgbs[i].b = GAL_UnpremulComponent (rgbs[i].b, rgbs[i].a);
+        }
+    }
 }
 
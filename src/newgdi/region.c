@@ -134,6 +134,7 @@ SOFTWARE.
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <errno.h>
 
 #include "common.h"
@@ -142,11 +143,6 @@ SOFTWARE.
 #include "gal.h"
 #include "blockheap.h"
 
-typedef void (*voidProcp1)(CLIPRGN *region, const CLIPRECT *r1, const CLIPRECT *r1End,
-                          const CLIPRECT *r2, const CLIPRECT *r2End, int top, int bottom);
-typedef void (*voidProcp2)(CLIPRGN *region, const CLIPRECT *r, const CLIPRECT *rEnd,
-                          int top, int bottom);
-
 /*  1 if two RECTs overlap.
  *  0 if two RECTs do not overlap.
  */
@@ -181,10 +177,269 @@ typedef void (*voidProcp2)(CLIPRGN *region, const CLIPRECT *r, const CLIPRECT *r
 
 extern BLOCKHEAP __mg_FreeClipRectList;
 
+/***********************************************************************
+ *           Band index
+ *
+ *      PtInRegion and RectInRegion would walk the list of clipping rects
+ *      from the head. For a complex region which is queried repeatedly,
+ *      e.g. a shaped region hit-tested on every mouse move, the rects are
+ *      copied into a band index, which supports binary searches on the
+ *      bands and on the rects in a band.
+ *
+ *      CLIPRGN is a public structure which callers may copy or build by
+ *      themselves, so the indexes are kept in a small cache here instead
+ *      of the region. Every function which changes or initializes a region
+ *      calls REGION_Changed, which drops the index of that region only;
+ *      an index is also checked against the head, tail and bounding rect
+ *      of the region. An index is built for the second query on the same
+ *      unchanged region, so a region queried once does not pay for it.
+ */
+#define NR_BAND_INDEXES     4
+
+typedef struct _BANDINDEX {
+    const CLIPRGN* region;
+    const CLIPRECT* head;
+    const CLIPRECT* tail;
+    RECT rcBound;
+
+    int nr_bands;
+    int* bands;         /* index of the first rect of each band, and nr_rects */
+    RECT* rects;
+} BANDINDEX;
+
+static BANDINDEX band_indexes [NR_BAND_INDEXES];
+static int next_band_index;
+static const CLIPRGN* last_queried;
+
+#ifdef _MGRM_THREADS
+static pthread_mutex_t band_index_lock = PTHREAD_MUTEX_INITIALIZER;
+#endif
+
+/*
+ * The owners of the indexes are written with band_index_lock locked, but
+ * are read without it by REGION_Changed.
+ */
+#if defined(_MGRM_THREADS) && defined(__GNUC__)
+#   define GET_OWNER(v)         __atomic_load_n (&(v), __ATOMIC_RELAXED)
+#   define SET_OWNER(v, rgn)    __atomic_store_n (&(v), (rgn), __ATOMIC_RELAXED)
+#else
+#   define GET_OWNER(v)         (v)
+#   define SET_OWNER(v, rgn)    ((v) = (rgn))
+#endif
+
+static void free_band_index (BANDINDEX* idx)
+{
+    SET_OWNER (idx->region, NULL);
+    free (idx->bands);
+    free (idx->rects);
+    idx->bands = NULL;
+    idx->rects = NULL;
+    idx->nr_bands = 0;
+}
+
+static BOOL build_band_index (BANDINDEX* idx, const CLIPRGN* region)
+{
+    const CLIPRECT *cliprect;
+    int nr_rects = 0, nr_bands = 0, top = 0, i;
+
+    for (cliprect = region->head; cliprect; cliprect = cliprect->next) {
+        if (nr_rects == 0 || cliprect->rc.top != top) {
+            top = cliprect->rc.top;
+            nr_bands++;
+        }
+        nr_rects++;
+    }
+
+    idx->bands = malloc (sizeof (int) * (nr_bands + 1));
+    idx->rects = malloc (sizeof (RECT) * nr_rects);
+    if (idx->bands == NULL || idx->rects == NULL) {
+        free_band_index (idx);
+        return FALSE;
+    }
+
+    nr_bands = 0;
+    i = 0;
+    for (cliprect = region->head; cliprect; cliprect = cliprect->next) {
+        if (i == 0 || cliprect->rc.top != top) {
+            top = cliprect->rc.top;
+            idx->bands [nr_bands++] = i;
+        }
+        idx->rects [i++] = cliprect->rc;
+    }
+    idx->bands [nr_bands] = nr_rects;
+    idx->nr_bands = nr_bands;
+
+    idx->head = region->head;
+    idx->tail = region->tail;
+    idx->rcBound = region->rcBound;
+    SET_OWNER (idx->region, region);
+    return TRUE;
+}
+
+/* Returns the index of the region; call with band_index_lock locked. */
+static BANDINDEX* get_band_index (const CLIPRGN* region)
+{
+    BANDINDEX* idx;
+    int i;
+
+    for (i = 0; i < NR_BAND_INDEXES; i++) {
+        idx = band_indexes + i;
+        if (idx->region == region &&
+                idx->head == region->head && idx->tail == region->tail &&
+                EqualRect (&idx->rcBound, &region->rcBound))
+            return idx;
+    }
+
+    /* the first query on this region since it was changed */
+    if (last_queried != region) {
+        SET_OWNER (last_queried, region);
+        return NULL;
+    }
+
+    idx = band_indexes + next_band_index;
+    next_band_index = (next_band_index + 1) % NR_BAND_INDEXES;
+    free_band_index (idx);
+    if (!build_band_index (idx, region))
+        return NULL;
+    return idx;
+}
+
+/* Returns the first band whose bottom is below y, or nr_bands. */
+static int find_band (const BANDINDEX* idx, int y)
+{
+    int lo = 0, hi = idx->nr_bands;
+
+    while (lo < hi) {
+        int mid = (lo + hi) >> 1;
+        if (idx->rects [idx->bands [mid]].bottom <= y)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    return lo;
+}
+
+/* Returns the first rect in the band whose right is beyond x. */
+static int find_rect_in_band (const BANDINDEX* idx, int band, int x)
+{
+    int lo = idx->bands [band], hi = idx->bands [band + 1];
+
+    while (lo < hi) {
+        int mid = (lo + hi) >> 1;
+        if (idx->rects [mid].right <= x)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    return lo;
+}
+
+/*
+ * Answers PtInRegion (rect is NULL) or RectInRegion by the band index.
+ * Returns -1 if the region has no index.
+ */
+static int REGION_QueryIndex (const CLIPRGN* region, int x, int y,
+        const RECT* rect)
+{
+    BANDINDEX* idx;
+    int band, i, ret = -1;
+
+    /* not worth an index */
+    if (region->head == region->tail)
+        return -1;
+
+#ifdef _MGRM_THREADS
+    pthread_mutex_lock (&band_index_lock);
+#endif
+
+    if ((idx = get_band_index (region)) == NULL)
+        goto done;
+
+    ret = FALSE;
+    if (rect == NULL) {
+        band = find_band (idx, y);
+        if (band < idx->nr_bands && idx->rects [idx->bands [band]].top <= y) {
+            i = find_rect_in_band (idx, band, x);
+            if (i < idx->bands [band + 1] && idx->rects [i].left <= x)
+                ret = TRUE;
+        }
+    }
+    else {
+        for (band = find_band (idx, rect->top); band < idx->nr_bands &&
+                idx->rects [idx->bands [band]].top < rect->bottom; band++) {
+            i = find_rect_in_band (idx, band, rect->left);
+            if (i < idx->bands [band + 1] && idx->rects [i].left < rect->right) {
+                ret = TRUE;
+                break;
+            }
+        }
+    }
+
+done:
+#ifdef _MGRM_THREADS
+    pthread_mutex_unlock (&band_index_lock);
+#endif
+    return ret;
+}
+
+void __mg_free_region_indexes (void)
+{
+    int i;
+
+#ifdef _MGRM_THREADS
+    pthread_mutex_lock (&band_index_lock);
+#endif
+
+    for (i = 0; i < NR_BAND_INDEXES; i++)
+        free_band_index (band_indexes + i);
+    SET_OWNER (last_queried, NULL);
+
+#ifdef _MGRM_THREADS
+    pthread_mutex_unlock (&band_index_lock);
+#endif
+}
+
+/*
+ * Drops the index of a region which is being changed. A region is not
+ * changed and queried by different threads at the same time, so only
+ * the index of this region is looked for, and without the lock in most
+ * cases: the changes of the other regions keep their indexes.
+ */
+static void REGION_Changed (const CLIPRGN* region)
+{
+    BOOL owned = (GET_OWNER (last_queried) == region);
+    int i;
+
+    for (i = 0; i < NR_BAND_INDEXES && !owned; i++) {
+        if (GET_OWNER (band_indexes [i].region) == region)
+            owned = TRUE;
+    }
+
+    if (!owned)
+        return;
+
+#ifdef _MGRM_THREADS
+    pthread_mutex_lock (&band_index_lock);
+#endif
+
+    for (i = 0; i < NR_BAND_INDEXES; i++) {
+        if (band_indexes [i].region == region)
+            free_band_index (band_indexes + i);
+    }
+    if (last_queried == region)
+        SET_OWNER (last_queried, NULL);
+
+#ifdef _MGRM_THREADS
+    pthread_mutex_unlock (&band_index_lock);
+#endif
+}
+
 /* return TRUE if point is in region */
 BOOL GUIAPI PtInRegion (const PCLIPRGN region, int x, int y)
 {
-    int top;
+    int top, ret;
     PCLIPRECT cliprect = region->head;
 
     if (region->type == NULLREGION) {
@@ -195,6 +450,9 @@ BOOL GUIAPI PtInRegion (const PCLIPRGN region, int x, int y)
     if (y >= region->tail->rc.bottom || y < region->head->rc.top)
         return FALSE;
 
+    if ((ret = REGION_QueryIndex (region, x, y, NULL)) >= 0)
+        return ret;
+
     /* find the ban in which this point lies */
     cliprect = region->head;
     while (cliprect && y >= cliprect->rc.bottom) {
@@ -222,6 +480,10 @@ BOOL GUIAPI RectInRegion (const PCLIPRGN region, const RECT* rect)
     BOOL ret = FALSE;
 
     if (cliprect && EXTENTCHECK (&region->rcBound, rect)) {
+        if ((ret = REGION_QueryIndex (region, 0, 0, rect)) >= 0)
+            return ret;
+
+        ret = FALSE;
         while (cliprect) {
             if (cliprect->rc.bottom <= rect->top) {
                 cliprect = cliprect->next;
@@ -260,6 +522,8 @@ void GUIAPI InitClipRgn (PCLIPRGN pRgn, PBLOCKHEAP heap)
      pRgn->tail = NULL;
 
      pRgn->heap = heap;   // read-only field.
+
+     REGION_Changed (pRgn);
 }
 
 /* return bound rect of a region */
@@ -291,6 +555,8 @@ void GUIAPI EmptyClipRgn (PCLIPRGN pRgn)
     SetRectEmpty (&pRgn->rcBound);
     pRgn->head = NULL;
     pRgn->tail = NULL;
+
+    REGION_Changed (pRgn);
 }
 
 /* Creates a region */
@@ -445,6 +711,163 @@ void dbg_dumpRegion (CLIPRGN* region)
 }
 #endif
 
+/***********************************************************************
+ *           Band arrays
+ *
+ *      The region operations run on contiguous arrays of rectangles
+ *      sorted in y-x bands, as the X11 and pixman regions do. The clipping
+ *      rects of the source regions are copied to the arrays first, and
+ *      the result is written back to the list of the destination region at
+ *      last, reusing its clipping rects. So the operations do not chase
+ *      the pointers nor allocate and free a clipping rect for every
+ *      rectangle merged when coalescing the bands.
+ *
+ *      The arrays live on the stack unless a region has more than
+ *      RGNBUF_STACK_RECTS rectangles.
+ */
+#define RGNBUF_STACK_RECTS      64
+
+typedef struct _RGNBUF {
+    RECT* rects;
+    int nr_rects;
+    int size;
+    BOOL oom;
+    RECT stack [RGNBUF_STACK_RECTS];
+} RGNBUF;
+
+typedef void (*voidProcp1)(RGNBUF *region, const RECT *r1, const RECT *r1End,
+                          const RECT *r2, const RECT *r2End, int top, int bottom);
+typedef void (*voidProcp2)(RGNBUF *region, const RECT *r, const RECT *rEnd,
+                          int top, int bottom);
+
+static inline void rgnbuf_init (RGNBUF* buf)
+{
+    buf->rects = buf->stack;
+    buf->nr_rects = 0;
+    buf->size = RGNBUF_STACK_RECTS;
+    buf->oom = FALSE;
+}
+
+static inline void rgnbuf_release (RGNBUF* buf)
+{
+    if (buf->rects != buf->stack)
+        free (buf->rects);
+}
+
+static BOOL rgnbuf_grow (RGNBUF* buf)
+{
+    RECT* rects;
+    int size = buf->size << 1;
+
+    if (buf->rects == buf->stack) {
+        if ((rects = malloc (sizeof (RECT) * size)))
+            memcpy (rects, buf->stack, sizeof (RECT) * buf->nr_rects);
+    }
+    else
+        rects = realloc (buf->rects, sizeof (RECT) * size);
+
+    if (rects == NULL) {
+        buf->oom = TRUE;
+        return FALSE;
+    }
+
+    buf->rects = rects;
+    buf->size = size;
+    return TRUE;
+}
+
+/*
+ * Append a new rectangle to the array.
+ */
+#define NEWRECT(region, l, t, r, b) \
+       {\
+            if ((region)->nr_rects < (region)->size || rgnbuf_grow (region)) {\
+                RECT* newrect = (region)->rects + (region)->nr_rects++;\
+                newrect->left = (l);\
+                newrect->top = (t);\
+                newrect->right = (r);\
+                newrect->bottom = (b);\
+            }\
+       }
+
+static BOOL rgnbuf_load (RGNBUF* buf, const CLIPRGN* region)
+{
+    const CLIPRECT* cliprect = region->head;
+
+    while (cliprect) {
+        if (buf->nr_rects == buf->size && !rgnbuf_grow (buf))
+            return FALSE;
+
+        buf->rects [buf->nr_rects++] = cliprect->rc;
+        cliprect = cliprect->next;
+    }
+
+    return TRUE;
+}
+
+/*
+ * Write the rectangles back to the list of the region; the clipping rects
+ * of the region are reused, and the rcBound is re-calculated meanwhile.
+ */
+static void rgnbuf_store (const RGNBUF* buf, CLIPRGN* region)
+{
+    CLIPRECT *cliprect = region->head, *prev = NULL, *temp;
+    RECT *pExtents = &region->rcBound;
+    int i;
+
+    for (i = 0; i < buf->nr_rects; i++) {
+        const RECT* rc = buf->rects + i;
+
+        if (cliprect == NULL) {
+            cliprect = ClipRectAlloc (region->heap);
+            cliprect->next = NULL;
+            if (prev)
+                prev->next = cliprect;
+            else
+                region->head = cliprect;
+        }
+
+        cliprect->rc = *rc;
+        cliprect->prev = prev;
+
+        if (i == 0)
+            *pExtents = *rc;
+        else {
+            if (rc->left < pExtents->left)
+                pExtents->left = rc->left;
+            if (rc->right > pExtents->right)
+                pExtents->right = rc->right;
+            pExtents->bottom = rc->bottom;
+        }
+
+        prev = cliprect;
+        cliprect = cliprect->next;
+    }
+
+    /* free the clipping rects left */
+    while (cliprect) {
+        temp = cliprect->next;
+        FreeClipRect (region->heap, cliprect);
+        cliprect = temp;
+    }
+
+    if (prev)
+        prev->next = NULL;
+    else {
+        region->head = NULL;
+        SetRectEmpty (pExtents);
+    }
+
+    region->tail = prev;
+    REGION_Changed (region);
+    if (region->head == NULL)
+        region->type = NULLREGION;
+    else if (region->head == region->tail)
+        region->type = SIMPLEREGION;
+    else
+        region->type = COMPLEXREGION;
+}
+
 /***********************************************************************
  *           REGION_Coalesce
  *
@@ -458,72 +881,61 @@ void dbg_dumpRegion (CLIPRGN* region)
  *      If coalescing takes place:
  *          - rectangles in the previous band will have their bottom fields
  *            altered.
- *          - some clipping rect will be deleted.
+ *          - region->nr_rects will be decreased.
  *
  */
-static CLIPRECT* REGION_Coalesce (
-             CLIPRGN *region,      /* Region to coalesce */
-             CLIPRECT *prevStart,  /* start of previous band */
-             CLIPRECT *curStart    /* start of current band */
+static int REGION_Coalesce (
+             RGNBUF *region,       /* Region to coalesce */
+             int prevStart,        /* Index of start of previous band */
+             int curStart          /* Index of start of current band */
 ) {
-    CLIPRECT *newStart;         /* Start of new band */
-    CLIPRECT *pPrevRect;        /* Current rect in previous band */
-    CLIPRECT *pCurRect;         /* Current rect in current band */
-    CLIPRECT *temp;             /* Temporary clipping rect */
+    RECT *pRegEnd;              /* End of region */
+    RECT *pPrevRect;            /* Current rect in previous band */
+    RECT *pCurRect;             /* Current rect in current band */
     int curNumRects;            /* Number of rectangles in current band */
     int prevNumRects;           /* Number of rectangles in previous band */
     int bandtop;                /* top coordinate for current band */
 
-    if (prevStart == NULL) prevStart = region->head;
-    if (curStart == NULL) curStart = region->head;
-
-    if (prevStart == curStart)
-        return prevStart;
-
-    newStart = pCurRect = curStart;
+    pRegEnd = region->rects + region->nr_rects;
 
-    pPrevRect = prevStart;
-    temp = prevStart;
-    prevNumRects = 0;
-    while (temp != curStart) {
-        prevNumRects ++;
-        temp = temp->next;
-    }
+    pPrevRect = region->rects + prevStart;
+    prevNumRects = curStart - prevStart;
 
     /*
      * Figure out how many rectangles are in the current band. Have to do
      * this because multiple bands could have been added in REGION_RegionOp
      * at the end when one region has been exhausted.
      */
-    pCurRect = curStart;
-    bandtop = pCurRect->rc.top;
-    curNumRects = 0;
-    while (pCurRect && (pCurRect->rc.top == bandtop)) {
-        curNumRects ++;
-        pCurRect = pCurRect->next;
+    pCurRect = region->rects + curStart;
+    bandtop = pCurRect->top;
+    for (curNumRects = 0;
+            (pCurRect != pRegEnd) && (pCurRect->top == bandtop);
+            curNumRects++) {
+        pCurRect++;
     }
 
-    if (pCurRect) {
+    if (pCurRect != pRegEnd) {
         /*
          * If more than one band was added, we have to find the start
          * of the last band added so the next coalescing job can start
          * at the right place... (given when multiple bands are added,
          * this may be pointless -- see above).
          */
-        temp = region->tail;
-        while (temp->prev->rc.top == temp->rc.top) {
-            temp = temp->prev;
+        pRegEnd--;
+        while (pRegEnd[-1].top == pRegEnd->top) {
+            pRegEnd--;
         }
-        newStart = temp;
+        curStart = pRegEnd - region->rects;
+        pRegEnd = region->rects + region->nr_rects;
     }
 
     if ((curNumRects == prevNumRects) && (curNumRects != 0)) {
-        pCurRect = curStart;
+        pCurRect -= curNumRects;
         /*
          * The bands may only be coalesced if the bottom of the previous
          * matches the top scanline of the current.
          */
-        if (pPrevRect->rc.bottom == pCurRect->rc.top) {
+        if (pPrevRect->bottom == pCurRect->top) {
             /*
              * Make sure the bands have rects in the same places. This
              * assumes that rects have been added in such a way that they
@@ -531,78 +943,57 @@ static CLIPRECT* REGION_Coalesce (
              * have some horizontal space between them.
              */
             do {
-                if ((pPrevRect->rc.left != pCurRect->rc.left) ||
-                    (pPrevRect->rc.right != pCurRect->rc.right))
+                if ((pPrevRect->left != pCurRect->left) ||
+                    (pPrevRect->right != pCurRect->right))
                 {
                     /*
                      * The bands don't line up so they can't be coalesced.
                      */
-                    return newStart;
+                    return curStart;
                 }
-                pPrevRect = pPrevRect->next;
-                pCurRect = pCurRect->next;
-            } while (--prevNumRects);
+                pPrevRect++;
+                pCurRect++;
+                prevNumRects -= 1;
+            } while (prevNumRects != 0);
 
-            /*
-             * If only one band was added to the region, we have to backup
-             * newStart to the start of the previous band.
-             */
-            if (pCurRect == NULL) {
-                newStart = prevStart;
-            }
+            region->nr_rects -= curNumRects;
+            pCurRect -= curNumRects;
+            pPrevRect -= curNumRects;
 
             /*
              * The bands may be merged, so set the bottom of each rect
              * in the previous band to that of the corresponding rect in
              * the current band.
              */
-            /*
-             * for implementation of MiniGUI, we should free
-             * the clipping rects merged.
-             */
-            pCurRect = curStart;
-            pPrevRect = prevStart;
             do {
-                pPrevRect->rc.bottom = pCurRect->rc.bottom;
-                pPrevRect = pPrevRect->next;
-
-                if (pCurRect->next)
-                    pCurRect->next->prev = pCurRect->prev;
-                else
-                    region->tail = pCurRect->prev;
-                if (pCurRect->prev)
-                    pCurRect->prev->next = pCurRect->next;
-                else
-                    region->head = pCurRect->next;
-
-                temp = pCurRect->next;
-                FreeClipRect (region->heap, pCurRect);
-                pCurRect = temp;
-            } while (--curNumRects);
+                pPrevRect->bottom = pCurRect->bottom;
+                pPrevRect++;
+                pCurRect++;
+                curNumRects -= 1;
+            } while (curNumRects != 0);
 
             /*
+             * If only one band was added to the region, we have to backup
+             * curStart to the start of the previous band.
              *
              * If more than one band was added to the region, copy the
              * other bands down. The assumption here is that the other bands
              * came from the same region as the current one and no further
              * coalescing can be done on them since it's all been done
-             * already... newStart is already in the right place.
+             * already... curStart is already in the right place.
              */
-            /* no need to copy for implementation of MiniGUI -- they are freed.
-            if (temp == regionEnd) {
-                newStart = prevStart;
+            if (pCurRect == pRegEnd) {
+                curStart = prevStart;
             }
-
             else {
                 do {
                     *pPrevRect++ = *pCurRect++;
-                } while (pCurRect != regionEnd);
+                } while (pCurRect != pRegEnd);
             }
-            */
-
         }
     }
-    return (newStart);
+
+    return curStart;
 }
 
 /***********************************************************************
@@ -612,7 +1003,7 @@ static CLIPRECT* REGION_Coalesce (
  *      Xor, Subtract, Intersect...
  *
  * Results:
- *      None.
+ *      FALSE if out of memory; the new region is not changed then.
  *
  * Side Effects:
  *      The new region is overwritten.
@@ -629,8 +1020,11 @@ static CLIPRECT* REGION_Coalesce (
  *      At the end of each band, the new region is coalesced, if possible,
  *      to reduce the number of rectangles in the region.
  *
+ *      The new region may be one of the source regions, because the
+ *      rectangles of the sources are copied to the band arrays first.
+ *
  */
-static void
+static BOOL
 REGION_RegionOp(
             CLIPRGN *newReg, /* Place to store result */
             const CLIPRGN *reg1,   /* First region in operation */
@@ -639,69 +1033,32 @@ REGION_RegionOp(
             voidProcp2 nonOverlap1Func, /* Function to call for non-overlapping bands in region 1 */
             voidProcp2 nonOverlap2Func  /* Function to call for non-overlapping bands in region 2 */
 ) {
-    CLIPRGN my_dst;
-    CLIPRGN* pdst;
-    const CLIPRECT *r1;                 /* Pointer into first region */
-    const CLIPRECT *r2;                 /* Pointer into 2d region */
-    const CLIPRECT *r1BandEnd;          /* End of current band in r1 */
-    const CLIPRECT *r2BandEnd;          /* End of current band in r2 */
+    RGNBUF buf1, buf2, dst;
+    const RECT *r1;                     /* Pointer into first region */
+    const RECT *r2;                     /* Pointer into 2d region */
+    const RECT *r1End;                  /* End of 1st region */
+    const RECT *r2End;                  /* End of 2d region */
+    const RECT *r1BandEnd;              /* End of current band in r1 */
+    const RECT *r2BandEnd;              /* End of current band in r2 */
     int ybot;                           /* Bottom of intersection */
     int ytop;                           /* Top of intersection */
-    CLIPRECT* prevBand;                 /* start of previous band in newReg */
-    CLIPRECT* curBand;                  /* start of current band in newReg */
+    int prevBand;                       /* Index of start of previous band in dst */
+    int curBand;                        /* Index of start of current band in dst */
     int top;                            /* Top of non-overlapping band */
     int bot;                            /* Bottom of non-overlapping band */
+    BOOL ok = FALSE;
 
-    /*
-     * Initialization:
-     *  set r1, r2, r1End and r2End appropriately, preserve the important
-     * parts of the destination region until the end in case it's one of
-     * the two source regions, then mark the "new" region empty, allocating
-     * another array of rectangles for it to use.
-     */
-    r1 = reg1->head;
-    r2 = reg2->head;
+    rgnbuf_init (&buf1);
+    rgnbuf_init (&buf2);
+    rgnbuf_init (&dst);
 
-    /*
-     * newReg may be one of the src regions so we can't empty it. We keep a
-     * note of its rects pointer (so that we can free them later), preserve its
-     * rcBound and simply set numRects to zero.
-     */
-    /*
-    oldRects = newReg->rects;
-    newReg->numRects = 0;
-     */
-
-    /*
-     * for implementation of MiniGUI, we create an empty region.
-     */
-    if (newReg == reg1 || newReg == reg2) {
-        InitClipRgn (&my_dst, newReg->heap);
-        pdst = &my_dst;
-    }
-    else {
-        EmptyClipRgn (newReg);
-        pdst = newReg;
-    }
-
-    /*
-     * Allocate a reasonable number of rectangles for the new region. The idea
-     * is to allocate enough so the individual functions don't need to
-     * reallocate and copy the array, which is time consuming, yet we don't
-     * have to worry about using too much memory. I hope to be able to
-     * nuke the Xrealloc() at the end of this function eventually.
-     */
-
-    /* for implementation of MiniGUI, dst always is an empty region.
-    newReg->size = MAX(reg1->numRects,reg2->numRects) * 2;
-
-    if (! (newReg->rects = malloc( sizeof(CLIPRECT) * newReg->size )))
-    {
-        newReg->size = 0;
-        return;
-    }
-     */
+    if (!rgnbuf_load (&buf1, reg1) || !rgnbuf_load (&buf2, reg2))
+        goto done;
 
+    r1 = buf1.rects;
+    r1End = r1 + buf1.nr_rects;
+    r2 = buf2.rects;
+    r2End = r2 + buf2.nr_rects;
 
     /*
      * Initialize ybot and ytop.
@@ -730,10 +1087,10 @@ REGION_RegionOp(
      * the possible expansion, and resultant moving, of the new region's
      * array of rectangles.
      */
-    prevBand = pdst->head;
+    prevBand = 0;
 
     do {
-        curBand = pdst->tail;
+        curBand = dst.nr_rects;
 
         /*
          * This algorithm proceeds one source-band (as opposed to a
@@ -743,12 +1100,12 @@ REGION_RegionOp(
          * respective regions.
          */
         r1BandEnd = r1;
-        while (r1BandEnd && (r1BandEnd->rc.top == r1->rc.top))
-            r1BandEnd = r1BandEnd->next;
+        while ((r1BandEnd != r1End) && (r1BandEnd->top == r1->top))
+            r1BandEnd++;
 
         r2BandEnd = r2;
-        while (r2BandEnd && (r2BandEnd->rc.top == r2->rc.top))
-            r2BandEnd = r2BandEnd->next;
+        while ((r2BandEnd != r2End) && (r2BandEnd->top == r2->top))
+            r2BandEnd++;
 
         /*
          * First handle the band that doesn't intersect, if any.
@@ -758,26 +1115,26 @@ REGION_RegionOp(
          * bands between the current position and the next place it overlaps
          * the other, this entire loop will be passed through n times.
          */
-        if (r1->rc.top < r2->rc.top) {
-            top = MAX (r1->rc.top, ybot);
-            bot = MIN (r1->rc.bottom, r2->rc.top);
+        if (r1->top < r2->top) {
+            top = MAX (r1->top, ybot);
+            bot = MIN (r1->bottom, r2->top);
 
             if ((top != bot) && (nonOverlap1Func != NULL))
-                (* nonOverlap1Func) (pdst, r1, r1BandEnd, top, bot);
+                (* nonOverlap1Func) (&dst, r1, r1BandEnd, top, bot);
 
-            ytop = r2->rc.top;
+            ytop = r2->top;
         }
-        else if (r2->rc.top < r1->rc.top) {
-            top = MAX (r2->rc.top, ybot);
-            bot = MIN (r2->rc.bottom, r1->rc.top);
+        else if (r2->top < r1->top) {
+            top = MAX (r2->top, ybot);
+            bot = MIN (r2->bottom, r1->top);
 
             if ((top != bot) && (nonOverlap2Func != NULL))
-                (* nonOverlap2Func) (pdst, r2, r2BandEnd, top, bot);
+                (* nonOverlap2Func) (&dst, r2, r2BandEnd, top, bot);
 
-            ytop = r1->rc.top;
+            ytop = r1->top;
         }
         else {
-            ytop = r1->rc.top;
+            ytop = r1->top;
         }
 
         /*
@@ -786,103 +1143,75 @@ REGION_RegionOp(
          * this test in miCoalesce, but some machines incur a not
          * inconsiderable cost for function calls, so...
          */
-        if (pdst->tail != curBand) {
-            prevBand = REGION_Coalesce (pdst, prevBand, curBand);
+        if (dst.nr_rects != curBand) {
+            prevBand = REGION_Coalesce (&dst, prevBand, curBand);
         }
 
         /*
          * Now see if we've hit an intersecting band. The two bands only
          * intersect if ybot > ytop
          */
-        ybot = MIN (r1->rc.bottom, r2->rc.bottom);
-        curBand = pdst->tail;
+        ybot = MIN (r1->bottom, r2->bottom);
+        curBand = dst.nr_rects;
         if (ybot > ytop)
-            (* overlapFunc) (pdst, r1, r1BandEnd, r2, r2BandEnd, ytop, ybot);
+            (* overlapFunc) (&dst, r1, r1BandEnd, r2, r2BandEnd, ytop, ybot);
 
-        if (pdst->tail != curBand)
-            prevBand = REGION_Coalesce (pdst, prevBand, curBand);
+        if (dst.nr_rects != curBand)
+            prevBand = REGION_Coalesce (&dst, prevBand, curBand);
 
         /*
          * If we've finished with a band (bottom == ybot) we skip forward
          * in the region to the next band.
          */
-        if (r1->rc.bottom == ybot)
+        if (r1->bottom == ybot)
             r1 = r1BandEnd;
-        if (r2->rc.bottom == ybot)
+        if (r2->bottom == ybot)
             r2 = r2BandEnd;
-    } while (r1 && r2);
+    } while ((r1 != r1End) && (r2 != r2End));
 
     /*
      * Deal with whichever region still has rectangles left.
      */
-    curBand = pdst->tail;
-    if (r1) {
+    curBand = dst.nr_rects;
+    if (r1 != r1End) {
         if (nonOverlap1Func != NULL) {
             do {
                 r1BandEnd = r1;
-                while ((r1BandEnd) && (r1BandEnd->rc.top == r1->rc.top)) {
-                    r1BandEnd = r1BandEnd->next;
+                while ((r1BandEnd != r1End) && (r1BandEnd->top == r1->top)) {
+                    r1BandEnd++;
                 }
-                (* nonOverlap1Func) (pdst, r1, r1BandEnd,
-                                     MAX (r1->rc.top, ybot), r1->rc.bottom);
+                (* nonOverlap1Func) (&dst, r1, r1BandEnd,
+                                     MAX (r1->top, ybot), r1->bottom);
                 r1 = r1BandEnd;
-            } while (r1);
+            } while (r1 != r1End);
         }
     }
-    else if ((r2) && (nonOverlap2Func != NULL))
+    else if ((r2 != r2End) && (nonOverlap2Func != NULL))
     {
         do {
             r2BandEnd = r2;
-            while ((r2BandEnd) && (r2BandEnd->rc.top == r2->rc.top)) {
-                 r2BandEnd = r2BandEnd->next;
+            while ((r2BandEnd != r2End) && (r2BandEnd->top == r2->top)) {
+                 r2BandEnd++;
             }
-            (* nonOverlap2Func) (pdst, r2, r2BandEnd,
-                                MAX (r2->rc.top, ybot), r2->rc.bottom);
+            (* nonOverlap2Func) (&dst, r2, r2BandEnd,
+                                MAX (r2->top, ybot), r2->bottom);
             r2 = r2BandEnd;
-        } while (r2);
+        } while (r2 != r2End);
     }
 
-    if (pdst->tail != curBand)
-        (void) REGION_Coalesce (pdst, prevBand, curBand);
-
-    /*
-     * A bit of cleanup. To keep regions from growing without bound,
-     * we shrink the array of rectangles to match the new number of
-     * rectangles in the region. This never goes to 0, however...
-     *
-     * Only do this stuff if the number of rectangles allocated is more than
-     * twice the number of rectangles in the region (a simple optimization...).
-     */
+    if (dst.nr_rects != curBand)
+        (void) REGION_Coalesce (&dst, prevBand, curBand);
 
-#if 0 // MiniGUI implementation does not need to do this
-    if (newReg->numRects < (newReg->size >> 1))
-    {
-        if (REGION_NOT_EMPTY(newReg))
-        {
-            CLIPRECT *prev_rects = newReg->rects;
-            newReg->size = newReg->numRects;
-            newReg->rects = realloc( newReg->rects, sizeof(CLIPRECT) * newReg->size );
-            if (! newReg->rects)
-                newReg->rects = prev_rects;
-        }
-        else
-        {
-            /*
-             * No point in doing the extra work involved in an Xrealloc if
-             * the region is empty
-             */
-            newReg->size = 1;
-            free( newReg->rects );
-            newReg->rects = malloc( sizeof(CLIPRECT) );
-        }
-    }
-    free( oldRects );
-#else
-    if (pdst != newReg) {
-        EmptyClipRgn (newReg);
-        *newReg = my_dst;
+    if (!dst.oom) {
+        rgnbuf_store (&dst, newReg);
+        ok = TRUE;
     }
-#endif
+
+done:
+    rgnbuf_release (&buf1);
+    rgnbuf_release (&buf2);
+    rgnbuf_release (&dst);
+    return ok;
 }
 
 /***********************************************************************
@@ -903,17 +1232,16 @@ REGION_RegionOp(
  *
  */
 static void
-REGION_IntersectO (CLIPRGN *region, const CLIPRECT *r1, const CLIPRECT *r1End,
-                        const CLIPRECT *r2, const CLIPRECT *r2End, int top, int bottom)
+REGION_IntersectO (RGNBUF *region, const RECT *r1, const RECT *r1End,
+                        const RECT *r2, const RECT *r2End, int top, int bottom)
 
 {
     int       left, right;
-    CLIPRECT  *newcliprect;
 
-    while (r1 && r2 && (r1 != r1End) && (r2 != r2End))
+    while ((r1 != r1End) && (r2 != r2End))
     {
-        left  = MAX (r1->rc.left, r2->rc.left);
-        right = MIN (r1->rc.right, r2->rc.right);
+        left  = MAX (r1->left, r2->left);
+        right = MIN (r1->right, r2->right);
 
         /*
          * If there's any overlap between the two rectangles, add that
@@ -923,12 +1251,7 @@ REGION_IntersectO (CLIPRGN *region, const CLIPRECT *r1, const CLIPRECT *r1End,
          * right next to each other. Since that should never happen...
          */
         if (left < right) {
-            NEWCLIPRECT (region, newcliprect);
-
-            newcliprect->rc.left = left;
-            newcliprect->rc.top = top;
-            newcliprect->rc.right = right;
-            newcliprect->rc.bottom = bottom;
+            NEWRECT (region, left, top, right, bottom);
         }
 
         /*
@@ -936,15 +1259,15 @@ REGION_IntersectO (CLIPRGN *region, const CLIPRECT *r1, const CLIPRECT *r1End,
          * to the right the least, since the other still has a chance to
          * overlap with that region's next rectangle, if you see what I mean.
          */
-        if (r1->rc.right < r2->rc.right) {
-            r1 = r1->next;
+        if (r1->right < r2->right) {
+            r1++;
         }
-        else if (r2->rc.right < r1->rc.right) {
-            r2 = r2->next;
+        else if (r2->right < r1->right) {
+            r2++;
         }
         else {
-            r1 = r1->next;
-            r2 = r2->next;
+            r1++;
+            r2++;
         }
     }
 }
@@ -964,23 +1287,16 @@ REGION_IntersectO (CLIPRGN *region, const CLIPRECT *r1, const CLIPRECT *r1End,
  *      None.
  *
  * Side Effects:
- *      region->numRects is incremented and the final rectangles overwritten
+ *      region->nr_rects is incremented and the final rectangles overwritten
  *      with the rectangles we're passed.
  *
  */
 static void
-REGION_UnionNonO (CLIPRGN *region, const CLIPRECT *r, const CLIPRECT *rEnd, int top, int bottom)
+REGION_UnionNonO (RGNBUF *region, const RECT *r, const RECT *rEnd, int top, int bottom)
 {
-    CLIPRECT *newcliprect;
-
-    while (r && r != rEnd) {
-        NEWCLIPRECT (region, newcliprect);
-        newcliprect->rc.left = r->rc.left;
-        newcliprect->rc.top = top;
-        newcliprect->rc.right = r->rc.right;
-        newcliprect->rc.bottom = bottom;
-
-        r = r->next;
+    while (r != rEnd) {
+        NEWRECT (region, r->left, top, r->right, bottom);
+        r++;
     }
 }
 
@@ -994,40 +1310,34 @@ REGION_UnionNonO (CLIPRGN *region, const CLIPRECT *r, const CLIPRECT *rEnd, int
  *      None.
  *
  * Side Effects:
- *      Rectangles are overwritten in region->rects and region->numRects will
+ *      Rectangles are overwritten in region->rects and region->nr_rects will
  *      be changed.
  *
  */
 static void
-REGION_UnionO(CLIPRGN *region, const CLIPRECT *r1, const CLIPRECT *r1End,
-                           const CLIPRECT *r2, const CLIPRECT *r2End, int top, int bottom)
+REGION_UnionO(RGNBUF *region, const RECT *r1, const RECT *r1End,
+                           const RECT *r2, const RECT *r2End, int top, int bottom)
 {
-    CLIPRECT *newcliprect;
-
 #define MERGERECT(r) \
-    if ((region->head) &&  \
-        (region->tail->rc.top == top) &&  \
-        (region->tail->rc.bottom == bottom) &&  \
-        (region->tail->rc.right >= r->rc.left))  \
+    if ((region->nr_rects != 0) &&  \
+        (region->rects[region->nr_rects-1].top == top) &&  \
+        (region->rects[region->nr_rects-1].bottom == bottom) &&  \
+        (region->rects[region->nr_rects-1].right >= r->left))  \
     {  \
-        if (region->tail->rc.right < r->rc.right)  \
+        if (region->rects[region->nr_rects-1].right < r->right)  \
         {  \
-            region->tail->rc.right = r->rc.right;  \
+            region->rects[region->nr_rects-1].right = r->right;  \
         }  \
     }  \
     else  \
     {  \
-        NEWCLIPRECT(region, newcliprect);  \
-        newcliprect->rc.top = top;  \
-        newcliprect->rc.bottom = bottom;  \
-        newcliprect->rc.left = r->rc.left;  \
-        newcliprect->rc.right = r->rc.right;  \
+        NEWRECT(region, r->left, top, r->right, bottom);  \
     }  \
-    r = r->next;
+    r++;
 
-    while (r1 && r2 && (r1 != r1End) && (r2 != r2End))
+    while ((r1 != r1End) && (r2 != r2End))
     {
-        if (r1->rc.left < r2->rc.left)
+        if (r1->left < r2->left)
         {
             MERGERECT(r1);
         }
@@ -1037,13 +1347,13 @@ REGION_UnionO(CLIPRGN *region, const CLIPRECT *r1, const CLIPRECT *r1End,
         }
     }
 
-    if (r1 && r1 != r1End)
+    if (r1 != r1End)
     {
         do {
             MERGERECT(r1);
-        } while (r1 && r1 != r1End);
+        } while (r1 != r1End);
     }
-    else while (r2 && r2 != r2End)
+    else while (r2 != r2End)
     {
         MERGERECT(r2);
     }
@@ -1067,18 +1377,12 @@ REGION_UnionO(CLIPRGN *region, const CLIPRECT *r1, const CLIPRECT *r1End,
  *
  */
 static void
-REGION_SubtractNonO1 (CLIPRGN *region, const CLIPRECT *r, const CLIPRECT *rEnd,
+REGION_SubtractNonO1 (RGNBUF *region, const RECT *r, const RECT *rEnd,
                         int top, int bottom)
 {
-    CLIPRECT *newcliprect;
-
-    while (r && r != rEnd) {
-        NEWCLIPRECT(region, newcliprect);
-        newcliprect->rc.left = r->rc.left;
-        newcliprect->rc.top = top;
-        newcliprect->rc.right = r->rc.right;
-        newcliprect->rc.bottom = bottom;
-        r = r->next;
+    while (r != rEnd) {
+        NEWRECT (region, r->left, top, r->right, bottom);
+        r++;
     }
 }
 
@@ -1097,35 +1401,34 @@ REGION_SubtractNonO1 (CLIPRGN *region, const CLIPRECT *r, const CLIPRECT *rEnd,
  *
  */
 static void
-REGION_SubtractO (CLIPRGN *region, const CLIPRECT *r1, const CLIPRECT *r1End,
-                        const CLIPRECT *r2, const CLIPRECT *r2End, int top, int bottom)
+REGION_SubtractO (RGNBUF *region, const RECT *r1, const RECT *r1End,
+                        const RECT *r2, const RECT *r2End, int top, int bottom)
 {
-    CLIPRECT *newcliprect;
     int left;
 
-    left = r1->rc.left;
-    while (r1 && r2 && (r1 != r1End) && (r2 != r2End)) {
-        if (r2->rc.right <= left) {
+    left = r1->left;
+    while ((r1 != r1End) && (r2 != r2End)) {
+        if (r2->right <= left) {
             /*
              * Subtrahend missed the boat: go to next subtrahend.
              */
-            r2 = r2->next;
+            r2++;
         }
-        else if (r2->rc.left <= left)
+        else if (r2->left <= left)
         {
             /*
              * Subtrahend preceeds minuend: nuke left edge of minuend.
              */
-            left = r2->rc.right;
-            if (left >= r1->rc.right)
+            left = r2->right;
+            if (left >= r1->right)
             {
                 /*
                  * Minuend completely covered: advance to next minuend and
                  * reset left fence to edge of new minuend.
                  */
-                r1 = r1->next;
+                r1++;
                 if (r1 != r1End)
-                    left = r1->rc.left;
+                    left = r1->left;
             }
             else
             {
@@ -1133,36 +1436,32 @@ REGION_SubtractO (CLIPRGN *region, const CLIPRECT *r1, const CLIPRECT *r1End,
                  * Subtrahend now used up since it doesn't extend beyond
                  * minuend
                  */
-                r2 = r2->next;
+                r2++;
             }
         }
-        else if (r2->rc.left < r1->rc.right)
+        else if (r2->left < r1->right)
         {
             /*
              * Left part of subtrahend covers part of minuend: add uncovered
              * part of minuend to region and skip to next subtrahend.
              */
-            NEWCLIPRECT(region, newcliprect);
-            newcliprect->rc.left = left;
-            newcliprect->rc.top = top;
-            newcliprect->rc.right = r2->rc.left;
-            newcliprect->rc.bottom = bottom;
-            left = r2->rc.right;
-            if (left >= r1->rc.right)
+            NEWRECT (region, left, top, r2->left, bottom);
+            left = r2->right;
+            if (left >= r1->right)
             {
                 /*
                  * Minuend used up: advance to new...
                  */
-                r1 = r1->next;
+                r1++;
                 if (r1 != r1End)
-                    left = r1->rc.left;
+                    left = r1->left;
             }
             else
             {
                 /*
                  * Subtrahend used up
                  */
-                r2 = r2->next;
+                r2++;
             }
         }
         else
@@ -1170,33 +1469,25 @@ REGION_SubtractO (CLIPRGN *region, const CLIPRECT *r1, const CLIPRECT *r1End,
             /*
              * Minuend used up: add any remaining piece before advancing.
              */
-            if (r1->rc.right > left)
+            if (r1->right > left)
             {
-                NEWCLIPRECT(region, newcliprect);
-                newcliprect->rc.left = left;
-                newcliprect->rc.top = top;
-                newcliprect->rc.right = r1->rc.right;
-                newcliprect->rc.bottom = bottom;
+                NEWRECT (region, left, top, r1->right, bottom);
             }
-            r1 = r1->next;
+            r1++;
             if (r1 != r1End)
-                left = r1->rc.left;
+                left = r1->left;
         }
     }
 
     /*
      * Add remaining minuend rectangles to region.
      */
-    while (r1 && r1 != r1End)
+    while (r1 != r1End)
     {
-        NEWCLIPRECT(region, newcliprect);
-        newcliprect->rc.left = left;
-        newcliprect->rc.top = top;
-        newcliprect->rc.right = r1->rc.right;
-        newcliprect->rc.bottom = bottom;
-        r1 = r1->next;
+        NEWRECT (region, left, top, r1->right, bottom);
+        r1++;
         if (r1 != r1End)
-            left = r1->rc.left;
+            left = r1->left;
     }
 }
 
@@ -1212,21 +1503,13 @@ BOOL GUIAPI ClipRgnIntersect (CLIPRGN *dst, const CLIPRGN *src1, const CLIPRGN *
         EmptyClipRgn (dst);
         return FALSE;
     }
-    else
-        REGION_RegionOp (dst, src1, src2,
-            REGION_IntersectO, NULL, NULL);
 
     /*
-     * Can't alter dst's rcBound before we call miRegionOp because
-     * it might be one of the source regions and miRegionOp depends
-     * on the rcBound of those regions being the same. Besides, this
-     * way there's no checking against rectangles that will be nuked
-     * due to coalescing, so we have to examine fewer rectangles.
+     * REGION_RegionOp sets the rcBound of dst when writing the result
+     * back, after the rectangles nuked due to coalescing are gone.
      */
-    REGION_SetExtents(dst);
-    dst->type = (dst->head) ? COMPLEXREGION : NULLREGION ;
-
-    return TRUE;
+    return REGION_RegionOp (dst, src1, src2,
+            REGION_IntersectO, NULL, NULL);
 }
 
 /***********************************************************************
@@ -1251,20 +1534,8 @@ BOOL GUIAPI SubtractRegion (CLIPRGN *rgnD, const CLIPRGN *rgnM, const CLIPRGN *r
         return TRUE;
     }
 
-    REGION_RegionOp (rgnD, rgnM, rgnS, REGION_SubtractO,
+    return REGION_RegionOp (rgnD, rgnM, rgnS, REGION_SubtractO,
                 REGION_SubtractNonO1, NULL);
-
-    /*
-     * Can't alter newReg's rcBound before we call miRegionOp because
-     * it might be one of the source regions and miRegionOp depends
-     * on the rcBound of those regions being the unaltered. Besides, this
-     * way there's no checking against rectangles that will be nuked
-     * due to coalescing, so we have to examine fewer rectangles.
-     */
-    REGION_SetExtents (rgnD);
-    rgnD->type = (rgnD->head) ? COMPLEXREGION : NULLREGION;
-
-    return TRUE;
 }
 
 /***********************************************************************
@@ -1320,11 +1591,10 @@ BOOL GUIAPI UnionRegion (CLIPRGN *dst, const CLIPRGN *src1, const CLIPRGN *src2)
         return TRUE;
     }
 
-    REGION_RegionOp (dst, src1, src2, REGION_UnionO,
-                REGION_UnionNonO, REGION_UnionNonO);
+    if (!REGION_RegionOp (dst, src1, src2, REGION_UnionO,
+                REGION_UnionNonO, REGION_UnionNonO))
+        return FALSE;
 
-    REGION_SetExtents (dst);
-    dst->type = (dst->head) ? COMPLEXREGION : NULLREGION ;
 #if 0
     dst->rcBound.left = MIN (src1->rcBound.left, src2->rcBound.left);
     dst->rcBound.top = MIN (src1->rcBound.top, src2->rcBound.top);
@@ -1354,11 +1624,305 @@ BOOL GUIAPI XorRegion (CLIPRGN *dst, const CLIPRGN *src1, const CLIPRGN *src2)
     return TRUE;
 }
 
+/***********************************************************************
+ *           Rectangle operations
+ *
+ *      AddClipRect, IntersectClipRect and SubtractClipRect edit the list
+ *      of the region in place instead of running REGION_RegionOp with a
+ *      one-rect region: only the bands which the rectangle crosses are
+ *      split and changed, the other clipping rects are left alone.
+ */
+
+/* Returns the first clipping rect after the band starting with cliprect. */
+static inline CLIPRECT* REGION_BandEnd (CLIPRECT *cliprect)
+{
+    int top = cliprect->rc.top;
+
+    do {
+        cliprect = cliprect->next;
+    } while (cliprect && cliprect->rc.top == top);
+
+    return cliprect;
+}
+
+/* Inserts a new clipping rect after prev, or at the head if prev is NULL. */
+static CLIPRECT* REGION_InsertRect (CLIPRGN *region, CLIPRECT *prev,
+        int left, int top, int right, int bottom)
+{
+    CLIPRECT *cliprect;
+
+    if ((cliprect = ClipRectAlloc (region->heap)) == NULL)
+        return NULL;
+
+    cliprect->rc.left = left;
+    cliprect->rc.top = top;
+    cliprect->rc.right = right;
+    cliprect->rc.bottom = bottom;
+
+    cliprect->prev = prev;
+    cliprect->next = prev ? prev->next : region->head;
+    if (cliprect->next)
+        cliprect->next->prev = cliprect;
+    else
+        region->tail = cliprect;
+    if (prev)
+        prev->next = cliprect;
+    else
+        region->head = cliprect;
+
+    return cliprect;
+}
+
+/* Unlinks and frees a clipping rect; returns the next one. */
+static CLIPRECT* REGION_RemoveRect (CLIPRGN *region, CLIPRECT *cliprect)
+{
+    CLIPRECT *next = cliprect->next;
+
+    if (cliprect->prev)
+        cliprect->prev->next = next;
+    else
+        region->head = next;
+    if (next)
+        next->prev = cliprect->prev;
+    else
+        region->tail = cliprect->prev;
+
+    FreeClipRect (region->heap, cliprect);
+    return next;
+}
+
+/*
+ * Splits the band starting with cliprect at y, which must lie inside
+ * the band. The upper part keeps the clipping rects of the band;
+ * returns the first rect of the lower part, NULL if out of memory.
+ */
+static CLIPRECT* REGION_SplitBand (CLIPRGN *region, CLIPRECT *cliprect, int y)
+{
+    CLIPRECT *end = REGION_BandEnd (cliprect);
+    CLIPRECT *last = end ? end->prev : region->tail;
+    CLIPRECT *ins = last, *lower = NULL;
+
+    for (;;) {
+        ins = REGION_InsertRect (region, ins, cliprect->rc.left, y,
+                cliprect->rc.right, cliprect->rc.bottom);
+        if (ins == NULL)
+            return NULL;
+        if (lower == NULL)
+            lower = ins;
+
+        cliprect->rc.bottom = y;
+        if (cliprect == last)
+            break;
+        cliprect = cliprect->next;
+    }
+
+    return lower;
+}
+
+/* Returns TRUE if the band between cliprect and end needs changing. */
+static BOOL REGION_BandTouched (const CLIPRECT *cliprect, const CLIPRECT *end,
+        const RECT *rc, BOOL is_union)
+{
+    for (; cliprect != end; cliprect = cliprect->next) {
+        if (is_union) {
+            if (cliprect->rc.left <= rc->left && cliprect->rc.right >= rc->right)
+                return FALSE;
+        }
+        else if (cliprect->rc.right > rc->left && cliprect->rc.left < rc->right)
+            return TRUE;
+    }
+
+    return is_union;
+}
+
+/* Merges [left, right) into the band between cliprect and end. */
+static BOOL REGION_UnionBand (CLIPRGN *region, CLIPRECT *cliprect,
+        CLIPRECT *end, int left, int right)
+{
+    CLIPRECT *merged = NULL;
+    int top = cliprect->rc.top, bottom = cliprect->rc.bottom;
+
+    while (cliprect != end) {
+        if (cliprect->rc.right < left) {
+            cliprect = cliprect->next;
+            continue;
+        }
+        if (cliprect->rc.left > right)
+            break;
+
+        /* overlapping or adjacent */
+        if (merged == NULL) {
+            merged = cliprect;
+            if (merged->rc.left > left)
+                merged->rc.left = left;
+            if (merged->rc.right < right)
+                merged->rc.right = right;
+            cliprect = cliprect->next;
+        }
+        else {
+            if (cliprect->rc.right > merged->rc.right)
+                merged->rc.right = cliprect->rc.right;
+            cliprect = REGION_RemoveRect (region, cliprect);
+        }
+    }
+
+    if (merged == NULL) {
+        if (!REGION_InsertRect (region,
+                    cliprect ? cliprect->prev : region->tail,
+                    left, top, right, bottom))
+            return FALSE;
+    }
+
+    return TRUE;
+}
+
+/* Cuts [left, right) off the band between cliprect and end. */
+static BOOL REGION_SubtractBand (CLIPRGN *region, CLIPRECT *cliprect,
+        CLIPRECT *end, int left, int right)
+{
+    while (cliprect != end) {
+        if (cliprect->rc.right <= left) {
+            cliprect = cliprect->next;
+            continue;
+        }
+        if (cliprect->rc.left >= right)
+            break;
+
+        if (cliprect->rc.left < left) {
+            if (cliprect->rc.right > right) {
+                if (!REGION_InsertRect (region, cliprect, right,
+                            cliprect->rc.top, cliprect->rc.right,
+                            cliprect->rc.bottom))
+                    return FALSE;
+                cliprect->rc.right = left;
+                break;
+            }
+            cliprect->rc.right = left;
+            cliprect = cliprect->next;
+        }
+        else if (cliprect->rc.right > right) {
+            cliprect->rc.left = right;
+            break;
+        }
+        else
+            cliprect = REGION_RemoveRect (region, cliprect);
+    }
+
+    return TRUE;
+}
+
+/*
+ * Merges the adjacent bands which have the same x-extents, and
+ * re-calculates the rcBound and the type of the region.
+ */
+static void REGION_Tidy (CLIPRGN *region)
+{
+    CLIPRECT *prev_band = NULL, *band = region->head, *end;
+    CLIPRECT *p, *q;
+
+    REGION_Changed (region);
+
+    while (band) {
+        end = REGION_BandEnd (band);
+
+        if (prev_band && prev_band->rc.bottom == band->rc.top) {
+            /* the previous band ends right before this one in the list */
+            for (p = prev_band, q = band; p != band && q != end;
+                    p = p->next, q = q->next) {
+                if (p->rc.left != q->rc.left || p->rc.right != q->rc.right)
+                    break;
+            }
+
+            if (p == band && q == end) {
+                for (p = prev_band; p != band; p = p->next)
+                    p->rc.bottom = band->rc.bottom;
+                while (band != end)
+                    band = REGION_RemoveRect (region, band);
+                continue;
+            }
+        }
+
+        prev_band = band;
+        band = end;
+    }
+
+    REGION_SetExtents (region);
+    if (region->head == NULL)
+        region->type = NULLREGION;
+    else if (region->head == region->tail)
+        region->type = SIMPLEREGION;
+    else
+        region->type = COMPLEXREGION;
+}
+
+/* Unions or subtracts a rectangle with the bands of a region in place. */
+static BOOL REGION_RectOp (CLIPRGN *region, const RECT *rc, BOOL is_union)
+{
+    CLIPRECT *band = region->head, *end;
+    int y = rc->top;
+    BOOL ok = TRUE;
+
+    while (band && band->rc.top < rc->bottom) {
+        end = REGION_BandEnd (band);
+
+        if (band->rc.bottom <= rc->top) {
+            band = end;                 /* not far enough down yet */
+            continue;
+        }
+
+        /* fill the gap above this band */
+        if (is_union && y < band->rc.top) {
+            if (!REGION_InsertRect (region, band->prev,
+                        rc->left, y, rc->right, band->rc.top)) {
+                ok = FALSE;
+                break;
+            }
+        }
+
+        if (!REGION_BandTouched (band, end, rc, is_union)) {
+            y = band->rc.bottom;
+            band = end;
+            continue;
+        }
+
+        if (band->rc.top < rc->top &&
+                (band = REGION_SplitBand (region, band, rc->top)) == NULL) {
+            ok = FALSE;
+            break;
+        }
+        if (band->rc.bottom > rc->bottom &&
+                !REGION_SplitBand (region, band, rc->bottom)) {
+            ok = FALSE;
+            break;
+        }
+
+        y = band->rc.bottom;
+        end = REGION_BandEnd (band);
+        if (is_union)
+            ok = REGION_UnionBand (region, band, end, rc->left, rc->right);
+        else
+            ok = REGION_SubtractBand (region, band, end, rc->left, rc->right);
+        if (!ok)
+            break;
+
+        band = end;
+    }
+
+    /* fill the gap below the last band */
+    if (ok && is_union && y < rc->bottom) {
+        if (!REGION_InsertRect (region, band ? band->prev : region->tail,
+                    rc->left, y, rc->right, rc->bottom))
+            ok = FALSE;
+    }
+
+    REGION_Tidy (region);
+    return ok;
+}
+
 /* Adds a rectangle to a region */
 BOOL GUIAPI AddClipRect (PCLIPRGN region, const RECT *rect)
 {
-    CLIPRGN my_region;
-    CLIPRECT my_cliprect;
+    BOOL ok;
 
     if (IsRectEmpty (rect))
         return FALSE;
@@ -1369,54 +1933,71 @@ BOOL GUIAPI AddClipRect (PCLIPRGN region, const RECT *rect)
     dbg_dumpRegion (region);
 #endif
 
-    my_cliprect.rc = *rect;
-    my_cliprect.next = NULL;
-    my_cliprect.prev = NULL;
-
-    my_region.type = SIMPLEREGION;
-    my_region.rcBound = *rect;
-    my_region.head = &my_cliprect;
-    my_region.tail = &my_cliprect;
-    my_region.heap = NULL;
-
-    UnionRegion (region, region, &my_region);
+    /* the rectangle covers the whole region */
+    if (region->head == NULL ||
+            (rect->left <= region->rcBound.left &&
+             rect->top <= region->rcBound.top &&
+             rect->right >= region->rcBound.right &&
+             rect->bottom >= region->rcBound.bottom))
+        ok = SetClipRgn (region, rect);
+    else
+        ok = REGION_RectOp (region, rect, TRUE);
 
 #ifdef _DEBUG_REGION
     dbg_dumpRegion (region);
     fprintf (stderr, "***************After Union\n");
 #endif
 
-    return TRUE;
+    return ok;
 }
 
 /* Intersect a rect with a region */
 BOOL GUIAPI IntersectClipRect (PCLIPRGN region, const RECT* rect)
 {
-    CLIPRGN my_region;
-    CLIPRECT my_cliprect;
+    CLIPRECT *cliprect;
 
-    if (IsRectEmpty (rect)) {
+    if (IsRectEmpty (rect) || !EXTENTCHECK (&region->rcBound, rect)) {
         EmptyClipRgn (region);
         return TRUE;
     }
 
+    /* the rectangle covers the whole region */
+    if (rect->left <= region->rcBound.left &&
+            rect->top <= region->rcBound.top &&
+            rect->right >= region->rcBound.right &&
+            rect->bottom >= region->rcBound.bottom)
+        return TRUE;
+
 #ifdef _DEBUG_REGION
     fprintf (stderr, "\n***************before intersect by rect (%d, %d, %d, %d):\n",
                     rect->left, rect->top, rect->right, rect->bottom);
     dbg_dumpRegion (region);
 #endif
 
-    my_cliprect.rc = *rect;
-    my_cliprect.next = NULL;
-    my_cliprect.prev = NULL;
+    /* clipping the rects keeps the bands; only coalescing is needed */
+    cliprect = region->head;
+    while (cliprect) {
+        RECT *rc = &cliprect->rc;
 
-    my_region.type = SIMPLEREGION;
-    my_region.rcBound = *rect;
-    my_region.head = &my_cliprect;
-    my_region.tail = &my_cliprect;
-    my_region.heap = NULL;
+        if (rc->top >= rect->bottom) {
+            /* too far down; drop the rest */
+            while (cliprect)
+                cliprect = REGION_RemoveRect (region, cliprect);
+            break;
+        }
 
-    ClipRgnIntersect (region, region, &my_region);
+        rc->left = MAX (rc->left, rect->left);
+        rc->top = MAX (rc->top, rect->top);
+        rc->right = MIN (rc->right, rect->right);
+        rc->bottom = MIN (rc->bottom, rect->bottom);
+
+        if (rc->left >= rc->right || rc->top >= rc->bottom)
+            cliprect = REGION_RemoveRect (region, cliprect);
+        else
+            cliprect = cliprect->next;
+    }
+
+    REGION_Tidy (region);
 
 #ifdef _DEBUG_REGION
     dbg_dumpRegion (region);
@@ -1428,8 +2009,7 @@ BOOL GUIAPI IntersectClipRect (PCLIPRGN region, const RECT* rect)
 
 BOOL GUIAPI SubtractClipRect (PCLIPRGN region, const RECT* rect)
 {
-    CLIPRGN my_region;
-    CLIPRECT my_cliprect;
+    BOOL ok;
 
     if (IsRectEmpty (rect) || !DoesIntersect (&region->rcBound, rect))
         return FALSE;
@@ -1440,24 +2020,23 @@ BOOL GUIAPI SubtractClipRect (PCLIPRGN region, const RECT* rect)
     dbg_dumpRegion (region);
 #endif
 
-    my_cliprect.rc = *rect;
-    my_cliprect.next = NULL;
-    my_cliprect.prev = NULL;
-
-    my_region.type = SIMPLEREGION;
-    my_region.rcBound = *rect;
-    my_region.head = &my_cliprect;
-    my_region.tail = &my_cliprect;
-    my_region.heap = NULL;
-
-    SubtractRegion (region, region, &my_region);
+    /* the rectangle covers the whole region */
+    if (rect->left <= region->rcBound.left &&
+            rect->top <= region->rcBound.top &&
+            rect->right >= region->rcBound.right &&
+            rect->bottom >= region->rcBound.bottom) {
+        EmptyClipRgn (region);
+        ok = TRUE;
+    }
+    else
+        ok = REGION_RectOp (region, rect, FALSE);
 
 #ifdef _DEBUG_REGION
     dbg_dumpRegion (region);
     fprintf (stderr, "***************After subtraction\n");
 #endif
 
-    return TRUE;
+    return ok;
 }
 
 #if 1
@@ -1476,6 +2055,8 @@ void GUIAPI OffsetRegionEx (PCLIPRGN region,
     if (!IntersectRect (&rc, rcClient, rcScroll))
         return;
 
+    REGION_Changed (region);
+
 #ifdef _DEBUG_REGION
     fprintf (stderr, "***************enter OffsetRegionEx\n");
     dbg_dumpRegion (region);
@@ -1566,6 +2147,8 @@ void GUIAPI OffsetRegionEx (PCLIPRGN region,
     if (!IntersectRect (&rc, rcClient, rcScroll))
         return;
 
+    REGION_Changed (region);
+
 #ifdef _DEBUG_REGION
     fprintf (stderr, "***************enter OffsetRegionEx\n");
     dbg_dumpRegion (region);
@@ -1624,6 +2207,8 @@ void GUIAPI OffsetRegion (PCLIPRGN region, int x, int y)
 {
     CLIPRECT* cliprect = region->head;
 
+    REGION_Changed (region);
+
     while (cliprect) {
         OffsetRect (&cliprect->rc, x, y);
         cliprect = cliprect->next;
@@ -0,0 +1,206 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+//                          IMPORTANT NOTICE
+//
+// The following open source license statement does not apply to any
+// entity in the Exception List published by FMSoft.
+//
+// For more information, please visit:
+//
+// https://www.fmsoft.cn/exception-list
+//
+//////////////////////////////////////////////////////////////////////////////
+/*
+ *   This file is part of MiniGUI, a mature cross-platform windowing
+ *   and Graphics User Interface (GUI) support system for embedded systems
+ *   and smart IoT devices.
+ *
+ *   Copyright (C) 2002~2020, Beijing FMSoft Technologies Co., Ltd.
+ *   Copyright (C) 1998~2002, WEI Yongming
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *   Or,
+ *
+ *   As this program is a library, any link to this program must follow
+ *   GNU General Public License version 3 (GPLv3). If you cannot accept
+ *   GPLv3, you need to be licensed from FMSoft.
+ *
+ *   If you have got a commercial license of this program, please use it
+ *   under the terms and conditions of the commercial license.
+ *
+ *   For more information about the commercial license, please refer to
+ *   <http://www.minigui.com/blog/minigui-licensing-policy/>.
+ */
+/*
+** premul-test.c: Tests drawing into a premultiplied memory DC.
+**
+** The test fills, draws text, and blits a straight alpha DC into a
+** memory DC created with MEMDC_FLAG_PREMULALPHA. The filled and blitted
+** pixels must be premultiplied (no color component larger than alpha).
+** Then the DC is blended onto an opaque white DC; every component of
+** the result must be the clamped sum of the premultiplied blend, which
+** fails if a component carries into the next one.
+**
+** The test exits with 0 if all the checks pass.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <minigui/common.h>
+#include <minigui/minigui.h>
+#include <minigui/gdi.h>
+#include <minigui/window.h>
+
+#define TEST_W      64
+#define TEST_H      48
+
+#define ARGB_MASKS  0x00FF0000, 0x0000FF00, 0x000000FF, 0xFF000000
+
+static int nr_failures;
+
+#define CHECK(cond, fmt, ...)                                           \
+    do {                                                                \
+        if (!(cond)) {                                                  \
+            if (nr_failures++ < 16)                                     \
+                fprintf (stderr, "FAILED: " fmt "\n", ##__VA_ARGS__);   \
+        }                                                               \
+    } while (0)
+
+static Uint32 get_pixel32 (HDC hdc, int x, int y)
+{
+    int w, h, pitch;
+    RECT rc = {x, y, x + 1, y + 1};
+    Uint8* bits;
+    Uint32 pixel;
+
+    bits = LockDC (hdc, &rc, &w, &h, &pitch);
+    pixel = *(Uint32*)bits;
+    UnlockDC (hdc);
+    return pixel;
+}
+
+/* every color component of the pixels in rc is not larger than alpha */
+static void check_premultiplied (HDC hdc, const RECT* rc, const char* what)
+{
+    int x, y;
+
+    for (y = rc->top; y < rc->bottom; y++) {
+        for (x = rc->left; x < rc->right; x++) {
+            Uint32 p = get_pixel32 (hdc, x, y);
+            Uint32 a = p >> 24;
+
+            CHECK (((p >> 16) & 0xFF) <= a && ((p >> 8) & 0xFF) <= a
+                    && (p & 0xFF) <= a,
+                    "%s: pixel 0x%08X at (%d, %d) is not premultiplied",
+                    what, p, x, y);
+        }
+    }
+}
+
+/* a component of the premultiplied blend onto an opaque white pixel */
+static Uint32 blend_on_white (Uint32 c, Uint32 a)
+{
+    c += (255 * (256 - a)) >> 8;
+    return c > 255 ? 255 : c;
+}
+
+static void check_blend (HDC premul_dc, HDC white_dc)
+{
+    int x, y, shift;
+
+    for (y = 0; y < TEST_H; y++) {
+        for (x = 0; x < TEST_W; x++) {
+            Uint32 s = get_pixel32 (premul_dc, x, y);
+            Uint32 d = get_pixel32 (white_dc, x, y);
+
+            for (shift = 0; shift < 24; shift += 8) {
+                Uint32 c = blend_on_white ((s >> shift) & 0xFF, s >> 24);
+
+                CHECK (((d >> shift) & 0xFF) == c,
+                        "blend: 0x%08X on white gave 0x%08X at (%d, %d)",
+                        s, d, x, y);
+            }
+        }
+    }
+}
+
+int MiniGUIMain (int argc, const char* argv[])
+{
+    HDC premul_dc, straight_dc, white_dc;
+    RECT rc_fill = {0, 0, TEST_W, TEST_H / 2};
+    RECT rc_raw = {0, TEST_H / 2, TEST_W / 2, TEST_H};
+    RECT rc_blit = {TEST_W / 2, TEST_H / 2, TEST_W, TEST_H};
+
+    premul_dc = CreateMemDC (TEST_W, TEST_H, 32,
+            MEMDC_FLAG_SWSURFACE | MEMDC_FLAG_SRCPIXELALPHA |
+            MEMDC_FLAG_PREMULALPHA, ARGB_MASKS);
+    straight_dc = CreateMemDC (TEST_W, TEST_H, 32,
+            MEMDC_FLAG_SWSURFACE | MEMDC_FLAG_SRCPIXELALPHA, ARGB_MASKS);
+    white_dc = CreateMemDC (TEST_W, TEST_H, 32,
+            MEMDC_FLAG_SWSURFACE, ARGB_MASKS);
+    if (premul_dc == HDC_INVALID || straight_dc == HDC_INVALID
+            || white_dc == HDC_INVALID) {
+        fprintf (stderr, "FAILED: can not create the memory DCs\n");
+        return 1;
+    }
+
+    /* a fill with a color mapped by the DC */
+    SetBrushColor (premul_dc, RGBA2Pixel (premul_dc, 0xFF, 0x80, 0x20, 0x80));
+    FillBox (premul_dc, rc_fill.left, rc_fill.top,
+            RECTW (rc_fill), RECTH (rc_fill));
+    check_premultiplied (premul_dc, &rc_fill, "fill");
+
+    /* a fill with a pixel value which is not premultiplied */
+    SetBrushColor (premul_dc, 0x40FFFFFF);
+    FillBox (premul_dc, rc_raw.left, rc_raw.top,
+            RECTW (rc_raw), RECTH (rc_raw));
+
+    /* straight alpha blits into the premultiplied DC */
+    SetBrushColor (straight_dc, RGBA2Pixel (straight_dc, 0xFF, 0x00, 0xFF, 0x60));
+    FillBox (straight_dc, 0, 0, TEST_W, TEST_H);
+    BitBlt (straight_dc, 0, 0, RECTW (rc_blit), RECTH (rc_blit),
+            premul_dc, rc_blit.left, rc_blit.top, 0);
+    check_premultiplied (premul_dc, &rc_blit, "straight alpha blit");
+
+    /* text over the fill and the raw pixels */
+    SetBkMode (premul_dc, BM_TRANSPARENT);
+    SetTextColor (premul_dc, RGBA2Pixel (premul_dc, 0xFF, 0xFF, 0xFF, 0xC0));
+    TextOut (premul_dc, 2, 2, "Premultiplied");
+    TextOut (premul_dc, 2, TEST_H / 2 + 2, "Alpha");
+
+    /* the premultiplied DC onto an opaque white DC */
+    SetBrushColor (white_dc, RGB2Pixel (white_dc, 0xFF, 0xFF, 0xFF));
+    FillBox (white_dc, 0, 0, TEST_W, TEST_H);
+    BitBlt (premul_dc, 0, 0, TEST_W, TEST_H, white_dc, 0, 0, 0);
+    check_blend (premul_dc, white_dc);
+
+    DeleteMemDC (white_dc);
+    DeleteMemDC (straight_dc);
+    DeleteMemDC (premul_dc);
+
+    if (nr_failures) {
+        fprintf (stderr, "premul-test: %d checks failed\n", nr_failures);
+        return 1;
+    }
+
+    printf ("premul-test: all checks passed\n");
+    return 0;
+}
+
+#ifdef _MGRM_THREADS
+#include <minigui/dti.c>
+#endif
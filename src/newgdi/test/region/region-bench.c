@@ -0,0 +1,468 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+//                          IMPORTANT NOTICE
+//
+// The following open source license statement does not apply to any
+// entity in the Exception List published by FMSoft.
+//
+// For more information, please visit:
+//
+// https://www.fmsoft.cn/exception-list
+//
+//////////////////////////////////////////////////////////////////////////////
+/*
+ *   This file is part of MiniGUI, a mature cross-platform windowing
+ *   and Graphics User Interface (GUI) support system for embedded systems
+ *   and smart IoT devices.
+ *
+ *   Copyright (C) 2002~2020, Beijing FMSoft Technologies Co., Ltd.
+ *   Copyright (C) 1998~2002, WEI Yongming
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *   Or,
+ *
+ *   As this program is a library, any link to this program must follow
+ *   GNU General Public License version 3 (GPLv3). If you cannot accept
+ *   GPLv3, you need to be licensed from FMSoft.
+ *
+ *   If you have got a commercial license of this program, please use it
+ *   under the terms and conditions of the commercial license.
+ *
+ *   For more information about the commercial license, please refer to
+ *   <http://www.minigui.com/blog/minigui-licensing-policy/>.
+ */
+/*
+** region-bench.c: A headless micro-benchmark of the region engine.
+**
+** The benchmark does not need a display: it only calls the region
+** functions on a private block data heap. Every benchmark runs on a
+** window stack, which is cascaded windows, a typical desktop, or read
+** from a file given by -f, and prints one CSV line:
+**
+**      workload,bench,iterations,ops_per_sec,ns_per_op,allocs_per_op,rects
+**
+** allocs_per_op counts the clipping rects allocated from the block heap
+** and all allocations from the system heap (including the buffers of the
+** region operations) per operation; rects is the number of clipping
+** rects in the result of the last operation, or the number of hits for
+** the point and rectangle queries.
+**
+** Usage: region-bench [-n iterations] [-w cascade|desktop|all]
+**                     [-f stack-file] [-b bench]
+**
+** A stack file has one window per line from the topmost to the bottommost,
+** in the form of `left top right bottom`; the lines starting with `#`
+** are ignored. A stack can be captured from a real session by printing
+** the window rects of the z-order, e.g. with GetWindowRect for the main
+** windows returned by GetNextMainWindow.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+
+#include <minigui/common.h>
+#include <minigui/minigui.h>
+#include <minigui/gdi.h>
+
+#define SCREEN_WIDTH        1024
+#define SCREEN_HEIGHT       768
+#define MAX_WINS            64
+#define SIZE_HEAP           4096
+#define NR_QUERIES          64
+
+typedef struct _WINSTACK {
+    const char* name;
+    int nr_wins;
+    RECT rcs [MAX_WINS];    /* from the topmost to the bottommost */
+} WINSTACK;
+
+/* a synthetic desktop: the typical windows of a session, hand placed */
+static const RECT typical_desktop [] = {
+    {  0, 736, 1024, 768 },     /* task bar */
+    { 612, 530, 742,  552 },    /* tooltip */
+    { 420, 180, 780,  470 },    /* message box */
+    { 300, 140, 480,  420 },    /* popup menu */
+    { 480, 210, 660,  330 },    /* sub menu */
+    { 120,  60, 840,  600 },    /* main window */
+    { 640, 320, 1000, 700 },    /* property sheet */
+    {  40, 100, 500,  520 },    /* file manager */
+    { 180, 420, 700,  730 },    /* terminal */
+    {  0,   0, 1024, 736 },     /* desktop */
+};
+
+static BLOCKHEAP heap;
+
+static WINSTACK stack;
+static CLIPRGN vis [MAX_WINS];
+static CLIPRGN rgn_a, rgn_b, rgn_c;
+
+static unsigned int seed = 1;
+
+static int rnd (int n)
+{
+    seed = seed * 1103515245 + 12345;
+    return (seed >> 8) % n;
+}
+
+static void rnd_rect (RECT* rc, int max_w, int max_h)
+{
+    int x = rnd (SCREEN_WIDTH), y = rnd (SCREEN_HEIGHT);
+
+    SetRect (rc, x, y, x + 1 + rnd (max_w), y + 1 + rnd (max_h));
+}
+
+static double now (void)
+{
+    struct timespec ts;
+
+    clock_gettime (CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+#ifdef __GLIBC__
+/*
+ * Count the allocations from the system heap by interposing malloc and
+ * friends; the calls from libminigui resolve to these ones as well.
+ */
+extern void* __libc_malloc (size_t size);
+extern void* __libc_calloc (size_t nmemb, size_t size);
+extern void* __libc_realloc (void* ptr, size_t size);
+
+static Uint64 nr_mallocs;
+
+void* malloc (size_t size)
+{
+    nr_mallocs++;
+    return __libc_malloc (size);
+}
+
+void* calloc (size_t nmemb, size_t size)
+{
+    nr_mallocs++;
+    return __libc_calloc (nmemb, size);
+}
+
+void* realloc (void* ptr, size_t size)
+{
+    nr_mallocs++;
+    return __libc_realloc (ptr, size);
+}
+#else
+#   warning "allocs_per_op only counts the block heap on this C library"
+static Uint64 nr_mallocs;
+#endif
+
+static Uint64 nr_allocs (void)
+{
+    BLOCKHEAPSTATS stats;
+
+    /* the overflows of the block heap are counted by malloc */
+    GetBlockDataHeapStats (&heap, &stats);
+    return stats.nr_hits + nr_mallocs;
+}
+
+static int count_rects (const CLIPRGN* rgn)
+{
+    PCLIPRECT crc;
+    int n = 0;
+
+    for (crc = rgn->head; crc; crc = crc->next)
+        n++;
+    return n;
+}
+
+static void make_cascade (WINSTACK* ws, int nr_wins)
+{
+    int i;
+
+    ws->name = "cascade";
+    ws->nr_wins = nr_wins;
+    for (i = 0; i < nr_wins; i++) {
+        int x = (nr_wins - 1 - i) * 30, y = (nr_wins - 1 - i) * 24;
+        SetRect (ws->rcs + i, x, y, x + 480, y + 360);
+    }
+}
+
+static void make_desktop (WINSTACK* ws)
+{
+    ws->name = "desktop";
+    ws->nr_wins = TABLESIZE (typical_desktop);
+    memcpy (ws->rcs, typical_desktop, sizeof (typical_desktop));
+}
+
+static BOOL load_stack (WINSTACK* ws, const char* file)
+{
+    FILE* fp;
+    char line [256];
+    RECT rc;
+
+    if ((fp = fopen (file, "r")) == NULL) {
+        perror (file);
+        return FALSE;
+    }
+
+    ws->name = "file";
+    ws->nr_wins = 0;
+    while (fgets (line, sizeof (line), fp) && ws->nr_wins < MAX_WINS) {
+        if (line [0] == '#')
+            continue;
+        if (sscanf (line, "%d %d %d %d", &rc.left, &rc.top,
+                    &rc.right, &rc.bottom) == 4 && !IsRectEmpty (&rc))
+            ws->rcs [ws->nr_wins++] = rc;
+    }
+
+    fclose (fp);
+    return ws->nr_wins > 0;
+}
+
+/* Recalculates the visible regions of all windows in the stack. */
+static int bench_visible (void)
+{
+    int i;
+
+    EmptyClipRgn (&rgn_a);
+    for (i = 0; i < stack.nr_wins; i++) {
+        SetClipRgn (&rgn_b, stack.rcs + i);
+        SubtractRegion (vis + i, &rgn_b, &rgn_a);
+        UnionRegion (&rgn_a, &rgn_a, &rgn_b);
+    }
+
+    return count_rects (&rgn_a);
+}
+
+/* Clips random damaged areas by the visible regions. */
+static int bench_damage (void)
+{
+    RECT rc;
+    int i, n = 0;
+
+    EmptyClipRgn (&rgn_b);
+    for (i = 0; i < 8; i++) {
+        rnd_rect (&rc, 200, 150);
+        AddClipRect (&rgn_b, &rc);
+    }
+
+    for (i = 0; i < stack.nr_wins; i++) {
+        ClipRgnIntersect (&rgn_c, vis + i, &rgn_b);
+        n += count_rects (&rgn_c);
+    }
+
+    return n;
+}
+
+/* Pops up and closes a menu with two sub menus over the bottom window. */
+static int bench_popup (void)
+{
+    static const RECT menus [] = {
+        { 200, 120, 380, 420 },
+        { 380, 180, 560, 300 },
+        { 560, 240, 720, 330 },
+    };
+    int i, n;
+
+    CopyRegion (&rgn_c, vis + stack.nr_wins - 1);
+    for (i = 0; i < TABLESIZE (menus); i++)
+        SubtractClipRect (&rgn_c, menus + i);
+    n = count_rects (&rgn_c);
+    for (i = TABLESIZE (menus) - 1; i >= 0; i--) {
+        AddClipRect (&rgn_c, menus + i);
+        IntersectClipRect (&rgn_c, stack.rcs + stack.nr_wins - 1);
+    }
+
+    return n;
+}
+
+/* Clips the topmost window by a mask with round corners. */
+static int bench_round_corner (void)
+{
+    const RECT* rc = stack.rcs;
+    int r = 12;
+    RECT body;
+
+    EmptyClipRgn (&rgn_b);
+    InitCircleRegion (&rgn_c, rc->left + r, rc->top + r, r);
+    UnionRegion (&rgn_b, &rgn_b, &rgn_c);
+    InitCircleRegion (&rgn_c, rc->right - r - 1, rc->top + r, r);
+    UnionRegion (&rgn_b, &rgn_b, &rgn_c);
+    InitCircleRegion (&rgn_c, rc->left + r, rc->bottom - r - 1, r);
+    UnionRegion (&rgn_b, &rgn_b, &rgn_c);
+    InitCircleRegion (&rgn_c, rc->right - r - 1, rc->bottom - r - 1, r);
+    UnionRegion (&rgn_b, &rgn_b, &rgn_c);
+
+    SetRect (&body, rc->left + r, rc->top, rc->right - r, rc->bottom);
+    AddClipRect (&rgn_b, &body);
+    SetRect (&body, rc->left, rc->top + r, rc->right, rc->bottom - r);
+    AddClipRect (&rgn_b, &body);
+
+    ClipRgnIntersect (&rgn_c, vis, &rgn_b);
+    return count_rects (&rgn_c);
+}
+
+/* Builds a star-shaped polygon region. */
+static int bench_polygon (void)
+{
+    static const POINT star [] = {
+        { 300, 100 }, { 340, 220 }, { 460, 220 }, { 360, 290 },
+        { 400, 410 }, { 300, 340 }, { 200, 410 }, { 240, 290 },
+        { 140, 220 }, { 260, 220 },
+    };
+
+    InitPolygonRegion (&rgn_c, star, TABLESIZE (star));
+    return count_rects (&rgn_c);
+}
+
+/* Moves the visible region of the bottom window back and forth. */
+static int bench_offset (void)
+{
+    OffsetRegion (vis + stack.nr_wins - 1, 7, -5);
+    OffsetRegion (vis + stack.nr_wins - 1, -7, 5);
+    return count_rects (vis + stack.nr_wins - 1);
+}
+
+static int bench_pt_in_region (void)
+{
+    int i, n = 0;
+
+    for (i = 0; i < NR_QUERIES; i++)
+        n += PtInRegion (vis + stack.nr_wins - 1,
+                rnd (SCREEN_WIDTH), rnd (SCREEN_HEIGHT));
+    return n;
+}
+
+static int bench_rect_in_region (void)
+{
+    RECT rc;
+    int i, n = 0;
+
+    for (i = 0; i < NR_QUERIES; i++) {
+        rnd_rect (&rc, 40, 40);
+        n += RectInRegion (vis + stack.nr_wins - 1, &rc);
+    }
+    return n;
+}
+
+static const struct {
+    const char* name;
+    int (*run) (void);
+} benches [] = {
+    { "visible",            bench_visible },
+    { "damage",             bench_damage },
+    { "popup",              bench_popup },
+    { "round_corner",       bench_round_corner },
+    { "polygon",            bench_polygon },
+    { "offset",             bench_offset },
+    { "pt_in_region",       bench_pt_in_region },
+    { "rect_in_region",     bench_rect_in_region },
+};
+
+static void run_workload (int iterations, const char* only)
+{
+    int i, j, result = 0;
+    double t;
+    Uint64 allocs;
+
+    /* the other benchmarks need the visible regions */
+    bench_visible ();
+
+    for (i = 0; i < TABLESIZE (benches); i++) {
+        if (only && strcmp (only, benches [i].name))
+            continue;
+
+        seed = 1;
+        benches [i].run ();     /* warm up */
+
+        allocs = nr_allocs ();
+        t = now ();
+        for (j = 0; j < iterations; j++)
+            result = benches [i].run ();
+        t = now () - t;
+        allocs = nr_allocs () - allocs;
+
+        printf ("%s,%s,%d,%.0f,%.1f,%.2f,%d\n", stack.name, benches [i].name,
+                iterations, iterations / t, t * 1e9 / iterations,
+                (double)allocs / iterations, result);
+    }
+}
+
+int main (int argc, char* argv [])
+{
+    const char* workload = "all";
+    const char* file = NULL;
+    const char* only = NULL;
+    int iterations = 10000;
+    int i, opt;
+
+    while ((opt = getopt (argc, argv, "n:w:f:b:")) != -1) {
+        switch (opt) {
+        case 'n':
+            iterations = atoi (optarg);
+            break;
+        case 'w':
+            workload = optarg;
+            break;
+        case 'f':
+            file = optarg;
+            break;
+        case 'b':
+            only = optarg;
+            break;
+        default:
+            fprintf (stderr, "Usage: %s [-n iterations] "
+                    "[-w cascade|desktop|all] [-f stack-file] [-b bench]\n",
+                    argv [0]);
+            return 1;
+        }
+    }
+
+    if (iterations <= 0)
+        iterations = 1;
+
+    InitFreeClipRectList (&heap, SIZE_HEAP);
+    InitClipRgn (&rgn_a, &heap);
+    InitClipRgn (&rgn_b, &heap);
+    InitClipRgn (&rgn_c, &heap);
+    for (i = 0; i < MAX_WINS; i++)
+        InitClipRgn (vis + i, &heap);
+
+    printf ("workload,bench,iterations,ops_per_sec,ns_per_op,allocs_per_op,rects\n");
+
+    if (file) {
+        if (!load_stack (&stack, file))
+            return 2;
+        run_workload (iterations, only);
+    }
+    else {
+        if (!strcmp (workload, "cascade") || !strcmp (workload, "all")) {
+            make_cascade (&stack, 16);
+            run_workload (iterations, only);
+        }
+        if (!strcmp (workload, "desktop") || !strcmp (workload, "all")) {
+            make_desktop (&stack);
+            run_workload (iterations, only);
+        }
+    }
+
+    EmptyClipRgn (&rgn_a);
+    EmptyClipRgn (&rgn_b);
+    EmptyClipRgn (&rgn_c);
+    for (i = 0; i < MAX_WINS; i++)
+        EmptyClipRgn (vis + i);
+    DestroyFreeClipRectList (&heap);
+
+    return 0;
+}
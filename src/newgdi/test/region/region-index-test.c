@@ -0,0 +1,205 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+//                          IMPORTANT NOTICE
+//
+// The following open source license statement does not apply to any
+// entity in the Exception List published by FMSoft.
+//
+// For more information, please visit:
+//
+// https://www.fmsoft.cn/exception-list
+//
+//////////////////////////////////////////////////////////////////////////////
+/*
+ *   This file is part of MiniGUI, a mature cross-platform windowing
+ *   and Graphics User Interface (GUI) support system for embedded systems
+ *   and smart IoT devices.
+ *
+ *   Copyright (C) 2002~2020, Beijing FMSoft Technologies Co., Ltd.
+ *   Copyright (C) 1998~2002, WEI Yongming
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *   Or,
+ *
+ *   As this program is a library, any link to this program must follow
+ *   GNU General Public License version 3 (GPLv3). If you cannot accept
+ *   GPLv3, you need to be licensed from FMSoft.
+ *
+ *   If you have got a commercial license of this program, please use it
+ *   under the terms and conditions of the commercial license.
+ *
+ *   For more information about the commercial license, please refer to
+ *   <http://www.minigui.com/blog/minigui-licensing-policy/>.
+ */
+/*
+** region-index-test.c: A headless test of the band index of regions.
+**
+** PtInRegion and RectInRegion answer the queries on a complex region by
+** a band index once the region is queried twice. The test checks that
+** the index of a region is kept when another region is changed, that it
+** is dropped when the region itself is changed, and that the answers are
+** the same as the ones found by walking the clipping rects.
+**
+** Whether an index is built is told by the allocations from the system
+** heap: building one allocates two buffers, and a query by an index
+** allocates nothing. The allocations are counted by interposing malloc,
+** so the test needs the GNU C library.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <minigui/common.h>
+#include <minigui/minigui.h>
+#include <minigui/gdi.h>
+
+#define SIZE_HEAP           256
+
+extern void* __libc_malloc (size_t size);
+extern void* __libc_calloc (size_t nmemb, size_t size);
+extern void* __libc_realloc (void* ptr, size_t size);
+
+static int nr_mallocs;
+
+void* malloc (size_t size)
+{
+    nr_mallocs++;
+    return __libc_malloc (size);
+}
+
+void* calloc (size_t nmemb, size_t size)
+{
+    nr_mallocs++;
+    return __libc_calloc (nmemb, size);
+}
+
+void* realloc (void* ptr, size_t size)
+{
+    nr_mallocs++;
+    return __libc_realloc (ptr, size);
+}
+
+static BLOCKHEAP heap;
+static CLIPRGN rgn_queried, rgn_other, rgn_result;
+static int nr_failures;
+
+static void check (BOOL ok, const char* what)
+{
+    printf ("%s: %s\n", ok ? "PASS" : "FAIL", what);
+    if (!ok)
+        nr_failures++;
+}
+
+/* a checkerboard of 8x8 cells, so the region has many bands and rects */
+static void make_board (CLIPRGN* rgn, int x, int y)
+{
+    RECT rc;
+    int i, j;
+
+    EmptyClipRgn (rgn);
+    for (i = 0; i < 8; i++) {
+        for (j = (i & 1); j < 8; j += 2) {
+            SetRect (&rc, x + j * 10, y + i * 10,
+                    x + j * 10 + 10, y + i * 10 + 10);
+            AddClipRect (rgn, &rc);
+        }
+    }
+}
+
+static BOOL walk_pt_in_region (const CLIPRGN* rgn, int x, int y)
+{
+    const CLIPRECT* crc;
+
+    for (crc = rgn->head; crc; crc = crc->next) {
+        if (PtInRect (&crc->rc, x, y))
+            return TRUE;
+    }
+    return FALSE;
+}
+
+/* Returns the number of the system heap allocations made by two queries. */
+static int query_twice (CLIPRGN* rgn, int x, int y)
+{
+    int nr = nr_mallocs;
+
+    PtInRegion (rgn, x, y);
+    PtInRegion (rgn, x, y);
+    return nr_mallocs - nr;
+}
+
+static BOOL same_answers (CLIPRGN* rgn)
+{
+    int x, y;
+
+    for (y = rgn->rcBound.top - 2; y < rgn->rcBound.bottom + 2; y++) {
+        for (x = rgn->rcBound.left - 2; x < rgn->rcBound.right + 2; x++) {
+            if (PtInRegion (rgn, x, y) != walk_pt_in_region (rgn, x, y))
+                return FALSE;
+        }
+    }
+    return TRUE;
+}
+
+int main (void)
+{
+    RECT rc;
+
+    InitFreeClipRectList (&heap, SIZE_HEAP);
+    InitClipRgn (&rgn_queried, &heap);
+    InitClipRgn (&rgn_other, &heap);
+    InitClipRgn (&rgn_result, &heap);
+
+    make_board (&rgn_queried, 0, 0);
+    make_board (&rgn_other, 200, 200);
+
+    check (query_twice (&rgn_queried, 15, 5) == 2,
+            "the index is built by the second query");
+    check (query_twice (&rgn_queried, 15, 5) == 0,
+            "the index is used by the later queries");
+
+    /* change other regions in place and by the region operations */
+    SetRect (&rc, 200, 200, 215, 215);
+    SubtractClipRect (&rgn_other, &rc);
+    OffsetRegion (&rgn_other, 3, 3);
+    UnionRegion (&rgn_result, &rgn_other, &rgn_other);
+    EmptyClipRgn (&rgn_result);
+    check (query_twice (&rgn_queried, 15, 5) == 0,
+            "the index survives the changes of other regions");
+    check (same_answers (&rgn_queried),
+            "the answers by the index are right");
+
+    /* move the rects in place: the head and the tail are the same */
+    OffsetRegion (&rgn_queried, 10, 0);
+    check (query_twice (&rgn_queried, 15, 5) == 2,
+            "the index is dropped when the region is changed");
+    check (same_answers (&rgn_queried),
+            "the answers after the change are right");
+
+    /* intersect in place, which keeps the head and the bounding rect */
+    SetRect (&rc, 0, 0, 1000, 75);
+    make_board (&rgn_queried, 0, 0);
+    query_twice (&rgn_queried, 15, 5);
+    IntersectClipRect (&rgn_queried, &rc);
+    check (same_answers (&rgn_queried),
+            "the answers after an intersection are right");
+
+    EmptyClipRgn (&rgn_queried);
+    EmptyClipRgn (&rgn_other);
+    EmptyClipRgn (&rgn_result);
+    DestroyFreeClipRectList (&heap);
+
+    return nr_failures ? 1 : 0;
+}
@@ -199,6 +199,7 @@ int _gdi_text_out (PDC pdc, int x, int y,
                 const unsigned char* text, int len, POINT* cur_pos)
 {
     TEXTOUT_CTXT ctxt;
+    GLYPH_RUN run;
 
     /* convert to the start point on baseline. */
     _gdi_get_baseline_point (pdc, &x, &y);
@@ -210,8 +211,10 @@ int _gdi_text_out (PDC pdc, int x, int y,
     ctxt.only_extent = FALSE;
 
     _gdi_start_new_line (pdc);
+    _gdi_begin_glyph_run (pdc, &run);
     _gdi_reorder_text (pdc, text, len,
         (pdc->ta_flags & TA_X_MASK) != TA_RIGHT, cb_textout, &ctxt);
+    _gdi_end_glyph_run (pdc, &run);
 
     if (cur_pos) {
         cur_pos->x = ctxt.x;
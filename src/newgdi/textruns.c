@@ -85,6 +85,7 @@ enum {
 
 typedef struct _TextRunState {
     TEXTRUNS*   runinfo;
+    struct list_head* truns;    // the list to add the runs to
     const Uchar32*  text;
     const Uchar32*  end;
     TextRun*        run;
@@ -244,7 +245,7 @@ static void state_add_character(TextRunState *state,
             TEXTRUN_FLAG_CENTERED_BASELINE : 0;
 #endif
 
-    list_add_tail(&state->run->list, &state->runinfo->truns);
+    list_add_tail(&state->run->list, state->truns);
     state->runinfo->nr_runs++;
 }
 
@@ -325,6 +326,7 @@ static BOOL create_text_runs(TEXTRUNS* runinfo, BidiLevel* els)
         goto out;
 
     state.runinfo = runinfo;
+    state.truns = &runinfo->truns;
     state.text = runinfo->ucs;
     state.end = runinfo->ucs + runinfo->nr_ucs;
     state.run = NULL;
@@ -460,6 +462,7 @@ TEXTRUNS* GUIAPI CreateTextRuns(const Uchar32* ucs, int nr_ucs,
     TEXTRUNS* runinfo;
     BidiLevel  local_els[LOCAL_ARRAY_SIZE];
     BidiLevel* els = NULL;
+    ParagraphDir req_dir = base_dir;
 
     if (ucs == NULL || nr_ucs <= 0 || logfont_name == NULL) {
         return NULL;
@@ -496,6 +499,7 @@ TEXTRUNS* GUIAPI CreateTextRuns(const Uchar32* ucs, int nr_ucs,
         runinfo->lc     = LANGCODE_en;  // fallback to English
     else
         runinfo->lc     = lang_code;
+    runinfo->req_dir  = req_dir;
     runinfo->base_dir = base_dir;
 
 #if 0
@@ -627,54 +631,13 @@ TextRun* __mg_text_run_split(TextRun *orig, int split_index)
     return new_run;
 }
 
-BOOL GUIAPI SetFontNameInTextRuns(TEXTRUNS* runinfo,
+static BOOL set_fontname_in_runs(TEXTRUNS* runinfo,
         int start_index, int length, const char* logfont_name)
 {
     TextRun* run;
     int start_offset;
-    int left_ucs;;
-
-    if (runinfo == NULL || logfont_name == NULL ||
-            start_index < 0 || start_index >= runinfo->nr_ucs)
-        return FALSE;
-
-    // can not change font for empty runs
-    if (list_empty(&runinfo->truns))
-        return FALSE;
-
-    if (!is_fontname_conformed(logfont_name)) {
-        return FALSE;
-    }
-
-    // normalize length
-    if (length <= 0)
-        length = runinfo->nr_ucs;
-    if ((start_index + length) > runinfo->nr_ucs)
-        length = runinfo->nr_ucs - start_index;
-
-    // change the default fontname
-    if (start_index == 0 && length >= runinfo->nr_ucs) {
-        struct list_head* i;
+    int left_ucs = length;
 
-        // reset all runs fontname
-        list_for_each(i, &runinfo->truns) {
-            TextRun* run = (TextRun*)i;
-            if (run->fontname) {
-                free(run->fontname);
-                run->fontname = NULL;
-            }
-        }
-
-        // do not allow to set the same font as the default
-        if (strcmp(logfont_name, runinfo->fontname) == 0)
-            return TRUE;
-
-        free(runinfo->fontname);
-        runinfo->fontname = strdup(logfont_name);
-        return TRUE;
-    }
-
-    left_ucs = length;
     while (left_ucs > 0) {
         run = __mg_text_run_get_by_offset(runinfo, start_index, &start_offset);
 
@@ -702,7 +665,8 @@ BOOL GUIAPI SetFontNameInTextRuns(TEXTRUNS* runinfo,
             else {
                 TextRun* new_run;
 
-                new_run = __mg_text_run_split(run, run->len - left_ucs);
+                // the new run is the head of the run
+                new_run = __mg_text_run_split(run, left_ucs);
                 new_run->fontname = strdup(logfont_name);
                 // insert the new run to the list.
                 __list_add(&new_run->list, run->list.prev, &run->list);
@@ -725,6 +689,52 @@ BOOL GUIAPI SetFontNameInTextRuns(TEXTRUNS* runinfo,
     return TRUE;
 }
 
+BOOL GUIAPI SetFontNameInTextRuns(TEXTRUNS* runinfo,
+        int start_index, int length, const char* logfont_name)
+{
+    if (runinfo == NULL || logfont_name == NULL ||
+            start_index < 0 || start_index >= runinfo->nr_ucs)
+        return FALSE;
+
+    // can not change font for empty runs
+    if (list_empty(&runinfo->truns))
+        return FALSE;
+
+    if (!is_fontname_conformed(logfont_name)) {
+        return FALSE;
+    }
+
+    // normalize length
+    if (length <= 0)
+        length = runinfo->nr_ucs;
+    if ((start_index + length) > runinfo->nr_ucs)
+        length = runinfo->nr_ucs - start_index;
+
+    // change the default fontname
+    if (start_index == 0 && length >= runinfo->nr_ucs) {
+        struct list_head* i;
+
+        // reset all runs fontname
+        list_for_each(i, &runinfo->truns) {
+            TextRun* run = (TextRun*)i;
+            if (run->fontname) {
+                free(run->fontname);
+                run->fontname = NULL;
+            }
+        }
+
+        // do not allow to set the same font as the default
+        if (strcmp(logfont_name, runinfo->fontname) == 0)
+            return TRUE;
+
+        free(runinfo->fontname);
+        runinfo->fontname = strdup(logfont_name);
+        return TRUE;
+    }
+
+    return set_fontname_in_runs(runinfo, start_index, length, logfont_name);
+}
+
 const char* GUIAPI GetFontNameInTextRuns(const TEXTRUNS* runinfo, int index)
 {
     struct list_head *i;
@@ -867,6 +877,216 @@ RGBCOLOR GetBackgroundColorInTextRuns(const TEXTRUNS* runinfo, int index)
     return runinfo->bg_colors.value;
 }
 
+/*
+ * Maps an index in the text before a change to the one after the change.
+ * The characters inserted take the attributes of the character before them.
+ */
+static inline int map_index_after_change(int index,
+        int start_index, int old_length, int new_length)
+{
+    if (index < start_index)
+        return index;
+    if (index >= start_index + old_length)
+        return index + new_length - old_length;
+    return start_index + new_length;
+}
+
+static void update_color_map(TextColorMap* head, int nr_ucs,
+        int start_index, int old_length, int new_length)
+{
+    struct list_head *i, *n;
+
+    list_for_each_safe(i, n, &head->list) {
+        TextColorMap* entry = (TextColorMap*)i;
+        int si, end;
+
+        si = map_index_after_change(entry->si,
+                start_index, old_length, new_length);
+        end = map_index_after_change(entry->si + entry->len,
+                start_index, old_length, new_length);
+        if (end <= si) {
+            list_del(i);
+            mg_slice_delete(TextColorMap, entry);
+        }
+        else {
+            entry->si = si;
+            entry->len = end - si;
+        }
+    }
+
+    head->len = nr_ucs;
+}
+
+static void free_text_runs(struct list_head* truns)
+{
+    while (!list_empty(truns)) {
+        TextRun* run = (TextRun*)truns->prev;
+        list_del(truns->prev);
+        if (run->fontname)
+            free(run->fontname);
+        mg_slice_delete(TextRun, run);
+    }
+}
+
+static BOOL is_same_run(const TextRun* old_run, const TextRun* new_run,
+        int delta)
+{
+    if (old_run->si + delta != new_run->si || old_run->len != new_run->len ||
+            old_run->lc != new_run->lc || old_run->st != new_run->st ||
+            old_run->el != new_run->el || old_run->flags != new_run->flags)
+        return FALSE;
+
+    if (old_run->fontname == NULL || new_run->fontname == NULL)
+        return old_run->fontname == new_run->fontname;
+
+    return strcmp(old_run->fontname, new_run->fontname) == 0;
+}
+
+/*
+ * The text runs are generated again for the whole paragraph, since the
+ * embedding levels depend on the whole paragraph, and generating them
+ * costs much less than shaping the glyphs and breaking the lines. The
+ * runs not changed at the head and the tail of the paragraph give the
+ * range of the change, which is used by UpdateLayout to reuse the lines.
+ */
+BOOL GUIAPI UpdateTextRuns(TEXTRUNS* runinfo,
+        const Uchar32* ucs, int nr_ucs,
+        int start_index, int old_length, int new_length,
+        BreakOppo* break_oppos)
+{
+    BOOL ok = FALSE;
+    struct list_head old_truns;
+    struct list_head *i, *j;
+    const Uchar32* old_ucs;
+    int old_nr_ucs, delta;
+    int chg_si, chg_old_end;
+    BidiLevel  local_els[LOCAL_ARRAY_SIZE];
+    BidiLevel* els = NULL;
+    ParagraphDir base_dir;
+
+    if (runinfo == NULL || ucs == NULL || nr_ucs <= 0 ||
+            start_index < 0 || old_length < 0 || new_length < 0 ||
+            start_index + old_length > runinfo->nr_ucs ||
+            nr_ucs != runinfo->nr_ucs - old_length + new_length) {
+        return FALSE;
+    }
+
+    if (nr_ucs < LOCAL_ARRAY_SIZE)
+        els = local_els;
+    else
+        els = (BidiLevel*)malloc(nr_ucs * sizeof(BidiLevel));
+
+    if (!els) {
+        _ERR_PRINTF("%s: failed to allocate space for embedding levels.\n",
+            __FUNCTION__);
+        return FALSE;
+    }
+
+    base_dir = runinfo->req_dir;
+    UBidiGetParagraphEmbeddingLevelsAlt(ucs, nr_ucs, &base_dir, els);
+
+    // keep the old runs to find the runs not changed
+    list_move(&old_truns, &runinfo->truns);
+    old_ucs = runinfo->ucs;
+    old_nr_ucs = runinfo->nr_ucs;
+
+    runinfo->ucs = ucs;
+    runinfo->nr_ucs = nr_ucs;
+    runinfo->nr_runs = 0;
+    if (!create_text_runs(runinfo, els)) {
+        _ERR_PRINTF("%s: failed to call create_text_runs.\n",
+            __FUNCTION__);
+
+        free_text_runs(&runinfo->truns);
+        list_move(&runinfo->truns, &old_truns);
+        runinfo->ucs = old_ucs;
+        runinfo->nr_ucs = old_nr_ucs;
+        runinfo->nr_runs = 0;
+        list_for_each(i, &runinfo->truns) {
+            runinfo->nr_runs++;
+        }
+        goto out;
+    }
+
+    // apply the fontnames of the old runs to the new ones
+    list_for_each(i, &old_truns) {
+        TextRun* run = (TextRun*)i;
+        int si, end;
+
+        if (run->fontname == NULL)
+            continue;
+
+        si = map_index_after_change(run->si,
+                start_index, old_length, new_length);
+        end = map_index_after_change(run->si + run->len,
+                start_index, old_length, new_length);
+        if (end > si)
+            set_fontname_in_runs(runinfo, si, end - si, run->fontname);
+    }
+
+    // find the runs not changed at the head
+    chg_si = 0;
+    for (i = old_truns.next, j = runinfo->truns.next;
+            i != &old_truns && j != &runinfo->truns;
+            i = i->next, j = j->next) {
+        const TextRun* old_run = (const TextRun*)i;
+
+        if (old_run->si + old_run->len > start_index ||
+                !is_same_run(old_run, (const TextRun*)j, 0))
+            break;
+        chg_si = old_run->si + old_run->len;
+    }
+
+    // find the runs not changed at the tail
+    delta = new_length - old_length;
+    chg_old_end = old_nr_ucs;
+    for (i = old_truns.prev, j = runinfo->truns.prev;
+            i != &old_truns && j != &runinfo->truns;
+            i = i->prev, j = j->prev) {
+        const TextRun* old_run = (const TextRun*)i;
+
+        if (old_run->si < start_index + old_length ||
+                old_run->si < chg_si ||
+                !is_same_run(old_run, (const TextRun*)j, delta))
+            break;
+        chg_old_end = old_run->si;
+    }
+
+    if (base_dir != runinfo->base_dir) {
+        // the direction of all lines changed
+        chg_si = 0;
+        chg_old_end = old_nr_ucs;
+        runinfo->base_dir = base_dir;
+    }
+
+    runinfo->chg_si = chg_si;
+    runinfo->chg_old_len = chg_old_end - chg_si;
+    runinfo->chg_new_len = chg_old_end + delta - chg_si;
+    runinfo->nr_changes++;
+
+    update_color_map(&runinfo->fg_colors, nr_ucs,
+            start_index, old_length, new_length);
+    update_color_map(&runinfo->bg_colors, nr_ucs,
+            start_index, old_length, new_length);
+
+    if (break_oppos) {
+        list_for_each(i, &runinfo->truns) {
+            TextRun* trun = (TextRun*)i;
+            UStrTailorBreaks(trun->st, runinfo->ucs + trun->si, trun->len,
+                break_oppos + trun->si);
+        }
+    }
+
+    free_text_runs(&old_truns);
+    ok = TRUE;
+
+out:
+    if (els && els != local_els)
+        free(els);
+
+    return ok;
+}
+
 BOOL GUIAPI DestroyTextRuns(TEXTRUNS* runinfo)
 {
     if (runinfo == NULL)
@@ -884,13 +1104,7 @@ BOOL GUIAPI DestroyTextRuns(TEXTRUNS* runinfo)
         mg_slice_delete(TextColorMap, entry);
     }
 
-    while (!list_empty(&runinfo->truns)) {
-        TextRun* run = (TextRun*)runinfo->truns.prev;
-        list_del(runinfo->truns.prev);
-        if (run->fontname)
-            free(run->fontname);
-        mg_slice_delete(TextRun, run);
-    }
+    free_text_runs(&runinfo->truns);
 
     if (runinfo->sei.inst) {
         runinfo->sei.free(runinfo->sei.inst);
@@ -120,6 +120,13 @@ struct _TEXTRUNS {
     int                 nr_runs;    // number of runs
     LanguageCode        lc;         // language code specified
     ParagraphDir        base_dir;   // paragraph base direction
+    ParagraphDir        req_dir;    // paragraph base direction requested
+
+    /* The following fields will be updated by UpdateTextRuns. */
+    Uint32              nr_changes; // number of the changes of the text
+    int                 chg_si;     // start index of the last change
+    int                 chg_old_len;// length of the changed text before
+    int                 chg_new_len;// length of the changed text after
 
 #if 0
     Uint32      lc:8;           // language code specified
@@ -118,12 +118,16 @@ static char* _rtos_xvfb_values[]={
 static char* _shadow_keys[]={
     "real_engine",
     "defaultmode",
-    "rotate_screen"
+    "rotate_screen",
+    "refresh_fps",
+    "damage_tile_size"
 };
 static char* _shadow_values[]={
     "pc_xvfb",
     "800x600-16bpp",
-    "normal"
+    "normal",
+    "60",
+    "0"
 };
 #endif
 #ifdef _MGGAL_MLSHADOW
@@ -811,7 +815,7 @@ static ETCSECTION _etc_sections [] = {
 #endif
     {0, 1, "rtos_xvfb", _rtos_xvfb_keys,_rtos_xvfb_values },
 #ifdef _MGGAL_SHADOW
-    {0, 3, "shadow", _shadow_keys,_shadow_values },
+    {0, 5, "shadow", _shadow_keys,_shadow_values },
 #endif
 #ifdef _MGGAL_MLSHADOW
     {0, 4, "mlshadow", _mlshadow_keys,_mlshadow_values },